@@ -0,0 +1,94 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "lt_geometry.hpp"
+#include "lt_random.hpp"
+
+// Build time of the 4-wide BVH over a height field terrain (1M triangles by default), and the
+// time per ray of closest hit and occlusion queries against it.
+
+lt_internal f64
+seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+}
+
+int
+main(int argc, char **argv)
+{
+    const u32 num_triangles = argc > 1 ? (u32)strtoul(argv[1], nullptr, 10) : 1000000;
+    const u32 num_rays = argc > 2 ? (u32)strtoul(argv[2], nullptr, 10) : 1000000;
+
+    // Grid of quads, two triangles each.
+    const u32 side = (u32)std::sqrt((f64)num_triangles / 2.0) + 1;
+    std::vector<Vec3f> positions;
+    std::vector<u32> indices;
+    positions.reserve((usize)(side + 1) * (side + 1));
+    for (u32 y = 0; y <= side; y++)
+        for (u32 x = 0; x <= side; x++)
+        {
+            const f32 h = std::sin(x * 0.05f) * std::cos(y * 0.07f) * 20.0f + std::sin(x * 0.31f + y * 0.17f);
+            positions.push_back(Vec3f((f32)x, h, (f32)y));
+        }
+    indices.reserve((usize)side * side * 6);
+    for (u32 y = 0; y < side; y++)
+        for (u32 x = 0; x < side; x++)
+        {
+            const u32 i = y * (side + 1) + x;
+            const u32 quad[6] = {i, i + side + 1, i + 1, i + 1, i + side + 1, i + side + 2};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    const usize triangles = indices.size() / 3;
+
+    Bvh4 bvh;
+    auto start = std::chrono::steady_clock::now();
+    if (!lt::bvh_build(&bvh, positions.data(), indices.data(), triangles))
+    {
+        fprintf(stderr, "bvh_build failed\n");
+        return 1;
+    }
+    const f64 build = seconds_since(start);
+    printf("%zu triangles: build %.1f ms, %u nodes, %u packets\n", triangles, build * 1e3, bvh.num_nodes,
+           bvh.num_packets);
+
+    // Rays from above the terrain towards random points on it, then shadow rays from the hit
+    // points towards a low light, so that the hills occlude some of them.
+    Rng rng;
+    lt::rng_seed(&rng, 1);
+    std::vector<Ray> rays(num_rays);
+    for (Ray &ray : rays)
+    {
+        const Vec3f target(lt::rng_f32(&rng) * side, 0.0f, lt::rng_f32(&rng) * side);
+        const Vec3f origin(lt::rng_f32(&rng) * side, 60.0f, lt::rng_f32(&rng) * side);
+        ray = Ray(origin, target - origin);
+    }
+
+    std::vector<Ray> shadows;
+    shadows.reserve(num_rays);
+    u32 hits = 0;
+    f64 sum = 0.0;
+    start = std::chrono::steady_clock::now();
+    for (const Ray &ray : rays)
+    {
+        RayHit hit;
+        if (lt::bvh_intersect(bvh, ray, &hit))
+        {
+            hits++;
+            sum += hit.t;
+            shadows.push_back(Ray(ray.origin + ray.direction * (hit.t * 0.999f), Vec3f(1.0f, 0.15f, 0.3f)));
+        }
+    }
+    const f64 closest = seconds_since(start);
+
+    u32 occluded = 0;
+    start = std::chrono::steady_clock::now();
+    for (const Ray &shadow : shadows) occluded += lt::bvh_occluded(bvh, shadow);
+    const f64 any = seconds_since(start);
+
+    printf("%u rays: closest hit %.3f us/ray (%u hits, %.1f), occlusion %.3f us/ray (%u occluded)\n", num_rays,
+           closest * 1e6 / num_rays, hits, sum, any * 1e6 / shadows.size(), occluded);
+    lt::bvh_destroy(&bvh);
+    return 0;
+}
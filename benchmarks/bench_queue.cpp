@@ -0,0 +1,108 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "lt_queue.hpp"
+
+// Throughput of the blocking push and pop of the lt queues against a mutex and condition
+// variable queue, with 1 and 4 producers and consumers.
+
+struct MutexQueue
+{
+    template<typename U> void
+    push(U &&item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_items.push_back(item);
+        }
+        m_cv.notify_one();
+    }
+
+    void
+    pop(u64 *out)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() { return !m_items.empty(); });
+        *out = m_items.front();
+        m_items.pop_front();
+    }
+
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    std::deque<u64>         m_items;
+};
+
+// Items are 1..count, consumers stop on a 0 pushed once the producers are done. Returns
+// millions of items per second.
+template<typename Q> lt_internal f64
+run(Q *queue, u32 producers, u32 consumers, u64 count)
+{
+    std::vector<std::thread> threads;
+    std::vector<u64> sums(consumers, 0);
+    const auto start = std::chrono::steady_clock::now();
+    for (u32 c = 0; c < consumers; c++)
+        threads.emplace_back([=, &sums]() {
+            u64 sum = 0, item;
+            for (;;)
+            {
+                queue->pop(&item);
+                if (!item) break;
+                sum += item;
+            }
+            sums[c] = sum;
+        });
+    std::vector<std::thread> pushers;
+    for (u32 p = 0; p < producers; p++)
+        pushers.emplace_back([=]() {
+            for (u64 i = p + 1; i <= count; i += producers) queue->push(i);
+        });
+    for (std::thread &t : pushers) t.join();
+    for (u32 c = 0; c < consumers; c++) queue->push((u64)0);
+    for (std::thread &t : threads) t.join();
+    const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+    u64 total = 0;
+    for (u64 s : sums) total += s;
+    if (total != count * (count + 1) / 2) fprintf(stderr, "lost items\n");
+    return (f64)count / seconds / 1e6;
+}
+
+int
+main(int argc, char **argv)
+{
+    const u64 count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4000000;
+    const usize capacity = 1024;
+    printf("%llu items, capacity %zu, %u hardware threads\n", (unsigned long long)count, capacity,
+           std::thread::hardware_concurrency());
+
+    {
+        lt::SpscQueue<u64> spsc(capacity);
+        MutexQueue mutex;
+        const f64 a = run(&spsc, 1, 1, count);
+        const f64 b = run(&mutex, 1, 1, count);
+        printf("spsc 1:1   %8.2f M/s   mutex %8.2f M/s\n", a, b);
+    }
+    {
+        lt::MpmcQueue<u64> mpmc(capacity);
+        MutexQueue mutex;
+        const f64 a = run(&mpmc, 1, 1, count);
+        const f64 b = run(&mutex, 1, 1, count);
+        printf("mpmc 1:1   %8.2f M/s   mutex %8.2f M/s\n", a, b);
+        const f64 c = run(&mpmc, 4, 4, count);
+        const f64 d = run(&mutex, 4, 4, count);
+        printf("mpmc 4:4   %8.2f M/s   mutex %8.2f M/s\n", c, d);
+    }
+    {
+        lt::MpscQueue<u64> mpsc;
+        MutexQueue mutex;
+        const f64 a = run(&mpsc, 4, 1, count);
+        const f64 b = run(&mutex, 4, 1, count);
+        printf("mpsc 4:1   %8.2f M/s   mutex %8.2f M/s\n", a, b);
+    }
+    printf("membarrier fences: %s\n", lt::membarrier_registered() ? "yes" : "no");
+    return 0;
+}
@@ -0,0 +1,476 @@
+#include "lt_animation.hpp"
+#include "lt_fastmath.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Longest run of source keys one reduced segment may cover. Checking a segment costs one
+// evaluation per skipped key, so the greedy reduction is O(count * ANIM_MAX_SEGMENT_KEYS)
+// instead of quadratic in the length of long, almost linear curves.
+#define ANIM_MAX_SEGMENT_KEYS 256
+
+lt_internal inline i32
+anim_dims(i32 channel)
+{
+    return (channel == AnimChannel_Rotation) ? 4 : 3;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Key reduction
+//
+
+// Value of the segment between the keys `i` and `j` at `time`, normalized for rotations.
+lt_internal void
+anim_segment_value(const f32 *times, const f32 *values, i32 dims, u32 i, u32 j, f64 time, f64 *out)
+{
+    const f64 span = (f64)times[j] - (f64)times[i];
+    const f64 alpha = (span > 0) ? (time - (f64)times[i]) / span : 0;
+
+    f64 len2 = 0;
+    for (i32 d = 0; d < dims; d++)
+    {
+        const f64 a = values[i*dims + d], b = values[j*dims + d];
+        out[d] = a + (b - a) * alpha;
+        len2 += out[d] * out[d];
+    }
+    if (dims == 4 && len2 > 0)
+        for (i32 d = 0; d < 4; d++) out[d] /= std::sqrt(len2);
+}
+
+lt_internal f64
+anim_value_error(const f64 *a, const f64 *b, i32 channel)
+{
+    if (channel == AnimChannel_Rotation)
+    {
+        f64 dot = std::fabs(a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3]);
+        return 2.0 * std::acos(std::min(dot, 1.0));
+    }
+    if (channel == AnimChannel_Translation)
+    {
+        f64 dist2 = 0;
+        for (i32 d = 0; d < 3; d++) dist2 += (a[d] - b[d]) * (a[d] - b[d]);
+        return std::sqrt(dist2);
+    }
+
+    f64 err = 0;
+    for (i32 d = 0; d < 3; d++) err = std::max(err, std::fabs(a[d] - b[d]));
+    return err;
+}
+
+// Checks the segment between the keys `i` and `j` against the original curve, at every key it
+// skips and halfway between original keys. The midpoints catch the drift of nlerp, which does
+// not move at constant speed and strays furthest from the original keys between them.
+lt_internal bool
+anim_segment_fits(const f32 *times, const f32 *values, i32 channel, u32 i, u32 j, f32 tolerance)
+{
+    const i32 dims = anim_dims(channel);
+    f64 reduced[4], original[4];
+    for (u32 k = i + 1; k <= j; k++)
+    {
+        const f64 mid = 0.5 * ((f64)times[k - 1] + (f64)times[k]);
+        anim_segment_value(times, values, dims, i, j, mid, reduced);
+        anim_segment_value(times, values, dims, k - 1, k, mid, original);
+        if (anim_value_error(reduced, original, channel) > tolerance) return false;
+
+        if (k == j) break;
+        anim_segment_value(times, values, dims, i, j, times[k], reduced);
+        anim_segment_value(times, values, dims, k, k, times[k], original);
+        if (anim_value_error(reduced, original, channel) > tolerance) return false;
+    }
+    return true;
+}
+
+// Greedy reduction: from every kept key, extend the segment for as long as it fits, up to
+// ANIM_MAX_SEGMENT_KEYS.
+lt_internal void
+anim_reduce_keys(const f32 *times, const f32 *values, u32 count, i32 channel, f32 tolerance,
+                 std::vector<u32> *kept)
+{
+    kept->clear();
+    kept->push_back(0);
+    if (count <= 1) return;
+
+    u32 i = 0;
+    while (i < count - 1)
+    {
+        u32 end = i + 1;
+        const u32 last = (count - 1 - i > ANIM_MAX_SEGMENT_KEYS) ? i + ANIM_MAX_SEGMENT_KEYS : count - 1;
+        for (u32 j = i + 2; j <= last; j++)
+        {
+            if (!anim_segment_fits(times, values, channel, i, j, tolerance)) break;
+            end = j;
+        }
+        kept->push_back(end);
+        i = end;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// Clip
+//
+
+lt_internal bool
+anim_curves_alloc(AnimCurves *curves, u32 num_tracks, u32 num_keys, bool rotation)
+{
+    curves->num_keys = num_keys;
+    curves->first = (u32*)LT_Malloc(sizeof(u32) * (num_tracks + 1), MemoryTag_Animation);
+    curves->time = (f32*)LT_Malloc(sizeof(f32) * num_keys, MemoryTag_Animation);
+    curves->x = (f32*)LT_Malloc(sizeof(f32) * num_keys, MemoryTag_Animation);
+    curves->y = (f32*)LT_Malloc(sizeof(f32) * num_keys, MemoryTag_Animation);
+    curves->z = (f32*)LT_Malloc(sizeof(f32) * num_keys, MemoryTag_Animation);
+    curves->w = rotation ? (f32*)LT_Malloc(sizeof(f32) * num_keys, MemoryTag_Animation) : NULL;
+    return curves->first && curves->time && curves->x && curves->y && curves->z && (!rotation || curves->w);
+}
+
+lt_internal void
+anim_curves_free(AnimCurves *curves)
+{
+    LT_Free(curves->first);
+    LT_Free(curves->time);
+    LT_Free(curves->x);
+    LT_Free(curves->y);
+    LT_Free(curves->z);
+    LT_Free(curves->w);
+    curves->num_keys = 0;
+}
+
+bool
+lt::anim_clip_build(AnimClip *clip, const AnimTrackKeys *tracks, u32 num_tracks,
+                    const AnimCompression *compression)
+{
+    *clip = AnimClip{};
+    clip->num_tracks = num_tracks;
+
+    std::vector<f32> times;
+    std::vector<f32> values;
+    std::vector<u32> kept;
+    // Kept keys of every track, flattened: (time, values...) per key.
+    std::vector<f32> out_times;
+    std::vector<f32> out_values;
+
+    for (i32 c = 0; c < AnimChannel_Count; c++)
+    {
+        const i32 dims = anim_dims(c);
+        out_times.clear();
+        out_values.clear();
+        std::vector<u32> first(num_tracks + 1, 0);
+
+        for (u32 t = 0; t < num_tracks; t++)
+        {
+            const AnimTrackKeys &track = tracks[t];
+            u32 count = 0;
+            const f32 *src_times = NULL;
+            const f32 *src_values = NULL;
+            f32 tolerance = 0;
+            if (c == AnimChannel_Translation)
+            {
+                count = track.num_translations;
+                src_times = track.translation_times;
+                src_values = track.translations ? track.translations->val : NULL;
+                tolerance = compression ? compression->translation_tolerance : 0;
+            }
+            else if (c == AnimChannel_Rotation)
+            {
+                count = track.num_rotations;
+                src_times = track.rotation_times;
+                src_values = track.rotations ? track.rotations->val : NULL;
+                tolerance = compression ? compression->rotation_tolerance : 0;
+            }
+            else
+            {
+                count = track.num_scales;
+                src_times = track.scale_times;
+                src_values = track.scales ? track.scales->val : NULL;
+                tolerance = compression ? compression->scale_tolerance : 0;
+            }
+
+            times.assign(1, 0.0f);
+            if (count == 0)
+            {
+                // Identity: no translation, no rotation (w first, as in Quat), unit scale.
+                const f32 identity[3][4] = {{0, 0, 0, 0}, {1, 0, 0, 0}, {1, 1, 1, 0}};
+                values.assign(identity[c], identity[c] + dims);
+                count = 1;
+            }
+            else
+            {
+                times.assign(src_times, src_times + count);
+                values.assign(src_values, src_values + (usize)count * dims);
+            }
+
+            if (c == AnimChannel_Rotation)
+            {
+                for (u32 k = 1; k < count; k++)
+                {
+                    f32 *q = &values[k*4];
+                    const f32 *prev = &values[(k - 1)*4];
+                    if (q[0]*prev[0] + q[1]*prev[1] + q[2]*prev[2] + q[3]*prev[3] < 0)
+                        for (i32 d = 0; d < 4; d++) q[d] = -q[d];
+                }
+            }
+
+            if (compression)
+            {
+                anim_reduce_keys(times.data(), values.data(), count, c, tolerance, &kept);
+            }
+            else
+            {
+                kept.resize(count);
+                for (u32 k = 0; k < count; k++) kept[k] = k;
+            }
+
+            first[t] = (u32)out_times.size();
+            for (u32 k : kept)
+            {
+                out_times.push_back(times[k]);
+                out_values.insert(out_values.end(), &values[k*dims], &values[k*dims] + dims);
+                clip->duration = std::max(clip->duration, times[k]);
+            }
+        }
+        first[num_tracks] = (u32)out_times.size();
+
+        AnimCurves *curves = &clip->channels[c];
+        if (!anim_curves_alloc(curves, num_tracks, (u32)out_times.size(), c == AnimChannel_Rotation))
+        {
+            lt::anim_clip_destroy(clip);
+            return false;
+        }
+        memcpy(curves->first, first.data(), sizeof(u32) * (num_tracks + 1));
+        for (usize k = 0; k < out_times.size(); k++)
+        {
+            curves->time[k] = out_times[k];
+            curves->x[k] = out_values[k*dims + (dims == 4 ? 1 : 0)];
+            curves->y[k] = out_values[k*dims + (dims == 4 ? 2 : 1)];
+            curves->z[k] = out_values[k*dims + (dims == 4 ? 3 : 2)];
+            if (dims == 4) curves->w[k] = out_values[k*dims];
+        }
+    }
+    return true;
+}
+
+void
+lt::anim_clip_destroy(AnimClip *clip)
+{
+    for (i32 c = 0; c < AnimChannel_Count; c++) anim_curves_free(&clip->channels[c]);
+    *clip = AnimClip{};
+}
+
+bool
+lt::anim_cursor_init(AnimCursor *cursor, const AnimClip &clip)
+{
+    cursor->num_tracks = clip.num_tracks;
+    cursor->time = 0;
+    cursor->key = (u32*)LT_Calloc((usize)AnimChannel_Count * clip.num_tracks + 1, sizeof(u32), MemoryTag_Animation);
+    return cursor->key != NULL;
+}
+
+void
+lt::anim_cursor_destroy(AnimCursor *cursor)
+{
+    LT_Free(cursor->key);
+    cursor->num_tracks = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Sampling
+//
+
+// Keys of 8 tracks, gathered so that the interpolation runs on all of them at once.
+#define ANIM_LANES 8
+
+struct AnimLanes
+{
+    alignas(32) f32 x0[ANIM_LANES], y0[ANIM_LANES], z0[ANIM_LANES], w0[ANIM_LANES];
+    alignas(32) f32 x1[ANIM_LANES], y1[ANIM_LANES], z1[ANIM_LANES], w1[ANIM_LANES];
+    alignas(32) f32 alpha[ANIM_LANES];
+};
+
+// Moves the cursor to the segment containing `time` and writes the segment's keys and the
+// interpolation factor into `lane`.
+lt_internal inline void
+anim_gather(const AnimCurves &curves, u32 track, u32 *cursor_key, f32 time, AnimLanes *lanes, i32 lane)
+{
+    const u32 first = curves.first[track];
+    const u32 n = curves.first[track + 1] - first;
+    const f32 *times = curves.time + first;
+
+    u32 i = *cursor_key;
+    u32 k0 = 0, k1 = 0;
+    f32 alpha = 0;
+    if (n > 1)
+    {
+        if (i > n - 2 || times[i] > time)
+        {
+            i = (u32)(std::upper_bound(times, times + n, time) - times);
+            i = (i > 0) ? i - 1 : 0;
+            if (i > n - 2) i = n - 2;
+        }
+        while (i + 2 < n && times[i + 1] <= time) i++;
+
+        k0 = i;
+        k1 = i + 1;
+        const f32 span = times[k1] - times[k0];
+        alpha = (span > 0) ? (time - times[k0]) / span : 0;
+        alpha = (alpha < 0) ? 0 : ((alpha > 1) ? 1 : alpha);
+    }
+    *cursor_key = i;
+
+    lanes->x0[lane] = curves.x[first + k0]; lanes->x1[lane] = curves.x[first + k1];
+    lanes->y0[lane] = curves.y[first + k0]; lanes->y1[lane] = curves.y[first + k1];
+    lanes->z0[lane] = curves.z[first + k0]; lanes->z1[lane] = curves.z[first + k1];
+    if (curves.w)
+    {
+        lanes->w0[lane] = curves.w[first + k0];
+        lanes->w1[lane] = curves.w[first + k1];
+    }
+    lanes->alpha[lane] = alpha;
+}
+
+template<typename V> lt_internal inline V
+anim_load(const f32 *p)
+{
+    if constexpr (std::is_same_v<V, f32>) return *p;
+    else return V::load(p);
+}
+
+lt_internal inline void anim_store(f32 v, f32 *p) { *p = v; }
+template<typename V> lt_internal inline void anim_store(V v, f32 *p) { v.store(p); }
+
+// Interpolation kernels over the 8 lanes, in steps of the lane type V (f32 or F32x4).
+template<typename V> lt_internal void
+anim_lerp_lanes(const AnimLanes &l, f32 *x, f32 *y, f32 *z)
+{
+    for (i32 i = 0; i < ANIM_LANES; i += (i32)(sizeof(V) / sizeof(f32)))
+    {
+        const V a = anim_load<V>(l.alpha + i);
+        const V x0 = anim_load<V>(l.x0 + i), y0 = anim_load<V>(l.y0 + i), z0 = anim_load<V>(l.z0 + i);
+        anim_store(lt::fm_madd(anim_load<V>(l.x1 + i) - x0, a, x0), x + i);
+        anim_store(lt::fm_madd(anim_load<V>(l.y1 + i) - y0, a, y0), y + i);
+        anim_store(lt::fm_madd(anim_load<V>(l.z1 + i) - z0, a, z0), z + i);
+    }
+}
+
+template<typename V> lt_internal void
+anim_nlerp_lanes(const AnimLanes &l, f32 *x, f32 *y, f32 *z, f32 *w)
+{
+    for (i32 i = 0; i < ANIM_LANES; i += (i32)(sizeof(V) / sizeof(f32)))
+    {
+        const V a = anim_load<V>(l.alpha + i);
+        const V x0 = anim_load<V>(l.x0 + i), y0 = anim_load<V>(l.y0 + i);
+        const V z0 = anim_load<V>(l.z0 + i), w0 = anim_load<V>(l.w0 + i);
+        const V qx = lt::fm_madd(anim_load<V>(l.x1 + i) - x0, a, x0);
+        const V qy = lt::fm_madd(anim_load<V>(l.y1 + i) - y0, a, y0);
+        const V qz = lt::fm_madd(anim_load<V>(l.z1 + i) - z0, a, z0);
+        const V qw = lt::fm_madd(anim_load<V>(l.w1 + i) - w0, a, w0);
+        const V inv_len = lt::fast_rsqrt<FastMathPrecision_Accurate>(qx*qx + qy*qy + qz*qz + qw*qw);
+        anim_store(qx * inv_len, x + i);
+        anim_store(qy * inv_len, y + i);
+        anim_store(qz * inv_len, z + i);
+        anim_store(qw * inv_len, w + i);
+    }
+}
+
+#if LT_CPU_HAS_AVX2
+LT_TARGET_AVX2 lt_internal void
+anim_lerp_avx2(const AnimLanes &l, f32 *x, f32 *y, f32 *z)
+{
+    const __m256 a = _mm256_load_ps(l.alpha);
+    const __m256 x0 = _mm256_load_ps(l.x0), y0 = _mm256_load_ps(l.y0), z0 = _mm256_load_ps(l.z0);
+    _mm256_store_ps(x, _mm256_fmadd_ps(_mm256_sub_ps(_mm256_load_ps(l.x1), x0), a, x0));
+    _mm256_store_ps(y, _mm256_fmadd_ps(_mm256_sub_ps(_mm256_load_ps(l.y1), y0), a, y0));
+    _mm256_store_ps(z, _mm256_fmadd_ps(_mm256_sub_ps(_mm256_load_ps(l.z1), z0), a, z0));
+}
+
+LT_TARGET_AVX2 lt_internal void
+anim_nlerp_avx2(const AnimLanes &l, f32 *x, f32 *y, f32 *z, f32 *w)
+{
+    const __m256 a = _mm256_load_ps(l.alpha);
+    const __m256 x0 = _mm256_load_ps(l.x0), y0 = _mm256_load_ps(l.y0);
+    const __m256 z0 = _mm256_load_ps(l.z0), w0 = _mm256_load_ps(l.w0);
+    const __m256 qx = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_load_ps(l.x1), x0), a, x0);
+    const __m256 qy = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_load_ps(l.y1), y0), a, y0);
+    const __m256 qz = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_load_ps(l.z1), z0), a, z0);
+    const __m256 qw = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_load_ps(l.w1), w0), a, w0);
+    const __m256 len2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(qx, qx), _mm256_mul_ps(qy, qy)),
+                                      _mm256_add_ps(_mm256_mul_ps(qz, qz), _mm256_mul_ps(qw, qw)));
+    // rsqrt estimate and one Newton-Raphson step, as fast_rsqrt<FastMathPrecision_Accurate>.
+    __m256 inv_len = _mm256_rsqrt_ps(len2);
+    const __m256 half = _mm256_mul_ps(_mm256_set1_ps(0.5f), len2);
+    inv_len = _mm256_mul_ps(inv_len, _mm256_fnmadd_ps(half, _mm256_mul_ps(inv_len, inv_len), _mm256_set1_ps(1.5f)));
+    _mm256_store_ps(x, _mm256_mul_ps(qx, inv_len));
+    _mm256_store_ps(y, _mm256_mul_ps(qy, inv_len));
+    _mm256_store_ps(z, _mm256_mul_ps(qz, inv_len));
+    _mm256_store_ps(w, _mm256_mul_ps(qw, inv_len));
+}
+#endif
+
+struct AnimKernel
+{
+    CpuIsa isa;
+    void (*lerp)(const AnimLanes &l, f32 *x, f32 *y, f32 *z);
+    void (*nlerp)(const AnimLanes &l, f32 *x, f32 *y, f32 *z, f32 *w);
+};
+
+lt_global_variable const AnimKernel g_anim_kernels[] = {
+    {CpuIsa_Scalar, anim_lerp_lanes<f32>,       anim_nlerp_lanes<f32>},
+#if defined(__SSE2__)
+    {CpuIsa_SSE2,   anim_lerp_lanes<lt::F32x4>, anim_nlerp_lanes<lt::F32x4>},
+#endif
+#if LT_CPU_HAS_AVX2
+    {CpuIsa_AVX2,   anim_lerp_avx2,             anim_nlerp_avx2},
+#endif
+};
+lt_global_variable CpuDispatchCache g_anim_dispatch;
+
+const char *
+lt::anim_kernel_name()
+{
+    return cpu_isa_name(cpu_select(g_anim_kernels, &g_anim_dispatch)->isa);
+}
+
+void
+lt::anim_sample(const AnimClip &clip, AnimCursor *cursor, f32 time, AnimTransform *out)
+{
+    LT_Assert(cursor->num_tracks == clip.num_tracks);
+    time = (time < 0) ? 0 : ((time > clip.duration) ? clip.duration : time);
+    cursor->time = time;
+
+    const AnimKernel *kernel = cpu_select(g_anim_kernels, &g_anim_dispatch);
+    const u32 num_tracks = clip.num_tracks;
+    for (u32 base = 0; base < num_tracks; base += ANIM_LANES)
+    {
+        const u32 active = std::min<u32>(ANIM_LANES, num_tracks - base);
+        AnimLanes lanes[AnimChannel_Count];
+        alignas(32) f32 res[AnimChannel_Count][4][ANIM_LANES];
+
+        for (i32 c = 0; c < AnimChannel_Count; c++)
+        {
+            u32 *keys = cursor->key + (usize)c * num_tracks;
+            for (u32 lane = 0; lane < ANIM_LANES; lane++)
+            {
+                // Unused lanes repeat the last track, their results are dropped.
+                const u32 track = base + ((lane < active) ? lane : active - 1);
+                u32 scratch = keys[track];
+                anim_gather(clip.channels[c], track, (lane < active) ? &keys[track] : &scratch, time,
+                            &lanes[c], (i32)lane);
+            }
+        }
+
+        kernel->lerp(lanes[AnimChannel_Translation], res[0][0], res[0][1], res[0][2]);
+        kernel->nlerp(lanes[AnimChannel_Rotation], res[1][0], res[1][1], res[1][2], res[1][3]);
+        kernel->lerp(lanes[AnimChannel_Scale], res[2][0], res[2][1], res[2][2]);
+
+        for (u32 lane = 0; lane < active; lane++)
+        {
+            AnimTransform &t = out[base + lane];
+            t.translation = Vec3f(res[0][0][lane], res[0][1][lane], res[0][2][lane]);
+            t.rotation = Quatf(res[1][3][lane], res[1][0][lane], res[1][1][lane], res[1][2][lane]);
+            t.scale = Vec3f(res[2][0][lane], res[2][1][lane], res[2][2][lane]);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef LT_ANIMATION_HPP
+#define LT_ANIMATION_HPP
+
+#include "lt_core.hpp"
+#include "lt_math.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Animation clips
+//
+// A clip holds translation, rotation and scale curves for a number of tracks (usually bones).
+// Each channel keeps the keys of all tracks in shared SoA arrays, with the keys of track i in
+// [first[i], first[i + 1]). Keys are removed at build time as long as linear interpolation
+// (nlerp for rotations) between the kept ones stays within the given tolerances of the
+// original curve, checked at the removed keys and halfway between the original keys. A kept
+// segment spans at most 256 source keys, which keeps the build linear in the key count.
+//
+// Sampling keeps a cursor with the current key of every curve. Moving forward in time only
+// advances the cursors, so sampling a clip frame by frame costs O(1) per curve; jumping back
+// falls back to a binary search. All tracks are sampled together: keys are gathered into lanes
+// and interpolated 8 tracks at a time by a kernel picked from the CpuIsa (scalar, SSE2 or
+// AVX2+FMA).
+//
+// Rotation keys are sign aligned at build time (every key has a non-negative dot product
+// with the previous one), so nlerp always takes the short path.
+//
+
+struct AnimTrackKeys
+{
+    const f32   *translation_times;
+    const Vec3f *translations;
+    u32          num_translations;
+
+    const f32   *rotation_times;
+    const Quatf *rotations;
+    u32          num_rotations;
+
+    const f32   *scale_times;
+    const Vec3f *scales;
+    u32          num_scales;
+};
+
+struct AnimCompression
+{
+    f32 translation_tolerance; // Distance.
+    f32 rotation_tolerance;    // Radians.
+    f32 scale_tolerance;       // Per component.
+};
+
+enum AnimChannel
+{
+    AnimChannel_Translation,
+    AnimChannel_Rotation,
+    AnimChannel_Scale,
+    AnimChannel_Count,
+};
+
+struct AnimCurves
+{
+    u32 *first;      // num_tracks + 1
+    f32 *time;
+    f32 *x, *y, *z;
+    f32 *w;          // Rotations only.
+    u32  num_keys;
+};
+
+struct AnimClip
+{
+    f32        duration;
+    u32        num_tracks;
+    AnimCurves channels[AnimChannel_Count];
+};
+
+struct AnimCursor
+{
+    u32 *key;        // AnimChannel_Count * num_tracks, relative to the curve's first key.
+    u32  num_tracks;
+    f32  time;
+};
+
+struct AnimTransform
+{
+    Vec3f translation;
+    Quatf rotation;
+    Vec3f scale;
+};
+
+namespace lt
+{
+
+inline AnimCompression
+anim_default_compression()
+{
+    return AnimCompression{1e-4f, 1e-4f, 1e-4f};
+}
+
+// Tracks with no keys in a channel get a single identity key. Key times must be increasing.
+// Passing NULL for `compression` keeps every key.
+bool anim_clip_build(AnimClip *clip, const AnimTrackKeys *tracks, u32 num_tracks,
+                     const AnimCompression *compression);
+void anim_clip_destroy(AnimClip *clip);
+
+bool anim_cursor_init(AnimCursor *cursor, const AnimClip &clip);
+void anim_cursor_destroy(AnimCursor *cursor);
+
+// Writes clip.num_tracks local transforms. `time` is clamped to [0, clip.duration].
+void anim_sample(const AnimClip &clip, AnimCursor *cursor, f32 time, AnimTransform *out);
+
+// Name of the CpuIsa tier anim_sample runs on.
+const char *anim_kernel_name();
+
+}
+
+#endif // LT_ANIMATION_HPP
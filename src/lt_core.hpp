@@ -131,6 +131,57 @@ static_assert(Kilobytes(1) == 1024);
 static_assert(Megabytes(1) == 1024*1024);
 static_assert(Gigabytes(1) == 1024*1024*1024);
 
+// Size used to pad data that is written concurrently by different threads.
+#ifndef LT_CACHE_LINE_SIZE
+#define LT_CACHE_LINE_SIZE 64
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// Allocation
+//
+// Memory owned by lt is allocated with these macros and released with LT_Free. They map to
+// the C allocator, unless LT_MEMORY_TRACKING is defined: then every allocation is attributed
+// to its tag and recorded by lt_memory (statistics, size histograms, leak reports).
+//
+
+enum MemoryTag
+{
+    MemoryTag_General,
+    MemoryTag_File,
+    MemoryTag_Logging,
+    MemoryTag_Math,
+    MemoryTag_Geometry,
+    MemoryTag_Spatial,
+    MemoryTag_Animation,
+    MemoryTag_Ecs,
+
+    MemoryTag_Count,
+};
+
+#if LT_MEMORY_TRACKING
+namespace lt
+{
+void *tracked_alloc(usize size, usize alignment, bool zero, MemoryTag tag, const char *file, int line);
+void *tracked_realloc(void *p, usize size, MemoryTag tag, const char *file, int line);
+void  tracked_free(void *p);
+}
+#  define LT_Malloc(size, tag)         lt::tracked_alloc((size), 0, false, (tag), __FILE__, __LINE__)
+#  define LT_Calloc(count, size, tag)  lt::tracked_alloc((usize)(count) * (size), 0, true, (tag), __FILE__, __LINE__)
+#  define LT_Realloc(p, size, tag)     lt::tracked_realloc((p), (size), (tag), __FILE__, __LINE__)
+#  define LT_AlignedAlloc(alignment, size, tag) \
+    lt::tracked_alloc((size), (alignment), false, (tag), __FILE__, __LINE__)
+#  define LT_Free(p) do { \
+        lt::tracked_free(p); \
+        p = NULL;            \
+    } while(0)
+#else
+#  define LT_Malloc(size, tag)         malloc(size)
+#  define LT_Calloc(count, size, tag)  calloc((count), (size))
+#  define LT_Realloc(p, size, tag)     realloc((p), (size))
+#  define LT_AlignedAlloc(alignment, size, tag) aligned_alloc((alignment), (size))
+#endif
+
 #ifndef LT_Free
 #define LT_Free(p) do { \
         free(p);        \
@@ -138,6 +189,18 @@ static_assert(Gigabytes(1) == 1024*1024*1024);
     } while(0)
 #endif
 
+// With LT_FLIGHT_RECORDER, panics and failed asserts dump the recent events of every thread
+// before trapping (see lt_flight).
+#if LT_FLIGHT_RECORDER
+namespace lt
+{
+void flight_crash(const char *what, const char *message, const char *file, int line);
+}
+#  define LT_FLIGHT_CRASH(what, message, file, line) lt::flight_crash((what), (message), (file), (line))
+#else
+#  define LT_FLIGHT_CRASH(what, message, file, line) do { } while(0)
+#endif
+
 #ifndef LT_Panic
 #  ifdef LT_DEBUG
 #    define LT_Panic2(msg, file, number) do {                         \
@@ -150,6 +213,7 @@ static_assert(Gigabytes(1) == 1024*1024*1024);
         fprintf(stderr, "******************************\n");            \
         fprintf(stderr, "******************************\n");            \
         fflush(stderr);                                                 \
+        LT_FLIGHT_CRASH("panic", #msg, file, number);                   \
         __builtin_trap();                                               \
     } while(0)
 #    define LT_Panic(msg) LT_Panic2(msg, __FILE__, __LINE__)
@@ -171,6 +235,7 @@ static_assert(Gigabytes(1) == 1024*1024*1024);
             fprintf(stderr, "******************************\n");        \
             fprintf(stderr, "******************************\n");        \
             fflush(stderr);                                             \
+            LT_FLIGHT_CRASH("assert", #cond, file, number);             \
             __builtin_trap();                                           \
         }                                                               \
     } while(0)
@@ -210,6 +275,23 @@ rdtsc()
 #endif
 }
 
+// Hint for spin-wait loops.
+lt_internal inline void
+cpu_relax()
+{
+#if LT_ARCH_X86 && (LT_CLANG || LT_GCC)
+    _mm_pause();
+#endif
+}
+
+inline usize
+next_power_of_two(usize n)
+{
+    usize p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
 lt_internal inline int
 sign_float(f32 val)
 {
@@ -0,0 +1,191 @@
+#include "lt_cpu.hpp"
+
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#if LT_OS_WINDOWS
+#define strcasecmp _stricmp
+#else
+#include <strings.h>
+#endif
+
+#if (LT_GCC || LT_CLANG) && LT_ARCH_X86
+#include <cpuid.h>
+#endif
+
+lt_global_variable const char *g_isa_names[CpuIsa_Count] = {
+    "scalar",
+    "sse2",
+    "sse4.2",
+    "avx2",
+    "avx512",
+};
+
+// -1 until the first call to cpu_isa or cpu_set_isa.
+lt_global_variable std::atomic<i32> g_active_isa{-1};
+
+// Every dispatch cache that was filled, cleared by cpu_set_isa.
+lt_global_variable std::mutex            g_dispatch_mutex;
+lt_global_variable CpuDispatchCache *g_dispatch_caches = nullptr;
+
+#if (LT_GCC || LT_CLANG) && LT_ARCH_X86
+
+// Register state enabled by the OS in XCR0.
+#define LT_XCR0_AVX    0x06  // XMM, YMM
+#define LT_XCR0_AVX512 0xE6  // XMM, YMM, opmask, ZMM_Hi256, Hi16_ZMM
+
+lt_internal u64
+read_xcr0()
+{
+    u32 lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (u64)lo | ((u64)hi << 32);
+}
+
+lt_internal u32
+detect_features()
+{
+    u32 a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return 0;
+
+    u32 features = 0;
+    if (d & (1u << 26)) features |= CpuFeature_SSE2;
+    if (c & (1u << 9))  features |= CpuFeature_SSSE3;
+    if (c & (1u << 19)) features |= CpuFeature_SSE41;
+    if (c & (1u << 20)) features |= CpuFeature_SSE42;
+    if (c & (1u << 23)) features |= CpuFeature_POPCNT;
+    if (c & (1u << 1))  features |= CpuFeature_PCLMUL;
+
+    const bool osxsave = (c & (1u << 27)) != 0;
+    const u64 xcr0 = osxsave ? read_xcr0() : 0;
+    const bool os_avx = (xcr0 & LT_XCR0_AVX) == LT_XCR0_AVX;
+    const bool os_avx512 = (xcr0 & LT_XCR0_AVX512) == LT_XCR0_AVX512;
+
+    if (os_avx)
+    {
+        if (c & (1u << 28)) features |= CpuFeature_AVX;
+        if (c & (1u << 12)) features |= CpuFeature_FMA;
+        if (c & (1u << 29)) features |= CpuFeature_F16C;
+    }
+
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d))
+    {
+        if (b & (1u << 3)) features |= CpuFeature_BMI1;
+        if (b & (1u << 8)) features |= CpuFeature_BMI2;
+        if (os_avx && (b & (1u << 5))) features |= CpuFeature_AVX2;
+        if (os_avx512)
+        {
+            if (b & (1u << 16)) features |= CpuFeature_AVX512F;
+            if (b & (1u << 17)) features |= CpuFeature_AVX512DQ;
+            if (b & (1u << 30)) features |= CpuFeature_AVX512BW;
+            if (b & (1u << 31)) features |= CpuFeature_AVX512VL;
+        }
+    }
+    return features;
+}
+
+#else
+
+lt_internal u32
+detect_features()
+{
+    return 0;
+}
+
+#endif
+
+u32
+lt::cpu_features()
+{
+    lt_local_persist const u32 features = detect_features();
+    return features;
+}
+
+CpuIsa
+lt::cpu_detected_isa()
+{
+    const u32 f = cpu_features();
+    const u32 sse42 = CpuFeature_SSE2 | CpuFeature_SSSE3 | CpuFeature_SSE41 | CpuFeature_SSE42 | CpuFeature_POPCNT;
+    const u32 avx2 = sse42 | CpuFeature_AVX | CpuFeature_AVX2 | CpuFeature_FMA | CpuFeature_F16C |
+                     CpuFeature_BMI1 | CpuFeature_BMI2;
+    const u32 avx512 = avx2 | CpuFeature_AVX512F | CpuFeature_AVX512BW | CpuFeature_AVX512DQ | CpuFeature_AVX512VL;
+
+    if ((f & avx512) == avx512) return CpuIsa_AVX512;
+    if ((f & avx2) == avx2) return CpuIsa_AVX2;
+    if ((f & sse42) == sse42) return CpuIsa_SSE42;
+    if (f & CpuFeature_SSE2) return CpuIsa_SSE2;
+    return CpuIsa_Scalar;
+}
+
+lt_internal CpuIsa
+initial_isa()
+{
+    CpuIsa isa = lt::cpu_detected_isa();
+    CpuIsa requested;
+    const char *env = getenv("LT_CPU_ISA");
+    if (env && lt::cpu_parse_isa(env, &requested) && requested < isa) isa = requested;
+    return isa;
+}
+
+CpuIsa
+lt::cpu_isa()
+{
+    i32 isa = g_active_isa.load(std::memory_order_relaxed);
+    if (isa < 0)
+    {
+        i32 expected = -1;
+        isa = initial_isa();
+        if (!g_active_isa.compare_exchange_strong(expected, isa, std::memory_order_relaxed)) isa = expected;
+    }
+    return (CpuIsa)isa;
+}
+
+CpuIsa
+lt::cpu_set_isa(CpuIsa isa)
+{
+    const CpuIsa detected = cpu_detected_isa();
+    if (isa < CpuIsa_Scalar) isa = CpuIsa_Scalar;
+    if (isa > detected) isa = detected;
+
+    std::lock_guard<std::mutex> lock(g_dispatch_mutex);
+    g_active_isa.store(isa, std::memory_order_relaxed);
+    for (CpuDispatchCache *cache = g_dispatch_caches; cache; cache = cache->next)
+        cache->kernel.store(nullptr, std::memory_order_relaxed);
+    return isa;
+}
+
+void
+lt::cpu_dispatch_store(CpuDispatchCache *cache, const void *kernel, CpuIsa isa)
+{
+    std::lock_guard<std::mutex> lock(g_dispatch_mutex);
+    if (!cache->linked)
+    {
+        cache->next = g_dispatch_caches;
+        cache->linked = true;
+        g_dispatch_caches = cache;
+    }
+    if (g_active_isa.load(std::memory_order_relaxed) == isa) cache->kernel.store(kernel, std::memory_order_relaxed);
+}
+
+const char *
+lt::cpu_isa_name(CpuIsa isa)
+{
+    return (isa >= 0 && isa < CpuIsa_Count) ? g_isa_names[isa] : "unknown";
+}
+
+bool
+lt::cpu_parse_isa(const char *name, CpuIsa *isa)
+{
+    for (i32 i = 0; i < CpuIsa_Count; i++)
+    {
+        if (strcasecmp(name, g_isa_names[i]) == 0)
+        {
+            *isa = (CpuIsa)i;
+            return true;
+        }
+    }
+    return false;
+}
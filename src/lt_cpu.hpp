@@ -0,0 +1,134 @@
+#ifndef LT_CPU_HPP
+#define LT_CPU_HPP
+
+#include "lt_core.hpp"
+
+#include <atomic>
+
+/////////////////////////////////////////////////////////
+//
+// CPU features and kernel dispatch
+//
+// Feature detection with cpuid (and xgetbv for the register state the OS saves), reduced to
+// an ISA tier that kernels are selected by:
+//
+//   CpuIsa_Scalar   no vector kernels
+//   CpuIsa_SSE2     x86-64 baseline
+//   CpuIsa_SSE42    SSSE3, SSE4.1/4.2, POPCNT
+//   CpuIsa_AVX2     AVX, AVX2, FMA, F16C, BMI1/2
+//   CpuIsa_AVX512   AVX-512 F, BW, DQ, VL
+//
+// Modules that have several kernels compile each of them with a target attribute
+// (LT_TARGET_*), so a binary built for the baseline still contains the AVX2 and AVX-512
+// versions, and keep them in a table sorted by tier. cpu_select searches it once per dispatch
+// site and caches the entry until cpu_set_isa changes the tier.
+//
+// The active tier is the detected one unless it is lowered by the LT_CPU_ISA environment
+// variable (read once, e.g. LT_CPU_ISA=sse2) or by cpu_set_isa, which is how every path is
+// tested and benchmarked on a single machine. Define LT_NO_CPU_DISPATCH to only build the
+// kernels enabled by the compiler flags.
+//
+
+enum CpuFeature
+{
+    CpuFeature_SSE2     = 1 << 0,
+    CpuFeature_SSSE3    = 1 << 1,
+    CpuFeature_SSE41    = 1 << 2,
+    CpuFeature_SSE42    = 1 << 3,
+    CpuFeature_POPCNT   = 1 << 4,
+    CpuFeature_PCLMUL   = 1 << 5,
+    CpuFeature_AVX      = 1 << 6,
+    CpuFeature_AVX2     = 1 << 7,
+    CpuFeature_FMA      = 1 << 8,
+    CpuFeature_F16C     = 1 << 9,
+    CpuFeature_BMI1     = 1 << 10,
+    CpuFeature_BMI2     = 1 << 11,
+    CpuFeature_AVX512F  = 1 << 12,
+    CpuFeature_AVX512BW = 1 << 13,
+    CpuFeature_AVX512DQ = 1 << 14,
+    CpuFeature_AVX512VL = 1 << 15,
+};
+
+enum CpuIsa
+{
+    CpuIsa_Scalar,
+    CpuIsa_SSE2,
+    CpuIsa_SSE42,
+    CpuIsa_AVX2,
+    CpuIsa_AVX512,
+
+    CpuIsa_Count,
+};
+
+#if (LT_GCC || LT_CLANG) && defined(__x86_64__) && !defined(LT_NO_CPU_DISPATCH)
+#  define LT_CPU_DISPATCH 1
+#  define LT_TARGET_SSE42  __attribute__((target("sse4.2,popcnt")))
+#  define LT_TARGET_AVX2   __attribute__((target("avx2,fma,f16c,bmi,bmi2,popcnt")))
+#  define LT_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma,bmi,bmi2,popcnt")))
+#else
+#  define LT_TARGET_SSE42
+#  define LT_TARGET_AVX2
+#  define LT_TARGET_AVX512
+#endif
+
+// Which kernels can be built: all of them with dispatch, otherwise the ones the compiler
+// flags allow.
+#if LT_CPU_DISPATCH || defined(__SSE4_2__)
+#  define LT_CPU_HAS_SSE42 1
+#endif
+#if LT_CPU_DISPATCH || (defined(__AVX2__) && defined(__FMA__))
+#  define LT_CPU_HAS_AVX2 1
+#endif
+#if LT_CPU_DISPATCH || (defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512VL__))
+#  define LT_CPU_HAS_AVX512 1
+#endif
+
+// The kernel a dispatch site selected for the active tier, null until the first call and
+// after every cpu_set_isa. One per table, next to it.
+struct CpuDispatchCache
+{
+    std::atomic<const void*> kernel{nullptr};
+    CpuDispatchCache        *next = nullptr;
+    bool                     linked = false;
+};
+
+namespace lt
+{
+
+// CpuFeature bits of the running CPU, with the AVX ones cleared when the OS does not save
+// their registers.
+u32    cpu_features();
+inline bool cpu_has(u32 features) { return (cpu_features() & features) == features; }
+
+CpuIsa cpu_detected_isa();
+CpuIsa cpu_isa();
+// Caps the tier used by the kernels from now on (it never goes above the detected one) and
+// returns the tier in effect. Not meant to be called while other threads run kernels.
+CpuIsa cpu_set_isa(CpuIsa isa);
+
+const char *cpu_isa_name(CpuIsa isa);
+// Accepts the names returned by cpu_isa_name, case insensitive.
+bool        cpu_parse_isa(const char *name, CpuIsa *isa);
+
+// Caches `kernel`, selected for `isa`, unless the tier changed since. Links the cache so that
+// cpu_set_isa can clear it.
+void cpu_dispatch_store(CpuDispatchCache *cache, const void *kernel, CpuIsa isa);
+
+// Returns the last entry of `table` whose `isa` the active tier can run. Entries are sorted
+// by tier and the first one must be the scalar fallback.
+template<typename K, usize N> inline const K *
+cpu_select(const K (&table)[N], CpuDispatchCache *cache)
+{
+    if (const void *kernel = cache->kernel.load(std::memory_order_relaxed)) return (const K*)kernel;
+
+    const CpuIsa isa = cpu_isa();
+    const K *best = &table[0];
+    for (usize i = 1; i < N; i++)
+        if (table[i].isa <= isa) best = &table[i];
+    cpu_dispatch_store(cache, best, isa);
+    return best;
+}
+
+}
+
+#endif // LT_CPU_HPP
@@ -7,8 +7,59 @@
 #include <X11/extensions/Xrandr.h>
 #endif
 
+#ifndef LT_DISPLAY_MAX_OUTPUTS
+#define LT_DISPLAY_MAX_OUTPUTS 16
+#endif
+
 namespace lt
 {
+
+struct DisplayOutput
+{
+    char name[64];
+    i32  x, y;              // Position inside the X screen, in pixels.
+    i32  width, height;     // Current mode size, in pixels (already rotated).
+    i32  width_mm, height_mm;
+    i32  dpi_x, dpi_y;
+    f64  refresh_rate;      // In Hz, zero when unknown.
+    bool primary;
+#if defined(__unix__)
+    RROutput output_id;
+    RRCrtc   crtc_id;
+    RRMode   mode_id;
+    Rotation rotation;
+#endif
+};
+
+// Keeps a single X connection open and caches every connected output. The cache is only
+// refreshed when the server reports a RandR change, see display_context_update.
+//
+// NOTE: A context is not thread-safe, use it from the thread that owns the UI.
+struct DisplayContext
+{
+#if defined(__unix__)
+    Display *dpy;
+    Window   root;
+    i32      rr_event_base;
+    i32      rr_error_base;
+    bool     has_randr;
+#endif
+    DisplayOutput outputs[LT_DISPLAY_MAX_OUTPUTS];
+    i32           num_outputs;
+};
+
+bool display_context_open(DisplayContext *ctx, const char *display_name = nullptr);
+void display_context_close(DisplayContext *ctx);
+// Drains pending X events without blocking and applies RandR notifications to the cache.
+// Returns true if any output changed.
+bool display_context_update(DisplayContext *ctx);
+// File descriptor of the X connection, for integrating the context into a poll loop.
+i32  display_context_fd(const DisplayContext *ctx);
+
+const DisplayOutput *display_primary_output(const DisplayContext *ctx);
+const DisplayOutput *display_output_at(const DisplayContext *ctx, i32 x, i32 y);
+
+// DPI of the primary output. Uses a context that is opened on the first call and kept alive.
 void lt_get_display_dpi(i32 *x, i32 *y);
 }
 
@@ -29,36 +80,328 @@ void lt_get_display_dpi(i32 *x, i32 *y);
 #if defined(LT_DISPLAY_IMPL) && !defined(LT_DISPLAY_IMPL_DONE)
 #define LT_DISPLAY_IMPL_DONE
 
+#include <cstring>
+
+#ifdef __unix__
+
+/*
+ * there are 2.54 centimeters to an inch; so there are 25.4 millimeters.
+ *
+ *     dpi = N pixels / (M millimeters / (25.4 millimeters / 1 inch))
+ *         = N pixels / (M inch / 25.4)
+ *         = N * 25.4 pixels / M inch
+ */
+lt_internal inline i32
+lt_display_compute_dpi(i32 pixels, i32 mm)
+{
+    if (mm <= 0) return 0;
+    return (i32)((((f64)pixels * 25.4) / (f64)mm) + 0.5);
+}
+
+lt_internal f64
+lt_display_mode_refresh_rate(const XRRModeInfo *mode)
+{
+    f64 v_total = (f64)mode->vTotal;
+    if (mode->modeFlags & RR_DoubleScan) v_total *= 2;
+    if (mode->modeFlags & RR_Interlace) v_total /= 2;
+
+    if (mode->hTotal == 0 || v_total == 0) return 0;
+    return (f64)mode->dotClock / ((f64)mode->hTotal * v_total);
+}
+
+lt_internal void
+lt_display_finish_output(const lt::DisplayContext *ctx, lt::DisplayOutput *out, Rotation rotation)
+{
+    // The physical size is reported for the unrotated panel.
+    if (rotation & (RR_Rotate_90 | RR_Rotate_270))
+    {
+        i32 tmp = out->width_mm;
+        out->width_mm = out->height_mm;
+        out->height_mm = tmp;
+    }
+
+    // Some servers (Xvfb, several projectors) report no physical size for the output,
+    // fall back to the size of the whole screen.
+    if (out->width_mm <= 0 || out->height_mm <= 0)
+    {
+        i32 scr = DefaultScreen(ctx->dpy);
+        i32 screen_w = DisplayWidth(ctx->dpy, scr);
+        i32 screen_h = DisplayHeight(ctx->dpy, scr);
+        out->width_mm = (i32)((f64)DisplayWidthMM(ctx->dpy, scr) * out->width / screen_w);
+        out->height_mm = (i32)((f64)DisplayHeightMM(ctx->dpy, scr) * out->height / screen_h);
+    }
+
+    out->dpi_x = lt_display_compute_dpi(out->width, out->width_mm);
+    out->dpi_y = lt_display_compute_dpi(out->height, out->height_mm);
+}
+
+lt_internal void
+lt_display_refresh_screen_fallback(lt::DisplayContext *ctx)
+{
+    i32 scr = DefaultScreen(ctx->dpy);
+    lt::DisplayOutput *out = &ctx->outputs[0];
+    memset(out, 0, sizeof(*out));
+
+    strncpy(out->name, "default", sizeof(out->name) - 1);
+    out->width = DisplayWidth(ctx->dpy, scr);
+    out->height = DisplayHeight(ctx->dpy, scr);
+    out->width_mm = DisplayWidthMM(ctx->dpy, scr);
+    out->height_mm = DisplayHeightMM(ctx->dpy, scr);
+    out->primary = true;
+    out->rotation = RR_Rotate_0;
+    lt_display_finish_output(ctx, out, RR_Rotate_0);
+
+    ctx->num_outputs = 1;
+}
+
+// Rebuilds the whole cache. XRRGetScreenResourcesCurrent returns the server's current state
+// without probing the hardware, so this is a few round-trips and is only done on changes.
+lt_internal void
+lt_display_refresh_all(lt::DisplayContext *ctx)
+{
+    ctx->num_outputs = 0;
+
+    if (!ctx->has_randr)
+    {
+        lt_display_refresh_screen_fallback(ctx);
+        return;
+    }
+
+    XRRScreenResources *res = XRRGetScreenResourcesCurrent(ctx->dpy, ctx->root);
+    if (!res)
+    {
+        lt_display_refresh_screen_fallback(ctx);
+        return;
+    }
+
+    RROutput primary = XRRGetOutputPrimary(ctx->dpy, ctx->root);
+
+    for (i32 i = 0; i < res->noutput && ctx->num_outputs < LT_DISPLAY_MAX_OUTPUTS; i++)
+    {
+        XRROutputInfo *info = XRRGetOutputInfo(ctx->dpy, res, res->outputs[i]);
+        if (!info) continue;
+
+        if (info->connection != RR_Connected || info->crtc == None)
+        {
+            XRRFreeOutputInfo(info);
+            continue;
+        }
+
+        XRRCrtcInfo *crtc = XRRGetCrtcInfo(ctx->dpy, res, info->crtc);
+        if (!crtc)
+        {
+            XRRFreeOutputInfo(info);
+            continue;
+        }
+
+        lt::DisplayOutput *out = &ctx->outputs[ctx->num_outputs++];
+        memset(out, 0, sizeof(*out));
+
+        i32 name_len = (info->nameLen < (i32)sizeof(out->name) - 1) ? info->nameLen : (i32)sizeof(out->name) - 1;
+        memcpy(out->name, info->name, name_len);
+        out->output_id = res->outputs[i];
+        out->crtc_id = info->crtc;
+        out->mode_id = crtc->mode;
+        out->rotation = crtc->rotation;
+        out->x = crtc->x;
+        out->y = crtc->y;
+        out->width = (i32)crtc->width;
+        out->height = (i32)crtc->height;
+        out->width_mm = (i32)info->mm_width;
+        out->height_mm = (i32)info->mm_height;
+        out->primary = (res->outputs[i] == primary);
+
+        for (i32 m = 0; m < res->nmode; m++)
+        {
+            if (res->modes[m].id == crtc->mode)
+            {
+                out->refresh_rate = lt_display_mode_refresh_rate(&res->modes[m]);
+                break;
+            }
+        }
+
+        lt_display_finish_output(ctx, out, crtc->rotation);
+
+        XRRFreeCrtcInfo(crtc);
+        XRRFreeOutputInfo(info);
+    }
+
+    XRRFreeScreenResources(res);
+
+    if (ctx->num_outputs == 0)
+    {
+        lt_display_refresh_screen_fallback(ctx);
+        return;
+    }
+
+    // Without an explicit primary output the first one plays that role.
+    bool has_primary = false;
+    for (i32 i = 0; i < ctx->num_outputs; i++) has_primary |= ctx->outputs[i].primary;
+    if (!has_primary) ctx->outputs[0].primary = true;
+}
+
+// A CRTC that only moved (same mode, same rotation) is patched in place, anything else
+// falls back to a full refresh. Returns false if a full refresh is needed.
+lt_internal bool
+lt_display_apply_crtc_change(lt::DisplayContext *ctx, const XRRCrtcChangeNotifyEvent *ev)
+{
+    bool found = false;
+    for (i32 i = 0; i < ctx->num_outputs; i++)
+    {
+        lt::DisplayOutput *out = &ctx->outputs[i];
+        if (out->crtc_id != ev->crtc) continue;
+        if (out->mode_id != ev->mode || out->rotation != ev->rotation ||
+            (i32)ev->width != out->width || (i32)ev->height != out->height)
+            return false;
+
+        out->x = ev->x;
+        out->y = ev->y;
+        found = true;
+    }
+    return found;
+}
+
+#endif // __unix__
+
+bool
+lt::display_context_open(DisplayContext *ctx, const char *display_name)
+{
+#ifdef __unix__
+    memset(ctx, 0, sizeof(*ctx));
+
+    ctx->dpy = XOpenDisplay(display_name);
+    if (!ctx->dpy) return false;
+
+    ctx->root = DefaultRootWindow(ctx->dpy);
+
+    i32 major = 0, minor = 0;
+    ctx->has_randr = XRRQueryExtension(ctx->dpy, &ctx->rr_event_base, &ctx->rr_error_base) &&
+        XRRQueryVersion(ctx->dpy, &major, &minor) &&
+        (major > 1 || (major == 1 && minor >= 3));
+
+    if (ctx->has_randr)
+    {
+        XRRSelectInput(ctx->dpy, ctx->root,
+                       RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+    }
+
+    lt_display_refresh_all(ctx);
+    return true;
+#else
+    _Static_assert(false, "Not Implemented");
+#endif
+}
+
 void
-lt::lt_get_display_dpi(i32 *x, i32 *y)
+lt::display_context_close(DisplayContext *ctx)
 {
 #ifdef __unix__
-    i32 scr = 0; /* Screen number */
+    if (ctx->dpy) XCloseDisplay(ctx->dpy);
+    ctx->dpy = NULL;
+    ctx->num_outputs = 0;
+#else
+    _Static_assert(false, "Not Implemented");
+#endif
+}
 
-    if ((NULL == x) || (NULL == y)) { return; }
+bool
+lt::display_context_update(DisplayContext *ctx)
+{
+#ifdef __unix__
+    if (!ctx->dpy || !ctx->has_randr) return false;
+
+    bool changed = false;
+    bool needs_refresh = false;
 
-    char *displayname = NULL;
-    Display *dpy = XOpenDisplay(displayname);
-
-    /*
-     * there are 2.54 centimeters to an inch; so there are 25.4 millimeters.
-     *
-     *     dpi = N pixels / (M millimeters / (25.4 millimeters / 1 inch))
-     *         = N pixels / (M inch / 25.4)
-     *         = N * 25.4 pixels / M inch
-     */
-    f64 xres = ((((f64) DisplayWidth(dpy,scr)) * 25.4) /
-                ((f64) DisplayWidthMM(dpy,scr)));
-    f64 yres = ((((f64) DisplayHeight(dpy,scr)) * 25.4) /
-                ((f64) DisplayHeightMM(dpy,scr)));
-
-    *x = (i32)(xres + 0.5);
-    *y = (i32)(yres + 0.5);
-
-    XCloseDisplay (dpy);
+    while (XPending(ctx->dpy) > 0)
+    {
+        XEvent ev;
+        XNextEvent(ctx->dpy, &ev);
+
+        if (ev.type == ctx->rr_event_base + RRScreenChangeNotify)
+        {
+            XRRUpdateConfiguration(&ev);
+            needs_refresh = true;
+        }
+        else if (ev.type == ctx->rr_event_base + RRNotify)
+        {
+            const XRRNotifyEvent *notify = (const XRRNotifyEvent*)&ev;
+            if (notify->subtype == RRNotify_CrtcChange && !needs_refresh &&
+                lt_display_apply_crtc_change(ctx, (const XRRCrtcChangeNotifyEvent*)&ev))
+            {
+                changed = true;
+            }
+            else
+            {
+                needs_refresh = true;
+            }
+        }
+    }
+
+    if (needs_refresh)
+    {
+        lt_display_refresh_all(ctx);
+        changed = true;
+    }
+    return changed;
 #else
     _Static_assert(false, "Not Implemented");
 #endif
 }
 
+i32
+lt::display_context_fd(const DisplayContext *ctx)
+{
+#ifdef __unix__
+    return ctx->dpy ? ConnectionNumber(ctx->dpy) : -1;
+#else
+    _Static_assert(false, "Not Implemented");
+#endif
+}
+
+const lt::DisplayOutput *
+lt::display_primary_output(const DisplayContext *ctx)
+{
+    for (i32 i = 0; i < ctx->num_outputs; i++)
+        if (ctx->outputs[i].primary) return &ctx->outputs[i];
+    return (ctx->num_outputs > 0) ? &ctx->outputs[0] : NULL;
+}
+
+const lt::DisplayOutput *
+lt::display_output_at(const DisplayContext *ctx, i32 x, i32 y)
+{
+    for (i32 i = 0; i < ctx->num_outputs; i++)
+    {
+        const DisplayOutput *out = &ctx->outputs[i];
+        if (x >= out->x && x < out->x + out->width && y >= out->y && y < out->y + out->height)
+            return out;
+    }
+    return NULL;
+}
+
+void
+lt::lt_get_display_dpi(i32 *x, i32 *y)
+{
+    lt_local_persist DisplayContext ctx;
+    lt_local_persist bool ctx_open = false;
+
+    if ((NULL == x) || (NULL == y)) { return; }
+
+    if (!ctx_open)
+    {
+        if (!display_context_open(&ctx)) return;
+        ctx_open = true;
+    }
+    else
+    {
+        display_context_update(&ctx);
+    }
+
+    const DisplayOutput *out = display_primary_output(&ctx);
+    if (!out) return;
+
+    *x = out->dpi_x;
+    *y = out->dpi_y;
+}
+
 #endif // LT_DISPLAY_IMPL
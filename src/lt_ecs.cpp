@@ -0,0 +1,447 @@
+#include "lt_ecs.hpp"
+#include <cstring>
+
+#define ECS_ALIGNMENT 64
+
+lt_internal inline usize
+align_up(usize size)
+{
+    return (size + ECS_ALIGNMENT - 1) & ~(usize)(ECS_ALIGNMENT - 1);
+}
+
+template<typename T> lt_internal bool
+grow_array(T **array, u32 *capacity, u32 needed)
+{
+    if (needed <= *capacity) return true;
+    u32 n = (*capacity > 0) ? *capacity * 2 : 16;
+    while (n < needed) n *= 2;
+    T *p = (T*)LT_Realloc(*array, sizeof(T) * n, MemoryTag_Ecs);
+    if (!p) return false;
+    *array = p;
+    *capacity = n;
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Archetypes
+//
+
+lt_internal inline u32
+mask_hash(EcsMask mask, u32 table_size)
+{
+    return (u32)((mask * 0x9e3779b97f4a7c15ull) >> 32) & (table_size - 1);
+}
+
+lt_internal u32
+find_archetype(const EcsWorld *world, EcsMask mask)
+{
+    for (u32 h = mask_hash(mask, world->table_size);; h = (h + 1) & (world->table_size - 1))
+    {
+        const u32 a = world->archetype_table[h];
+        if (a == LT_ECS_INVALID || world->archetypes[a]->mask == mask) return a;
+    }
+}
+
+// Keeps the table at most half full.
+lt_internal bool
+insert_archetype(EcsWorld *world, u32 index)
+{
+    if ((world->num_archetypes + 1) * 2 > world->table_size)
+    {
+        const u32 size = world->table_size * 2;
+        u32 *table = (u32*)LT_Malloc(sizeof(u32) * size, MemoryTag_Ecs);
+        if (!table) return false;
+        memset(table, 0xff, sizeof(u32) * size);
+        for (u32 a = 0; a < world->num_archetypes; a++)
+        {
+            u32 h = mask_hash(world->archetypes[a]->mask, size);
+            while (table[h] != LT_ECS_INVALID) h = (h + 1) & (size - 1);
+            table[h] = a;
+        }
+        LT_Free(world->archetype_table);
+        world->archetype_table = table;
+        world->table_size = size;
+    }
+
+    u32 h = mask_hash(world->archetypes[index]->mask, world->table_size);
+    while (world->archetype_table[h] != LT_ECS_INVALID) h = (h + 1) & (world->table_size - 1);
+    world->archetype_table[h] = index;
+    return true;
+}
+
+// Columns in component order after the entity handles, every one on a 64 byte boundary. As
+// many rows as fit in LT_ECS_CHUNK_SIZE, at least one.
+lt_internal void
+layout_archetype(const EcsWorld *world, EcsArchetype *archetype)
+{
+    usize row_bytes = sizeof(EcsEntity);
+    u32 num_columns = 1;
+    for (u32 c = 0; c < world->num_components; c++)
+    {
+        if (!(archetype->mask & ((EcsMask)1 << c))) continue;
+        row_bytes += world->components[c].size;
+        num_columns++;
+    }
+
+    const usize padding = sizeof(EcsChunk) + ECS_ALIGNMENT * num_columns;
+    usize capacity = (LT_ECS_CHUNK_SIZE > padding) ? (LT_ECS_CHUNK_SIZE - padding) / row_bytes : 0;
+    if (capacity == 0) capacity = 1;
+    archetype->chunk_capacity = (u32)capacity;
+
+    usize offset = sizeof(EcsChunk);
+    archetype->entity_offset = (u32)offset;
+    offset += align_up(capacity * sizeof(EcsEntity));
+    for (u32 c = 0; c < world->num_components; c++)
+    {
+        if (!(archetype->mask & ((EcsMask)1 << c))) continue;
+        archetype->column_offset[c] = (u32)offset;
+        offset += align_up(capacity * world->components[c].size);
+    }
+    archetype->chunk_bytes = offset;
+}
+
+// Index of the archetype of `mask`, created if needed. LT_ECS_INVALID when out of memory.
+lt_internal u32
+get_archetype(EcsWorld *world, EcsMask mask)
+{
+    const u32 found = find_archetype(world, mask);
+    if (found != LT_ECS_INVALID) return found;
+
+    if (!grow_array(&world->archetypes, &world->max_archetypes, world->num_archetypes + 1)) return LT_ECS_INVALID;
+    EcsArchetype *archetype = (EcsArchetype*)LT_Calloc(1, sizeof(EcsArchetype), MemoryTag_Ecs);
+    if (!archetype) return LT_ECS_INVALID;
+
+    archetype->mask = mask;
+    archetype->index = world->num_archetypes;
+    memset(archetype->add_edge, 0xff, sizeof(archetype->add_edge));
+    memset(archetype->remove_edge, 0xff, sizeof(archetype->remove_edge));
+    layout_archetype(world, archetype);
+
+    world->archetypes[world->num_archetypes] = archetype;
+    if (!insert_archetype(world, world->num_archetypes))
+    {
+        LT_Free(archetype);
+        return LT_ECS_INVALID;
+    }
+    return world->num_archetypes++;
+}
+
+lt_internal void
+destroy_archetype(EcsArchetype *archetype)
+{
+    for (u32 c = 0; c < archetype->num_chunks; c++) LT_Free(archetype->chunks[c]);
+    LT_Free(archetype->chunks);
+    LT_Free(archetype);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Rows
+//
+
+lt_internal inline u8 *
+column_row(EcsChunk *chunk, u32 offset, u32 size, u32 row)
+{
+    return (u8*)chunk + offset + (usize)row * size;
+}
+
+lt_internal inline EcsEntity *
+entity_column(EcsChunk *chunk)
+{
+    return (EcsEntity*)((u8*)chunk + chunk->archetype->entity_offset);
+}
+
+// Appends `count` rows (at most the room left in the last chunk, or a new chunk) and returns
+// the chunk, with the first row in `row`. The rows are not initialized.
+lt_internal EcsChunk *
+append_rows(EcsArchetype *archetype, u32 count, u32 *row, u32 *appended)
+{
+    EcsChunk *chunk = archetype->num_chunks ? archetype->chunks[archetype->num_chunks - 1] : nullptr;
+    if (!chunk || chunk->count == archetype->chunk_capacity)
+    {
+        if (!grow_array(&archetype->chunks, &archetype->max_chunks, archetype->num_chunks + 1)) return nullptr;
+        chunk = (EcsChunk*)LT_AlignedAlloc(ECS_ALIGNMENT, archetype->chunk_bytes, MemoryTag_Ecs);
+        if (!chunk) return nullptr;
+        chunk->archetype = archetype;
+        chunk->count = 0;
+        chunk->index = archetype->num_chunks;
+        archetype->chunks[archetype->num_chunks++] = chunk;
+    }
+
+    const u32 room = archetype->chunk_capacity - chunk->count;
+    *row = chunk->count;
+    *appended = (count < room) ? count : room;
+    chunk->count += *appended;
+    archetype->num_entities += *appended;
+    return chunk;
+}
+
+// Moves the last row of the archetype into (chunk, row), which is being vacated, and frees the
+// last chunk once it is empty.
+lt_internal void
+remove_row(EcsWorld *world, EcsChunk *chunk, u32 row)
+{
+    EcsArchetype *archetype = chunk->archetype;
+    EcsChunk *last = archetype->chunks[archetype->num_chunks - 1];
+    const u32 last_row = last->count - 1;
+
+    if (last != chunk || last_row != row)
+    {
+        const EcsEntity moved = entity_column(last)[last_row];
+        entity_column(chunk)[row] = moved;
+        for (u32 c = 0; c < world->num_components; c++)
+        {
+            const u32 offset = archetype->column_offset[c];
+            if (!offset) continue;
+            const u32 size = world->components[c].size;
+            memcpy(column_row(chunk, offset, size, row), column_row(last, offset, size, last_row), size);
+        }
+        world->records[moved.index].chunk = chunk->index;
+        world->records[moved.index].row = row;
+    }
+
+    last->count--;
+    archetype->num_entities--;
+    if (last->count == 0)
+    {
+        archetype->num_chunks--;
+        LT_Free(last);
+    }
+}
+
+lt_internal inline bool
+alive(const EcsWorld *world, EcsEntity entity)
+{
+    return entity.index < world->num_records && world->records[entity.index].chunk != LT_ECS_INVALID &&
+        world->records[entity.index].generation == entity.generation;
+}
+
+/////////////////////////////////////////////////////////
+//
+// World
+//
+
+bool
+lt::ecs_world_init(EcsWorld *world)
+{
+    *world = EcsWorld{};
+    world->free_record = LT_ECS_INVALID;
+    world->table_size = 16;
+    world->archetype_table = (u32*)LT_Malloc(sizeof(u32) * world->table_size, MemoryTag_Ecs);
+    if (!world->archetype_table) return false;
+    memset(world->archetype_table, 0xff, sizeof(u32) * world->table_size);
+
+    if (get_archetype(world, 0) == LT_ECS_INVALID)
+    {
+        ecs_world_destroy(world);
+        return false;
+    }
+    return true;
+}
+
+void
+lt::ecs_world_destroy(EcsWorld *world)
+{
+    for (u32 a = 0; a < world->num_archetypes; a++) destroy_archetype(world->archetypes[a]);
+    LT_Free(world->archetypes);
+    LT_Free(world->archetype_table);
+    LT_Free(world->records);
+    *world = EcsWorld{};
+}
+
+EcsComponent
+lt::ecs_component_register(EcsWorld *world, const char *name, u32 size, u32 alignment)
+{
+    LT_Assert(alignment <= ECS_ALIGNMENT);
+    if (world->num_components == LT_ECS_MAX_COMPONENTS) return LT_ECS_INVALID;
+    world->components[world->num_components] = EcsComponentInfo{name, size, alignment};
+    return world->num_components++;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Entities
+//
+
+bool
+lt::ecs_entity_create_many(EcsWorld *world, EcsMask mask, u32 count, EcsEntity *out)
+{
+    LT_Assert(world->num_components == 64 || (mask >> world->num_components) == 0);
+    const u32 a = get_archetype(world, mask);
+    if (a == LT_ECS_INVALID) return false;
+    EcsArchetype *archetype = world->archetypes[a];
+
+    // Slots for every entity first, so the only failure after that is a chunk allocation.
+    const u32 num_free = world->num_records - world->num_entities;
+    if (count > num_free && !grow_array(&world->records, &world->max_records, world->num_records + (count - num_free)))
+        return false;
+
+    for (u32 created = 0; created < count;)
+    {
+        u32 row, n;
+        EcsChunk *chunk = append_rows(archetype, count - created, &row, &n);
+        if (!chunk) return false;
+
+        EcsEntity *entities = entity_column(chunk);
+        for (u32 i = 0; i < n; i++)
+        {
+            u32 index = world->free_record;
+            if (index != LT_ECS_INVALID)
+            {
+                world->free_record = world->records[index].archetype;
+            }
+            else
+            {
+                index = world->num_records++;
+                world->records[index].generation = 1;
+            }
+            EcsRecord *record = &world->records[index];
+            record->archetype = a;
+            record->chunk = chunk->index;
+            record->row = row + i;
+            entities[row + i] = EcsEntity{index, record->generation};
+            out[created + i] = entities[row + i];
+        }
+        for (u32 c = 0; c < world->num_components; c++)
+        {
+            const u32 offset = archetype->column_offset[c];
+            if (offset)
+                memset(column_row(chunk, offset, world->components[c].size, row), 0, (usize)n * world->components[c].size);
+        }
+
+        world->num_entities += n;
+        created += n;
+    }
+    return true;
+}
+
+EcsEntity
+lt::ecs_entity_create(EcsWorld *world, EcsMask mask)
+{
+    EcsEntity entity = {};
+    if (!ecs_entity_create_many(world, mask, 1, &entity)) return EcsEntity{};
+    return entity;
+}
+
+bool
+lt::ecs_entity_destroy(EcsWorld *world, EcsEntity entity)
+{
+    if (!alive(world, entity)) return false;
+
+    EcsRecord *record = &world->records[entity.index];
+    EcsArchetype *archetype = world->archetypes[record->archetype];
+    remove_row(world, archetype->chunks[record->chunk], record->row);
+
+    // Generation 0 is left for the null entity when the counter wraps.
+    record->generation = (record->generation == 0xffffffffu) ? 1 : record->generation + 1;
+    record->archetype = world->free_record;
+    record->chunk = LT_ECS_INVALID;
+    world->free_record = entity.index;
+    world->num_entities--;
+    return true;
+}
+
+bool
+lt::ecs_entity_alive(const EcsWorld *world, EcsEntity entity)
+{
+    return alive(world, entity);
+}
+
+EcsMask
+lt::ecs_entity_mask(const EcsWorld *world, EcsEntity entity)
+{
+    return alive(world, entity) ? world->archetypes[world->records[entity.index].archetype]->mask : 0;
+}
+
+void *
+lt::ecs_get(const EcsWorld *world, EcsEntity entity, EcsComponent component)
+{
+    if (component >= world->num_components || !alive(world, entity)) return nullptr;
+    const EcsRecord &record = world->records[entity.index];
+    const EcsArchetype *archetype = world->archetypes[record.archetype];
+    const u32 offset = archetype->column_offset[component];
+    if (!offset) return nullptr;
+    return column_row(archetype->chunks[record.chunk], offset, world->components[component].size, record.row);
+}
+
+// Moves the entity to the archetype of `mask`: shared components are copied, new ones zeroed.
+lt_internal bool
+move_entity(EcsWorld *world, EcsEntity entity, u32 to)
+{
+    EcsRecord *record = &world->records[entity.index];
+    EcsArchetype *src = world->archetypes[record->archetype];
+    EcsArchetype *dst = world->archetypes[to];
+    EcsChunk *src_chunk = src->chunks[record->chunk];
+    const u32 src_row = record->row;
+
+    u32 row, n;
+    EcsChunk *chunk = append_rows(dst, 1, &row, &n);
+    if (!chunk) return false;
+
+    entity_column(chunk)[row] = entity;
+    for (u32 c = 0; c < world->num_components; c++)
+    {
+        const u32 offset = dst->column_offset[c];
+        if (!offset) continue;
+        const u32 size = world->components[c].size;
+        u8 *p = column_row(chunk, offset, size, row);
+        if (src->column_offset[c]) memcpy(p, column_row(src_chunk, src->column_offset[c], size, src_row), size);
+        else memset(p, 0, size);
+    }
+
+    remove_row(world, src_chunk, src_row);
+    record->archetype = to;
+    record->chunk = chunk->index;
+    record->row = row;
+    return true;
+}
+
+bool
+lt::ecs_add_component(EcsWorld *world, EcsEntity entity, EcsComponent component)
+{
+    if (component >= world->num_components || !alive(world, entity)) return false;
+
+    const u32 from = world->records[entity.index].archetype;
+    EcsArchetype *archetype = world->archetypes[from];
+    if (archetype->mask & ((EcsMask)1 << component)) return true;
+
+    u32 to = archetype->add_edge[component];
+    if (to == LT_ECS_INVALID)
+    {
+        to = get_archetype(world, archetype->mask | ((EcsMask)1 << component));
+        if (to == LT_ECS_INVALID) return false;
+        archetype->add_edge[component] = to;
+        world->archetypes[to]->remove_edge[component] = from;
+    }
+    return move_entity(world, entity, to);
+}
+
+bool
+lt::ecs_remove_component(EcsWorld *world, EcsEntity entity, EcsComponent component)
+{
+    if (component >= world->num_components || !alive(world, entity)) return false;
+
+    const u32 from = world->records[entity.index].archetype;
+    EcsArchetype *archetype = world->archetypes[from];
+    if (!(archetype->mask & ((EcsMask)1 << component))) return true;
+
+    u32 to = archetype->remove_edge[component];
+    if (to == LT_ECS_INVALID)
+    {
+        to = get_archetype(world, archetype->mask & ~((EcsMask)1 << component));
+        if (to == LT_ECS_INVALID) return false;
+        archetype->remove_edge[component] = to;
+        world->archetypes[to]->add_edge[component] = from;
+    }
+    return move_entity(world, entity, to);
+}
+
+u32
+lt::ecs_count(const EcsWorld *world, const EcsQuery &query)
+{
+    u32 count = 0;
+    for (u32 a = 0; a < world->num_archetypes; a++)
+        if (ecs_matches(world->archetypes[a], query)) count += world->archetypes[a]->num_entities;
+    return count;
+}
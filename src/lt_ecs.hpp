@@ -0,0 +1,258 @@
+#ifndef LT_ECS_HPP
+#define LT_ECS_HPP
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "lt_core.hpp"
+#include "lt_parallel.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Entity component system
+//
+// Archetype storage: all entities that have the same set of components (an archetype) live
+// together in fixed size chunks of LT_ECS_CHUNK_SIZE bytes. A chunk holds one column per
+// component, each column a contiguous array of that component starting on a 64 byte
+// boundary, plus a column of entity handles. Columns are plain arrays of the math types
+// (Vec3f, Quatf, Mat4f, ...), so a system is a linear sweep over each chunk, and the batch
+// kernels (lt::decompose, lt::pack_quat32, skinning, ...) can run on columns directly:
+//
+//     lt::ecs_each<Vec3f, const Vec3f>(&world, {position, velocity},
+//         [&](const EcsEntity *, u32 count, Vec3f *p, const Vec3f *v) {
+//             for (u32 i = 0; i < count; i++) p[i] += v[i] * dt;
+//         });
+//
+// Chunks stay dense: removing an entity moves the last entity of its archetype into the hole.
+// Adding or removing a component moves the entity to another archetype. Entities are
+// referred to by handles (slot index and generation), a handle stops being alive when its
+// entity is destroyed, even after the slot is reused.
+//
+// Components are registered at run time and must be trivially copyable, they are moved with
+// memcpy and start zeroed. No structural change (create, destroy, add, remove) may happen
+// while iterating, and the parallel iteration gives whole chunks to threads, so the system
+// must only write to the rows of the chunk it is given.
+//
+
+#define LT_ECS_MAX_COMPONENTS 64
+#define LT_ECS_CHUNK_SIZE     Kilobytes(16)
+#define LT_ECS_INVALID        0xffffffffu
+
+typedef u32 EcsComponent;
+typedef u64 EcsMask;       // Bit c for component c.
+
+struct EcsEntity
+{
+    u32 index;
+    u32 generation;        // Live generations start at 1, {0, 0} is the null entity.
+};
+
+struct EcsComponentInfo
+{
+    const char *name;
+    u32         size;
+    u32         alignment;
+};
+
+struct EcsArchetype;
+
+// Header at the start of every chunk, the columns follow it.
+struct alignas(64) EcsChunk
+{
+    EcsArchetype *archetype;
+    u32           count;
+    u32           index;      // In archetype->chunks.
+};
+
+struct EcsArchetype
+{
+    EcsMask    mask;
+    u32        index;
+    u32        chunk_capacity;                           // Entities per chunk.
+    u32        entity_offset;                            // Of the entity column, from the chunk.
+    u32        column_offset[LT_ECS_MAX_COMPONENTS];    // 0 when the component is absent.
+    u32        add_edge[LT_ECS_MAX_COMPONENTS];         // Archetype with one more component, or LT_ECS_INVALID until known.
+    u32        remove_edge[LT_ECS_MAX_COMPONENTS];
+    usize      chunk_bytes;
+    EcsChunk **chunks;                                   // All full but the last one.
+    u32        num_chunks;
+    u32        max_chunks;
+    u32        num_entities;
+};
+
+struct EcsRecord
+{
+    u32 generation;
+    u32 archetype;         // Next free slot when the slot is free.
+    u32 chunk;             // LT_ECS_INVALID when the slot is free.
+    u32 row;
+};
+
+struct EcsWorld
+{
+    EcsComponentInfo components[LT_ECS_MAX_COMPONENTS];
+    u32              num_components;
+
+    EcsArchetype   **archetypes;       // Archetype 0 has no components.
+    u32              num_archetypes;
+    u32              max_archetypes;
+    u32             *archetype_table;  // Open addressing by mask, power of two.
+    u32              table_size;
+
+    EcsRecord       *records;
+    u32              num_records;
+    u32              max_records;
+    u32              free_record;      // Head of the free slots, LT_ECS_INVALID when empty.
+    u32              num_entities;
+};
+
+struct EcsQuery
+{
+    EcsMask all;       // Components the entities must have.
+    EcsMask none;      // Components they must not have.
+};
+
+namespace lt
+{
+
+bool ecs_world_init(EcsWorld *world);
+void ecs_world_destroy(EcsWorld *world);
+
+// Returns LT_ECS_INVALID when LT_ECS_MAX_COMPONENTS are registered. `alignment` is at most 64.
+EcsComponent ecs_component_register(EcsWorld *world, const char *name, u32 size, u32 alignment);
+
+template<typename T> inline EcsComponent
+ecs_component_register(EcsWorld *world, const char *name)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Components are moved with memcpy.");
+    static_assert(alignof(T) <= 64, "Columns are aligned to 64 bytes.");
+    return ecs_component_register(world, name, (u32)sizeof(T), (u32)alignof(T));
+}
+
+// Create entities with the components of `mask`, zeroed. They return the null entity (and
+// false) when out of memory, ecs_entity_create_many then leaves the created ones alive.
+EcsEntity ecs_entity_create(EcsWorld *world, EcsMask mask);
+bool      ecs_entity_create_many(EcsWorld *world, EcsMask mask, u32 count, EcsEntity *out);
+// Returns false if the entity is not alive.
+bool      ecs_entity_destroy(EcsWorld *world, EcsEntity entity);
+bool      ecs_entity_alive(const EcsWorld *world, EcsEntity entity);
+EcsMask   ecs_entity_mask(const EcsWorld *world, EcsEntity entity);
+
+// Moving to the new archetype invalidates the component pointers of the entity and of the one
+// that fills its old row. Adding a component the entity has, or removing one it does not
+// have, does nothing. Return false if the entity is not alive, the component is not registered
+// (LT_ECS_INVALID included) or when out of memory.
+bool ecs_add_component(EcsWorld *world, EcsEntity entity, EcsComponent component);
+bool ecs_remove_component(EcsWorld *world, EcsEntity entity, EcsComponent component);
+
+// Null if the entity is not alive or does not have the component (or the component is not
+// registered). Valid until the next structural change.
+void *ecs_get(const EcsWorld *world, EcsEntity entity, EcsComponent component);
+
+template<typename T> inline T *
+ecs_get(const EcsWorld *world, EcsEntity entity, EcsComponent component)
+{
+    return (T*)ecs_get(world, entity, component);
+}
+
+u32 ecs_count(const EcsWorld *world, const EcsQuery &query);
+
+inline bool
+ecs_matches(const EcsArchetype *archetype, const EcsQuery &query)
+{
+    return (archetype->mask & query.all) == query.all && (archetype->mask & query.none) == 0;
+}
+
+inline const EcsEntity *
+ecs_entities(const EcsChunk *chunk)
+{
+    return (const EcsEntity*)((const u8*)chunk + chunk->archetype->entity_offset);
+}
+
+// Column of `component` in the chunk, null if its archetype does not have it.
+template<typename T> inline T *
+ecs_column(const EcsChunk *chunk, EcsComponent component)
+{
+    if (component >= LT_ECS_MAX_COMPONENTS) return nullptr;
+    const u32 offset = chunk->archetype->column_offset[component];
+    return offset ? (T*)((u8*)chunk + offset) : nullptr;
+}
+
+// Calls fn(chunk) for every non-empty chunk that matches the query.
+template<typename F> void
+ecs_each_chunk(const EcsWorld *world, const EcsQuery &query, const F &fn)
+{
+    for (u32 a = 0; a < world->num_archetypes; a++)
+    {
+        const EcsArchetype *archetype = world->archetypes[a];
+        if (archetype->num_entities == 0 || !ecs_matches(archetype, query)) continue;
+        for (u32 c = 0; c < archetype->num_chunks; c++) fn(archetype->chunks[c]);
+    }
+}
+
+// Same, with the chunks spread over the worker threads, at least `grain` chunks per thread.
+template<typename F> void
+ecs_each_chunk_parallel(const EcsWorld *world, const EcsQuery &query, const F &fn, usize grain = 4)
+{
+    std::vector<EcsChunk*> chunks;
+    ecs_each_chunk(world, query, [&](EcsChunk *chunk) { chunks.push_back(chunk); });
+    parallel_for(chunks.size(), grain, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) fn(chunks[i]);
+    });
+}
+
+// Ids past LT_ECS_MAX_COMPONENTS (LT_ECS_INVALID from a failed registration) have no bit and
+// are left out.
+inline EcsMask
+ecs_mask(const EcsComponent *components, usize count)
+{
+    EcsMask mask = 0;
+    for (usize i = 0; i < count; i++)
+        if (components[i] < LT_ECS_MAX_COMPONENTS) mask |= (EcsMask)1 << components[i];
+    return mask;
+}
+
+// Same, false when an id has no bit.
+inline bool
+ecs_query_mask(const EcsComponent *components, usize count, EcsMask *mask)
+{
+    for (usize i = 0; i < count; i++)
+        if (components[i] >= LT_ECS_MAX_COMPONENTS) return false;
+    *mask = ecs_mask(components, count);
+    return true;
+}
+
+template<typename... Ts, usize... I, typename F> inline void
+ecs_call_columns(EcsChunk *chunk, const EcsComponent *components, std::index_sequence<I...>, const F &fn)
+{
+    fn(ecs_entities(chunk), chunk->count, ecs_column<Ts>(chunk, components[I])...);
+}
+
+// Typed queries: fn(entities, count, Ts *columns...) for every chunk with all the components,
+// in the order of `components`. Columns of const types are read only. Entities with a
+// component of `exclude` are skipped. No chunk matches an id past LT_ECS_MAX_COMPONENTS.
+template<typename... Ts, typename F> void
+ecs_each(const EcsWorld *world, const EcsComponent (&components)[sizeof...(Ts)], const F &fn,
+         EcsMask exclude = 0)
+{
+    EcsQuery query = {0, exclude};
+    if (!ecs_query_mask(components, sizeof...(Ts), &query.all)) return;
+    ecs_each_chunk(world, query, [&](EcsChunk *chunk) {
+        ecs_call_columns<Ts...>(chunk, components, std::index_sequence_for<Ts...>(), fn);
+    });
+}
+
+template<typename... Ts, typename F> void
+ecs_each_parallel(const EcsWorld *world, const EcsComponent (&components)[sizeof...(Ts)], const F &fn,
+                  EcsMask exclude = 0)
+{
+    EcsQuery query = {0, exclude};
+    if (!ecs_query_mask(components, sizeof...(Ts), &query.all)) return;
+    ecs_each_chunk_parallel(world, query, [&](EcsChunk *chunk) {
+        ecs_call_columns<Ts...>(chunk, components, std::index_sequence_for<Ts...>(), fn);
+    });
+}
+
+}
+
+#endif // LT_ECS_HPP
@@ -0,0 +1,43 @@
+#include "lt_fastmath.hpp"
+
+namespace lt
+{
+// Defined in lt_fastmath_avx2.cpp, NULL when that file could not be built for AVX2.
+const FastMathKernels *fastmath_avx2_kernels();
+}
+
+lt_global_variable constexpr FastMathKernels g_scalar_kernels = lt::fm_make_kernels<f32>(CpuIsa_Scalar, "scalar");
+
+// Widest lane type of the build itself.
+#if LT_FM_AVX2
+lt_global_variable constexpr FastMathKernels g_build_kernels = lt::fm_make_kernels<lt::F32x8>(CpuIsa_AVX2, "avx2");
+#elif defined(__SSE2__)
+lt_global_variable constexpr FastMathKernels g_build_kernels = lt::fm_make_kernels<lt::F32x4>(CpuIsa_SSE2, "sse2");
+#else
+lt_global_variable constexpr FastMathKernels g_build_kernels = g_scalar_kernels;
+#endif
+
+lt_global_variable CpuDispatchCache g_fastmath_dispatch;
+
+lt_internal const FastMathKernels *
+select_kernels(CpuIsa isa)
+{
+    if (isa >= CpuIsa_AVX2)
+    {
+        const FastMathKernels *avx2 = lt::fastmath_avx2_kernels();
+        if (avx2) return avx2;
+    }
+    return (g_build_kernels.isa <= isa) ? &g_build_kernels : &g_scalar_kernels;
+}
+
+const FastMathKernels *
+lt::fastmath_kernels()
+{
+    if (const void *kernels = g_fastmath_dispatch.kernel.load(std::memory_order_relaxed))
+        return (const FastMathKernels*)kernels;
+
+    const CpuIsa isa = cpu_isa();
+    const FastMathKernels *kernels = select_kernels(isa);
+    cpu_dispatch_store(&g_fastmath_dispatch, kernels, isa);
+    return kernels;
+}
@@ -0,0 +1,607 @@
+#ifndef LT_FASTMATH_HPP
+#define LT_FASTMATH_HPP
+
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include "lt_core.hpp"
+#include "lt_cpu.hpp"
+
+#if (LT_GCC || LT_CLANG) && LT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// Fast math
+//
+// Polynomial approximations of the transcendental functions in single precision. Every
+// function is a template over the lane type, so the same code runs on f32, F32x4 (SSE2) and
+// F32x8 (AVX2), and over a precision tier:
+//
+//   - FastMathPrecision_Accurate: Cephes-derived polynomials, a few ULP from the true value.
+//   - FastMathPrecision_Fast:     lower degree minimax polynomials, 1e-5 to 5e-5 relative error.
+//
+// Maximum errors, measured against double precision over the documented domain. Where the
+// result crosses zero the absolute error is the meaningful bound and is given instead.
+//
+//   function   domain                 Accurate                       Fast
+//   sincos     |x| <= pi              2 ULP                          abs 1.4e-5
+//              |x| <= 8192            abs 1e-7                       abs 1.4e-5
+//   tan        |x| <= 1.5             4 ULP                          256 ULP
+//   acos       [-1, 1]                2 ULP                          abs 4e-5
+//   rsqrt      x > 0                  4 ULP                          rel 3.3e-4 (raw rsqrtps)
+//   exp        [-87.3, 88.7]          2 ULP                          80 ULP
+//   log        x > 0, normal          1 ULP                          256 ULP, abs 1e-5
+//
+// Outside the domain: exp saturates to 0 and +inf, log returns -inf for 0 and NaN for negative
+// inputs, acos returns NaN for |x| > 1. sincos loses accuracy past |x| = 8192.
+//
+// The array versions at the end run a kernel picked at run time from the CpuIsa: scalar, the
+// widest lane type of the build, or AVX2+FMA from lt_fastmath_avx2.cpp, which compiles this
+// header again with LT_FASTMATH_AVX2 under a target pragma. Each configuration of the header
+// lives in its own inline namespace (LT_FM_NAMESPACE), so inline functions compiled for AVX2
+// are never merged with the baseline ones by the linker.
+//
+
+#if defined(__AVX2__) || LT_FASTMATH_AVX2
+#  define LT_FM_AVX2 1
+#endif
+#if defined(__FMA__) || LT_FASTMATH_AVX2
+#  define LT_FM_FMA 1
+#endif
+
+#if LT_FM_AVX2 && LT_FM_FMA
+#  define LT_FM_NAMESPACE fm_avx2_fma
+#elif LT_FM_AVX2
+#  define LT_FM_NAMESPACE fm_avx2
+#elif LT_FM_FMA
+#  define LT_FM_NAMESPACE fm_sse2_fma
+#elif defined(__SSE2__)
+#  define LT_FM_NAMESPACE fm_sse2
+#else
+#  define LT_FM_NAMESPACE fm_scalar
+#endif
+
+enum FastMathPrecision
+{
+    FastMathPrecision_Fast,
+    FastMathPrecision_Accurate,
+};
+
+// Array functions with a single input, see FastMathKernels.
+enum FastMathOp
+{
+    FastMathOp_Tan,
+    FastMathOp_Acos,
+    FastMathOp_Rsqrt,
+    FastMathOp_Exp,
+    FastMathOp_Log,
+
+    FastMathOp_Count,
+};
+
+struct FastMathKernels
+{
+    CpuIsa      isa;
+    const char *name;
+    // Indexed by FastMathPrecision.
+    void      (*sincos[2])(const f32 *in, f32 *out_sin, f32 *out_cos, usize count);
+    void      (*unary[FastMathOp_Count][2])(const f32 *in, f32 *out, usize count);
+};
+
+namespace lt
+{
+
+inline namespace LT_FM_NAMESPACE
+{
+
+/////////////////////////////////////////////////////////
+//
+// Lane types
+//
+
+#if defined(__SSE2__)
+struct F32x4
+{
+    __m128 v;
+
+    F32x4() = default;
+    F32x4(__m128 v) : v(v) {}
+    F32x4(f32 k) : v(_mm_set1_ps(k)) {}
+
+    static inline F32x4 load(const f32 *p) { return _mm_loadu_ps(p); }
+    inline void store(f32 *p) const { _mm_storeu_ps(p, v); }
+};
+
+struct I32x4
+{
+    __m128i v;
+};
+
+inline F32x4 operator+(F32x4 a, F32x4 b) { return _mm_add_ps(a.v, b.v); }
+inline F32x4 operator-(F32x4 a, F32x4 b) { return _mm_sub_ps(a.v, b.v); }
+inline F32x4 operator*(F32x4 a, F32x4 b) { return _mm_mul_ps(a.v, b.v); }
+inline F32x4 operator/(F32x4 a, F32x4 b) { return _mm_div_ps(a.v, b.v); }
+inline F32x4 operator-(F32x4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+#endif
+
+#if LT_FM_AVX2
+struct F32x8
+{
+    __m256 v;
+
+    F32x8() = default;
+    F32x8(__m256 v) : v(v) {}
+    F32x8(f32 k) : v(_mm256_set1_ps(k)) {}
+
+    static inline F32x8 load(const f32 *p) { return _mm256_loadu_ps(p); }
+    inline void store(f32 *p) const { _mm256_storeu_ps(p, v); }
+};
+
+struct I32x8
+{
+    __m256i v;
+};
+
+inline F32x8 operator+(F32x8 a, F32x8 b) { return _mm256_add_ps(a.v, b.v); }
+inline F32x8 operator-(F32x8 a, F32x8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline F32x8 operator*(F32x8 a, F32x8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline F32x8 operator/(F32x8 a, F32x8 b) { return _mm256_div_ps(a.v, b.v); }
+inline F32x8 operator-(F32x8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// Lane primitives (fm_*), overloaded for every lane type
+//
+
+inline f32  fm_madd(f32 a, f32 b, f32 c) { return a*b + c; }
+inline f32  fm_abs(f32 x) { return std::fabs(x); }
+inline f32  fm_sqrt(f32 x) { return std::sqrt(x); }
+inline bool fm_gt(f32 a, f32 b) { return a > b; }
+inline bool fm_lt(f32 a, f32 b) { return a < b; }
+inline bool fm_eq(f32 a, f32 b) { return a == b; }
+inline f32  fm_select(bool mask, f32 a, f32 b) { return mask ? a : b; }
+inline i32  fm_round_to_int(f32 x) { return (i32)(x + ((x >= 0) ? 0.5f : -0.5f)); }
+inline f32  fm_to_float(i32 i) { return (f32)i; }
+inline bool fm_int_test(i32 i, i32 bit) { return (i & bit) != 0; }
+inline i32  fm_int_add(i32 i, i32 k) { return i + k; }
+
+// 2^i for i in [-126, 127].
+inline f32
+fm_pow2i(i32 i)
+{
+    u32 bits = (u32)(i + 127) << 23;
+    f32 r;
+    memcpy(&r, &bits, sizeof(r));
+    return r;
+}
+
+// Splits a positive normal x into a mantissa in [1, 2) and its exponent.
+inline f32
+fm_frexp(f32 x, i32 *e)
+{
+    u32 bits;
+    memcpy(&bits, &x, sizeof(bits));
+    *e = (i32)((bits >> 23) & 0xFF) - 127;
+    bits = (bits & 0x007FFFFF) | 0x3F800000;
+    f32 m;
+    memcpy(&m, &bits, sizeof(m));
+    return m;
+}
+
+inline f32
+fm_rsqrt_estimate(f32 x)
+{
+#if defined(__SSE2__)
+    return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+    u32 bits;
+    memcpy(&bits, &x, sizeof(bits));
+    bits = 0x5F375A86 - (bits >> 1);
+    f32 y;
+    memcpy(&y, &bits, sizeof(y));
+    // Two Newton steps bring the bit trick close to the precision of rsqrtss.
+    y = y * (1.5f - 0.5f*x*y*y);
+    return y * (1.5f - 0.5f*x*y*y);
+#endif
+}
+
+#if defined(__SSE2__)
+inline F32x4
+fm_madd(F32x4 a, F32x4 b, F32x4 c)
+{
+#if LT_FM_FMA
+    return _mm_fmadd_ps(a.v, b.v, c.v);
+#else
+    return _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v);
+#endif
+}
+
+inline F32x4 fm_abs(F32x4 x) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), x.v); }
+inline F32x4 fm_sqrt(F32x4 x) { return _mm_sqrt_ps(x.v); }
+inline F32x4 fm_gt(F32x4 a, F32x4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline F32x4 fm_lt(F32x4 a, F32x4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline F32x4 fm_eq(F32x4 a, F32x4 b) { return _mm_cmpeq_ps(a.v, b.v); }
+inline I32x4 fm_round_to_int(F32x4 x) { return I32x4{_mm_cvtps_epi32(x.v)}; }
+inline F32x4 fm_to_float(I32x4 i) { return _mm_cvtepi32_ps(i.v); }
+inline I32x4 fm_int_add(I32x4 i, i32 k) { return I32x4{_mm_add_epi32(i.v, _mm_set1_epi32(k))}; }
+inline F32x4 fm_rsqrt_estimate(F32x4 x) { return _mm_rsqrt_ps(x.v); }
+
+inline F32x4
+fm_select(F32x4 mask, F32x4 a, F32x4 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+
+inline F32x4
+fm_int_test(I32x4 i, i32 bit)
+{
+    __m128i b = _mm_set1_epi32(bit);
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(i.v, b), b));
+}
+
+inline F32x4
+fm_pow2i(I32x4 i)
+{
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i.v, _mm_set1_epi32(127)), 23));
+}
+
+inline F32x4
+fm_frexp(F32x4 x, I32x4 *e)
+{
+    __m128i bits = _mm_castps_si128(x.v);
+    e->v = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xFF)), _mm_set1_epi32(127));
+    bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000));
+    return _mm_castsi128_ps(bits);
+}
+#endif
+
+#if LT_FM_AVX2
+inline F32x8
+fm_madd(F32x8 a, F32x8 b, F32x8 c)
+{
+#if LT_FM_FMA
+    return _mm256_fmadd_ps(a.v, b.v, c.v);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v);
+#endif
+}
+
+inline F32x8 fm_abs(F32x8 x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x.v); }
+inline F32x8 fm_sqrt(F32x8 x) { return _mm256_sqrt_ps(x.v); }
+inline F32x8 fm_gt(F32x8 a, F32x8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline F32x8 fm_lt(F32x8 a, F32x8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline F32x8 fm_eq(F32x8 a, F32x8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+inline F32x8 fm_select(F32x8 mask, F32x8 a, F32x8 b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+inline I32x8 fm_round_to_int(F32x8 x) { return I32x8{_mm256_cvtps_epi32(x.v)}; }
+inline F32x8 fm_to_float(I32x8 i) { return _mm256_cvtepi32_ps(i.v); }
+inline I32x8 fm_int_add(I32x8 i, i32 k) { return I32x8{_mm256_add_epi32(i.v, _mm256_set1_epi32(k))}; }
+inline F32x8 fm_rsqrt_estimate(F32x8 x) { return _mm256_rsqrt_ps(x.v); }
+
+inline F32x8
+fm_int_test(I32x8 i, i32 bit)
+{
+    __m256i b = _mm256_set1_epi32(bit);
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(i.v, b), b));
+}
+
+inline F32x8
+fm_pow2i(I32x8 i)
+{
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(i.v, _mm256_set1_epi32(127)), 23));
+}
+
+inline F32x8
+fm_frexp(F32x8 x, I32x8 *e)
+{
+    __m256i bits = _mm256_castps_si256(x.v);
+    e->v = _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xFF)),
+                            _mm256_set1_epi32(127));
+    bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000));
+    return _mm256_castsi256_ps(bits);
+}
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// Functions
+//
+
+template<FastMathPrecision P = FastMathPrecision_Accurate, typename V> inline void
+fast_sincos(V x, V *out_sin, V *out_cos)
+{
+    // Cody-Waite reduction to [-pi/4, pi/4], pi/2 is split in three parts so that q*part is
+    // exact for |q| < 2^13.
+    auto q = fm_round_to_int(x * V(0.636619772367581343f));
+    V qf = fm_to_float(q);
+    V r = fm_madd(qf, V(-1.5703125f), x);
+    r = fm_madd(qf, V(-4.837512969970703125e-4f), r);
+    r = fm_madd(qf, V(-7.54978995489188216e-8f), r);
+    V z = r*r;
+
+    V s, c;
+    if constexpr (P == FastMathPrecision_Fast)
+    {
+        s = fm_madd(fm_madd(V(8.1632819257e-3f), z, V(-1.6663390378e-1f)) * z, r, r);
+        c = fm_madd(fm_madd(V(4.0458452284e-2f), z, V(-4.9976055710e-1f)), z, V(1.0f));
+    }
+    else
+    {
+        V ps = fm_madd(fm_madd(V(-1.9515295891e-4f), z, V(8.3321608736e-3f)), z, V(-1.6666654611e-1f));
+        s = fm_madd(ps * z, r, r);
+        V pc = fm_madd(fm_madd(V(2.443315711809948e-5f), z, V(-1.388731625493765e-3f)), z,
+                       V(4.166664568298827e-2f));
+        c = fm_madd(pc * z, z, fm_madd(V(-0.5f), z, V(1.0f)));
+    }
+
+    auto swap = fm_int_test(q, 1);
+    V sin_r = fm_select(swap, c, s);
+    V cos_r = fm_select(swap, s, c);
+    *out_sin = fm_select(fm_int_test(q, 2), -sin_r, sin_r);
+    *out_cos = fm_select(fm_int_test(fm_int_add(q, 1), 2), -cos_r, cos_r);
+}
+
+template<FastMathPrecision P = FastMathPrecision_Accurate, typename V> inline V
+fast_sin(V x)
+{
+    V s, c;
+    fast_sincos<P>(x, &s, &c);
+    return s;
+}
+
+template<FastMathPrecision P = FastMathPrecision_Accurate, typename V> inline V
+fast_cos(V x)
+{
+    V s, c;
+    fast_sincos<P>(x, &s, &c);
+    return c;
+}
+
+template<FastMathPrecision P = FastMathPrecision_Accurate, typename V> inline V
+fast_tan(V x)
+{
+    V s, c;
+    fast_sincos<P>(x, &s, &c);
+    return s / c;
+}
+
+template<FastMathPrecision P = FastMathPrecision_Accurate, typename V> inline V
+fast_acos(V x)
+{
+    const V pi_2(1.57079632679489661923f);
+
+    // asin on [0, 0.5], the upper half of the domain uses asin(x) = pi/2 - 2*asin(sqrt((1-x)/2)).
+    V a = fm_abs(x);
+    auto big = fm_gt(a, V(0.5f));
+    V z = fm_select(big, V(0.5f) * (V(1.0f) - a), a*a);
+    V s = fm_select(big, fm_sqrt(z), a);
+
+    V p;
+    if constexpr (P == FastMathPrecision_Fast)
+    {
+        p = fm_madd(V(9.4298676986e-2f), z, V(1.6505775951e-1f));
+    }
+    else
+    {
+        p = fm_madd(V(4.2163199048e-2f), z, V(2.4181311049e-2f));
+        p = fm_madd(p, z, V(4.5470025998e-2f));
+        p = fm_madd(p, z, V(7.4953002686e-2f));
+        p = fm_madd(p, z, V(1.6666752422e-1f));
+    }
+    V asin_s = fm_madd(s * z, p, s);
+
+    auto negative = fm_lt(x, V(0.0f));
+    V small_result = fm_select(negative, pi_2 + asin_s, pi_2 - asin_s);
+    V twice = asin_s + asin_s;
+    V big_result = fm_select(negative, V(3.14159265358979323846f) - twice, twice);
+    return fm_select(big, big_result, small_result);
+}
+
+template<FastMathPrecision P = FastMathPrecision_Accurate, typename V> inline V
+fast_rsqrt(V x)
+{
+    V y = fm_rsqrt_estimate(x);
+    if constexpr (P == FastMathPrecision_Accurate)
+    {
+        // One Newton-Raphson step: y' = y * (1.5 - 0.5*x*y*y)
+        V half_x = V(0.5f) * x;
+        y = y * fm_madd(-half_x, y*y, V(1.5f));
+    }
+    return y;
+}
+
+template<FastMathPrecision P = FastMathPrecision_Accurate, typename V> inline V
+fast_exp(V x)
+{
+    // exp(x) = 2^q * exp(r), with |r| <= ln(2)/2.
+    auto q = fm_round_to_int(x * V(1.44269504088896341f));
+    V qf = fm_to_float(q);
+    V r = fm_madd(qf, V(-0.693359375f), x);
+    r = fm_madd(qf, V(2.12194440e-4f), r);
+
+    V p;
+    if constexpr (P == FastMathPrecision_Fast)
+    {
+        p = fm_madd(V(4.1277747091e-2f), r, V(1.6753513931e-1f));
+        p = fm_madd(p, r, V(5.0005116027e-1f));
+    }
+    else
+    {
+        p = fm_madd(V(1.9875691500e-4f), r, V(1.3981999507e-3f));
+        p = fm_madd(p, r, V(8.3334519073e-3f));
+        p = fm_madd(p, r, V(4.1665795894e-2f));
+        p = fm_madd(p, r, V(1.6666665459e-1f));
+        p = fm_madd(p, r, V(5.0000001201e-1f));
+    }
+    V y = fm_madd(p, r*r, r + V(1.0f));
+
+    // Scale in two steps so that q = 128 (the top of the domain) does not overflow the exponent.
+    auto q_half = fm_round_to_int(qf * V(0.5f));
+    y = y * fm_pow2i(q_half);
+    y = y * fm_pow2i(fm_round_to_int(qf - fm_to_float(q_half)));
+
+    y = fm_select(fm_gt(x, V(88.7228391f)), V(HUGE_VALF), y);
+    return fm_select(fm_lt(x, V(-87.3365448f)), V(0.0f), y);
+}
+
+template<FastMathPrecision P = FastMathPrecision_Accurate, typename V> inline V
+fast_log(V x)
+{
+    decltype(fm_round_to_int(x)) e;
+    V m = fm_frexp(x, &e);
+    V ef = fm_to_float(e);
+
+    // Center the mantissa around 1: m in [sqrt(1/2), sqrt(2)).
+    auto above = fm_gt(m, V(1.41421356237309504880f));
+    m = fm_select(above, m * V(0.5f), m);
+    ef = fm_select(above, ef + V(1.0f), ef);
+
+    V t = m - V(1.0f);
+    V z = t*t;
+
+    V p;
+    if constexpr (P == FastMathPrecision_Fast)
+    {
+        p = fm_madd(V(-1.4592515081e-1f), t, V(2.1776510022e-1f));
+        p = fm_madd(p, t, V(-2.5244997504e-1f));
+        p = fm_madd(p, t, V(3.3285471025e-1f));
+    }
+    else
+    {
+        p = fm_madd(V(7.0376836292e-2f), t, V(-1.1514610310e-1f));
+        p = fm_madd(p, t, V(1.1676998740e-1f));
+        p = fm_madd(p, t, V(-1.2420140846e-1f));
+        p = fm_madd(p, t, V(1.4249322787e-1f));
+        p = fm_madd(p, t, V(-1.6668057665e-1f));
+        p = fm_madd(p, t, V(2.0000714765e-1f));
+        p = fm_madd(p, t, V(-2.4999993993e-1f));
+        p = fm_madd(p, t, V(3.3333331174e-1f));
+    }
+
+    V y = p * t * z;
+    y = fm_madd(ef, V(-2.12194440e-4f), y);
+    y = fm_madd(z, V(-0.5f), y);
+    V result = fm_madd(ef, V(0.693359375f), t + y);
+
+    result = fm_select(fm_eq(x, V(0.0f)), V(-HUGE_VALF), result);
+    return fm_select(fm_lt(x, V(0.0f)), V(NAN), result);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Array kernels over lane type V, then the narrower ones for the remainder
+//
+
+template<FastMathOp Op, FastMathPrecision P, typename V> inline V
+fm_apply(V x)
+{
+    if constexpr (Op == FastMathOp_Tan) return fast_tan<P>(x);
+    else if constexpr (Op == FastMathOp_Acos) return fast_acos<P>(x);
+    else if constexpr (Op == FastMathOp_Rsqrt) return fast_rsqrt<P>(x);
+    else if constexpr (Op == FastMathOp_Exp) return fast_exp<P>(x);
+    else return fast_log<P>(x);
+}
+
+template<typename V, FastMathOp Op, FastMathPrecision P> void
+fm_kernel_unary(const f32 *in, f32 *out, usize count)
+{
+    usize i = 0;
+#if LT_FM_AVX2
+    if constexpr (std::is_same_v<V, F32x8>)
+        for (; i + 8 <= count; i += 8) fm_apply<Op, P>(F32x8::load(in + i)).store(out + i);
+#endif
+#if defined(__SSE2__)
+    if constexpr (!std::is_same_v<V, f32>)
+        for (; i + 4 <= count; i += 4) fm_apply<Op, P>(F32x4::load(in + i)).store(out + i);
+#endif
+    for (; i < count; i++) out[i] = fm_apply<Op, P>(in[i]);
+}
+
+template<typename V, FastMathPrecision P> void
+fm_kernel_sincos(const f32 *in, f32 *out_sin, f32 *out_cos, usize count)
+{
+    usize i = 0;
+#if LT_FM_AVX2
+    if constexpr (std::is_same_v<V, F32x8>)
+    {
+        for (; i + 8 <= count; i += 8)
+        {
+            F32x8 s, c;
+            fast_sincos<P>(F32x8::load(in + i), &s, &c);
+            s.store(out_sin + i);
+            c.store(out_cos + i);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    if constexpr (!std::is_same_v<V, f32>)
+    {
+        for (; i + 4 <= count; i += 4)
+        {
+            F32x4 s, c;
+            fast_sincos<P>(F32x4::load(in + i), &s, &c);
+            s.store(out_sin + i);
+            c.store(out_cos + i);
+        }
+    }
+#endif
+    for (; i < count; i++) fast_sincos<P>(in[i], &out_sin[i], &out_cos[i]);
+}
+
+template<typename V> constexpr FastMathKernels
+fm_make_kernels(CpuIsa isa, const char *name)
+{
+    FastMathKernels k = {};
+    k.isa = isa;
+    k.name = name;
+    k.sincos[FastMathPrecision_Fast] = fm_kernel_sincos<V, FastMathPrecision_Fast>;
+    k.sincos[FastMathPrecision_Accurate] = fm_kernel_sincos<V, FastMathPrecision_Accurate>;
+    k.unary[FastMathOp_Tan][FastMathPrecision_Fast] = fm_kernel_unary<V, FastMathOp_Tan, FastMathPrecision_Fast>;
+    k.unary[FastMathOp_Tan][FastMathPrecision_Accurate] = fm_kernel_unary<V, FastMathOp_Tan, FastMathPrecision_Accurate>;
+    k.unary[FastMathOp_Acos][FastMathPrecision_Fast] = fm_kernel_unary<V, FastMathOp_Acos, FastMathPrecision_Fast>;
+    k.unary[FastMathOp_Acos][FastMathPrecision_Accurate] = fm_kernel_unary<V, FastMathOp_Acos, FastMathPrecision_Accurate>;
+    k.unary[FastMathOp_Rsqrt][FastMathPrecision_Fast] = fm_kernel_unary<V, FastMathOp_Rsqrt, FastMathPrecision_Fast>;
+    k.unary[FastMathOp_Rsqrt][FastMathPrecision_Accurate] = fm_kernel_unary<V, FastMathOp_Rsqrt, FastMathPrecision_Accurate>;
+    k.unary[FastMathOp_Exp][FastMathPrecision_Fast] = fm_kernel_unary<V, FastMathOp_Exp, FastMathPrecision_Fast>;
+    k.unary[FastMathOp_Exp][FastMathPrecision_Accurate] = fm_kernel_unary<V, FastMathOp_Exp, FastMathPrecision_Accurate>;
+    k.unary[FastMathOp_Log][FastMathPrecision_Fast] = fm_kernel_unary<V, FastMathOp_Log, FastMathPrecision_Fast>;
+    k.unary[FastMathOp_Log][FastMathPrecision_Accurate] = fm_kernel_unary<V, FastMathOp_Log, FastMathPrecision_Accurate>;
+    return k;
+}
+
+} // LT_FM_NAMESPACE
+
+/////////////////////////////////////////////////////////
+//
+// Batch versions over arrays, dispatched at run time
+//
+
+// Kernels for the active CpuIsa.
+const FastMathKernels *fastmath_kernels();
+
+template<FastMathPrecision P = FastMathPrecision_Accurate> inline void
+fast_sincos(const f32 *in, f32 *out_sin, f32 *out_cos, usize count)
+{
+    fastmath_kernels()->sincos[P](in, out_sin, out_cos, count);
+}
+
+template<FastMathPrecision P = FastMathPrecision_Accurate> inline void
+fast_tan(const f32 *in, f32 *out, usize count) { fastmath_kernels()->unary[FastMathOp_Tan][P](in, out, count); }
+
+template<FastMathPrecision P = FastMathPrecision_Accurate> inline void
+fast_acos(const f32 *in, f32 *out, usize count) { fastmath_kernels()->unary[FastMathOp_Acos][P](in, out, count); }
+
+template<FastMathPrecision P = FastMathPrecision_Accurate> inline void
+fast_rsqrt(const f32 *in, f32 *out, usize count) { fastmath_kernels()->unary[FastMathOp_Rsqrt][P](in, out, count); }
+
+template<FastMathPrecision P = FastMathPrecision_Accurate> inline void
+fast_exp(const f32 *in, f32 *out, usize count) { fastmath_kernels()->unary[FastMathOp_Exp][P](in, out, count); }
+
+template<FastMathPrecision P = FastMathPrecision_Accurate> inline void
+fast_log(const f32 *in, f32 *out, usize count) { fastmath_kernels()->unary[FastMathOp_Log][P](in, out, count); }
+
+}
+
+#endif // LT_FASTMATH_HPP
@@ -0,0 +1,42 @@
+// The fast math array kernels built for AVX2 and FMA, whatever the flags of the build, and
+// only called when cpu_isa allows it. Everything this file includes apart from lt_fastmath.hpp
+// comes before the target pragma, so only the functions of lt_fastmath.hpp (in their own
+// inline namespace) are compiled with it.
+
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include "lt_core.hpp"
+#include "lt_cpu.hpp"
+
+#if (LT_GCC || LT_CLANG) && LT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+// Clang does not apply `#pragma GCC target` to the functions that follow, it only gets these
+// kernels from -mavx2 -mfma, which makes lt_fastmath.cpp use them directly.
+#if LT_CPU_DISPATCH && LT_GCC && !LT_CLANG && !defined(__AVX2__)
+#  pragma GCC target("avx2,fma")
+#  define LT_FASTMATH_AVX2 1
+#endif
+
+#include "lt_fastmath.hpp"
+
+#if LT_FASTMATH_AVX2
+lt_global_variable constexpr FastMathKernels g_avx2_kernels = lt::fm_make_kernels<lt::F32x8>(CpuIsa_AVX2, "avx2");
+#endif
+
+namespace lt
+{
+const FastMathKernels *fastmath_avx2_kernels();
+}
+
+const FastMathKernels *
+lt::fastmath_avx2_kernels()
+{
+#if LT_FASTMATH_AVX2
+    return &g_avx2_kernels;
+#else
+    return nullptr;
+#endif
+}
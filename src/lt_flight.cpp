@@ -0,0 +1,518 @@
+#include "lt_flight.hpp"
+#include "lt_format.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#if LT_PLATFORM_UNIX
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#if LT_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+// Longest name printed, names are only trusted to be zero terminated.
+#define LT_FLIGHT_NAME_SIZE 64
+#define LT_FLIGHT_SIGNAL_STACK_SIZE Kilobytes(64)
+
+static_assert((LT_FLIGHT_EVENTS & (LT_FLIGHT_EVENTS - 1)) == 0, "LT_FLIGHT_EVENTS must be a power of two");
+
+thread_local FlightRing *lt::t_flight_ring = nullptr;
+
+lt_global_variable std::atomic<FlightRing*> g_rings{nullptr};
+
+// Used by threads whose ring could not be allocated. Their events interleave, but every field
+// is written whole so the dump stays safe to read.
+lt_global_variable FlightEvent g_fallback_events[LT_FLIGHT_EVENTS];
+lt_global_variable FlightRing  g_fallback_ring;
+
+lt_global_variable char g_path[LT_FLIGHT_PATH_SIZE];
+lt_global_variable u64  g_init_tsc;
+lt_global_variable u64  g_init_ns;
+
+enum DumpState
+{
+    DumpState_None,
+    DumpState_Running,
+    DumpState_Done,
+};
+
+lt_global_variable std::atomic<u32> g_crash_dump{DumpState_None};
+
+lt_internal u32
+thread_id()
+{
+#if LT_OS_LINUX
+    return (u32)syscall(SYS_gettid);
+#else
+    return 0;
+#endif
+}
+
+lt_internal u64
+monotonic_ns()
+{
+#if LT_PLATFORM_UNIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/////////////////////////////////////////////////////////
+//
+// Recording
+//
+
+// Gives the ring back when its thread exits.
+struct FlightThreadSlot
+{
+    FlightRing *ring = nullptr;
+
+    ~FlightThreadSlot()
+    {
+        if (!ring || ring == &g_fallback_ring) return;
+        lt::t_flight_ring = nullptr;
+        ring->in_use.store(0, std::memory_order_release);
+    }
+};
+
+lt_internal thread_local FlightThreadSlot t_slot;
+
+lt_internal FlightRing *
+reuse_ring()
+{
+    for (FlightRing *r = g_rings.load(std::memory_order_acquire); r; r = r->next)
+    {
+        u32 expected = 0;
+        if (r->in_use.load(std::memory_order_relaxed) == 0 &&
+            r->in_use.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+            return r;
+    }
+    return nullptr;
+}
+
+// Rings are never freed, and stay out of the LT_MEMORY_TRACKING leak report.
+lt_internal FlightRing *
+new_ring()
+{
+    void *memory = calloc(1, sizeof(FlightRing));
+    FlightEvent *events = (FlightEvent*)calloc(LT_FLIGHT_EVENTS, sizeof(FlightEvent));
+    if (!memory || !events)
+    {
+        free(memory);
+        free(events);
+        return nullptr;
+    }
+
+    FlightRing *ring = new (memory) FlightRing();
+    ring->events = events;
+    ring->in_use.store(1, std::memory_order_relaxed);
+    ring->next = g_rings.load(std::memory_order_relaxed);
+    while (!g_rings.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed)) {}
+    return ring;
+}
+
+FlightRing *
+lt::flight_acquire_ring()
+{
+    FlightRing *ring = reuse_ring();
+    if (ring) ring->head.store(0, std::memory_order_relaxed);
+    else ring = new_ring();
+
+    if (!ring)
+    {
+        ring = &g_fallback_ring;
+        ring->events = g_fallback_events;
+    }
+    else
+    {
+        ring->thread_id = thread_id();
+        memset(ring->thread_name, 0, sizeof(ring->thread_name));
+        t_slot.ring = ring;
+    }
+
+    t_flight_ring = ring;
+    return ring;
+}
+
+void
+lt::flight_text(FlightEventKind kind, const char *name, const char *text, usize len)
+{
+    FlightRing *ring = flight_ring();
+    const u64 head = ring->head.load(std::memory_order_relaxed);
+    const u64 tsc = rdtsc();
+    if (len > LT_FLIGHT_TEXT_SIZE) len = LT_FLIGHT_TEXT_SIZE;
+
+    // The first slot has the event, the rest of the text goes in FlightEvent_Text slots.
+    const usize chunk = sizeof(FlightEvent::text);
+    u64 slot = head;
+    usize done = 0;
+    do
+    {
+        FlightEvent *e = &ring->events[slot & (LT_FLIGHT_EVENTS - 1)];
+        const usize n = (len - done < chunk) ? len - done : chunk;
+        e->tsc = tsc;
+        e->name = (slot == head) ? name : nullptr;
+        e->value = 0;
+        e->kind = (slot == head) ? (u32)kind : (u32)FlightEvent_Text;
+        e->size = (slot == head) ? (u32)len : (u32)n;
+        memcpy(e->text, text + done, n);
+        done += n;
+        slot++;
+    } while (done < len);
+
+    ring->head.store(slot, std::memory_order_release);
+}
+
+void
+lt::flight_note(const char *name, const char *text)
+{
+    flight_text(FlightEvent_Note, name, text, strlen(text));
+}
+
+void
+lt::flight_set_thread_name(const char *name)
+{
+    FlightRing *ring = flight_ring();
+    if (ring == &g_fallback_ring) return;
+    const usize len = strnlen(name, LT_FLIGHT_THREAD_NAME_SIZE - 1);
+    memcpy(ring->thread_name, name, len);
+    ring->thread_name[len] = 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Dump
+//
+// Everything below can run in a signal handler: no allocation, no stdio, no locks. The text
+// is assembled in a FormatBuffer without sink and written to the file descriptor.
+//
+
+struct DumpWriter
+{
+    int          fd;
+    lt::FormatBuffer buf;
+    u64          crash_tsc;
+    f64          ns_per_tick;   // 0 when the tsc rate is unknown.
+};
+
+lt_internal void
+dump_flush(DumpWriter *w)
+{
+    const char *p = w->buf.data;
+    usize left = w->buf.size;
+    while (left > 0)
+    {
+        const ssize_t n = write(w->fd, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        p += n;
+        left -= (usize)n;
+    }
+    w->buf.size = 0;
+}
+
+// Every line fits in the space left after this.
+lt_internal void
+dump_reserve(DumpWriter *w)
+{
+    if (w->buf.capacity - w->buf.size < 1024) dump_flush(w);
+}
+
+lt_internal void
+append_name(lt::FormatBuffer *buf, const char *name)
+{
+    if (name) lt::format_append(buf, name, strnlen(name, LT_FLIGHT_NAME_SIZE));
+}
+
+// Control characters would break the one event per line layout.
+lt_internal void
+append_text(lt::FormatBuffer *buf, const char *text, usize len)
+{
+    for (usize i = 0; i < len; i++)
+    {
+        const char c = text[i];
+        lt::format_append(buf, ((u8)c < 0x20 || c == 0x7f) ? ' ' : c);
+    }
+}
+
+lt_internal const char *
+kind_name(u32 kind)
+{
+    lt_local_persist const char *names[FlightEvent_Count] = {
+        "marker", "note", "log", "begin", "end", "text", "crash",
+    };
+    return (kind < FlightEvent_Count) ? names[kind] : "?";
+}
+
+lt_internal void
+dump_time(DumpWriter *w, u64 tsc)
+{
+    // Events after the crash tsc come from threads that kept running.
+    const bool before = tsc <= w->crash_tsc;
+    const u64 delta = before ? w->crash_tsc - tsc : tsc - w->crash_tsc;
+    const u64 value = (w->ns_per_tick > 0) ? (u64)((f64)delta * w->ns_per_tick) : delta;
+    char tmp[LT_FORMAT_INT_SIZE + 1];
+    tmp[0] = before ? '-' : '+';
+    const usize len = (usize)(lt::format_u64(tmp + 1, value) - tmp);
+    lt::format_append_padded(&w->buf, tmp, len, 14);
+    lt::format_append(&w->buf, (w->ns_per_tick > 0) ? " ns  " : " tk  ");
+}
+
+lt_internal void
+dump_ring(DumpWriter *w, const FlightRing *ring)
+{
+    lt::FormatBuffer *buf = &w->buf;
+    const u64 head = ring->head.load(std::memory_order_acquire);
+    // The slot of the oldest event is the one its thread writes next.
+    const u64 first = (head >= LT_FLIGHT_EVENTS) ? head - LT_FLIGHT_EVENTS + 1 : 0;
+
+    dump_reserve(w);
+    lt::format_append(buf, "\nthread ");
+    lt::format_append(buf, ring->thread_id);
+    if (ring->thread_name[0])
+    {
+        lt::format_append(buf, " \"");
+        append_name(buf, ring->thread_name);
+        lt::format_append(buf, '"');
+    }
+    if (ring == &g_fallback_ring) lt::format_append(buf, " (shared by threads without a ring)");
+    lt::format_append(buf, ", ");
+    lt::format_append(buf, head - first);
+    lt::format_append(buf, (ring->in_use.load(std::memory_order_relaxed) ? " events\n" : " events, exited\n"));
+
+    for (u64 i = first; i < head; i++)
+    {
+        FlightEvent e = ring->events[i & (LT_FLIGHT_EVENTS - 1)];
+        if (e.kind == FlightEvent_Text) continue;
+
+        char text[LT_FLIGHT_TEXT_SIZE];
+        usize size = 0;
+        const usize len = (e.size < LT_FLIGHT_TEXT_SIZE) ? e.size : LT_FLIGHT_TEXT_SIZE;
+        for (u64 j = i; size < len && j < head; j++)
+        {
+            const FlightEvent &slot = ring->events[j & (LT_FLIGHT_EVENTS - 1)];
+            usize n = (len - size < sizeof(slot.text)) ? len - size : sizeof(slot.text);
+            memcpy(text + size, slot.text, n);
+            size += n;
+        }
+
+        // Still valid when the thread has not come around to the slot again, the copies
+        // above are ordered before the check like a seqlock read.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (ring->head.load(std::memory_order_relaxed) >= i + LT_FLIGHT_EVENTS) continue;
+
+        dump_reserve(w);
+        lt::format_append(buf, "  ");
+        dump_time(w, e.tsc);
+        const char *kind = kind_name(e.kind);
+        lt::format_append(buf, kind);
+        lt::format_append(buf, "        ", 8 - strlen(kind));
+
+        switch (e.kind)
+        {
+            case FlightEvent_Marker:
+            {
+                append_name(buf, e.name);
+                lt::format_append(buf, ' ');
+                lt::format_append(buf, e.value);
+            } break;
+            case FlightEvent_ScopeEnd:
+            {
+                append_name(buf, e.name);
+                lt::format_append(buf, " (");
+                lt::format_append(buf, e.value);
+                lt::format_append(buf, " ticks)");
+            } break;
+            case FlightEvent_Log:
+            {
+                append_text(buf, text, size);
+            } break;
+            default:
+            {
+                append_name(buf, e.name);
+                if (size > 0)
+                {
+                    lt::format_append(buf, ": ");
+                    append_text(buf, text, size);
+                }
+            } break;
+        }
+        lt::format_append(buf, '\n');
+    }
+}
+
+void
+lt::flight_dump_fd(int fd, const char *reason)
+{
+    char storage[8192];
+    DumpWriter w = {fd, FormatBuffer(storage, sizeof(storage)), rdtsc(), 0.0};
+    const u64 now_ns = monotonic_ns();
+    if (g_init_tsc != 0 && w.crash_tsc > g_init_tsc && now_ns > g_init_ns)
+        w.ns_per_tick = (f64)(now_ns - g_init_ns) / (f64)(w.crash_tsc - g_init_tsc);
+
+    format_append(&w.buf, "lt flight recorder\nreason: ");
+    append_name(&w.buf, reason ? reason : "dump");
+    format_append(&w.buf, "\nthread: ");
+    format_append(&w.buf, thread_id());
+    format_append(&w.buf, "\ntimes: relative to the dump, ");
+    format_append(&w.buf, (w.ns_per_tick > 0) ? "in ns\n" : "in tsc ticks (flight_init was not called)\n");
+
+    // The ring of the dumping thread first.
+    FlightRing *own = t_flight_ring;
+    if (own) dump_ring(&w, own);
+    for (FlightRing *r = g_rings.load(std::memory_order_acquire); r; r = r->next)
+        if (r != own) dump_ring(&w, r);
+    if (g_fallback_ring.events && own != &g_fallback_ring) dump_ring(&w, &g_fallback_ring);
+
+    dump_flush(&w);
+}
+
+bool
+lt::flight_dump(const char *path)
+{
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    flight_dump_fd(fd, nullptr);
+    close(fd);
+    return true;
+}
+
+// Set on the thread that runs the crash dump.
+lt_internal thread_local bool t_crash_dumping = false;
+
+// Only the first crash of the process dumps, the threads that crash during it wait for it.
+// Returns false when the dumping thread crashes again inside the dump, it must not wait for
+// itself.
+lt_internal bool
+crash_dump(const char *reason)
+{
+    u32 expected = DumpState_None;
+    if (!g_crash_dump.compare_exchange_strong(expected, DumpState_Running, std::memory_order_acq_rel))
+    {
+        if (t_crash_dumping) return false;
+        while (g_crash_dump.load(std::memory_order_acquire) != DumpState_Done) lt::cpu_relax();
+        return true;
+    }
+    t_crash_dumping = true;
+
+    const int fd = g_path[0] ? open(g_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+    lt::flight_dump_fd((fd >= 0) ? fd : STDERR_FILENO, reason);
+    if (fd >= 0) close(fd);
+    g_crash_dump.store(DumpState_Done, std::memory_order_release);
+    return true;
+}
+
+void
+lt::flight_crash(const char *what, const char *message, const char *file, int line)
+{
+    char storage[LT_FLIGHT_TEXT_SIZE];
+    FormatBuffer buf(storage, sizeof(storage));
+    format_append(&buf, message);
+    format_append(&buf, " at ");
+    format_append(&buf, file);
+    format_append(&buf, ':');
+    format_append(&buf, line);
+    flight_text(FlightEvent_Crash, what, buf.data, buf.size);
+    crash_dump(what);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Signals
+//
+
+#if LT_PLATFORM_UNIX
+
+lt_global_variable const int g_signals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT, SIGTRAP};
+lt_global_variable const char *g_signal_names[] = {"SIGSEGV", "SIGBUS", "SIGILL", "SIGFPE", "SIGABRT", "SIGTRAP"};
+lt_global_variable struct sigaction g_previous[LT_Count(g_signals)];
+
+lt_internal void
+fatal_signal(int sig, siginfo_t *info, void *context)
+{
+    LT_Unused(context);
+    usize index = 0;
+    while (index < LT_Count(g_signals) && g_signals[index] != sig) index++;
+    const char *name = (index < LT_Count(g_signals)) ? g_signal_names[index] : "signal";
+
+    // A thread without a ring would have to allocate one, it only shows in the dump header.
+    if (lt::t_flight_ring)
+    {
+        char storage[64];
+        lt::FormatBuffer buf(storage, sizeof(storage));
+        lt::format_append(&buf, "address ");
+        lt::format_append(&buf, (const void*)info->si_addr);
+        lt::flight_text(FlightEvent_Crash, name, buf.data, buf.size);
+    }
+    if (!crash_dump(name))
+    {
+        // The dump itself crashed, the default action ends the process without a second try.
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = SIG_DFL;
+        sigemptyset(&action.sa_mask);
+        sigaction(sig, &action, nullptr);
+        if (info->si_code <= 0) raise(sig);
+        return;
+    }
+
+    // Back to the previous handler: a fault happens again when this returns, signals that were
+    // sent are sent again and delivered once this handler returns.
+    if (index < LT_Count(g_signals))
+    {
+        struct sigaction previous = g_previous[index];
+        if (!(previous.sa_flags & SA_SIGINFO) && previous.sa_handler == SIG_IGN) previous.sa_handler = SIG_DFL;
+        sigaction(sig, &previous, nullptr);
+    }
+    if (info->si_code <= 0) raise(sig);
+}
+
+lt_internal void
+install_signal_handlers()
+{
+    lt_local_persist bool installed = false;
+    if (installed) return;
+    installed = true;
+
+    // Stack overflows can only be handled on another stack.
+    stack_t stack;
+    memset(&stack, 0, sizeof(stack));
+    stack.ss_sp = malloc(LT_FLIGHT_SIGNAL_STACK_SIZE);
+    stack.ss_size = LT_FLIGHT_SIGNAL_STACK_SIZE;
+    if (stack.ss_sp) sigaltstack(&stack, nullptr);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = fatal_signal;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    for (usize i = 0; i < LT_Count(g_signals); i++) sigaction(g_signals[i], &action, &g_previous[i]);
+}
+
+#endif // LT_PLATFORM_UNIX
+
+void
+lt::flight_init(const char *path, bool install_handlers)
+{
+    const usize len = path ? strnlen(path, LT_FLIGHT_PATH_SIZE - 1) : 0;
+    if (len > 0) memcpy(g_path, path, len);
+    g_path[len] = 0;
+
+    g_init_ns = monotonic_ns();
+    g_init_tsc = rdtsc();
+    flight_ring();
+
+#if LT_PLATFORM_UNIX
+    if (install_handlers) install_signal_handlers();
+#else
+    LT_Unused(install_handlers);
+#endif
+}
@@ -0,0 +1,157 @@
+#ifndef LT_FLIGHT_HPP
+#define LT_FLIGHT_HPP
+
+#include <atomic>
+#include "lt_core.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Flight recorder
+//
+// Keeps the last events of every thread in memory so a crash report can tell what led up to
+// it: markers, log lines and profile scopes, stamped with rdtsc. Each thread writes its own
+// ring of LT_FLIGHT_EVENTS slots without locks or atomics read-modify-writes, a marker is an
+// rdtsc and four stores, so recording can stay on in release builds.
+//
+// The rings are written out as text by flight_dump, and automatically by:
+//   - LT_Panic and LT_Assert, when built with LT_FLIGHT_RECORDER.
+//   - The fatal signal handlers installed by flight_init (SIGSEGV, SIGBUS, SIGILL, SIGFPE,
+//     SIGABRT, SIGTRAP). They dump and then hand the signal to the previous handler, or to
+//     the default action that ends the process.
+// The dump only uses async-signal-safe calls. Times are printed relative to the crash, in
+// nanoseconds estimated from the tsc rate measured between flight_init and the dump.
+//
+// Names given to the recorder are stored as pointers and must be static strings. Texts are
+// copied, up to LT_FLIGHT_TEXT_SIZE bytes.
+//
+// Rings of exited threads are kept, with their events, until a new thread takes them over.
+// Events that a running thread overwrites while the dump reads them are skipped.
+//
+// LT_FLIGHT_SCOPE and LT_FLIGHT_MARK compile to nothing unless LT_FLIGHT_RECORDER is defined,
+// which also records the Logger lines and the LT_PERF_SCOPE regions.
+//
+
+#define LT_FLIGHT_EVENTS           4096   // Per thread, a power of two.
+#define LT_FLIGHT_TEXT_SIZE        256
+#define LT_FLIGHT_THREAD_NAME_SIZE 16
+#define LT_FLIGHT_PATH_SIZE        256
+
+enum FlightEventKind
+{
+    FlightEvent_Marker,
+    FlightEvent_Note,         // Marker with a text.
+    FlightEvent_Log,
+    FlightEvent_ScopeBegin,
+    FlightEvent_ScopeEnd,     // value: ticks since the begin.
+    FlightEvent_Text,         // Continues the text of the event before it.
+    FlightEvent_Crash,
+
+    FlightEvent_Count,
+};
+
+struct FlightEvent
+{
+    u64         tsc;
+    const char *name;
+    u64         value;
+    u32         kind;    // FlightEventKind
+    u32         size;    // Text bytes, including those of the FlightEvent_Text slots that follow.
+    char        text[32];
+};
+
+static_assert(sizeof(FlightEvent) == 64, "flight event layout");
+
+struct FlightRing
+{
+    FlightEvent      *events = nullptr;
+    std::atomic<u64>  head{0};        // Events written, only the owner thread stores it.
+    std::atomic<u32>  in_use{0};
+    u32               thread_id = 0;
+    char              thread_name[LT_FLIGHT_THREAD_NAME_SIZE] = {};
+    FlightRing       *next = nullptr;
+};
+
+namespace lt
+{
+
+extern thread_local FlightRing *t_flight_ring;
+
+// Slow path of flight_ring, on the first event of a thread.
+FlightRing *flight_acquire_ring();
+
+lt_internal inline FlightRing *
+flight_ring()
+{
+    FlightRing *ring = t_flight_ring;
+    return ring ? ring : flight_acquire_ring();
+}
+
+lt_internal inline void
+flight_event(FlightEventKind kind, const char *name, u64 value)
+{
+    FlightRing *ring = flight_ring();
+    const u64 head = ring->head.load(std::memory_order_relaxed);
+    FlightEvent *e = &ring->events[head & (LT_FLIGHT_EVENTS - 1)];
+    e->tsc = rdtsc();
+    e->name = name;
+    e->value = value;
+    e->kind = kind;
+    e->size = 0;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+lt_internal inline void flight_mark(const char *name, u64 value = 0) { flight_event(FlightEvent_Marker, name, value); }
+
+// Event with a copy of `text`, cut to LT_FLIGHT_TEXT_SIZE bytes.
+void flight_text(FlightEventKind kind, const char *name, const char *text, usize len);
+void flight_note(const char *name, const char *text);
+
+// Where crash dumps go, stderr until this is called. With `install_handlers` the fatal
+// signals dump too, and the calling thread gets an alternate signal stack so stack overflows
+// are reported as well.
+void flight_init(const char *path, bool install_handlers = true);
+void flight_set_thread_name(const char *name);
+
+// Writes the events of all the threads, oldest first. Async-signal-safe.
+bool flight_dump(const char *path);
+void flight_dump_fd(int fd, const char *reason);
+
+// Records the crash on the calling thread and dumps, once per process. Called by LT_Panic and
+// LT_Assert, the process is expected to end right after.
+void flight_crash(const char *what, const char *message, const char *file, int line);
+
+struct FlightScope
+{
+    explicit FlightScope(const char *name)
+        : m_name(name), m_begin(rdtsc())
+    {
+        flight_event(FlightEvent_ScopeBegin, name, 0);
+    }
+
+    ~FlightScope()
+    {
+        flight_event(FlightEvent_ScopeEnd, m_name, rdtsc() - m_begin);
+    }
+
+    FlightScope(const FlightScope&) = delete;
+    FlightScope &operator=(const FlightScope&) = delete;
+
+private:
+    const char *m_name;
+    u64         m_begin;
+};
+
+}
+
+#define LT_FLIGHT_CONCAT2(a, b) a##b
+#define LT_FLIGHT_CONCAT(a, b)  LT_FLIGHT_CONCAT2(a, b)
+
+#if LT_FLIGHT_RECORDER
+#  define LT_FLIGHT_SCOPE(name)       lt::FlightScope LT_FLIGHT_CONCAT(lt_flight_scope_, __LINE__)(name)
+#  define LT_FLIGHT_MARK(name, value) lt::flight_mark((name), (value))
+#else
+#  define LT_FLIGHT_SCOPE(name)       do { } while (0)
+#  define LT_FLIGHT_MARK(name, value) do { } while (0)
+#endif
+
+#endif // LT_FLIGHT_HPP
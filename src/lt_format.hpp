@@ -0,0 +1,137 @@
+#ifndef LT_FORMAT_HPP
+#define LT_FORMAT_HPP
+
+#include <stdio.h>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+#include "lt_core.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Number formatting and parsing
+//
+// Conversions between numbers and text that write into caller buffers, never allocate and do
+// not depend on the locale:
+//
+//   format_f64/f32         shortest text that parses back to the same value (Schubfach)
+//   format_f64/f32_digits  rounded to a number of significant digits, like "%.*g"
+//   format_u64/i64         two digits per division, from a table
+//   parse_f64/f32          correctly rounded, Clinger and Eisel-Lemire fast paths
+//   parse_u64/i64          with overflow checks
+//
+// Both float directions use the same table of 128-bit powers of ten.
+//
+// FormatBuffer and the format_append overloads assemble lines out of these pieces. Logger and
+// the printers of lt_math use them, other types get printed by adding a format_append overload
+// in namespace lt next to the type.
+//
+
+// Sizes that fit the longest output of the integer and float functions.
+#define LT_FORMAT_INT_SIZE   24
+#define LT_FORMAT_FLOAT_SIZE 32
+
+namespace lt
+{
+
+// The functions below do not write a terminating zero and return the end of the text.
+char *format_u64(char *buf, u64 value);
+char *format_i64(char *buf, i64 value);
+
+// Fixed notation when the decimal exponent is in [-5, 17), scientific otherwise ("1e+17",
+// "-2.5e-06"). Non-finite values are "inf", "-inf" and "nan".
+char *format_f64(char *buf, f64 value);
+char *format_f32(char *buf, f32 value);
+
+// At most `digits` (1 to 17) significant digits, the same text as printf "%.*g" in the C locale.
+// Rounds the shortest digits, and asks printf when they end in a tie or when printf would show
+// digits of the exact value past them.
+char *format_f64_digits(char *buf, f64 value, i32 digits);
+char *format_f32_digits(char *buf, f32 value, i32 digits);
+
+// Same grammar as std::from_chars: an optional '-', then digits with an optional fraction and
+// exponent, or inf, infinity and nan (any case). No leading whitespace or '+'. Returns the end
+// of the number, or `begin` with *value untouched when there is none, an integer does not
+// fit, or a float too long for the stack buffer cannot be copied. Floats out of range become
+// infinity or zero.
+const char *parse_u64(const char *begin, const char *end, u64 *value);
+const char *parse_i64(const char *begin, const char *end, i64 *value);
+const char *parse_f64(const char *begin, const char *end, f64 *value);
+const char *parse_f32(const char *begin, const char *end, f32 *value);
+
+// Text assembled in caller storage. With a sink, full storage is written to it and reused,
+// without one the text is cut and `truncated` is set.
+struct FormatBuffer
+{
+    char  *data;
+    usize  capacity;
+    usize  size = 0;
+    FILE  *sink = nullptr;
+    bool   truncated = false;
+
+    FormatBuffer(char *data, usize capacity, FILE *sink = nullptr)
+        : data(data), capacity(capacity), sink(sink) {}
+
+    std::string_view view() const { return std::string_view(data, size); }
+};
+
+void format_append_slow(FormatBuffer *buf, const char *str, usize len);
+// Writes the text to the sink and empties the buffer.
+void format_flush(FormatBuffer *buf);
+
+inline void
+format_append(FormatBuffer *buf, const char *str, usize len)
+{
+    if (len <= buf->capacity - buf->size)
+    {
+        memcpy(buf->data + buf->size, str, len);
+        buf->size += len;
+    }
+    else format_append_slow(buf, str, len);
+}
+
+inline void format_append(FormatBuffer *buf, std::string_view str) { format_append(buf, str.data(), str.size()); }
+inline void format_append(FormatBuffer *buf, const char *str) { format_append(buf, str, strlen(str)); }
+inline void format_append(FormatBuffer *buf, char c) { format_append(buf, &c, 1); }
+// 1 and 0, like std::ostream.
+inline void format_append(FormatBuffer *buf, bool b) { format_append(buf, b ? '1' : '0'); }
+
+// Every integer type but char and bool, including i8 and u8 that iostreams print as characters.
+template<typename T> inline std::enable_if_t<std::is_integral_v<T>>
+format_append(FormatBuffer *buf, T value)
+{
+    char tmp[LT_FORMAT_INT_SIZE];
+    char *end = std::is_signed_v<T> ? format_i64(tmp, (i64)value) : format_u64(tmp, (u64)value);
+    format_append(buf, tmp, (usize)(end - tmp));
+}
+
+inline void
+format_append(FormatBuffer *buf, f64 value)
+{
+    char tmp[LT_FORMAT_FLOAT_SIZE];
+    format_append(buf, tmp, (usize)(format_f64(tmp, value) - tmp));
+}
+
+inline void
+format_append(FormatBuffer *buf, f32 value)
+{
+    char tmp[LT_FORMAT_FLOAT_SIZE];
+    format_append(buf, tmp, (usize)(format_f32(tmp, value) - tmp));
+}
+
+template<typename T> inline std::enable_if_t<std::is_enum_v<T>>
+format_append(FormatBuffer *buf, T value)
+{
+    format_append(buf, (std::underlying_type_t<T>)value);
+}
+
+// Pointers other than strings, in hexadecimal.
+void format_append(FormatBuffer *buf, const void *ptr);
+
+// Right aligned in `width` columns, like std::setw.
+void format_append_padded(FormatBuffer *buf, const char *str, usize len, usize width);
+
+}
+
+#endif // LT_FORMAT_HPP
@@ -6,6 +6,15 @@
 
 #if LT_PLATFORM_UNIX
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #endif
 
 #if LT_OS_LINUX
@@ -67,7 +76,7 @@ file_read_contents(const char *filename, bool insert_final_zero)
 
     if (!fp)
     {
-        FileContents *ret =  (FileContents*)calloc(1, sizeof(*ret));
+        FileContents *ret = (FileContents*)LT_Calloc(1, sizeof(*ret), MemoryTag_File);
         ret->error = FileError_NotExists;
         ret->data = NULL;
         ret->size = -1;
@@ -79,7 +88,7 @@ file_read_contents(const char *filename, bool insert_final_zero)
     if (file_size == -1)
     {
         fclose(fp);
-        FileContents *ret = (FileContents*)malloc(sizeof(*ret));
+        FileContents *ret = (FileContents*)LT_Malloc(sizeof(*ret), MemoryTag_File);
         ret->error = FileError_Unknown;
         ret->data = NULL;
         ret->size = -1;
@@ -87,8 +96,8 @@ file_read_contents(const char *filename, bool insert_final_zero)
     }
 
     file_data = (insert_final_zero)
-        ? (char*)calloc(1, sizeof(char) * file_size + 1)
-        : (char*)calloc(1, sizeof(char) * file_size);
+        ? (char*)LT_Calloc(1, sizeof(char) * file_size + 1, MemoryTag_File)
+        : (char*)LT_Calloc(1, sizeof(char) * file_size, MemoryTag_File);
 
     if (!file_data)
     {
@@ -98,7 +107,7 @@ file_read_contents(const char *filename, bool insert_final_zero)
     isize newlen = fread(file_data, sizeof(u8), file_size, fp);
     if (newlen < 0)
     {
-        FileContents *ret = (FileContents*)malloc(sizeof(*ret));
+        FileContents *ret = (FileContents*)LT_Malloc(sizeof(*ret), MemoryTag_File);
         ret->error = FileError_Read;
         ret->data = NULL;
         ret->size = -1;
@@ -113,9 +122,9 @@ file_read_contents(const char *filename, bool insert_final_zero)
     {
         fputs("Error reading file\n", stderr);
         fclose(fp);
-        free(file_data);
+        LT_Free(file_data);
 
-        FileContents *ret = (FileContents*)malloc(sizeof(*ret));
+        FileContents *ret = (FileContents*)LT_Malloc(sizeof(*ret), MemoryTag_File);
         ret->error = FileError_Read;
         ret->data = NULL;
         ret->size = -1;
@@ -123,7 +132,7 @@ file_read_contents(const char *filename, bool insert_final_zero)
     }
     fclose(fp);
 
-    FileContents *ret = (FileContents*)malloc(sizeof(*ret));
+    FileContents *ret = (FileContents*)LT_Malloc(sizeof(*ret), MemoryTag_File);
     ret->error = FileError_None;
     ret->data = file_data;
     ret->size = file_size;
@@ -151,3 +160,728 @@ file_get_size(const char *filename)
 #  error "Still not implemented"
 #endif
 }
+
+/////////////////////////////////////////////////////////
+//
+// File writer
+//
+
+#if LT_PLATFORM_UNIX
+
+#define FILE_WRITER_ALIGNMENT 4096
+#define FILE_WRITER_MAX_IOV   1024
+
+struct FileFlusher
+{
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable cv;
+    const char             *pending = nullptr;
+    usize                   pending_size = 0;
+    bool                    quit = false;
+    bool                    failed = false;
+};
+
+lt_internal bool
+write_all(int fd, const char *data, usize size)
+{
+    while (size > 0)
+    {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= (usize)n;
+    }
+    return true;
+}
+
+// Writes the whole list, resubmitting after partial writes. `iov` is modified.
+lt_internal bool
+writev_all(int fd, struct iovec *iov, usize count)
+{
+    while (count > 0)
+    {
+        const int batch = (int)((count < FILE_WRITER_MAX_IOV) ? count : FILE_WRITER_MAX_IOV);
+        ssize_t n = ::writev(fd, iov, batch);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        while (count > 0 && (usize)n >= iov->iov_len)
+        {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (n > 0)
+        {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (usize)n;
+        }
+    }
+    return true;
+}
+
+lt_internal void
+flusher_run(FileFlusher *flusher, int fd)
+{
+    std::unique_lock<std::mutex> lock(flusher->mutex);
+    for (;;)
+    {
+        flusher->cv.wait(lock, [&] { return flusher->pending || flusher->quit; });
+        if (!flusher->pending) return;
+
+        const char *data = flusher->pending;
+        const usize size = flusher->pending_size;
+        lock.unlock();
+        const bool ok = write_all(fd, data, size);
+        lock.lock();
+
+        if (!ok) flusher->failed = true;
+        flusher->pending = nullptr;
+        flusher->cv.notify_all();
+    }
+}
+
+// Waits until the background thread is done with its buffer.
+lt_internal bool
+writer_wait(FileWriter *writer)
+{
+    FileFlusher *flusher = writer->flusher;
+    if (!flusher) return writer->error == FileError_None;
+
+    std::unique_lock<std::mutex> lock(flusher->mutex);
+    flusher->cv.wait(lock, [&] { return flusher->pending == nullptr; });
+    if (flusher->failed) writer->error = FileError_Write;
+    return writer->error == FileError_None;
+}
+
+lt_internal bool
+writer_fail(FileWriter *writer, FileError error)
+{
+    writer->error = error;
+    return false;
+}
+
+// Sends the active buffer to the file, or to the background thread and switches buffers.
+lt_internal bool
+writer_submit(FileWriter *writer)
+{
+    if (writer->used == 0) return writer->error == FileError_None;
+    if (!writer_wait(writer)) return false;
+
+    const usize size = writer->used;
+    writer->written += size;
+    writer->used = 0;
+
+    if (writer->flusher)
+    {
+        FileFlusher *flusher = writer->flusher;
+        {
+            std::lock_guard<std::mutex> lock(flusher->mutex);
+            flusher->pending = writer->buffers[writer->active];
+            flusher->pending_size = size;
+        }
+        flusher->cv.notify_all();
+        writer->active ^= 1;
+        return true;
+    }
+
+    if (!write_all(writer->fd, writer->buffers[writer->active], size))
+        return writer_fail(writer, FileError_Write);
+    return true;
+}
+
+lt_internal void
+writer_stop_flusher(FileWriter *writer)
+{
+    FileFlusher *flusher = writer->flusher;
+    if (!flusher) return;
+
+    {
+        std::lock_guard<std::mutex> lock(flusher->mutex);
+        flusher->quit = true;
+    }
+    flusher->cv.notify_all();
+    flusher->thread.join();
+    if (flusher->failed) writer->error = FileError_Write;
+    delete flusher;
+    writer->flusher = nullptr;
+}
+
+lt_internal std::string
+parent_directory(const std::string &path)
+{
+    const usize slash = path.find_last_of('/');
+    if (slash == std::string::npos) return ".";
+    if (slash == 0) return "/";
+    return path.substr(0, slash);
+}
+
+lt_internal void
+writer_release(FileWriter *writer, bool remove_temp)
+{
+    writer_stop_flusher(writer);
+    if (writer->fd >= 0) ::close(writer->fd);
+    if (remove_temp && !writer->temp_path.empty()) ::unlink(writer->temp_path.c_str());
+    writer->fd = -1;
+    writer->temp_path.clear();
+}
+
+bool
+ltfs::writer_open(FileWriter *writer, const std::string &path, const FileWriteOptions &options)
+{
+    LT_Assert(writer->fd < 0);
+    lt_local_persist std::atomic<u32> temp_counter{0};
+
+    writer->options = options;
+    writer->path = path;
+    writer->temp_path.clear();
+    writer->error = FileError_None;
+    writer->active = 0;
+    writer->used = 0;
+    writer->written = 0;
+
+    const usize capacity = (options.buffer_size + FILE_WRITER_ALIGNMENT - 1) & ~(usize)(FILE_WRITER_ALIGNMENT - 1);
+    if (capacity != writer->buffer_capacity)
+    {
+        LT_Free(writer->buffers[0]);
+        LT_Free(writer->buffers[1]);
+        writer->buffer_capacity = 0;
+    }
+    const u32 num_buffers = options.background_flush ? 2 : 1;
+    for (u32 i = 0; i < num_buffers; i++)
+    {
+        if (!writer->buffers[i]) writer->buffers[i] = (char*)LT_AlignedAlloc(FILE_WRITER_ALIGNMENT, capacity, MemoryTag_File);
+        if (!writer->buffers[i]) return writer_fail(writer, FileError_Unknown);
+    }
+    writer->buffer_capacity = capacity;
+
+    if (options.atomic)
+    {
+        // Same directory as the target, rename is only atomic within a file system.
+        writer->temp_path = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(temp_counter++);
+        writer->fd = ::open(writer->temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    }
+    else
+    {
+        writer->fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    }
+    if (writer->fd < 0)
+    {
+        writer->temp_path.clear();
+        return writer_fail(writer, FileError_Create);
+    }
+
+    // The rename replaces the target's permissions with the temporary file's, keep the old ones.
+    struct stat target;
+    if (options.atomic && ::stat(path.c_str(), &target) == 0 && fchmod(writer->fd, target.st_mode & 07777) != 0)
+    {
+        writer_release(writer, true);
+        return writer_fail(writer, FileError_Create);
+    }
+
+#if LT_OS_LINUX
+    // Only a hint: file systems without fallocate still work, just with more fragmentation.
+    if (options.preallocate > 0)
+        fallocate(writer->fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)options.preallocate);
+#endif
+
+    if (options.background_flush)
+    {
+        writer->flusher = new FileFlusher;
+        writer->flusher->thread = std::thread(flusher_run, writer->flusher, writer->fd);
+    }
+    return true;
+}
+
+bool
+ltfs::writer_write(FileWriter *writer, const void *data, usize size)
+{
+    const WriteBlock block = {data, size};
+    return writer_write_blocks(writer, &block, 1);
+}
+
+bool
+ltfs::writer_write_blocks(FileWriter *writer, const WriteBlock *blocks, usize count)
+{
+    if (writer->error != FileError_None) return false;
+    LT_Assert(writer->fd >= 0);
+
+    usize total = 0;
+    for (usize i = 0; i < count; i++) total += blocks[i].size;
+
+    if (writer->used + total <= writer->buffer_capacity)
+    {
+        char *dst = writer->buffers[writer->active] + writer->used;
+        for (usize i = 0; i < count; i++)
+        {
+            if (blocks[i].size == 0) continue;
+            memcpy(dst, blocks[i].data, blocks[i].size);
+            dst += blocks[i].size;
+        }
+        writer->used += total;
+        return true;
+    }
+
+    // Less than a buffer's worth: top up the buffer and carry on in the next one.
+    if (total < writer->buffer_capacity)
+    {
+        for (usize i = 0; i < count; i++)
+        {
+            const char *src = (const char*)blocks[i].data;
+            usize left = blocks[i].size;
+            while (left > 0)
+            {
+                const usize room = writer->buffer_capacity - writer->used;
+                const usize n = (left < room) ? left : room;
+                memcpy(writer->buffers[writer->active] + writer->used, src, n);
+                writer->used += n;
+                src += n;
+                left -= n;
+                if (writer->used == writer->buffer_capacity && !writer_submit(writer)) return false;
+            }
+        }
+        return true;
+    }
+
+    // Large writes skip the copy: buffered data and blocks go out in one gather write.
+    if (!writer_wait(writer)) return false;
+
+    std::vector<struct iovec> iov;
+    iov.reserve(count + 1);
+    if (writer->used > 0) iov.push_back({writer->buffers[writer->active], writer->used});
+    for (usize i = 0; i < count; i++)
+        if (blocks[i].size > 0) iov.push_back({(void*)blocks[i].data, blocks[i].size});
+
+    if (!writev_all(writer->fd, iov.data(), iov.size())) return writer_fail(writer, FileError_Write);
+    writer->written += writer->used + total;
+    writer->used = 0;
+    return true;
+}
+
+bool
+ltfs::writer_flush(FileWriter *writer)
+{
+    return writer_submit(writer) && writer_wait(writer);
+}
+
+bool
+ltfs::writer_close(FileWriter *writer)
+{
+    if (writer->fd < 0) return false;
+
+    bool ok = writer_flush(writer);
+    writer_stop_flusher(writer);
+    ok = ok && writer->error == FileError_None;
+
+    if (ok && writer->options.preallocate > writer->written)
+        ok = ftruncate(writer->fd, (off_t)writer->written) == 0;
+    if (ok && (writer->options.atomic || writer->options.sync))
+        ok = fsync(writer->fd) == 0;
+
+    if (ok && writer->options.atomic)
+    {
+        ok = ::rename(writer->temp_path.c_str(), writer->path.c_str()) == 0;
+        if (ok)
+        {
+            writer->temp_path.clear();
+            // Make the rename itself durable.
+            const int dir = ::open(parent_directory(writer->path).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dir >= 0)
+            {
+                fsync(dir);
+                ::close(dir);
+            }
+        }
+    }
+
+    if (!ok && writer->error == FileError_None) writer->error = FileError_Write;
+    writer_release(writer, !ok);
+    return ok;
+}
+
+void
+ltfs::writer_abort(FileWriter *writer)
+{
+    if (writer->fd < 0) return;
+    writer->used = 0;
+    writer_release(writer, true);
+}
+
+void
+ltfs::writer_destroy(FileWriter *writer)
+{
+    writer_abort(writer);
+    LT_Free(writer->buffers[0]);
+    LT_Free(writer->buffers[1]);
+    writer->buffer_capacity = 0;
+}
+
+bool
+ltfs::write_file(const std::string &path, const void *data, usize size, bool atomic)
+{
+    FileWriteOptions options;
+    options.atomic = atomic;
+    options.buffer_size = FILE_WRITER_ALIGNMENT;
+    options.preallocate = size;
+
+    FileWriter writer;
+    bool ok = writer_open(&writer, path, options) && writer_write(&writer, data, size);
+    ok = ok ? writer_close(&writer) : false;
+    writer_destroy(&writer);
+    return ok;
+}
+
+#endif // LT_PLATFORM_UNIX
+
+/////////////////////////////////////////////////////////
+//
+// File reader
+//
+
+#if LT_PLATFORM_UNIX
+
+#define DIRECT_READ_PIECE Megabytes(8)
+
+lt_internal inline u64
+align_up(u64 x, u64 alignment)
+{
+    return (x + alignment - 1) & ~(alignment - 1);
+}
+
+// Opens `path` for reading, with O_DIRECT when asked and supported. Some file systems accept
+// O_DIRECT at open and only fail the reads, so a first block is read to find out.
+lt_internal int
+open_for_scan(const char *path, bool want_direct, bool *direct, FileError *error)
+{
+    *direct = false;
+    int fd = -1;
+#if LT_OS_LINUX
+    if (want_direct)
+    {
+        fd = ::open(path, O_RDONLY | O_DIRECT | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            void *probe = LT_AlignedAlloc(LT_DIRECT_IO_ALIGNMENT, LT_DIRECT_IO_ALIGNMENT, MemoryTag_File);
+            if (!probe)
+            {
+                LT_Panic("Failed allocating memory\n");
+            }
+            const ssize_t n = pread(fd, probe, LT_DIRECT_IO_ALIGNMENT, 0);
+            LT_Free(probe);
+
+            *direct = true;
+            if (n < 0 && errno == EINVAL)
+            {
+                *direct = false;
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+            }
+        }
+    }
+#else
+    LT_Unused(want_direct);
+#endif
+    if (fd < 0) fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        *error = (errno == ENOENT) ? FileError_NotExists : FileError_Unknown;
+        return -1;
+    }
+
+#if LT_OS_LINUX
+    if (!*direct) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return fd;
+}
+
+// Reads until `size` bytes or the end of the file. With O_DIRECT the offset, size and buffer
+// must be aligned; short reads only happen at the end of the file.
+lt_internal isize
+read_full(int fd, char *dst, usize size, u64 offset)
+{
+    usize total = 0;
+    while (total < size)
+    {
+        const ssize_t n = pread(fd, dst + total, size - total, (off_t)(offset + total));
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        total += (usize)n;
+    }
+    return (isize)total;
+}
+
+lt_internal void
+drop_cached_pages(int fd, u64 offset, u64 size)
+{
+#if LT_OS_LINUX
+    posix_fadvise(fd, (off_t)offset, (off_t)size, POSIX_FADV_DONTNEED);
+#else
+    LT_Unused(fd); LT_Unused(offset); LT_Unused(size);
+#endif
+}
+
+FileContents *
+file_read_contents_direct(const char *filename, bool insert_final_zero, bool *used_direct)
+{
+    FileContents *ret = (FileContents*)LT_Calloc(1, sizeof(*ret), MemoryTag_File);
+    ret->data = NULL;
+    ret->size = -1;
+
+    bool direct = false;
+    const int fd = open_for_scan(filename, true, &direct, &ret->error);
+    if (used_direct) *used_direct = direct;
+    if (fd < 0) return ret;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        ::close(fd);
+        ret->error = FileError_Unknown;
+        return ret;
+    }
+
+    // Whole blocks are read, so the buffer is rounded up past the end of the file.
+    const u64 file_size = (u64)st.st_size;
+    const u64 capacity = align_up(file_size + (insert_final_zero ? 1 : 0), LT_DIRECT_IO_ALIGNMENT);
+    char *data = (char*)LT_AlignedAlloc(LT_DIRECT_IO_ALIGNMENT, capacity > 0 ? capacity : LT_DIRECT_IO_ALIGNMENT,
+                                        MemoryTag_File);
+    if (!data)
+    {
+        LT_Panic("Failed allocating memory\n");
+    }
+
+    u64 offset = 0;
+    while (offset < file_size)
+    {
+        const u64 piece = (capacity - offset < DIRECT_READ_PIECE) ? capacity - offset : DIRECT_READ_PIECE;
+        const isize n = read_full(fd, data + offset, piece, offset);
+        if (n < 0)
+        {
+            ::close(fd);
+            LT_Free(data);
+            ret->error = FileError_Read;
+            return ret;
+        }
+        if (n == 0) break;
+        offset += (u64)n;
+    }
+    if (!direct) drop_cached_pages(fd, 0, file_size);
+    ::close(fd);
+
+    if (offset != file_size)
+    {
+        LT_Free(data);
+        ret->error = FileError_Read;
+        return ret;
+    }
+
+    if (insert_final_zero) data[file_size] = 0;
+    ret->error = FileError_None;
+    ret->data = data;
+    ret->size = (isize)file_size;
+    return ret;
+}
+
+struct FilePrefetcher
+{
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable cv;
+    u64                     offset[2] = {};
+    isize                   result[2] = {};
+    bool                    requested[2] = {};
+    bool                    ready[2] = {};
+    bool                    quit = false;
+};
+
+// Chunks are requested in file order and alternate between the two buffers, so the thread
+// serves them in the same alternating order.
+lt_internal void
+prefetcher_run(FilePrefetcher *prefetcher, int fd, char *buffers[2], usize chunk_size)
+{
+    u32 next = 0;
+    std::unique_lock<std::mutex> lock(prefetcher->mutex);
+    for (;;)
+    {
+        prefetcher->cv.wait(lock, [&] { return prefetcher->requested[next] || prefetcher->quit; });
+        if (prefetcher->quit) return;
+
+        const u64 offset = prefetcher->offset[next];
+        lock.unlock();
+        const isize n = read_full(fd, buffers[next], chunk_size, offset);
+        lock.lock();
+
+        prefetcher->result[next] = n;
+        prefetcher->requested[next] = false;
+        prefetcher->ready[next] = true;
+        prefetcher->cv.notify_all();
+        next ^= 1;
+    }
+}
+
+lt_internal void
+prefetch_request(FilePrefetcher *prefetcher, u32 buffer, u64 offset)
+{
+    {
+        std::lock_guard<std::mutex> lock(prefetcher->mutex);
+        prefetcher->offset[buffer] = offset;
+        prefetcher->requested[buffer] = true;
+    }
+    prefetcher->cv.notify_all();
+}
+
+bool
+ltfs::reader_open(FileReader *reader, const std::string &path, const FileReadOptions &options)
+{
+    LT_Assert(reader->fd < 0);
+    *reader = FileReader{};
+
+    reader->fd = open_for_scan(path.c_str(), options.direct, &reader->direct, &reader->error);
+    if (reader->fd < 0) return false;
+
+    struct stat st;
+    if (fstat(reader->fd, &st) < 0)
+    {
+        reader->error = FileError_Unknown;
+        reader_close(reader);
+        return false;
+    }
+    reader->size = (u64)st.st_size;
+
+    reader->chunk_size = align_up(options.chunk_size > 0 ? options.chunk_size : 1, LT_DIRECT_IO_ALIGNMENT);
+    const u32 num_buffers = options.prefetch ? 2 : 1;
+    for (u32 i = 0; i < num_buffers; i++)
+    {
+        reader->buffers[i] = (char*)LT_AlignedAlloc(LT_DIRECT_IO_ALIGNMENT, reader->chunk_size, MemoryTag_File);
+        if (!reader->buffers[i])
+        {
+            reader->error = FileError_Unknown;
+            reader_close(reader);
+            return false;
+        }
+    }
+
+    if (options.prefetch)
+    {
+        reader->prefetcher = new FilePrefetcher;
+        reader->prefetcher->thread = std::thread(prefetcher_run, reader->prefetcher, reader->fd,
+                                                 reader->buffers, reader->chunk_size);
+        if (reader->size > 0) prefetch_request(reader->prefetcher, 0, 0);
+    }
+    return true;
+}
+
+isize
+ltfs::reader_next(FileReader *reader, const char **data)
+{
+    if (reader->error != FileError_None) return -1;
+    if (reader->offset >= reader->size) return 0;
+
+    const u64 offset = reader->offset;
+    // The caller is done with the previous chunk.
+    if (offset > 0 && !reader->direct) drop_cached_pages(reader->fd, offset - reader->chunk_size, reader->chunk_size);
+
+    isize n;
+    FilePrefetcher *prefetcher = reader->prefetcher;
+    if (prefetcher)
+    {
+        const u32 buffer = reader->current;
+        // The previous chunk's buffer is free again, start reading the one after this chunk.
+        if (offset + reader->chunk_size < reader->size)
+            prefetch_request(prefetcher, buffer ^ 1, offset + reader->chunk_size);
+
+        std::unique_lock<std::mutex> lock(prefetcher->mutex);
+        prefetcher->cv.wait(lock, [&] { return prefetcher->ready[buffer]; });
+        prefetcher->ready[buffer] = false;
+        n = prefetcher->result[buffer];
+        *data = reader->buffers[buffer];
+        reader->current ^= 1;
+    }
+    else
+    {
+        n = read_full(reader->fd, reader->buffers[0], reader->chunk_size, offset);
+        *data = reader->buffers[0];
+    }
+
+    if (n <= 0)
+    {
+        // The file shrank or the read failed.
+        reader->error = FileError_Read;
+        return -1;
+    }
+    reader->offset += reader->chunk_size;
+    return n;
+}
+
+bool
+ltfs::reader_read_range(FileReader *reader, u64 offset, void *dst, usize size)
+{
+    if (reader->fd < 0) return false;
+    if (size == 0) return true;
+    if (offset + size > reader->size) return false;
+
+    const u64 a = LT_DIRECT_IO_ALIGNMENT;
+    if ((offset % a) == 0 && (size % a) == 0 && ((uintptr_t)dst % a) == 0)
+        return read_full(reader->fd, (char*)dst, size, offset) == (isize)size;
+
+    // Unaligned: read the covering blocks into a bounce buffer and copy the requested bytes.
+    const u64 begin = offset & ~(a - 1);
+    const u64 end = align_up(offset + size, a);
+    const usize bounce_size = (usize)((end - begin < reader->chunk_size) ? end - begin : reader->chunk_size);
+    char *bounce = (char*)LT_AlignedAlloc(LT_DIRECT_IO_ALIGNMENT, bounce_size, MemoryTag_File);
+    if (!bounce) return false;
+
+    bool ok = true;
+    char *out = (char*)dst;
+    for (u64 block = begin; block < end && ok; block += bounce_size)
+    {
+        const usize piece = (usize)((end - block < bounce_size) ? end - block : bounce_size);
+        const isize n = read_full(reader->fd, bounce, piece, block);
+        const u64 from = (offset > block) ? offset : block;
+        const u64 to = (offset + size < block + piece) ? offset + size : block + piece;
+        ok = n >= 0 && (u64)n >= to - block;
+        if (ok)
+        {
+            memcpy(out, bounce + (from - block), (usize)(to - from));
+            out += to - from;
+        }
+    }
+    LT_Free(bounce);
+    return ok;
+}
+
+void
+ltfs::reader_close(FileReader *reader)
+{
+    if (reader->prefetcher)
+    {
+        {
+            std::lock_guard<std::mutex> lock(reader->prefetcher->mutex);
+            reader->prefetcher->quit = true;
+        }
+        reader->prefetcher->cv.notify_all();
+        reader->prefetcher->thread.join();
+        delete reader->prefetcher;
+        reader->prefetcher = nullptr;
+    }
+    if (reader->fd >= 0)
+    {
+        if (!reader->direct) drop_cached_pages(reader->fd, 0, reader->offset);
+        ::close(reader->fd);
+    }
+    reader->fd = -1;
+    LT_Free(reader->buffers[0]);
+    LT_Free(reader->buffers[1]);
+}
+
+#endif // LT_PLATFORM_UNIX
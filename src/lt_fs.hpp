@@ -4,6 +4,9 @@
 #include <string>
 #include "lt_core.hpp"
 
+struct FileFlusher;
+struct FilePrefetcher;
+
 enum FileError
 {
     FileError_None,
@@ -12,6 +15,8 @@ enum FileError
     FileError_Seek,
     FileError_NotExists,
     FileError_Unknown,
+    FileError_Create,
+    FileError_Write,
 
     FileError_Count,
 };
@@ -24,12 +29,124 @@ struct FileContents
 };
 
 FileContents *file_read_contents(const char *filename, bool insert_final_zero = false);
+// Same as file_read_contents but reads with O_DIRECT, so the file does not stay in the page
+// cache. Falls back to buffered reads (and drops the pages afterwards) when the file system
+// does not support it, `used_direct` tells which one happened.
+FileContents *file_read_contents_direct(const char *filename, bool insert_final_zero = false,
+                                        bool *used_direct = nullptr);
 void          file_free_contents(FileContents *fc);
 isize         file_get_size(const char *filename);
 
+/////////////////////////////////////////////////////////
+//
+// File writer
+//
+// Buffered writer for large outputs. Writes are gathered into a large buffer and reach the
+// file in big chunks; lists of small blocks that do not fit are sent together with the buffer
+// in a single writev. The buffers stay allocated across writer_open/writer_close, so one writer
+// can be reused for many files.
+//
+// With `atomic` set the data goes to a temporary file next to the target, which is fsync'ed
+// and renamed over the target on close: readers see either the old file or the complete new
+// one, even after a crash. With `background_flush` set a thread writes full buffers while the
+// caller fills the next one.
+//
+
+struct FileWriteOptions
+{
+    usize buffer_size      = Megabytes(4);
+    usize preallocate      = 0;      // Bytes reserved up front with fallocate (Linux).
+    bool  atomic           = false;
+    bool  sync             = false;  // fsync on close. Always done for atomic writes.
+    bool  background_flush = false;
+};
+
+struct WriteBlock
+{
+    const void *data;
+    usize       size;
+};
+
+struct FileWriter
+{
+    int              fd = -1;
+    char            *buffers[2] = {};
+    usize            buffer_capacity = 0;
+    u32              active = 0;
+    usize            used = 0;
+    u64              written = 0;  // Bytes handed to the file so far.
+    FileError        error = FileError_None;
+    FileWriteOptions options;
+    std::string      path;
+    std::string      temp_path;
+    FileFlusher     *flusher = nullptr;
+};
+
+/////////////////////////////////////////////////////////
+//
+// File reader
+//
+// Sequential reader for one-pass scans of large files. Reads go through O_DIRECT into
+// aligned buffers, bypassing the page cache; when the file system refuses O_DIRECT (at open
+// or on the first read) the reader switches to buffered reads and drops the pages it has
+// consumed, `direct` tells which mode is in use. With `prefetch` set a thread reads the next
+// chunk while the caller works on the current one.
+//
+
+#define LT_DIRECT_IO_ALIGNMENT 4096
+
+struct FileReadOptions
+{
+    usize chunk_size = Megabytes(4);  // Rounded up to LT_DIRECT_IO_ALIGNMENT.
+    bool  direct     = true;
+    bool  prefetch   = true;
+};
+
+struct FileReader
+{
+    int             fd = -1;
+    bool            direct = false;
+    u64             size = 0;
+    u64             offset = 0;        // File offset of the next chunk.
+    char           *buffers[2] = {};
+    usize           chunk_size = 0;
+    u32             current = 0;
+    FileError       error = FileError_None;
+    FilePrefetcher *prefetcher = nullptr;
+};
+
 namespace ltfs
 {
 
+// All the writer functions return false once an error happened, `writer->error` tells which.
+bool writer_open(FileWriter *writer, const std::string &path,
+                 const FileWriteOptions &options = FileWriteOptions());
+bool writer_write(FileWriter *writer, const void *data, usize size);
+bool writer_write_blocks(FileWriter *writer, const WriteBlock *blocks, usize count);
+// Hands the buffered data to the OS, does not fsync.
+bool writer_flush(FileWriter *writer);
+// Flushes, trims the preallocated space, syncs and, for atomic writes, replaces the target.
+// When an atomic write fails the target is left untouched and the temporary file is removed.
+bool writer_close(FileWriter *writer);
+// Closes without replacing the target, the temporary file is removed.
+void writer_abort(FileWriter *writer);
+// Aborts an open file and frees the buffers.
+void writer_destroy(FileWriter *writer);
+
+// Atomically replaces `path` with `size` bytes of `data`.
+bool write_file(const std::string &path, const void *data, usize size, bool atomic = true);
+
+bool  reader_open(FileReader *reader, const std::string &path,
+                  const FileReadOptions &options = FileReadOptions());
+// Points `data` to the next chunk and returns its size, 0 at the end of the file and -1 on
+// errors. The chunk stays valid until the next call.
+isize reader_next(FileReader *reader, const char **data);
+// Reads any byte range, unaligned offsets and sizes included. Does not move the sequential
+// position.
+bool  reader_read_range(FileReader *reader, u64 offset, void *dst, usize size);
+void  reader_close(FileReader *reader);
+
+
 std::string absolute_path(const std::string &relative_path, bool *error = nullptr);
 bool        file_exists(const std::string &path);
 std::string join(const std::string &p1, const std::string &p2);
@@ -0,0 +1,1085 @@
+#include "lt_geometry.hpp"
+#include "lt_cpu.hpp"
+#include "lt_parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/////////////////////////////////////////////////////////
+//
+// Geometry
+//
+
+lt_internal inline Vec3f
+vec_min(Vec3f a, Vec3f b)
+{
+    return Vec3f(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z);
+}
+
+lt_internal inline Vec3f
+vec_max(Vec3f a, Vec3f b)
+{
+    return Vec3f(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z);
+}
+
+AABB
+lt::aabb_empty()
+{
+    const f32 inf = std::numeric_limits<f32>::infinity();
+    return AABB{Vec3f(inf), Vec3f(-inf)};
+}
+
+AABB
+lt::aabb_union(const AABB &a, const AABB &b)
+{
+    return AABB{vec_min(a.min, b.min), vec_max(a.max, b.max)};
+}
+
+AABB
+lt::aabb_extend(const AABB &a, Vec3f p)
+{
+    return AABB{vec_min(a.min, p), vec_max(a.max, p)};
+}
+
+f32
+lt::aabb_surface_area(const AABB &a)
+{
+    Vec3f d = a.max - a.min;
+    if (d.x < 0 || d.y < 0 || d.z < 0) return 0;
+    return 2.0f * (d.x*d.y + d.y*d.z + d.z*d.x);
+}
+
+AABB
+lt::triangle_bounds(Vec3f v0, Vec3f v1, Vec3f v2)
+{
+    return AABB{vec_min(vec_min(v0, v1), v2), vec_max(vec_max(v0, v1), v2)};
+}
+
+Vec3f
+lt::ray_inverse_direction(const Ray &ray)
+{
+    return Vec3f(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+}
+
+// The packet kernels work on 4 lanes of SoA data, these point to the first lane, so the
+// 8-wide packets can also be handled as two halves.
+struct BoxLanes
+{
+    const f32 *min_x, *min_y, *min_z;
+    const f32 *max_x, *max_y, *max_z;
+};
+
+struct TriangleLanes
+{
+    const f32 *v0_x, *v0_y, *v0_z;
+    const f32 *e1_x, *e1_y, *e1_z;
+    const f32 *e2_x, *e2_y, *e2_z;
+};
+
+template<typename P> lt_internal inline BoxLanes
+box_lanes(const P &p, i32 offset)
+{
+    return BoxLanes{p.min_x + offset, p.min_y + offset, p.min_z + offset,
+                    p.max_x + offset, p.max_y + offset, p.max_z + offset};
+}
+
+template<typename P> lt_internal inline TriangleLanes
+triangle_lanes(const P &p, i32 offset)
+{
+    return TriangleLanes{p.v0_x + offset, p.v0_y + offset, p.v0_z + offset,
+                         p.e1_x + offset, p.e1_y + offset, p.e1_z + offset,
+                         p.e2_x + offset, p.e2_y + offset, p.e2_z + offset};
+}
+
+// 0 * inf is NaN: the ray starts on a slab plane and runs along it. Such a slab does not limit
+// the ray, so a NaN bound becomes the infinity of the other plane: -inv for the near plane and
+// inv for the far one. Only rays with a zero direction component can produce it, the SIMD
+// kernels only pay for the fix up for those (Parallel).
+lt_internal inline void
+slab_axis(f32 lo, f32 hi, f32 origin, f32 inv, f32 *tn, f32 *tf)
+{
+    f32 t0 = (lo - origin) * inv, t1 = (hi - origin) * inv;
+    if (t0 != t0) t0 = -inv;
+    if (t1 != t1) t1 = inv;
+    *tn = std::max(*tn, std::min(t0, t1));
+    *tf = std::min(*tf, std::max(t0, t1));
+}
+
+lt_internal inline bool
+slab_lane(const Ray &ray, Vec3f inv_dir, const BoxLanes &b, i32 i, f32 *t_near)
+{
+    f32 tn = ray.t_min, tf = ray.t_max;
+    slab_axis(b.min_x[i], b.max_x[i], ray.origin.x, inv_dir.x, &tn, &tf);
+    slab_axis(b.min_y[i], b.max_y[i], ray.origin.y, inv_dir.y, &tn, &tf);
+    slab_axis(b.min_z[i], b.max_z[i], ray.origin.z, inv_dir.z, &tn, &tf);
+    *t_near = tn;
+    return tn <= tf;
+}
+
+lt_internal inline bool
+ray_has_zero_direction(Vec3f inv_dir)
+{
+    const f32 inf = std::numeric_limits<f32>::infinity();
+    return std::abs(inv_dir.x) == inf || std::abs(inv_dir.y) == inf || std::abs(inv_dir.z) == inf;
+}
+
+lt_internal inline bool
+triangle_lane(const Ray &ray, const TriangleLanes &tr, i32 i, f32 *t, f32 *u, f32 *v)
+{
+    const Vec3f d = ray.direction;
+    const Vec3f e1(tr.e1_x[i], tr.e1_y[i], tr.e1_z[i]);
+    const Vec3f e2(tr.e2_x[i], tr.e2_y[i], tr.e2_z[i]);
+
+    const Vec3f p(d.y*e2.z - d.z*e2.y, d.z*e2.x - d.x*e2.z, d.x*e2.y - d.y*e2.x);
+    const f32 det = e1.x*p.x + e1.y*p.y + e1.z*p.z;
+    if (det == 0) return false;
+    const f32 inv_det = 1.0f / det;
+
+    const Vec3f s(ray.origin.x - tr.v0_x[i], ray.origin.y - tr.v0_y[i], ray.origin.z - tr.v0_z[i]);
+    const f32 uu = (s.x*p.x + s.y*p.y + s.z*p.z) * inv_det;
+    const Vec3f q(s.y*e1.z - s.z*e1.y, s.z*e1.x - s.x*e1.z, s.x*e1.y - s.y*e1.x);
+    const f32 vv = (d.x*q.x + d.y*q.y + d.z*q.z) * inv_det;
+    const f32 tt = (e2.x*q.x + e2.y*q.y + e2.z*q.z) * inv_det;
+
+    *t = tt; *u = uu; *v = vv;
+    return uu >= 0 && vv >= 0 && uu + vv <= 1 && tt >= ray.t_min && tt <= ray.t_max;
+}
+
+lt_internal u32
+slab_scalar(const Ray &ray, Vec3f inv_dir, const BoxLanes &b, i32 lanes, f32 *t_near)
+{
+    u32 mask = 0;
+    for (i32 i = 0; i < lanes; i++)
+        if (slab_lane(ray, inv_dir, b, i, &t_near[i])) mask |= 1u << i;
+    return mask;
+}
+
+lt_internal u32
+triangle_scalar(const Ray &ray, const TriangleLanes &tr, i32 lanes, f32 *t, f32 *u, f32 *v)
+{
+    u32 mask = 0;
+    for (i32 i = 0; i < lanes; i++)
+        if (triangle_lane(ray, tr, i, &t[i], &u[i], &v[i])) mask |= 1u << i;
+    return mask;
+}
+
+#if defined(__SSE2__)
+lt_internal inline __m128
+slab_fix_sse(__m128 t, __m128 replacement)
+{
+    const __m128 ordered = _mm_cmpord_ps(t, t);
+    return _mm_or_ps(_mm_and_ps(ordered, t), _mm_andnot_ps(ordered, replacement));
+}
+
+template<bool Parallel> lt_internal inline u32
+slab_sse(const Ray &ray, Vec3f inv_dir, const BoxLanes &b, f32 *t_near)
+{
+    const __m128 ox = _mm_set1_ps(ray.origin.x), oy = _mm_set1_ps(ray.origin.y), oz = _mm_set1_ps(ray.origin.z);
+    const __m128 ix = _mm_set1_ps(inv_dir.x), iy = _mm_set1_ps(inv_dir.y), iz = _mm_set1_ps(inv_dir.z);
+
+    __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.min_x), ox), ix);
+    __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.max_x), ox), ix);
+    __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.min_y), oy), iy);
+    __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.max_y), oy), iy);
+    __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.min_z), oz), iz);
+    __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.max_z), oz), iz);
+    if (Parallel)
+    {
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        t0x = slab_fix_sse(t0x, _mm_xor_ps(ix, sign));
+        t1x = slab_fix_sse(t1x, ix);
+        t0y = slab_fix_sse(t0y, _mm_xor_ps(iy, sign));
+        t1y = slab_fix_sse(t1y, iy);
+        t0z = slab_fix_sse(t0z, _mm_xor_ps(iz, sign));
+        t1z = slab_fix_sse(t1z, iz);
+    }
+
+    const __m128 tn = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)),
+                                 _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_set1_ps(ray.t_min)));
+    const __m128 tf = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)),
+                                 _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(ray.t_max)));
+    _mm_storeu_ps(t_near, tn);
+    return (u32)_mm_movemask_ps(_mm_cmple_ps(tn, tf));
+}
+
+lt_internal inline u32
+triangle_sse(const Ray &ray, const TriangleLanes &tr, f32 *t, f32 *u, f32 *v)
+{
+    const __m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+    const __m128 e1x = _mm_load_ps(tr.e1_x), e1y = _mm_load_ps(tr.e1_y), e1z = _mm_load_ps(tr.e1_z);
+    const __m128 e2x = _mm_load_ps(tr.e2_x), e2y = _mm_load_ps(tr.e2_y), e2z = _mm_load_ps(tr.e2_z);
+
+    const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    const __m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(tr.v0_x));
+    const __m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(tr.v0_y));
+    const __m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(tr.v0_z));
+    const __m128 uu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv_det);
+
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    const __m128 vv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv_det);
+    const __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv_det);
+
+    const __m128 zero = _mm_setzero_ps();
+    __m128 ok = _mm_cmpneq_ps(det, zero);
+    ok = _mm_and_ps(ok, _mm_cmpge_ps(uu, zero));
+    ok = _mm_and_ps(ok, _mm_cmpge_ps(vv, zero));
+    ok = _mm_and_ps(ok, _mm_cmple_ps(_mm_add_ps(uu, vv), _mm_set1_ps(1.0f)));
+    ok = _mm_and_ps(ok, _mm_cmpge_ps(tt, _mm_set1_ps(ray.t_min)));
+    ok = _mm_and_ps(ok, _mm_cmple_ps(tt, _mm_set1_ps(ray.t_max)));
+
+    _mm_storeu_ps(t, tt);
+    _mm_storeu_ps(u, uu);
+    _mm_storeu_ps(v, vv);
+    return (u32)_mm_movemask_ps(ok);
+}
+#endif
+
+#if LT_CPU_HAS_AVX2
+LT_TARGET_AVX2 lt_internal inline __m256
+slab_fix_avx(__m256 t, __m256 replacement)
+{
+    return _mm256_blendv_ps(replacement, t, _mm256_cmp_ps(t, t, _CMP_ORD_Q));
+}
+
+template<bool Parallel> LT_TARGET_AVX2 lt_internal inline u32
+slab_avx(const Ray &ray, Vec3f inv_dir, const BoxLanes &b, f32 *t_near)
+{
+    const __m256 ox = _mm256_set1_ps(ray.origin.x), oy = _mm256_set1_ps(ray.origin.y), oz = _mm256_set1_ps(ray.origin.z);
+    const __m256 ix = _mm256_set1_ps(inv_dir.x), iy = _mm256_set1_ps(inv_dir.y), iz = _mm256_set1_ps(inv_dir.z);
+
+    __m256 t0x = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(b.min_x), ox), ix);
+    __m256 t1x = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(b.max_x), ox), ix);
+    __m256 t0y = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(b.min_y), oy), iy);
+    __m256 t1y = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(b.max_y), oy), iy);
+    __m256 t0z = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(b.min_z), oz), iz);
+    __m256 t1z = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(b.max_z), oz), iz);
+    if (Parallel)
+    {
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        t0x = slab_fix_avx(t0x, _mm256_xor_ps(ix, sign));
+        t1x = slab_fix_avx(t1x, ix);
+        t0y = slab_fix_avx(t0y, _mm256_xor_ps(iy, sign));
+        t1y = slab_fix_avx(t1y, iy);
+        t0z = slab_fix_avx(t0z, _mm256_xor_ps(iz, sign));
+        t1z = slab_fix_avx(t1z, iz);
+    }
+
+    const __m256 tn = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t0x, t1x), _mm256_min_ps(t0y, t1y)),
+                                    _mm256_max_ps(_mm256_min_ps(t0z, t1z), _mm256_set1_ps(ray.t_min)));
+    const __m256 tf = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t0x, t1x), _mm256_max_ps(t0y, t1y)),
+                                    _mm256_min_ps(_mm256_max_ps(t0z, t1z), _mm256_set1_ps(ray.t_max)));
+    _mm256_storeu_ps(t_near, tn);
+    return (u32)_mm256_movemask_ps(_mm256_cmp_ps(tn, tf, _CMP_LE_OQ));
+}
+
+LT_TARGET_AVX2 lt_internal inline u32
+triangle_avx(const Ray &ray, const TriangleLanes &tr, f32 *t, f32 *u, f32 *v)
+{
+    const __m256 dx = _mm256_set1_ps(ray.direction.x), dy = _mm256_set1_ps(ray.direction.y), dz = _mm256_set1_ps(ray.direction.z);
+    const __m256 e1x = _mm256_load_ps(tr.e1_x), e1y = _mm256_load_ps(tr.e1_y), e1z = _mm256_load_ps(tr.e1_z);
+    const __m256 e2x = _mm256_load_ps(tr.e2_x), e2y = _mm256_load_ps(tr.e2_y), e2z = _mm256_load_ps(tr.e2_z);
+
+    const __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+    const __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+    const __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+    const __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+    const __m256 inv_det = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+    const __m256 sx = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_load_ps(tr.v0_x));
+    const __m256 sy = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_load_ps(tr.v0_y));
+    const __m256 sz = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_load_ps(tr.v0_z));
+    const __m256 uu = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), inv_det);
+
+    const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+    const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+    const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+    const __m256 vv = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inv_det);
+    const __m256 tt = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inv_det);
+
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 ok = _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ);
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(uu, zero, _CMP_GE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(vv, zero, _CMP_GE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(_mm256_add_ps(uu, vv), _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(tt, _mm256_set1_ps(ray.t_min), _CMP_GE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(tt, _mm256_set1_ps(ray.t_max), _CMP_LE_OQ));
+
+    _mm256_storeu_ps(t, tt);
+    _mm256_storeu_ps(u, uu);
+    _mm256_storeu_ps(v, vv);
+    return (u32)_mm256_movemask_ps(ok);
+}
+#endif
+
+// 8-wide packets: two SSE halves on the baseline, one AVX register with AVX2, picked at run
+// time. The AVX2 kernels may fuse multiplies and adds, their values can differ from the
+// other tiers in the last bits.
+lt_internal u32
+aabb8_scalar(const Ray &ray, Vec3f inv_dir, const AABB8 &boxes, f32 *t_near)
+{
+    return slab_scalar(ray, inv_dir, box_lanes(boxes, 0), 8, t_near);
+}
+
+lt_internal u32
+triangle8_scalar(const Ray &ray, const Triangle8 &tris, f32 *t, f32 *u, f32 *v)
+{
+    return triangle_scalar(ray, triangle_lanes(tris, 0), 8, t, u, v);
+}
+
+#if defined(__SSE2__)
+lt_internal u32
+aabb8_sse2(const Ray &ray, Vec3f inv_dir, const AABB8 &boxes, f32 *t_near)
+{
+    if (ray_has_zero_direction(inv_dir))
+        return slab_sse<true>(ray, inv_dir, box_lanes(boxes, 0), t_near)
+            | (slab_sse<true>(ray, inv_dir, box_lanes(boxes, 4), t_near + 4) << 4);
+    return slab_sse<false>(ray, inv_dir, box_lanes(boxes, 0), t_near)
+        | (slab_sse<false>(ray, inv_dir, box_lanes(boxes, 4), t_near + 4) << 4);
+}
+
+lt_internal u32
+triangle8_sse2(const Ray &ray, const Triangle8 &tris, f32 *t, f32 *u, f32 *v)
+{
+    return triangle_sse(ray, triangle_lanes(tris, 0), t, u, v)
+        | (triangle_sse(ray, triangle_lanes(tris, 4), t + 4, u + 4, v + 4) << 4);
+}
+#endif
+
+#if LT_CPU_HAS_AVX2
+LT_TARGET_AVX2 lt_internal u32
+aabb8_avx2(const Ray &ray, Vec3f inv_dir, const AABB8 &boxes, f32 *t_near)
+{
+    if (ray_has_zero_direction(inv_dir)) return slab_avx<true>(ray, inv_dir, box_lanes(boxes, 0), t_near);
+    return slab_avx<false>(ray, inv_dir, box_lanes(boxes, 0), t_near);
+}
+
+LT_TARGET_AVX2 lt_internal u32
+triangle8_avx2(const Ray &ray, const Triangle8 &tris, f32 *t, f32 *u, f32 *v)
+{
+    return triangle_avx(ray, triangle_lanes(tris, 0), t, u, v);
+}
+#endif
+
+struct GeometryKernel
+{
+    CpuIsa isa;
+    u32  (*aabb8)(const Ray &ray, Vec3f inv_dir, const AABB8 &boxes, f32 *t_near);
+    u32  (*triangle8)(const Ray &ray, const Triangle8 &tris, f32 *t, f32 *u, f32 *v);
+};
+
+lt_global_variable const GeometryKernel g_geometry_kernels[] = {
+    {CpuIsa_Scalar, aabb8_scalar, triangle8_scalar},
+#if defined(__SSE2__)
+    {CpuIsa_SSE2,   aabb8_sse2,   triangle8_sse2},
+#endif
+#if LT_CPU_HAS_AVX2
+    {CpuIsa_AVX2,   aabb8_avx2,   triangle8_avx2},
+#endif
+};
+lt_global_variable CpuDispatchCache g_geometry_dispatch;
+
+bool
+lt::ray_aabb(const Ray &ray, Vec3f inv_dir, const AABB &box, f32 *t_near)
+{
+    const BoxLanes b = {&box.min.x, &box.min.y, &box.min.z, &box.max.x, &box.max.y, &box.max.z};
+    return slab_lane(ray, inv_dir, b, 0, t_near);
+}
+
+bool
+lt::ray_triangle(const Ray &ray, Vec3f v0, Vec3f v1, Vec3f v2, f32 *t, f32 *u, f32 *v)
+{
+    const Vec3f e1 = v1 - v0;
+    const Vec3f e2 = v2 - v0;
+    const TriangleLanes tr = {&v0.x, &v0.y, &v0.z, &e1.x, &e1.y, &e1.z, &e2.x, &e2.y, &e2.z};
+    return triangle_lane(ray, tr, 0, t, u, v);
+}
+
+template<bool Parallel> lt_internal inline u32
+slab4(const Ray &ray, Vec3f inv_dir, const AABB4 &boxes, f32 *t_near)
+{
+#if defined(__SSE2__)
+    return slab_sse<Parallel>(ray, inv_dir, box_lanes(boxes, 0), t_near);
+#else
+    return slab_scalar(ray, inv_dir, box_lanes(boxes, 0), 4, t_near);
+#endif
+}
+
+u32
+lt::ray_aabb4(const Ray &ray, Vec3f inv_dir, const AABB4 &boxes, f32 *t_near)
+{
+    if (ray_has_zero_direction(inv_dir)) return slab4<true>(ray, inv_dir, boxes, t_near);
+    return slab4<false>(ray, inv_dir, boxes, t_near);
+}
+
+u32
+lt::ray_aabb8(const Ray &ray, Vec3f inv_dir, const AABB8 &boxes, f32 *t_near)
+{
+    return cpu_select(g_geometry_kernels, &g_geometry_dispatch)->aabb8(ray, inv_dir, boxes, t_near);
+}
+
+u32
+lt::ray_triangle4(const Ray &ray, const Triangle4 &tris, f32 *t, f32 *u, f32 *v)
+{
+#if defined(__SSE2__)
+    return triangle_sse(ray, triangle_lanes(tris, 0), t, u, v);
+#else
+    return triangle_scalar(ray, triangle_lanes(tris, 0), 4, t, u, v);
+#endif
+}
+
+u32
+lt::ray_triangle8(const Ray &ray, const Triangle8 &tris, f32 *t, f32 *u, f32 *v)
+{
+    return cpu_select(g_geometry_kernels, &g_geometry_dispatch)->triangle8(ray, tris, t, u, v);
+}
+
+const char *
+lt::geometry_kernel_name()
+{
+    return cpu_isa_name(cpu_select(g_geometry_kernels, &g_geometry_dispatch)->isa);
+}
+
+template<typename P> lt_internal inline void
+triangle_packet_set(P *p, i32 lane, Vec3f v0, Vec3f v1, Vec3f v2, u32 prim)
+{
+    const Vec3f e1 = v1 - v0;
+    const Vec3f e2 = v2 - v0;
+    p->v0_x[lane] = v0.x; p->v0_y[lane] = v0.y; p->v0_z[lane] = v0.z;
+    p->e1_x[lane] = e1.x; p->e1_y[lane] = e1.y; p->e1_z[lane] = e1.z;
+    p->e2_x[lane] = e2.x; p->e2_y[lane] = e2.y; p->e2_z[lane] = e2.z;
+    p->prim[lane] = prim;
+}
+
+void
+lt::triangle4_set(Triangle4 *packet, i32 lane, Vec3f v0, Vec3f v1, Vec3f v2, u32 prim)
+{
+    LT_Assert(lane >= 0 && lane < 4);
+    triangle_packet_set(packet, lane, v0, v1, v2, prim);
+}
+
+void
+lt::triangle8_set(Triangle8 *packet, i32 lane, Vec3f v0, Vec3f v1, Vec3f v2, u32 prim)
+{
+    LT_Assert(lane >= 0 && lane < 8);
+    triangle_packet_set(packet, lane, v0, v1, v2, prim);
+}
+
+/////////////////////////////////////////////////////////
+//
+// BVH
+//
+
+#define BVH_NUM_BINS            16
+#define BVH_MAX_LEAF_SIZE       4
+#define BVH_PARALLEL_MIN_PRIMS  16384
+#define BVH_STACK_SIZE          256
+// SAH splits can peel a few primitives off at a time, past this depth the build splits at the
+// median. The binary tree is then at most BVH_MAX_DEPTH deep, the 4-wide one no deeper, and
+// the traversal keeps at most three pending siblings per level plus the four children of the
+// node it just opened.
+#define BVH_MAX_SAH_DEPTH       48
+#define BVH_MAX_DEPTH           (BVH_MAX_SAH_DEPTH + 32)
+static_assert(3 * BVH_MAX_DEPTH + 4 <= BVH_STACK_SIZE, "BVH traversal stack too small for BVH_MAX_DEPTH");
+
+struct BvhBuildNode
+{
+    AABB bounds;
+    u32  left;
+    u32  right;
+    u32  first;
+    u32  count; // Leaf when count > 0.
+};
+
+// Primitive references are partitioned in place, so they carry their bounds with them and
+// every pass over a range reads memory sequentially. The id sits in the fourth lane of `min`,
+// which lets SSE load the bounds directly, the fourth lane is never looked at.
+struct alignas(16) BvhPrimRef
+{
+    f32 min[3];
+    u32 id;
+    f32 max[3];
+    u32 pad;
+};
+
+struct BvhBuilder
+{
+    BvhPrimRef       *refs;
+    BvhBuildNode     *nodes;
+    std::atomic<u32>  num_nodes;
+    u32               max_parallel_depth;
+};
+
+// Box accumulator for the build loops.
+#if defined(__SSE2__)
+struct BvhBox
+{
+    __m128 min;
+    __m128 max;
+};
+
+lt_internal inline BvhBox
+bvh_box_empty()
+{
+    const f32 inf = std::numeric_limits<f32>::infinity();
+    return BvhBox{_mm_set1_ps(inf), _mm_set1_ps(-inf)};
+}
+
+lt_internal inline void
+bvh_box_grow(BvhBox *box, const BvhPrimRef &r)
+{
+    box->min = _mm_min_ps(box->min, _mm_load_ps(r.min));
+    box->max = _mm_max_ps(box->max, _mm_load_ps(r.max));
+}
+
+lt_internal inline void
+bvh_box_grow_centroid(BvhBox *box, const BvhPrimRef &r)
+{
+    const __m128 c = _mm_add_ps(_mm_load_ps(r.min), _mm_load_ps(r.max));
+    box->min = _mm_min_ps(box->min, c);
+    box->max = _mm_max_ps(box->max, c);
+}
+
+lt_internal inline void
+bvh_box_merge(BvhBox *box, const BvhBox &other)
+{
+    box->min = _mm_min_ps(box->min, other.min);
+    box->max = _mm_max_ps(box->max, other.max);
+}
+
+lt_internal inline AABB
+bvh_box_to_aabb(const BvhBox &box)
+{
+    alignas(16) f32 mn[4], mx[4];
+    _mm_store_ps(mn, box.min);
+    _mm_store_ps(mx, box.max);
+    return AABB{Vec3f(mn[0], mn[1], mn[2]), Vec3f(mx[0], mx[1], mx[2])};
+}
+#else
+struct BvhBox
+{
+    AABB aabb;
+};
+
+lt_internal inline BvhBox
+bvh_box_empty()
+{
+    return BvhBox{lt::aabb_empty()};
+}
+
+lt_internal inline void
+bvh_box_grow(BvhBox *box, const BvhPrimRef &r)
+{
+    box->aabb = lt::aabb_union(box->aabb, AABB{Vec3f(r.min[0], r.min[1], r.min[2]), Vec3f(r.max[0], r.max[1], r.max[2])});
+}
+
+lt_internal inline void
+bvh_box_grow_centroid(BvhBox *box, const BvhPrimRef &r)
+{
+    box->aabb = lt::aabb_extend(box->aabb, Vec3f(r.min[0] + r.max[0], r.min[1] + r.max[1], r.min[2] + r.max[2]));
+}
+
+lt_internal inline void
+bvh_box_merge(BvhBox *box, const BvhBox &other)
+{
+    box->aabb = lt::aabb_union(box->aabb, other.aabb);
+}
+
+lt_internal inline AABB
+bvh_box_to_aabb(const BvhBox &box)
+{
+    return box.aabb;
+}
+#endif
+
+struct BvhBin
+{
+    BvhBox bounds;
+    u32    count;
+};
+
+// Centroids are kept doubled (min + max) to save the multiply, the bins are relative anyway.
+lt_internal inline f32
+bvh_centroid(const BvhPrimRef &r, i32 axis)
+{
+    return r.min[axis] + r.max[axis];
+}
+
+lt_internal inline i32
+bvh_bin_index(f32 c, f32 cmin, f32 scale)
+{
+    i32 b = (i32)((c - cmin) * scale);
+    return (b < 0) ? 0 : ((b >= BVH_NUM_BINS) ? BVH_NUM_BINS - 1 : b);
+}
+
+lt_internal void
+bvh_build_recursive(BvhBuilder *b, u32 node_index, u32 first, u32 count, u32 depth)
+{
+    BvhBuildNode *node = &b->nodes[node_index];
+    BvhPrimRef *refs = b->refs + first;
+
+    BvhBox bounds = bvh_box_empty();
+    BvhBox centroids = bvh_box_empty();
+    for (u32 i = 0; i < count; i++)
+    {
+        bvh_box_grow(&bounds, refs[i]);
+        bvh_box_grow_centroid(&centroids, refs[i]);
+    }
+    node->bounds = bvh_box_to_aabb(bounds);
+    const AABB centroid_bounds = bvh_box_to_aabb(centroids);
+
+    if (count <= BVH_MAX_LEAF_SIZE)
+    {
+        node->first = first;
+        node->count = count;
+        return;
+    }
+
+    u32 mid = count / 2;
+    if (depth >= BVH_MAX_SAH_DEPTH)
+    {
+        // Object median on the widest centroid axis. Every level from here halves the range,
+        // which bounds the depth of the tree (and of this recursion) whatever the input.
+        i32 axis = 0;
+        const Vec3f extent = centroid_bounds.max - centroid_bounds.min;
+        if (extent.y > extent.val[axis]) axis = 1;
+        if (extent.z > extent.val[axis]) axis = 2;
+        std::nth_element(refs, refs + mid, refs + count, [axis](const BvhPrimRef &l, const BvhPrimRef &r) {
+            return bvh_centroid(l, axis) < bvh_centroid(r, axis);
+        });
+    }
+    else
+    {
+        // Binned SAH over all three axes in a single pass. The cost is relative, so the
+        // traversal/intersection constants and the parent area are left out.
+        f32 cmin[3], scale[3];
+        for (i32 axis = 0; axis < 3; axis++)
+        {
+            const f32 extent = centroid_bounds.max.val[axis] - centroid_bounds.min.val[axis];
+            cmin[axis] = centroid_bounds.min.val[axis];
+            scale[axis] = (extent > 0) ? (f32)BVH_NUM_BINS / extent : 0;
+        }
+
+        BvhBin bins[3][BVH_NUM_BINS];
+        for (i32 axis = 0; axis < 3; axis++)
+            for (i32 i = 0; i < BVH_NUM_BINS; i++) bins[axis][i] = BvhBin{bvh_box_empty(), 0};
+
+        for (u32 i = 0; i < count; i++)
+        {
+            for (i32 axis = 0; axis < 3; axis++)
+            {
+                BvhBin &bin = bins[axis][bvh_bin_index(bvh_centroid(refs[i], axis), cmin[axis], scale[axis])];
+                bvh_box_grow(&bin.bounds, refs[i]);
+                bin.count++;
+            }
+        }
+
+        i32 best_axis = -1;
+        i32 best_split = 0;
+        f32 best_cost = std::numeric_limits<f32>::max();
+
+        for (i32 axis = 0; axis < 3; axis++)
+        {
+            if (scale[axis] == 0) continue;
+
+            f32 right_area[BVH_NUM_BINS];
+            u32 right_count[BVH_NUM_BINS];
+            BvhBox acc = bvh_box_empty();
+            u32 acc_count = 0;
+            for (i32 i = BVH_NUM_BINS - 1; i > 0; i--)
+            {
+                bvh_box_merge(&acc, bins[axis][i].bounds);
+                acc_count += bins[axis][i].count;
+                right_area[i] = lt::aabb_surface_area(bvh_box_to_aabb(acc));
+                right_count[i] = acc_count;
+            }
+
+            acc = bvh_box_empty();
+            acc_count = 0;
+            for (i32 i = 1; i < BVH_NUM_BINS; i++)
+            {
+                bvh_box_merge(&acc, bins[axis][i - 1].bounds);
+                acc_count += bins[axis][i - 1].count;
+                if (acc_count == 0 || right_count[i] == 0) continue;
+
+                const f32 cost = lt::aabb_surface_area(bvh_box_to_aabb(acc)) * acc_count + right_area[i] * right_count[i];
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = i;
+                }
+            }
+        }
+
+        if (best_axis >= 0)
+        {
+            const i32 axis = best_axis;
+            BvhPrimRef *split = std::partition(refs, refs + count, [&](const BvhPrimRef &r) {
+                return bvh_bin_index(bvh_centroid(r, axis), cmin[axis], scale[axis]) < best_split;
+            });
+            mid = (u32)(split - refs);
+        }
+        // All centroids in the same spot or an unbalanced partition, fall back to a median split.
+        if (mid == 0 || mid == count) mid = count / 2;
+    }
+
+    const u32 left = b->num_nodes.fetch_add(2, std::memory_order_relaxed);
+    node->left = left;
+    node->right = left + 1;
+    node->count = 0;
+
+    if (count >= BVH_PARALLEL_MIN_PRIMS && depth < b->max_parallel_depth)
+    {
+        std::thread worker(bvh_build_recursive, b, left, first, mid, depth + 1);
+        bvh_build_recursive(b, left + 1, first + mid, count - mid, depth + 1);
+        worker.join();
+    }
+    else
+    {
+        bvh_build_recursive(b, left, first, mid, depth + 1);
+        bvh_build_recursive(b, left + 1, first + mid, count - mid, depth + 1);
+    }
+}
+
+lt_internal inline void
+bvh_slot_set_bounds(BvhNode4 *node, i32 slot, const AABB &box)
+{
+    node->bounds.min_x[slot] = box.min.x; node->bounds.min_y[slot] = box.min.y; node->bounds.min_z[slot] = box.min.z;
+    node->bounds.max_x[slot] = box.max.x; node->bounds.max_y[slot] = box.max.y; node->bounds.max_z[slot] = box.max.z;
+}
+
+lt_internal inline AABB
+bvh_slot_bounds(const BvhNode4 *node, i32 slot)
+{
+    return AABB{Vec3f(node->bounds.min_x[slot], node->bounds.min_y[slot], node->bounds.min_z[slot]),
+                Vec3f(node->bounds.max_x[slot], node->bounds.max_y[slot], node->bounds.max_z[slot])};
+}
+
+lt_internal void
+bvh_fill_packet(Triangle4 *packet, const u32 *prims, u32 count, const Vec3f *positions, const u32 *indices)
+{
+    for (u32 lane = 0; lane < 4; lane++)
+    {
+        if (lane < count)
+        {
+            const u32 p = prims[lane];
+            lt::triangle4_set(packet, lane, positions[indices[3*p]], positions[indices[3*p + 1]],
+                              positions[indices[3*p + 2]], p);
+        }
+        else
+        {
+            lt::triangle4_set(packet, lane, Vec3f(0), Vec3f(0), Vec3f(0), LT_GEOMETRY_INVALID_PRIM);
+        }
+    }
+}
+
+lt_internal AABB
+bvh_packet_bounds(const Triangle4 &packet)
+{
+    AABB box = lt::aabb_empty();
+    for (i32 lane = 0; lane < 4; lane++)
+    {
+        if (packet.prim[lane] == LT_GEOMETRY_INVALID_PRIM) continue;
+        const Vec3f v0(packet.v0_x[lane], packet.v0_y[lane], packet.v0_z[lane]);
+        const Vec3f e1(packet.e1_x[lane], packet.e1_y[lane], packet.e1_z[lane]);
+        const Vec3f e2(packet.e2_x[lane], packet.e2_y[lane], packet.e2_z[lane]);
+        box = lt::aabb_union(box, lt::triangle_bounds(v0, v0 + e1, v0 + e2));
+    }
+    return box;
+}
+
+// Turns the binary node into a 4-wide node by repeatedly opening the internal child with the
+// largest surface area. Nodes are allocated before their children, so children always end up
+// at higher indices.
+lt_internal u32
+bvh_collapse(Bvh4 *bvh, const BvhBuilder *b, u32 build_index, const Vec3f *positions, const u32 *indices)
+{
+    const u32 node_index = bvh->num_nodes++;
+    const BvhBuildNode &root = b->nodes[build_index];
+
+    u32 children[4];
+    i32 num_children = 0;
+    if (root.count > 0)
+    {
+        children[num_children++] = build_index;
+    }
+    else
+    {
+        children[num_children++] = root.left;
+        children[num_children++] = root.right;
+    }
+
+    while (num_children < 4)
+    {
+        i32 best = -1;
+        f32 best_area = -1;
+        for (i32 i = 0; i < num_children; i++)
+        {
+            const BvhBuildNode &c = b->nodes[children[i]];
+            if (c.count > 0) continue;
+            const f32 area = lt::aabb_surface_area(c.bounds);
+            if (area > best_area)
+            {
+                best_area = area;
+                best = i;
+            }
+        }
+        if (best < 0) break;
+
+        const BvhBuildNode &opened = b->nodes[children[best]];
+        children[best] = opened.left;
+        children[num_children++] = opened.right;
+    }
+
+    for (i32 slot = 0; slot < 4; slot++)
+    {
+        BvhNode4 *node = &bvh->nodes[node_index];
+        if (slot >= num_children)
+        {
+            bvh_slot_set_bounds(node, slot, lt::aabb_empty());
+            node->child[slot] = LT_BVH_EMPTY_CHILD;
+            node->is_leaf[slot] = 0;
+            continue;
+        }
+
+        const BvhBuildNode &c = b->nodes[children[slot]];
+        bvh_slot_set_bounds(node, slot, c.bounds);
+        if (c.count > 0)
+        {
+            const u32 packet = bvh->num_packets++;
+            u32 prims[BVH_MAX_LEAF_SIZE];
+            for (u32 i = 0; i < c.count; i++) prims[i] = b->refs[c.first + i].id;
+            bvh_fill_packet(&bvh->packets[packet], prims, c.count, positions, indices);
+            node->child[slot] = packet;
+            node->is_leaf[slot] = 1;
+        }
+        else
+        {
+            const u32 child = bvh_collapse(bvh, b, children[slot], positions, indices);
+            bvh->nodes[node_index].child[slot] = child;
+            bvh->nodes[node_index].is_leaf[slot] = 0;
+        }
+    }
+    return node_index;
+}
+
+lt_internal void *
+bvh_alloc(usize size)
+{
+    return LT_AlignedAlloc(64, (size + 63) & ~(usize)63, MemoryTag_Geometry);
+}
+
+bool
+lt::bvh_build(Bvh4 *bvh, const Vec3f *positions, const u32 *indices, usize num_triangles)
+{
+    *bvh = Bvh4{};
+    if (num_triangles == 0 || num_triangles >= 0x7fffffff) return false;
+    const u32 n = (u32)num_triangles;
+
+    BvhPrimRef *refs = (BvhPrimRef*)bvh_alloc(sizeof(BvhPrimRef) * n);
+    // A binary tree with at most BVH_MAX_LEAF_SIZE primitives per leaf has less than 2n nodes.
+    BvhBuildNode *build_nodes = (BvhBuildNode*)LT_Malloc(sizeof(BvhBuildNode) * 2 * n, MemoryTag_Geometry);
+
+    if (!refs || !build_nodes)
+    {
+        LT_Free(refs);
+        LT_Free(build_nodes);
+        return false;
+    }
+
+    lt::parallel_for(n, 65536, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++)
+        {
+            const AABB box = lt::triangle_bounds(positions[indices[3*i]], positions[indices[3*i + 1]],
+                                                 positions[indices[3*i + 2]]);
+            refs[i].min[0] = box.min.x; refs[i].min[1] = box.min.y; refs[i].min[2] = box.min.z;
+            refs[i].max[0] = box.max.x; refs[i].max[1] = box.max.y; refs[i].max[2] = box.max.z;
+            refs[i].id = (u32)i;
+            refs[i].pad = 0;
+        }
+    });
+
+    BvhBuilder builder;
+    builder.refs = refs;
+    builder.nodes = build_nodes;
+    builder.num_nodes.store(1, std::memory_order_relaxed);
+    builder.max_parallel_depth = 0;
+    while ((1u << builder.max_parallel_depth) < lt::worker_count()) builder.max_parallel_depth++;
+
+    bvh_build_recursive(&builder, 0, 0, n, 0);
+
+    const u32 num_build_nodes = builder.num_nodes.load();
+    bvh->nodes = (BvhNode4*)bvh_alloc(sizeof(BvhNode4) * num_build_nodes);
+    bvh->packets = (Triangle4*)bvh_alloc(sizeof(Triangle4) * n);
+    if (bvh->nodes && bvh->packets)
+    {
+        bvh_collapse(bvh, &builder, 0, positions, indices);
+        bvh->bounds = build_nodes[0].bounds;
+    }
+
+    LT_Free(refs);
+    LT_Free(build_nodes);
+
+    if (!bvh->nodes || !bvh->packets)
+    {
+        lt::bvh_destroy(bvh);
+        return false;
+    }
+    return true;
+}
+
+void
+lt::bvh_refit(Bvh4 *bvh, const Vec3f *positions, const u32 *indices)
+{
+    lt::parallel_for(bvh->num_packets, 16384, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++)
+        {
+            Triangle4 *packet = &bvh->packets[i];
+            u32 prims[4];
+            u32 count = 0;
+            for (i32 lane = 0; lane < 4; lane++)
+                if (packet->prim[lane] != LT_GEOMETRY_INVALID_PRIM) prims[count++] = packet->prim[lane];
+            bvh_fill_packet(packet, prims, count, positions, indices);
+        }
+    });
+
+    // Children are stored after their parents, so walking backwards sees every child first.
+    for (u32 i = bvh->num_nodes; i-- > 0;)
+    {
+        BvhNode4 *node = &bvh->nodes[i];
+        for (i32 slot = 0; slot < 4; slot++)
+        {
+            const u32 child = node->child[slot];
+            if (child == LT_BVH_EMPTY_CHILD) continue;
+
+            AABB box = lt::aabb_empty();
+            if (node->is_leaf[slot])
+            {
+                box = bvh_packet_bounds(bvh->packets[child]);
+            }
+            else
+            {
+                const BvhNode4 *c = &bvh->nodes[child];
+                for (i32 s = 0; s < 4; s++)
+                    if (c->child[s] != LT_BVH_EMPTY_CHILD) box = lt::aabb_union(box, bvh_slot_bounds(c, s));
+            }
+            bvh_slot_set_bounds(node, slot, box);
+        }
+    }
+
+    AABB bounds = lt::aabb_empty();
+    if (bvh->num_nodes > 0)
+        for (i32 s = 0; s < 4; s++)
+            if (bvh->nodes[0].child[s] != LT_BVH_EMPTY_CHILD) bounds = lt::aabb_union(bounds, bvh_slot_bounds(&bvh->nodes[0], s));
+    bvh->bounds = bounds;
+}
+
+void
+lt::bvh_destroy(Bvh4 *bvh)
+{
+    LT_Free(bvh->nodes);
+    LT_Free(bvh->packets);
+    *bvh = Bvh4{};
+}
+
+struct BvhStackEntry
+{
+    u32 node;
+    f32 t_near;
+};
+
+template<bool AnyHit, bool Parallel> lt_internal bool
+bvh_traverse(const Bvh4 &bvh, const Ray &in_ray, Vec3f inv_dir, RayHit *hit)
+{
+    if (bvh.num_nodes == 0) return false;
+
+    Ray ray = in_ray;
+    bool found = false;
+
+    BvhStackEntry stack[BVH_STACK_SIZE];
+    i32 sp = 0;
+    stack[sp++] = BvhStackEntry{0, ray.t_min};
+
+    while (sp > 0)
+    {
+        const BvhStackEntry entry = stack[--sp];
+        if (entry.t_near > ray.t_max) continue;
+
+        const BvhNode4 &node = bvh.nodes[entry.node];
+        alignas(16) f32 t_near[4];
+        u32 mask = slab4<Parallel>(ray, inv_dir, node.bounds, t_near);
+
+        BvhStackEntry inner[4];
+        i32 num_inner = 0;
+        while (mask)
+        {
+            const i32 slot = __builtin_ctz(mask);
+            mask &= mask - 1;
+
+            const u32 child = node.child[slot];
+            if (child == LT_BVH_EMPTY_CHILD) continue;
+
+            if (node.is_leaf[slot])
+            {
+                alignas(16) f32 t[4], u[4], v[4];
+                u32 tri_mask = lt::ray_triangle4(ray, bvh.packets[child], t, u, v);
+                if (tri_mask == 0) continue;
+                if (AnyHit) return true;
+
+                while (tri_mask)
+                {
+                    const i32 lane = __builtin_ctz(tri_mask);
+                    tri_mask &= tri_mask - 1;
+                    if (t[lane] <= ray.t_max)
+                    {
+                        ray.t_max = t[lane];
+                        hit->t = t[lane];
+                        hit->u = u[lane];
+                        hit->v = v[lane];
+                        hit->prim = bvh.packets[child].prim[lane];
+                        found = true;
+                    }
+                }
+            }
+            else
+            {
+                inner[num_inner++] = BvhStackEntry{child, t_near[slot]};
+            }
+        }
+
+        // Push the farthest first so the nearest child is visited next.
+        for (i32 i = 1; i < num_inner; i++)
+        {
+            const BvhStackEntry e = inner[i];
+            i32 j = i;
+            for (; j > 0 && inner[j - 1].t_near < e.t_near; j--) inner[j] = inner[j - 1];
+            inner[j] = e;
+        }
+        LT_Assert(sp + num_inner <= BVH_STACK_SIZE);
+        for (i32 i = 0; i < num_inner; i++) stack[sp++] = inner[i];
+    }
+    return found;
+}
+
+bool
+lt::bvh_intersect(const Bvh4 &bvh, const Ray &ray, RayHit *hit)
+{
+    const Vec3f inv_dir = lt::ray_inverse_direction(ray);
+    if (ray_has_zero_direction(inv_dir)) return bvh_traverse<false, true>(bvh, ray, inv_dir, hit);
+    return bvh_traverse<false, false>(bvh, ray, inv_dir, hit);
+}
+
+bool
+lt::bvh_occluded(const Bvh4 &bvh, const Ray &ray)
+{
+    const Vec3f inv_dir = lt::ray_inverse_direction(ray);
+    if (ray_has_zero_direction(inv_dir)) return bvh_traverse<true, true>(bvh, ray, inv_dir, NULL);
+    return bvh_traverse<true, false>(bvh, ray, inv_dir, NULL);
+}
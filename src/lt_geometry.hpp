@@ -0,0 +1,159 @@
+#ifndef LT_GEOMETRY_HPP
+#define LT_GEOMETRY_HPP
+
+#include "lt_core.hpp"
+#include "lt_math.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Geometry
+//
+// Rays, boxes and triangles. The packet kernels test one ray against 4 (SSE) or 8 (AVX)
+// primitives stored as structure of arrays, and return a bit mask with one bit per lane hit.
+// The 8-wide ones pick their kernel at run time (see geometry_kernel_name). Without SIMD
+// support they fall back to a per lane loop running the same tests.
+//
+
+struct Ray
+{
+    Vec3f origin;
+    Vec3f direction;
+    f32   t_min;
+    f32   t_max;
+
+    Ray(): t_min(0), t_max(std::numeric_limits<f32>::max()) {}
+    explicit Ray(Vec3f origin, Vec3f direction, f32 t_min = 0, f32 t_max = std::numeric_limits<f32>::max())
+        : origin(origin), direction(direction), t_min(t_min), t_max(t_max) {}
+};
+
+struct AABB
+{
+    Vec3f min;
+    Vec3f max;
+};
+
+struct alignas(16) AABB4
+{
+    f32 min_x[4], min_y[4], min_z[4];
+    f32 max_x[4], max_y[4], max_z[4];
+};
+
+struct alignas(32) AABB8
+{
+    f32 min_x[8], min_y[8], min_z[8];
+    f32 max_x[8], max_y[8], max_z[8];
+};
+
+// Triangles are stored as a vertex and two edges, which is what Moller-Trumbore consumes.
+// `prim` holds the caller's triangle index, unused lanes have LT_GEOMETRY_INVALID_PRIM and
+// zero edges, so they can never be hit.
+#define LT_GEOMETRY_INVALID_PRIM 0xffffffffu
+
+struct alignas(16) Triangle4
+{
+    f32 v0_x[4], v0_y[4], v0_z[4];
+    f32 e1_x[4], e1_y[4], e1_z[4];
+    f32 e2_x[4], e2_y[4], e2_z[4];
+    u32 prim[4];
+};
+
+struct alignas(32) Triangle8
+{
+    f32 v0_x[8], v0_y[8], v0_z[8];
+    f32 e1_x[8], e1_y[8], e1_z[8];
+    f32 e2_x[8], e2_y[8], e2_z[8];
+    u32 prim[8];
+};
+
+struct RayHit
+{
+    f32 t;
+    f32 u;
+    f32 v;
+    u32 prim;
+};
+
+namespace lt
+{
+
+AABB aabb_empty();
+AABB aabb_union(const AABB &a, const AABB &b);
+AABB aabb_extend(const AABB &a, Vec3f p);
+f32  aabb_surface_area(const AABB &a);
+AABB triangle_bounds(Vec3f v0, Vec3f v1, Vec3f v2);
+
+// Inverse direction used by the slab tests. Zero components become +/-inf. A ray running
+// inside a slab plane gives 0 * inf = NaN there, the slab tests treat that slab as not
+// limiting the ray (a hit when the origin lies on the box face).
+Vec3f ray_inverse_direction(const Ray &ray);
+
+// Scalar tests.
+bool ray_aabb(const Ray &ray, Vec3f inv_dir, const AABB &box, f32 *t_near);
+bool ray_triangle(const Ray &ray, Vec3f v0, Vec3f v1, Vec3f v2, f32 *t, f32 *u, f32 *v);
+
+// Packet tests. `t_near` (slab) and `t`, `u`, `v` (triangles) receive one value per lane and
+// are only meaningful for the lanes set in the returned mask.
+u32 ray_aabb4(const Ray &ray, Vec3f inv_dir, const AABB4 &boxes, f32 *t_near);
+u32 ray_aabb8(const Ray &ray, Vec3f inv_dir, const AABB8 &boxes, f32 *t_near);
+u32 ray_triangle4(const Ray &ray, const Triangle4 &tris, f32 *t, f32 *u, f32 *v);
+u32 ray_triangle8(const Ray &ray, const Triangle8 &tris, f32 *t, f32 *u, f32 *v);
+
+void triangle4_set(Triangle4 *packet, i32 lane, Vec3f v0, Vec3f v1, Vec3f v2, u32 prim);
+void triangle8_set(Triangle8 *packet, i32 lane, Vec3f v0, Vec3f v1, Vec3f v2, u32 prim);
+
+const char *geometry_kernel_name();
+
+}
+
+/////////////////////////////////////////////////////////
+//
+// BVH
+//
+// 4-wide bounding volume hierarchy over an indexed triangle mesh. It is built with binned SAH
+// on a binary tree (subtrees are built in parallel), which is then collapsed to 4-wide nodes.
+// Deep in the tree the build switches to median splits, so degenerate input (many triangles
+// in one spot) cannot make it deeper than the fixed traversal stack allows.
+// Each node keeps the boxes of its four children in SoA form, so one ray_aabb4 call tests all
+// of them, and every leaf is a single Triangle4 packet.
+//
+// Nodes are stored so that children always come after their parent, which lets bvh_refit
+// update the boxes for deformed geometry with one backwards pass. Refitting keeps the topology,
+// so rebuild when the motion is large enough to degrade the tree.
+//
+
+#define LT_BVH_EMPTY_CHILD 0xffffffffu
+
+struct alignas(64) BvhNode4
+{
+    AABB4 bounds;
+    // Internal child: node index. Leaf child: packet index. Empty slot: LT_BVH_EMPTY_CHILD.
+    u32   child[4];
+    u8    is_leaf[4];
+};
+
+struct Bvh4
+{
+    BvhNode4  *nodes;
+    u32        num_nodes;
+    Triangle4 *packets;
+    u32        num_packets;
+    AABB       bounds;
+};
+
+namespace lt
+{
+
+// Returns false on allocation failure or when there are no triangles.
+bool bvh_build(Bvh4 *bvh, const Vec3f *positions, const u32 *indices, usize num_triangles);
+// `positions` may have moved, `indices` must be the same ones the tree was built with.
+void bvh_refit(Bvh4 *bvh, const Vec3f *positions, const u32 *indices);
+void bvh_destroy(Bvh4 *bvh);
+
+// Closest hit in [ray.t_min, ray.t_max].
+bool bvh_intersect(const Bvh4 &bvh, const Ray &ray, RayHit *hit);
+// Any hit in [ray.t_min, ray.t_max], for shadow and visibility queries.
+bool bvh_occluded(const Bvh4 &bvh, const Ray &ray);
+
+}
+
+#endif // LT_GEOMETRY_HPP
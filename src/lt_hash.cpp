@@ -0,0 +1,842 @@
+#include "lt_hash.hpp"
+#include "lt_cpu.hpp"
+#include "lt_parallel.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if (LT_GCC || LT_CLANG) && LT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+#define LT_HASH_SECRET_SIZE  192
+#define LT_HASH_STRIPE_LEN   64
+#define LT_HASH_BLOCK_STRIPES ((LT_HASH_SECRET_SIZE - LT_HASH_STRIPE_LEN) / 8)
+#define LT_HASH_SHORT_MAX    240
+
+static_assert(sizeof(((lt::HashState*)0)->secret) == LT_HASH_SECRET_SIZE);
+
+lt_global_variable const u32 PRIME32_1 = 0x9E3779B1U;
+lt_global_variable const u32 PRIME32_2 = 0x85EBCA77U;
+lt_global_variable const u32 PRIME32_3 = 0xC2B2AE3DU;
+
+lt_global_variable const u64 PRIME64_1 = 0x9E3779B185EBCA87ULL;
+lt_global_variable const u64 PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+lt_global_variable const u64 PRIME64_3 = 0x165667B19E3779F9ULL;
+lt_global_variable const u64 PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+lt_global_variable const u64 PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+struct HashSecret
+{
+    u8 bytes[LT_HASH_SECRET_SIZE];
+};
+
+// The default secret is a splitmix64 stream, generated at compile time.
+lt_internal constexpr HashSecret
+make_default_secret()
+{
+    HashSecret s = {};
+    u64 x = 0x6C745F6861736821ULL;
+    for (usize i = 0; i < LT_HASH_SECRET_SIZE; i += 8)
+    {
+        x += 0x9E3779B97F4A7C15ULL;
+        u64 z = x;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        for (usize b = 0; b < 8; b++) s.bytes[i + b] = (u8)(z >> (8 * b));
+    }
+    return s;
+}
+
+alignas(64) lt_global_variable constexpr HashSecret k_default_secret = make_default_secret();
+
+lt_internal inline u32
+read32(const u8 *p)
+{
+    u32 v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+lt_internal inline u64
+read64(const u8 *p)
+{
+    u64 v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+lt_internal inline void
+write64(u8 *p, u64 v)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+lt_internal inline u64
+rotl64(u64 x, u32 r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+lt_internal inline u64
+mul128_fold64(u64 a, u64 b)
+{
+    unsigned __int128 product = (unsigned __int128)a * b;
+    return (u64)product ^ (u64)(product >> 64);
+}
+
+lt_internal inline u64
+xxh64_avalanche(u64 h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+lt_internal inline u64
+avalanche(u64 h)
+{
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+lt_internal inline u64
+rrmxmx(u64 h, u64 len)
+{
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= (h >> 35) + len;
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= h >> 28;
+    return h;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Short inputs (<= 240 bytes)
+//
+
+lt_internal inline u64
+mix16(const u8 *p, const u8 *secret, u64 seed)
+{
+    return mul128_fold64(read64(p) ^ (read64(secret) + seed),
+                         read64(p + 8) ^ (read64(secret + 8) - seed));
+}
+
+lt_internal u64
+hash_short(const u8 *p, usize len, const u8 *secret, u64 seed)
+{
+    LT_Assert(len <= LT_HASH_SHORT_MAX);
+
+    if (len == 0)
+    {
+        return xxh64_avalanche(seed ^ (read64(secret + 56) ^ read64(secret + 64)));
+    }
+    else if (len <= 3)
+    {
+        u32 c1 = p[0];
+        u32 c2 = p[len >> 1];
+        u32 c3 = p[len - 1];
+        u32 combined = (c1 << 16) | (c2 << 24) | c3 | ((u32)len << 8);
+        u64 bitflip = (u64)(read32(secret) ^ read32(secret + 4)) + seed;
+        return xxh64_avalanche((u64)combined ^ bitflip);
+    }
+    else if (len <= 8)
+    {
+        seed ^= (u64)__builtin_bswap32((u32)seed) << 32;
+        u64 in1 = read32(p);
+        u64 in2 = read32(p + len - 4);
+        u64 bitflip = (read64(secret + 8) ^ read64(secret + 16)) - seed;
+        return rrmxmx((in2 + (in1 << 32)) ^ bitflip, len);
+    }
+    else if (len <= 16)
+    {
+        u64 bitflip1 = (read64(secret + 24) ^ read64(secret + 32)) + seed;
+        u64 bitflip2 = (read64(secret + 40) ^ read64(secret + 48)) - seed;
+        u64 lo = read64(p) ^ bitflip1;
+        u64 hi = read64(p + len - 8) ^ bitflip2;
+        u64 acc = len + __builtin_bswap64(lo) + hi + mul128_fold64(lo, hi);
+        return avalanche(acc);
+    }
+    else if (len <= 128)
+    {
+        u64 acc = len * PRIME64_1;
+        if (len > 32)
+        {
+            if (len > 64)
+            {
+                if (len > 96)
+                {
+                    acc += mix16(p + 48, secret + 96, seed);
+                    acc += mix16(p + len - 64, secret + 112, seed);
+                }
+                acc += mix16(p + 32, secret + 64, seed);
+                acc += mix16(p + len - 48, secret + 80, seed);
+            }
+            acc += mix16(p + 16, secret + 32, seed);
+            acc += mix16(p + len - 32, secret + 48, seed);
+        }
+        acc += mix16(p, secret, seed);
+        acc += mix16(p + len - 16, secret + 16, seed);
+        return avalanche(acc);
+    }
+    else
+    {
+        u64 acc = len * PRIME64_1;
+        usize nb_rounds = len / 16;
+        for (usize i = 0; i < 8; i++)
+            acc += mix16(p + 16*i, secret + 16*i, seed);
+        acc = avalanche(acc);
+        for (usize i = 8; i < nb_rounds; i++)
+            acc += mix16(p + 16*i, secret + 16*(i - 8) + 3, seed);
+        acc += mix16(p + len - 16, secret + 136 - 17, seed);
+        return avalanche(acc);
+    }
+}
+
+lt_internal inline lt::Hash128
+hash_short128(const u8 *p, usize len, const u8 *secret, u64 seed)
+{
+    // The high half reuses the short path with shifted keys, every read stays in the secret.
+    lt::Hash128 h;
+    h.low = hash_short(p, len, secret, seed);
+    h.high = hash_short(p, len, secret + 48, seed ^ PRIME64_4);
+    return h;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Long inputs: stripe accumulation kernels
+//
+
+lt_internal void
+accumulate_scalar(u64 *acc, const u8 *p, const u8 *secret, usize nb_stripes)
+{
+    for (usize n = 0; n < nb_stripes; n++)
+    {
+        const u8 *in = p + n*LT_HASH_STRIPE_LEN;
+        const u8 *key = secret + n*8;
+        for (usize i = 0; i < 8; i++)
+        {
+            u64 data_val = read64(in + 8*i);
+            u64 data_key = data_val ^ read64(key + 8*i);
+            acc[i ^ 1] += data_val;
+            acc[i] += (data_key & 0xFFFFFFFFULL) * (data_key >> 32);
+        }
+    }
+}
+
+lt_internal void
+scramble_scalar(u64 *acc, const u8 *key)
+{
+    for (usize i = 0; i < 8; i++)
+    {
+        u64 a = acc[i];
+        a ^= a >> 47;
+        a ^= read64(key + 8*i);
+        a *= PRIME32_1;
+        acc[i] = a;
+    }
+}
+
+#if defined(__SSE2__)
+lt_internal void
+accumulate_sse2(u64 *acc, const u8 *p, const u8 *secret, usize nb_stripes)
+{
+    __m128i *xacc = (__m128i*)acc;
+    for (usize n = 0; n < nb_stripes; n++)
+    {
+        const u8 *in = p + n*LT_HASH_STRIPE_LEN;
+        const u8 *key = secret + n*8;
+        for (usize i = 0; i < 4; i++)
+        {
+            __m128i data_vec = _mm_loadu_si128((const __m128i*)(in + 16*i));
+            __m128i key_vec  = _mm_loadu_si128((const __m128i*)(key + 16*i));
+            __m128i data_key = _mm_xor_si128(data_vec, key_vec);
+            __m128i data_key_hi = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+            __m128i product = _mm_mul_epu32(data_key, data_key_hi);
+            __m128i data_swap = _mm_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+            __m128i sum = _mm_add_epi64(xacc[i], data_swap);
+            xacc[i] = _mm_add_epi64(product, sum);
+        }
+    }
+}
+
+lt_internal void
+scramble_sse2(u64 *acc, const u8 *key)
+{
+    __m128i *xacc = (__m128i*)acc;
+    const __m128i prime = _mm_set1_epi32((i32)PRIME32_1);
+    for (usize i = 0; i < 4; i++)
+    {
+        __m128i a = xacc[i];
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i*)(key + 16*i)));
+        __m128i a_hi = _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i prod_lo = _mm_mul_epu32(a, prime);
+        __m128i prod_hi = _mm_mul_epu32(a_hi, prime);
+        xacc[i] = _mm_add_epi64(prod_lo, _mm_slli_epi64(prod_hi, 32));
+    }
+}
+#endif
+
+#if LT_CPU_HAS_AVX2
+LT_TARGET_AVX2 lt_internal void
+accumulate_avx2(u64 *acc, const u8 *p, const u8 *secret, usize nb_stripes)
+{
+    __m256i *xacc = (__m256i*)acc;
+    for (usize n = 0; n < nb_stripes; n++)
+    {
+        const u8 *in = p + n*LT_HASH_STRIPE_LEN;
+        const u8 *key = secret + n*8;
+        for (usize i = 0; i < 2; i++)
+        {
+            __m256i data_vec = _mm256_loadu_si256((const __m256i*)(in + 32*i));
+            __m256i key_vec  = _mm256_loadu_si256((const __m256i*)(key + 32*i));
+            __m256i data_key = _mm256_xor_si256(data_vec, key_vec);
+            __m256i data_key_hi = _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+            __m256i product = _mm256_mul_epu32(data_key, data_key_hi);
+            __m256i data_swap = _mm256_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+            __m256i sum = _mm256_add_epi64(xacc[i], data_swap);
+            xacc[i] = _mm256_add_epi64(product, sum);
+        }
+    }
+}
+
+LT_TARGET_AVX2 lt_internal void
+scramble_avx2(u64 *acc, const u8 *key)
+{
+    __m256i *xacc = (__m256i*)acc;
+    const __m256i prime = _mm256_set1_epi32((i32)PRIME32_1);
+    for (usize i = 0; i < 2; i++)
+    {
+        __m256i a = xacc[i];
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i*)(key + 32*i)));
+        __m256i a_hi = _mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1));
+        __m256i prod_lo = _mm256_mul_epu32(a, prime);
+        __m256i prod_hi = _mm256_mul_epu32(a_hi, prime);
+        xacc[i] = _mm256_add_epi64(prod_lo, _mm256_slli_epi64(prod_hi, 32));
+    }
+}
+#endif
+
+#if LT_CPU_HAS_AVX512
+#if LT_GCC && !LT_CLANG
+// GCC 12 reports the self-initialized placeholder of _mm512_undefined_epi32, used by the
+// AVX-512 intrinsics, as uninitialized when they are inlined into a target function.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// A whole stripe per register, the accumulators stay in one register across the stripes.
+LT_TARGET_AVX512 lt_internal void
+accumulate_avx512(u64 *acc, const u8 *p, const u8 *secret, usize nb_stripes)
+{
+    __m512i xacc = _mm512_load_si512(acc);
+    for (usize n = 0; n < nb_stripes; n++)
+    {
+        __m512i data_vec = _mm512_loadu_si512(p + n*LT_HASH_STRIPE_LEN);
+        __m512i key_vec  = _mm512_loadu_si512(secret + n*8);
+        __m512i data_key = _mm512_xor_si512(data_vec, key_vec);
+        __m512i data_key_hi = _mm512_shuffle_epi32(data_key, (_MM_PERM_ENUM)_MM_SHUFFLE(0, 3, 0, 1));
+        __m512i product = _mm512_mul_epu32(data_key, data_key_hi);
+        __m512i data_swap = _mm512_shuffle_epi32(data_vec, (_MM_PERM_ENUM)_MM_SHUFFLE(1, 0, 3, 2));
+        __m512i sum = _mm512_add_epi64(xacc, data_swap);
+        xacc = _mm512_add_epi64(product, sum);
+    }
+    _mm512_store_si512(acc, xacc);
+}
+
+LT_TARGET_AVX512 lt_internal void
+scramble_avx512(u64 *acc, const u8 *key)
+{
+    const __m512i prime = _mm512_set1_epi32((i32)PRIME32_1);
+    __m512i a = _mm512_load_si512(acc);
+    a = _mm512_xor_si512(a, _mm512_srli_epi64(a, 47));
+    a = _mm512_xor_si512(a, _mm512_loadu_si512(key));
+    __m512i a_hi = _mm512_shuffle_epi32(a, (_MM_PERM_ENUM)_MM_SHUFFLE(0, 3, 0, 1));
+    __m512i prod_lo = _mm512_mul_epu32(a, prime);
+    __m512i prod_hi = _mm512_mul_epu32(a_hi, prime);
+    _mm512_store_si512(acc, _mm512_add_epi64(prod_lo, _mm512_slli_epi64(prod_hi, 32)));
+}
+
+#if LT_GCC && !LT_CLANG
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+// Every kernel produces the same digests, the widest one the active CpuIsa allows is used.
+// The accumulators must be 64 byte aligned.
+struct HashKernel
+{
+    CpuIsa      isa;
+    const char *name;
+    void      (*accumulate)(u64 *acc, const u8 *p, const u8 *secret, usize nb_stripes);
+    void      (*scramble)(u64 *acc, const u8 *key);
+};
+
+lt_global_variable const HashKernel g_hash_kernels[] = {
+    {CpuIsa_Scalar, "scalar", accumulate_scalar, scramble_scalar},
+#if defined(__SSE2__)
+    {CpuIsa_SSE2,   "sse2",   accumulate_sse2,   scramble_sse2},
+#endif
+#if LT_CPU_HAS_AVX2
+    {CpuIsa_AVX2,   "avx2",   accumulate_avx2,   scramble_avx2},
+#endif
+#if LT_CPU_HAS_AVX512
+    {CpuIsa_AVX512, "avx512", accumulate_avx512, scramble_avx512},
+#endif
+};
+lt_global_variable CpuDispatchCache g_hash_dispatch;
+
+lt_internal inline void
+init_acc(u64 *acc)
+{
+    acc[0] = PRIME32_3;
+    acc[1] = PRIME64_1;
+    acc[2] = PRIME64_2;
+    acc[3] = PRIME64_3;
+    acc[4] = PRIME64_4;
+    acc[5] = PRIME32_2;
+    acc[6] = PRIME64_5;
+    acc[7] = PRIME32_1;
+}
+
+// A seeded long hash runs on a secret derived from the seed, the same way as XXH3.
+lt_internal inline void
+init_secret(u8 *secret, u64 seed)
+{
+    for (usize i = 0; i < LT_HASH_SECRET_SIZE; i += 16)
+    {
+        write64(secret + i,     read64(k_default_secret.bytes + i) + seed);
+        write64(secret + i + 8, read64(k_default_secret.bytes + i + 8) - seed);
+    }
+}
+
+// Accumulates `nb_stripes` full stripes, scrambling at every block boundary.
+lt_internal inline void
+consume_stripes(u64 *acc, u32 *stripes_in_block, const u8 *p, usize nb_stripes, const u8 *secret)
+{
+    const HashKernel *kernel = lt::cpu_select(g_hash_kernels, &g_hash_dispatch);
+    while (nb_stripes > 0)
+    {
+        usize n = LT_HASH_BLOCK_STRIPES - *stripes_in_block;
+        if (n > nb_stripes) n = nb_stripes;
+
+        kernel->accumulate(acc, p, secret + (*stripes_in_block)*8, n);
+        p += n*LT_HASH_STRIPE_LEN;
+        nb_stripes -= n;
+        *stripes_in_block += (u32)n;
+
+        if (*stripes_in_block == LT_HASH_BLOCK_STRIPES)
+        {
+            kernel->scramble(acc, secret + LT_HASH_SECRET_SIZE - LT_HASH_STRIPE_LEN);
+            *stripes_in_block = 0;
+        }
+    }
+}
+
+lt_internal inline void
+accumulate_last_stripe(u64 *acc, const u8 *last_stripe, const u8 *secret)
+{
+    lt::cpu_select(g_hash_kernels, &g_hash_dispatch)->accumulate(acc, last_stripe, secret + LT_HASH_SECRET_SIZE - LT_HASH_STRIPE_LEN - 7, 1);
+}
+
+lt_internal inline u64
+merge_accs(const u64 *acc, const u8 *secret, u64 start)
+{
+    u64 result = start;
+    for (usize i = 0; i < 4; i++)
+        result += mul128_fold64(acc[2*i] ^ read64(secret + 16*i),
+                                acc[2*i + 1] ^ read64(secret + 16*i + 8));
+    return avalanche(result);
+}
+
+lt_internal inline u64
+merge_accs64(const u64 *acc, const u8 *secret, usize len)
+{
+    return merge_accs(acc, secret + 11, len * PRIME64_1);
+}
+
+lt_internal inline lt::Hash128
+merge_accs128(const u64 *acc, const u8 *secret, usize len)
+{
+    lt::Hash128 h;
+    h.low = merge_accs(acc, secret + 11, len * PRIME64_1);
+    h.high = merge_accs(acc, secret + LT_HASH_SECRET_SIZE - LT_HASH_STRIPE_LEN - 11, ~(len * PRIME64_2));
+    return h;
+}
+
+lt_internal inline void
+hash_long(u64 *acc, const u8 *p, usize len, const u8 *secret)
+{
+    init_acc(acc);
+    u32 stripes_in_block = 0;
+    consume_stripes(acc, &stripes_in_block, p, (len - 1) / LT_HASH_STRIPE_LEN, secret);
+    accumulate_last_stripe(acc, p + len - LT_HASH_STRIPE_LEN, secret);
+}
+
+u64
+lt::hash64(const void *data, usize len, u64 seed)
+{
+    const u8 *p = (const u8*)data;
+    if (len <= LT_HASH_SHORT_MAX) return hash_short(p, len, k_default_secret.bytes, seed);
+
+    alignas(64) u64 acc[8];
+    if (seed == 0)
+    {
+        hash_long(acc, p, len, k_default_secret.bytes);
+        return merge_accs64(acc, k_default_secret.bytes, len);
+    }
+
+    alignas(64) u8 secret[LT_HASH_SECRET_SIZE];
+    init_secret(secret, seed);
+    hash_long(acc, p, len, secret);
+    return merge_accs64(acc, secret, len);
+}
+
+lt::Hash128
+lt::hash128(const void *data, usize len, u64 seed)
+{
+    const u8 *p = (const u8*)data;
+    if (len <= LT_HASH_SHORT_MAX) return hash_short128(p, len, k_default_secret.bytes, seed);
+
+    alignas(64) u64 acc[8];
+    if (seed == 0)
+    {
+        hash_long(acc, p, len, k_default_secret.bytes);
+        return merge_accs128(acc, k_default_secret.bytes, len);
+    }
+
+    alignas(64) u8 secret[LT_HASH_SECRET_SIZE];
+    init_secret(secret, seed);
+    hash_long(acc, p, len, secret);
+    return merge_accs128(acc, secret, len);
+}
+
+lt::Hash128
+lt::hash128_tree(const void *data, usize len, u64 seed, usize leaf_size)
+{
+    if (leaf_size == 0) leaf_size = Megabytes(4);
+
+    const u8 *p = (const u8*)data;
+    const usize num_leaves = (len > 0) ? (len + leaf_size - 1) / leaf_size : 1;
+    std::vector<u8> digests(num_leaves * sizeof(Hash128));
+
+    lt::parallel_for(num_leaves, 1, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++)
+        {
+            usize offset = i * leaf_size;
+            usize n = (len - offset < leaf_size) ? len - offset : leaf_size;
+            Hash128 h = lt::hash128(p + offset, n, seed);
+            write64(&digests[i*sizeof(Hash128)], h.low);
+            write64(&digests[i*sizeof(Hash128) + 8], h.high);
+        }
+    });
+
+    return lt::hash128(digests.data(), digests.size(), seed ^ (u64)len);
+}
+
+u64
+lt::hash64_tree(const void *data, usize len, u64 seed, usize leaf_size)
+{
+    return lt::hash128_tree(data, len, seed, leaf_size).low;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Streaming
+//
+
+void
+lt::hash_init(HashState *state, u64 seed)
+{
+    init_acc(state->acc);
+    if (seed == 0) memcpy(state->secret, k_default_secret.bytes, LT_HASH_SECRET_SIZE);
+    else init_secret(state->secret, seed);
+    state->seed = seed;
+    state->total_len = 0;
+    state->buffered = 0;
+    state->stripes_in_block = 0;
+}
+
+void
+lt::hash_update(HashState *state, const void *data, usize len)
+{
+    const usize buffer_size = sizeof(state->buffer);
+    static_assert(sizeof(state->buffer) % LT_HASH_STRIPE_LEN == 0);
+
+    const u8 *p = (const u8*)data;
+    state->total_len += len;
+
+    if (state->buffered + len <= buffer_size)
+    {
+        memcpy(state->buffer + state->buffered, p, len);
+        state->buffered += (u32)len;
+        return;
+    }
+
+    // The buffer is only consumed once more input follows it, that way the last stripe of the
+    // input is always available at digest time.
+    if (state->buffered > 0)
+    {
+        usize fill = buffer_size - state->buffered;
+        memcpy(state->buffer + state->buffered, p, fill);
+        p += fill;
+        len -= fill;
+        consume_stripes(state->acc, &state->stripes_in_block, state->buffer,
+                        buffer_size / LT_HASH_STRIPE_LEN, state->secret);
+        memcpy(state->last_stripe, state->buffer + buffer_size - LT_HASH_STRIPE_LEN, LT_HASH_STRIPE_LEN);
+        state->buffered = 0;
+    }
+
+    if (len > buffer_size)
+    {
+        // Leaves between 1 and LT_HASH_STRIPE_LEN bytes for the buffer.
+        usize nb_stripes = (len - 1) / LT_HASH_STRIPE_LEN;
+        consume_stripes(state->acc, &state->stripes_in_block, p, nb_stripes, state->secret);
+        p += nb_stripes * LT_HASH_STRIPE_LEN;
+        len -= nb_stripes * LT_HASH_STRIPE_LEN;
+        memcpy(state->last_stripe, p - LT_HASH_STRIPE_LEN, LT_HASH_STRIPE_LEN);
+    }
+
+    LT_Assert(len > 0 && len <= buffer_size);
+    memcpy(state->buffer, p, len);
+    state->buffered = (u32)len;
+}
+
+lt_internal void
+digest_long(const lt::HashState *state, u64 *acc)
+{
+    memcpy(acc, state->acc, sizeof(state->acc));
+    u32 stripes_in_block = state->stripes_in_block;
+
+    consume_stripes(acc, &stripes_in_block, state->buffer,
+                    (state->buffered - 1) / LT_HASH_STRIPE_LEN, state->secret);
+
+    if (state->buffered >= LT_HASH_STRIPE_LEN)
+    {
+        accumulate_last_stripe(acc, state->buffer + state->buffered - LT_HASH_STRIPE_LEN, state->secret);
+    }
+    else
+    {
+        u8 last_stripe[LT_HASH_STRIPE_LEN];
+        usize from_previous = LT_HASH_STRIPE_LEN - state->buffered;
+        memcpy(last_stripe, state->last_stripe + LT_HASH_STRIPE_LEN - from_previous, from_previous);
+        memcpy(last_stripe + from_previous, state->buffer, state->buffered);
+        accumulate_last_stripe(acc, last_stripe, state->secret);
+    }
+}
+
+u64
+lt::hash_digest64(const HashState *state)
+{
+    if (state->total_len <= LT_HASH_SHORT_MAX)
+        return hash_short(state->buffer, (usize)state->total_len, k_default_secret.bytes, state->seed);
+
+    alignas(64) u64 acc[8];
+    digest_long(state, acc);
+    return merge_accs64(acc, state->secret, (usize)state->total_len);
+}
+
+lt::Hash128
+lt::hash_digest128(const HashState *state)
+{
+    if (state->total_len <= LT_HASH_SHORT_MAX)
+        return hash_short128(state->buffer, (usize)state->total_len, k_default_secret.bytes, state->seed);
+
+    alignas(64) u64 acc[8];
+    digest_long(state, acc);
+    return merge_accs128(acc, state->secret, (usize)state->total_len);
+}
+
+const char *
+lt::hash_kernel_name()
+{
+    return cpu_select(g_hash_kernels, &g_hash_dispatch)->name;
+}
+
+/////////////////////////////////////////////////////////
+//
+// CRC32C
+//
+
+#define LT_CRC32C_POLY 0x82F63B78U
+
+struct Crc32cTables
+{
+    u32 t[8][256];
+};
+
+lt_internal constexpr Crc32cTables
+make_crc32c_tables()
+{
+    Crc32cTables tables = {};
+    for (u32 i = 0; i < 256; i++)
+    {
+        u32 c = i;
+        for (i32 k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ LT_CRC32C_POLY : (c >> 1);
+        tables.t[0][i] = c;
+    }
+    for (u32 i = 0; i < 256; i++)
+        for (i32 s = 1; s < 8; s++)
+            tables.t[s][i] = (tables.t[s-1][i] >> 8) ^ tables.t[0][tables.t[s-1][i] & 0xFF];
+    return tables;
+}
+
+lt_global_variable constexpr Crc32cTables k_crc32c_tables = make_crc32c_tables();
+
+lt_internal u32
+crc32c_scalar(u32 crc, const u8 *p, usize len)
+{
+    const auto &t = k_crc32c_tables.t;
+    while (len >= 8)
+    {
+        u32 one = read32(p) ^ crc;
+        u32 two = read32(p + 4);
+        crc = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^ t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24] ^
+              t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^ t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    return crc;
+}
+
+#if LT_CPU_HAS_SSE42
+LT_TARGET_SSE42 lt_internal u32
+crc32c_sse42_serial(u32 crc, const u8 *p, usize len)
+{
+    u64 c = crc;
+    while (len >= 8)
+    {
+        c = _mm_crc32_u64(c, read64(p));
+        p += 8;
+        len -= 8;
+    }
+    u32 c32 = (u32)c;
+    while (len-- > 0) c32 = _mm_crc32_u8(c32, *p++);
+    return c32;
+}
+
+// The crc32 instruction has a latency of 3 cycles but a throughput of one per cycle, so large
+// inputs run three independent streams and stitch them together with crc32c_combine.
+LT_TARGET_SSE42 lt_internal u32
+crc32c_sse42(u32 crc, const u8 *p, usize len)
+{
+    if (len < Kilobytes(16)) return crc32c_sse42_serial(crc, p, len);
+
+    const usize part = (len / 3) & ~(usize)7;
+    const u8 *p0 = p;
+    const u8 *p1 = p + part;
+    const u8 *p2 = p + 2*part;
+
+    u64 c0 = crc;
+    u64 c1 = 0xFFFFFFFFU;
+    u64 c2 = 0xFFFFFFFFU;
+    for (usize i = 0; i < part; i += 8)
+    {
+        c0 = _mm_crc32_u64(c0, read64(p0 + i));
+        c1 = _mm_crc32_u64(c1, read64(p1 + i));
+        c2 = _mm_crc32_u64(c2, read64(p2 + i));
+    }
+    u32 tail = crc32c_sse42_serial((u32)c2, p2 + part, len - 3*part);
+
+    u32 result = lt::crc32c_combine(~(u32)c0, ~(u32)c1, part);
+    result = lt::crc32c_combine(result, ~tail, len - 2*part);
+    return ~result;
+}
+#endif
+
+struct Crc32cKernel
+{
+    CpuIsa isa;
+    u32  (*update)(u32 crc, const u8 *p, usize len);
+};
+
+lt_global_variable const Crc32cKernel g_crc32c_kernels[] = {
+    {CpuIsa_Scalar, crc32c_scalar},
+#if LT_CPU_HAS_SSE42
+    {CpuIsa_SSE42,  crc32c_sse42},
+#endif
+};
+lt_global_variable CpuDispatchCache g_crc32c_dispatch;
+
+u32
+lt::crc32c(const void *data, usize len, u32 crc)
+{
+    return ~cpu_select(g_crc32c_kernels, &g_crc32c_dispatch)->update(~crc, (const u8*)data, len);
+}
+
+lt_internal inline u32
+gf2_matrix_times(const u32 *mat, u32 vec)
+{
+    u32 sum = 0;
+    while (vec)
+    {
+        if (vec & 1) sum ^= *mat;
+        vec >>= 1;
+        mat++;
+    }
+    return sum;
+}
+
+lt_internal inline void
+gf2_matrix_square(u32 *square, const u32 *mat)
+{
+    for (i32 n = 0; n < 32; n++) square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+// Same construction as zlib's crc32_combine: apply len_b zero bytes to crc_a through repeated
+// squaring of the "shift by one zero bit" operator.
+u32
+lt::crc32c_combine(u32 crc_a, u32 crc_b, usize len_b)
+{
+    if (len_b == 0) return crc_a;
+
+    u32 even[32];
+    u32 odd[32];
+
+    odd[0] = LT_CRC32C_POLY;
+    u32 row = 1;
+    for (i32 n = 1; n < 32; n++)
+    {
+        odd[n] = row;
+        row <<= 1;
+    }
+
+    gf2_matrix_square(even, odd); // two zero bits
+    gf2_matrix_square(odd, even); // four zero bits
+
+    do
+    {
+        gf2_matrix_square(even, odd);
+        if (len_b & 1) crc_a = gf2_matrix_times(even, crc_a);
+        len_b >>= 1;
+        if (len_b == 0) break;
+
+        gf2_matrix_square(odd, even);
+        if (len_b & 1) crc_a = gf2_matrix_times(odd, crc_a);
+        len_b >>= 1;
+    } while (len_b != 0);
+
+    return crc_a ^ crc_b;
+}
@@ -0,0 +1,68 @@
+#ifndef LT_HASH_HPP
+#define LT_HASH_HPP
+
+#include "lt_core.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Hashing
+//
+// Non-cryptographic 64/128-bit hash following the XXH3 design (64 byte stripes over 8 lanes,
+// periodic scrambling, 128-bit multiply folding). The output is NOT compatible with the
+// reference XXH3, but it is stable across platforms and across the scalar/SSE2/AVX2/AVX-512
+// kernels, which are picked at run time from the CpuIsa (lt_cpu.hpp).
+//
+// CRC32C (Castagnoli) uses the SSE4.2 crc32 instruction when the CPU has it and a slice-by-8
+// table otherwise.
+//
+
+namespace lt
+{
+
+struct Hash128
+{
+    u64 low;
+    u64 high;
+};
+
+inline bool operator==(Hash128 a, Hash128 b) { return a.low == b.low && a.high == b.high; }
+inline bool operator!=(Hash128 a, Hash128 b) { return !(a == b); }
+
+u64     hash64(const void *data, usize len, u64 seed = 0);
+Hash128 hash128(const void *data, usize len, u64 seed = 0);
+
+// Tree mode: the input is cut into `leaf_size` chunks that are hashed in parallel, and the
+// leaf digests are hashed again. This is a different function from hash64/hash128, the
+// results are only comparable with other tree hashes that used the same leaf size.
+u64     hash64_tree(const void *data, usize len, u64 seed = 0, usize leaf_size = Megabytes(4));
+Hash128 hash128_tree(const void *data, usize len, u64 seed = 0, usize leaf_size = Megabytes(4));
+
+// Streaming interface, produces the same digests as the one-shot functions.
+struct HashState
+{
+    alignas(64) u64 acc[8];
+    alignas(64) u8  secret[192];
+    alignas(64) u8  buffer[256];
+    u8              last_stripe[64];
+    u64             seed;
+    u64             total_len;
+    u32             buffered;
+    u32             stripes_in_block;
+};
+
+void    hash_init(HashState *state, u64 seed = 0);
+void    hash_update(HashState *state, const void *data, usize len);
+u64     hash_digest64(const HashState *state);
+Hash128 hash_digest128(const HashState *state);
+
+// Pass the previous result as `crc` to continue a running checksum.
+u32 crc32c(const void *data, usize len, u32 crc = 0);
+// Computes crc32c(A ++ B) from crc32c(A), crc32c(B) and the length of B.
+u32 crc32c_combine(u32 crc_a, u32 crc_b, usize len_b);
+
+// Name of the kernel the active CpuIsa selects.
+const char *hash_kernel_name();
+
+}
+
+#endif // LT_HASH_HPP
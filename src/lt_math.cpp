@@ -1,40 +1,15 @@
 #include "lt_math.hpp"
+#include "lt_cpu.hpp"
+#include "lt_perf.hpp"
+#include <algorithm>
 #include <math.h>
 #include <stdio.h>
 
-Mat4f::Mat4f(f32 m00, f32 m01, f32 m02, f32 m03,
-			 f32 m10, f32 m11, f32 m12, f32 m13,
-			 f32 m20, f32 m21, f32 m22, f32 m23,
-			 f32 m30, f32 m31, f32 m32, f32 m33)
-    : m_col{
-        Vec4<f32>(m00, m10, m20, m30),
-        Vec4<f32>(m01, m11, m21, m31),
-        Vec4<f32>(m02, m12, m22, m32),
-        Vec4<f32>(m03, m13, m23, m33)}
-{
-}
-
-Mat4f::Mat4f(f32 diag)
-{
-    m_col[0] = Vec4<f32>(diag, 0, 0, 0);
-    m_col[1] = Vec4<f32>(0, diag, 0, 0);
-    m_col[2] = Vec4<f32>(0, 0, diag, 0);
-    m_col[3] = Vec4<f32>(0, 0, 0, diag);
-}
-
-Mat4f::Mat4f()
-{
-    m_col[0] = Vec4<f32>(1, 0, 0, 0);
-    m_col[1] = Vec4<f32>(0, 1, 0, 0);
-    m_col[2] = Vec4<f32>(0, 0, 1, 0);
-    m_col[3] = Vec4<f32>(0, 0, 0, 1);
-}
-
 Mat4f
 lt::perspective(f32 fovy, f32 aspect_ratio, f32 znear, f32 zfar)
 {
     f32 fovy_rad = fovy / 180 * LT_PI;
-    f32 f = 1.0/tanf(fovy_rad/2.0);
+    f32 f = 1.0f/lt::math_tan(fovy_rad*0.5f);
     f32 zz = (zfar+znear)/(znear-zfar);
     f32 zw = (2*zfar*znear)/(znear-zfar);
 
@@ -76,20 +51,212 @@ lt::look_at(const Vec3<f32> eye, const Vec3<f32> center, const Vec3<f32> up)
 				  0,     0,     0,                 1);
 }
 
-Mat4f
-lt::translation(const Mat4f& in_mat, Vec3<f32> amount)
+/////////////////////////////////////////////////////////
+//
+// Batch conversions
+//
+// The inline Mat4 operators are picked at compile time, these pick their kernel at run time.
+// The conversions give the same results on every tier. The AVX2 product uses FMA and can
+// differ from the scalar one in the last bit.
+//
+
+lt_internal void
+to_mat4f_scalar(const Mat4d *in, Mat4f *out, usize count)
 {
-    return in_mat * Mat4f(1, 0, 0, amount.x,
-                          0, 1, 0, amount.y,
-                          0, 0, 1, amount.z,
-                          0, 0, 0,         1);
+    for (usize i = 0; i < count; i++) out[i] = lt::to_mat4f(in[i]);
 }
 
-Mat4f
-lt::scale(const Mat4f &in_mat, Vec3<f32> scale)
+lt_internal void
+to_mat4d_scalar(const Mat4f *in, Mat4d *out, usize count)
+{
+    for (usize i = 0; i < count; i++) out[i] = lt::to_mat4d(in[i]);
+}
+
+lt_internal void
+camera_relative_scalar(const Mat4d *world, usize count, const Vec3<f64> &camera_position,
+                       const Mat4f &view_rotation, Mat4f *out)
+{
+    for (usize i = 0; i < count; i++)
+    {
+        Mat4d relative = world[i];
+        relative(0,3) -= camera_position.x;
+        relative(1,3) -= camera_position.y;
+        relative(2,3) -= camera_position.z;
+        out[i] = view_rotation * lt::to_mat4f(relative);
+    }
+}
+
+#if LT_CPU_HAS_AVX2
+LT_TARGET_AVX2 lt_internal void
+to_mat4f_avx2(const Mat4d *in, Mat4f *out, usize count)
+{
+    for (usize i = 0; i < count; i++)
+        for (i32 c = 0; c < 4; c++)
+            _mm_store_ps(out[i].data() + 4*c, _mm256_cvtpd_ps(_mm256_load_pd(in[i].data() + 4*c)));
+}
+
+LT_TARGET_AVX2 lt_internal void
+to_mat4d_avx2(const Mat4f *in, Mat4d *out, usize count)
+{
+    for (usize i = 0; i < count; i++)
+        for (i32 c = 0; c < 4; c++)
+            _mm256_store_pd(out[i].data() + 4*c, _mm256_cvtps_pd(_mm_load_ps(in[i].data() + 4*c)));
+}
+
+LT_TARGET_AVX2 lt_internal void
+camera_relative_avx2(const Mat4d *world, usize count, const Vec3<f64> &camera_position,
+                     const Mat4f &view_rotation, Mat4f *out)
+{
+    const __m256d camera = _mm256_setr_pd(camera_position.x, camera_position.y, camera_position.z, 0.0);
+    const __m128 a0 = _mm_load_ps(view_rotation.data());
+    const __m128 a1 = _mm_load_ps(view_rotation.data() + 4);
+    const __m128 a2 = _mm_load_ps(view_rotation.data() + 8);
+    const __m128 a3 = _mm_load_ps(view_rotation.data() + 12);
+    for (usize i = 0; i < count; i++)
+    {
+        const f64 *w = world[i].data();
+        alignas(16) f32 b[16];
+        _mm_store_ps(b,      _mm256_cvtpd_ps(_mm256_load_pd(w)));
+        _mm_store_ps(b + 4,  _mm256_cvtpd_ps(_mm256_load_pd(w + 4)));
+        _mm_store_ps(b + 8,  _mm256_cvtpd_ps(_mm256_load_pd(w + 8)));
+        _mm_store_ps(b + 12, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_load_pd(w + 12), camera)));
+
+        f32 *r = out[i].data();
+        for (i32 j = 0; j < 4; j++)
+        {
+            __m128 col = _mm_mul_ps(a0, _mm_set1_ps(b[4*j + 0]));
+            col = _mm_fmadd_ps(a1, _mm_set1_ps(b[4*j + 1]), col);
+            col = _mm_fmadd_ps(a2, _mm_set1_ps(b[4*j + 2]), col);
+            col = _mm_fmadd_ps(a3, _mm_set1_ps(b[4*j + 3]), col);
+            _mm_store_ps(r + 4*j, col);
+        }
+    }
+}
+#endif
+
+struct Mat4Kernel
+{
+    CpuIsa isa;
+    void (*to_mat4f)(const Mat4d *in, Mat4f *out, usize count);
+    void (*to_mat4d)(const Mat4f *in, Mat4d *out, usize count);
+    void (*camera_relative)(const Mat4d *world, usize count, const Vec3<f64> &camera_position,
+                            const Mat4f &view_rotation, Mat4f *out);
+};
+
+lt_global_variable const Mat4Kernel g_mat4_kernels[] = {
+    {CpuIsa_Scalar, to_mat4f_scalar, to_mat4d_scalar, camera_relative_scalar},
+#if LT_CPU_HAS_AVX2
+    {CpuIsa_AVX2,   to_mat4f_avx2,   to_mat4d_avx2,   camera_relative_avx2},
+#endif
+};
+lt_global_variable CpuDispatchCache g_mat4_dispatch;
+
+void
+lt::to_mat4f(const Mat4d *in, Mat4f *out, usize count)
+{
+    cpu_select(g_mat4_kernels, &g_mat4_dispatch)->to_mat4f(in, out, count);
+}
+
+void
+lt::to_mat4d(const Mat4f *in, Mat4d *out, usize count)
+{
+    cpu_select(g_mat4_kernels, &g_mat4_dispatch)->to_mat4d(in, out, count);
+}
+
+void
+lt::camera_relative_model_view(const Mat4d *world, usize count, const Vec3<f64> &camera_position,
+                               const Mat4f &view_rotation, Mat4f *out)
+{
+    LT_PERF_SCOPE("camera_relative_model_view", count);
+    cpu_select(g_mat4_kernels, &g_mat4_dispatch)->camera_relative(world, count, camera_position, view_rotation, out);
+}
+
+const char *
+lt::mat4_kernel_name()
+{
+    return cpu_isa_name(cpu_select(g_mat4_kernels, &g_mat4_dispatch)->isa);
+}
+
+// Unit vector orthogonal to `v` (unit length).
+lt_internal Vec3<f32>
+any_orthogonal(const Vec3<f32> &v)
+{
+    const Vec3<f32> axis = (std::fabs(v.x) < 0.5f) ? Vec3<f32>(1, 0, 0) : Vec3<f32>(0, 1, 0);
+    return lt::normalize(lt::cross(v, axis));
+}
+
+// `v` without its components along the unit vectors `a` and `b` (either can be null), as a unit
+// vector when what remains is longer than `epsilon`.
+lt_internal bool
+orthonormalize(Vec3<f32> v, const Vec3<f32> *a, const Vec3<f32> *b, f32 epsilon, Vec3<f32> *out)
+{
+    if (a) v -= *a * lt::dot(v, *a);
+    if (b) v -= *b * lt::dot(v, *b);
+    const f32 len = lt::norm(v);
+    if (!(len > epsilon)) return false;
+    *out = v * (1.0f / len);
+    return true;
+}
+
+void
+lt::decompose(const Mat4f &m, Vec3<f32> *translation, Quat<f32> *rotation, Vec3<f32> *scale)
+{
+    const Vec3<f32> c0(m(0,0), m(1,0), m(2,0));
+    const Vec3<f32> c1(m(0,1), m(1,1), m(2,1));
+    const Vec3<f32> c2(m(0,2), m(1,2), m(2,2));
+    *translation = Vec3<f32>(m(0,3), m(1,3), m(2,3));
+
+    // Lengths below this, relative to the longest column, count as zero.
+    const f32 longest = std::max(lt::norm(c0), std::max(lt::norm(c1), lt::norm(c2)));
+    const f32 epsilon = longest * 1e-6f;
+
+    Vec3<f32> x, y, z;
+    const bool has_x = orthonormalize(c0, nullptr, nullptr, epsilon, &x);
+    const bool has_y = orthonormalize(c1, has_x ? &x : nullptr, nullptr, epsilon, &y);
+    if (has_x && has_y)
+    {
+        z = lt::cross(x, y);
+    }
+    else if (has_x)
+    {
+        if (orthonormalize(c2, &x, nullptr, epsilon, &z)) y = lt::cross(z, x);
+        else
+        {
+            y = any_orthogonal(x);
+            z = lt::cross(x, y);
+        }
+    }
+    else if (has_y)
+    {
+        if (orthonormalize(c2, &y, nullptr, epsilon, &z)) x = lt::cross(y, z);
+        else
+        {
+            z = any_orthogonal(y);
+            x = lt::cross(y, z);
+        }
+    }
+    else if (orthonormalize(c2, nullptr, nullptr, epsilon, &z))
+    {
+        x = any_orthogonal(z);
+        y = lt::cross(z, x);
+    }
+    else
+    {
+        x = Vec3<f32>(1, 0, 0);
+        y = Vec3<f32>(0, 1, 0);
+        z = Vec3<f32>(0, 0, 1);
+    }
+
+    *scale = Vec3<f32>(lt::dot(c0, x), lt::dot(c1, y), lt::dot(c2, z));
+    *rotation = quat_from_matrix(Mat3<f32>(x.x, y.x, z.x,
+                                           x.y, y.y, z.y,
+                                           x.z, y.z, z.z));
+}
+
+void
+lt::decompose(const Mat4f *in, Vec3<f32> *translation, Quat<f32> *rotation, Vec3<f32> *scale, usize count)
 {
-    return in_mat * Mat4f(scale.x,       0,       0,        0,
-						  0,       scale.y,       0,        0,
-						  0,             0, scale.z,        0,
-						  0,             0,       0,        1);
+    LT_PERF_SCOPE("decompose", count);
+    for (usize i = 0; i < count; i++)
+        lt::decompose(in[i], &translation[i], &rotation[i], &scale[i]);
 }
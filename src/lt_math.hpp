@@ -4,18 +4,44 @@
 #include <stdio.h>
 #include <cmath>
 #include <iostream>
-#include <iomanip>
 #include <cstring>
 #include <type_traits>
 #include <limits>
 
 #include "lt_core.hpp"
+#include "lt_format.hpp"
 #include "math.h"
 
+// Defining LT_MATH_USE_FASTMATH (for every translation unit, lt_math.cpp included) routes the
+// f32 trigonometry, slerp and normalization through the polynomial approximations of
+// lt_fastmath.hpp, see the error table there.
+#ifdef LT_MATH_USE_FASTMATH
+#include "lt_fastmath.hpp"
+#ifndef LT_MATH_FASTMATH_PRECISION
+#define LT_MATH_FASTMATH_PRECISION FastMathPrecision_Accurate
+#endif
+#endif
+
 #ifndef LT_PI
 #define LT_PI 3.14159265358979323846
 #endif
 
+namespace lt
+{
+
+// The operator<< overloads below print through format_append into a stack buffer, so they
+// neither use nor change the flags of the stream (precision, width).
+template<typename T> inline std::ostream &
+format_to_stream(std::ostream &os, const T &value)
+{
+    char storage[512];
+    FormatBuffer buf(storage, sizeof(storage));
+    format_append(&buf, value);
+    return os.write(buf.data, (std::streamsize)buf.size);
+}
+
+}
+
 struct Point3f
 {
     f32 x, y, z;
@@ -79,11 +105,25 @@ operator+(const Vec2<T> &a, const Vec2<T> &b)
     return Vec2<T>(a.x + b.x, a.y + b.y);
 }
 
+namespace lt
+{
+
+template<typename T> inline void
+format_append(FormatBuffer *buf, const Vec2<T> &v)
+{
+    format_append(buf, '(');
+    format_append(buf, v.x);
+    format_append(buf, ", ");
+    format_append(buf, v.y);
+    format_append(buf, ')');
+}
+
+}
+
 template<typename T> static inline std::ostream &
 operator<<(std::ostream& os, const Vec2<T> &v)
 {
-    os << "(" << v.x << ", " << v.y << ")";
-    return os;
+    return lt::format_to_stream(os, v);
 }
 
 /////////////////////////////////////////////////////////
@@ -176,11 +216,27 @@ operator!=<f64>(const Vec3<f64> &a, const Vec3<f64> &b)
 	return !almost_equal(a.x, b.x) || !almost_equal(a.y, b.y) || !almost_equal(a.z, b.z);
 }
 
+namespace lt
+{
+
+template<typename T> inline void
+format_append(FormatBuffer *buf, const Vec3<T> &v)
+{
+    format_append(buf, '(');
+    format_append(buf, v.x);
+    format_append(buf, ", ");
+    format_append(buf, v.y);
+    format_append(buf, ", ");
+    format_append(buf, v.z);
+    format_append(buf, ')');
+}
+
+}
+
 template<typename T> static inline std::ostream &
 operator<<(std::ostream& os, const Vec3<T> &v)
 {
-	os << "(" << v.x << ", " << v.y << ", " << v.z << ")";
-	return os;
+    return lt::format_to_stream(os, v);
 }
 
 template<typename T> static inline Vec3<T>
@@ -232,6 +288,60 @@ union Vec4
 namespace lt
 {
 
+inline void
+math_sincos(f32 rad, f32 *s, f32 *c)
+{
+#ifdef LT_MATH_USE_FASTMATH
+    lt::fast_sincos<LT_MATH_FASTMATH_PRECISION>(rad, s, c);
+#else
+    *s = std::sin(rad);
+    *c = std::cos(rad);
+#endif
+}
+
+inline void
+math_sincos(f64 rad, f64 *s, f64 *c)
+{
+    *s = std::sin(rad);
+    *c = std::cos(rad);
+}
+
+inline f32
+math_sin(f32 rad)
+{
+#ifdef LT_MATH_USE_FASTMATH
+    return lt::fast_sin<LT_MATH_FASTMATH_PRECISION>(rad);
+#else
+    return std::sin(rad);
+#endif
+}
+
+inline f64 math_sin(f64 rad) { return std::sin(rad); }
+
+inline f32
+math_tan(f32 rad)
+{
+#ifdef LT_MATH_USE_FASTMATH
+    return lt::fast_tan<LT_MATH_FASTMATH_PRECISION>(rad);
+#else
+    return std::tan(rad);
+#endif
+}
+
+inline f64 math_tan(f64 rad) { return std::tan(rad); }
+
+inline f32
+math_acos(f32 x)
+{
+#ifdef LT_MATH_USE_FASTMATH
+    return lt::fast_acos<LT_MATH_FASTMATH_PRECISION>(x);
+#else
+    return std::acos(x);
+#endif
+}
+
+inline f64 math_acos(f64 x) { return std::acos(x); }
+
 template<typename T> inline T
 norm(const Vec4<T>& v) { return std::sqrt(v.x*v.x + v.y*v.y + v.z*v.z + v.w*v.w); }
 
@@ -290,6 +400,19 @@ cross(const Vec3<T>& a, const Vec3<T>& b)
                    (a.x * b.y) - (a.y * b.x));
 }
 
+#ifdef LT_MATH_USE_FASTMATH
+inline Vec3<f32>
+normalize(const Vec3<f32>& v)
+{
+    const f32 EPSILON = 0.0001f;
+    f32 sqr_length = lt::dot(v, v);
+    if (sqr_length <= EPSILON*EPSILON) return v;
+
+    f32 inv_length = lt::fast_rsqrt<LT_MATH_FASTMATH_PRECISION>(sqr_length);
+    return Vec3<f32>(v.x*inv_length, v.y*inv_length, v.z*inv_length);
+}
+#endif
+
 }
 
 /////////////////////////////////////////////////////////
@@ -298,59 +421,172 @@ cross(const Vec3<T>& a, const Vec3<T>& b)
 //
 // Column major
 //
-union Mat4f
+template<typename T>
+union alignas(4*sizeof(T)) Mat4
 {
-    Mat4f();
-    explicit Mat4f(f32 diag);
-    explicit Mat4f(f32 m00, f32 m01, f32 m02, f32 m03,
-				   f32 m10, f32 m11, f32 m12, f32 m13,
-				   f32 m20, f32 m21, f32 m22, f32 m23,
-				   f32 m30, f32 m31, f32 m32, f32 m33);
+    Mat4()
+        : m_col{Vec4<T>(1, 0, 0, 0), Vec4<T>(0, 1, 0, 0), Vec4<T>(0, 0, 1, 0), Vec4<T>(0, 0, 0, 1)} {}
+
+    explicit Mat4(T diag)
+        : m_col{Vec4<T>(diag, 0, 0, 0), Vec4<T>(0, diag, 0, 0), Vec4<T>(0, 0, diag, 0), Vec4<T>(0, 0, 0, diag)} {}
+
+    explicit Mat4(T m00, T m01, T m02, T m03,
+				  T m10, T m11, T m12, T m13,
+				  T m20, T m21, T m22, T m23,
+				  T m30, T m31, T m32, T m33)
+        : m_col{Vec4<T>(m00, m10, m20, m30),
+                Vec4<T>(m01, m11, m21, m31),
+                Vec4<T>(m02, m12, m22, m32),
+                Vec4<T>(m03, m13, m23, m33)} {}
+
+    // Precision conversion, see also lt::to_mat4f/lt::to_mat4d for the SIMD versions.
+    template<typename U> explicit Mat4(const Mat4<U> &m)
+    {
+        for (isize c = 0; c < 4; c++)
+            for (isize r = 0; r < 4; r++)
+                m_col[c].val[r] = static_cast<T>(m(r, c));
+    }
 
-    inline f32 operator()(isize row, isize col) const
+    inline T operator()(isize row, isize col) const
     {
         return m_col[col].val[row];
     }
 
-    inline f32& operator()(isize row, isize col)
+    inline T& operator()(isize row, isize col)
     {
         return m_col[col].val[row];
     }
 
-	inline Vec4<f32> col(isize col)
+	inline Vec4<T> col(isize col) const
 	{
 		return m_col[col];
 	}
 
-    inline f32 *data() const
+    inline T *data() const
+    {
+        return (T*)&m_col[0].val[0];
+    }
+
+private:
+    Vec4<T> m_col[4];
+};
+
+typedef Mat4<f32> Mat4f;
+typedef Mat4<f64> Mat4d;
+
+template<typename T>
+union Mat3
+{
+    Mat3()
+        : m_col{Vec3<T>(1, 0, 0), Vec3<T>(0, 1, 0), Vec3<T>(0, 0, 1)} {}
+
+    explicit Mat3(T diag)
+        : m_col{Vec3<T>(diag, 0, 0), Vec3<T>(0, diag, 0), Vec3<T>(0, 0, diag)} {}
+
+    explicit Mat3(T m00, T m01, T m02,
+				  T m10, T m11, T m12,
+				  T m20, T m21, T m22)
+        : m_col{Vec3<T>(m00, m10, m20), Vec3<T>(m01, m11, m21), Vec3<T>(m02, m12, m22)} {}
+
+    // Upper-left 3x3 block of a 4x4 matrix.
+    explicit Mat3(const Mat4<T> &m)
+        : m_col{Vec3<T>(m(0,0), m(1,0), m(2,0)),
+                Vec3<T>(m(0,1), m(1,1), m(2,1)),
+                Vec3<T>(m(0,2), m(1,2), m(2,2))} {}
+
+    template<typename U> explicit Mat3(const Mat3<U> &m)
     {
-        return (f32*)&m_col[0].val[0];
+        for (isize c = 0; c < 3; c++)
+            for (isize r = 0; r < 3; r++)
+                m_col[c].val[r] = static_cast<T>(m(r, c));
     }
 
-    Mat4f operator*(const Mat4f& rhs);
+    inline T operator()(isize row, isize col) const
+    {
+        return m_col[col].val[row];
+    }
+
+    inline T& operator()(isize row, isize col)
+    {
+        return m_col[col].val[row];
+    }
+
+	inline Vec3<T> col(isize col) const
+	{
+		return m_col[col];
+	}
+
+    inline T *data() const
+    {
+        return (T*)&m_col[0].val[0];
+    }
 
 private:
-    Vec4<f32> m_col[4];
+    Vec3<T> m_col[3];
 };
 
-inline std::ostream &operator<<(std::ostream& os, const Mat4f &mat)
+typedef Mat3<f32> Mat3f;
+typedef Mat3<f64> Mat3d;
+
+namespace lt
+{
+
+// Matrix cells are "%9.3g".
+inline void
+format_matrix_cell(FormatBuffer *buf, f64 value)
+{
+    char tmp[LT_FORMAT_FLOAT_SIZE];
+    const char *end = format_f64_digits(tmp, value, 3);
+    format_append_padded(buf, tmp, (usize)(end - tmp), 9);
+    format_append(buf, "  ");
+}
+
+template<typename T> inline void
+format_append(FormatBuffer *buf, const Mat4<T> &mat)
 {
     for (i32 row = 0; row < 4; row++)
     {
-        os << "|  ";
+        format_append(buf, "|  ");
         for (i32 col = 0; col < 4; col++)
         {
-            os << std::setw(9) << std::setprecision(3) << mat(row, col) << "  ";
+            format_matrix_cell(buf, (f64)mat(row, col));
         }
-        os << "|\n";
+        format_append(buf, "|\n");
     }
-    return os;
 }
 
-inline Mat4f
-operator*(const Mat4f &lhs, const Mat4f &rhs)
+template<typename T> inline void
+format_append(FormatBuffer *buf, const Mat3<T> &mat)
 {
-    Mat4f ret(1.0);
+    for (i32 row = 0; row < 3; row++)
+    {
+        format_append(buf, "|  ");
+        for (i32 col = 0; col < 3; col++)
+        {
+            format_matrix_cell(buf, (f64)mat(row, col));
+        }
+        format_append(buf, "|\n");
+    }
+}
+
+}
+
+template<typename T> inline std::ostream &
+operator<<(std::ostream& os, const Mat4<T> &mat)
+{
+    return lt::format_to_stream(os, mat);
+}
+
+template<typename T> inline std::ostream &
+operator<<(std::ostream& os, const Mat3<T> &mat)
+{
+    return lt::format_to_stream(os, mat);
+}
+
+template<typename T> inline Mat4<T>
+operator*(const Mat4<T> &lhs, const Mat4<T> &rhs)
+{
+    Mat4<T> ret(static_cast<T>(1));
     // First row
     ret(0,0) = lhs(0,0)*rhs(0,0) + lhs(0,1)*rhs(1,0) + lhs(0,2)*rhs(2,0) + lhs(0,3)*rhs(3,0);
     ret(0,1) = lhs(0,0)*rhs(0,1) + lhs(0,1)*rhs(1,1) + lhs(0,2)*rhs(2,1) + lhs(0,3)*rhs(3,1);
@@ -374,6 +610,152 @@ operator*(const Mat4f &lhs, const Mat4f &rhs)
     return ret;
 }
 
+// The SIMD versions build every result column as a linear combination of the lhs columns,
+// summing in the same order as the scalar version.
+//
+// NOTE: These operators are inline and picked at compile time, not through the lt_cpu
+// dispatch (an indirect call costs about as much as one 4x4 product). The f32 product uses
+// SSE2, which every x86-64 target has, so every translation unit sees the same definition.
+// The f64 product and to_mat4f/to_mat4d of a single matrix are scalar for the same reason.
+// Work on many matrices should go through the batch functions (to_mat4f/to_mat4d on arrays,
+// camera_relative_model_view), which pick an AVX2 kernel at run time.
+#if defined(__SSE2__)
+template<> inline Mat4<f32>
+operator*(const Mat4<f32> &lhs, const Mat4<f32> &rhs)
+{
+    Mat4<f32> ret;
+    const f32 *a = lhs.data();
+    const f32 *b = rhs.data();
+    f32 *r = ret.data();
+
+    const __m128 c0 = _mm_load_ps(a);
+    const __m128 c1 = _mm_load_ps(a + 4);
+    const __m128 c2 = _mm_load_ps(a + 8);
+    const __m128 c3 = _mm_load_ps(a + 12);
+    for (i32 j = 0; j < 4; j++)
+    {
+        __m128 col = _mm_mul_ps(c0, _mm_set1_ps(b[4*j + 0]));
+        col = _mm_add_ps(col, _mm_mul_ps(c1, _mm_set1_ps(b[4*j + 1])));
+        col = _mm_add_ps(col, _mm_mul_ps(c2, _mm_set1_ps(b[4*j + 2])));
+        col = _mm_add_ps(col, _mm_mul_ps(c3, _mm_set1_ps(b[4*j + 3])));
+        _mm_store_ps(r + 4*j, col);
+    }
+    return ret;
+}
+#endif
+
+template<typename T> inline Vec4<T>
+operator*(const Mat4<T> &m, const Vec4<T> &v)
+{
+    return Vec4<T>(m(0,0)*v.x + m(0,1)*v.y + m(0,2)*v.z + m(0,3)*v.w,
+                   m(1,0)*v.x + m(1,1)*v.y + m(1,2)*v.z + m(1,3)*v.w,
+                   m(2,0)*v.x + m(2,1)*v.y + m(2,2)*v.z + m(2,3)*v.w,
+                   m(3,0)*v.x + m(3,1)*v.y + m(3,2)*v.z + m(3,3)*v.w);
+}
+
+template<typename T> inline Mat3<T>
+operator*(const Mat3<T> &lhs, const Mat3<T> &rhs)
+{
+    Mat3<T> ret;
+    for (isize row = 0; row < 3; row++)
+        for (isize col = 0; col < 3; col++)
+            ret(row, col) = lhs(row,0)*rhs(0,col) + lhs(row,1)*rhs(1,col) + lhs(row,2)*rhs(2,col);
+    return ret;
+}
+
+template<typename T> inline Vec3<T>
+operator*(const Mat3<T> &m, const Vec3<T> &v)
+{
+    return Vec3<T>(m(0,0)*v.x + m(0,1)*v.y + m(0,2)*v.z,
+                   m(1,0)*v.x + m(1,1)*v.y + m(1,2)*v.z,
+                   m(2,0)*v.x + m(2,1)*v.y + m(2,2)*v.z);
+}
+
+namespace lt
+{
+
+template<typename T> inline Mat4<T>
+transpose(const Mat4<T> &m)
+{
+    return Mat4<T>(m(0,0), m(1,0), m(2,0), m(3,0),
+                   m(0,1), m(1,1), m(2,1), m(3,1),
+                   m(0,2), m(1,2), m(2,2), m(3,2),
+                   m(0,3), m(1,3), m(2,3), m(3,3));
+}
+
+template<typename T> inline Mat3<T>
+transpose(const Mat3<T> &m)
+{
+    return Mat3<T>(m(0,0), m(1,0), m(2,0),
+                   m(0,1), m(1,1), m(2,1),
+                   m(0,2), m(1,2), m(2,2));
+}
+
+template<typename T> inline T
+determinant(const Mat3<T> &m)
+{
+    return m(0,0)*(m(1,1)*m(2,2) - m(1,2)*m(2,1))
+        - m(0,1)*(m(1,0)*m(2,2) - m(1,2)*m(2,0))
+        + m(0,2)*(m(1,0)*m(2,1) - m(1,1)*m(2,0));
+}
+
+template<typename T> inline Mat3<T>
+inverse(const Mat3<T> &m)
+{
+    T det = lt::determinant(m);
+    LT_Assert(det != static_cast<T>(0));
+    T inv_det = static_cast<T>(1) / det;
+
+    return Mat3<T>((m(1,1)*m(2,2) - m(1,2)*m(2,1))*inv_det,
+                   (m(0,2)*m(2,1) - m(0,1)*m(2,2))*inv_det,
+                   (m(0,1)*m(1,2) - m(0,2)*m(1,1))*inv_det,
+                   (m(1,2)*m(2,0) - m(1,0)*m(2,2))*inv_det,
+                   (m(0,0)*m(2,2) - m(0,2)*m(2,0))*inv_det,
+                   (m(0,2)*m(1,0) - m(0,0)*m(1,2))*inv_det,
+                   (m(1,0)*m(2,1) - m(1,1)*m(2,0))*inv_det,
+                   (m(0,1)*m(2,0) - m(0,0)*m(2,1))*inv_det,
+                   (m(0,0)*m(1,1) - m(0,1)*m(1,0))*inv_det);
+}
+
+// Matrix that transforms normals for the given model matrix: the inverse transpose of its
+// upper-left 3x3 block.
+template<typename T> inline Mat3<T>
+normal_matrix(const Mat4<T> &model)
+{
+    return lt::transpose(lt::inverse(Mat3<T>(model)));
+}
+
+inline Mat4f
+to_mat4f(const Mat4d &m)
+{
+    Mat4f ret;
+    for (i32 i = 0; i < 16; i++) ret.data()[i] = (f32)m.data()[i];
+    return ret;
+}
+
+inline Mat4d
+to_mat4d(const Mat4f &m)
+{
+    Mat4d ret;
+    for (i32 i = 0; i < 16; i++) ret.data()[i] = (f64)m.data()[i];
+    return ret;
+}
+
+// Batch conversions, with the kernel chosen at run time (see mat4_kernel_name).
+void to_mat4f(const Mat4d *in, Mat4f *out, usize count);
+void to_mat4d(const Mat4f *in, Mat4d *out, usize count);
+
+// Camera-relative rendering: the camera position is subtracted from every f64 world transform
+// while still in f64, and only the (small) relative transform is converted to f32 and
+// multiplied by `view_rotation`, the camera orientation without its translation. This keeps
+// objects far from the origin free of precision jitter.
+void camera_relative_model_view(const Mat4d *world, usize count, const Vec3<f64> &camera_position,
+                                const Mat4f &view_rotation, Mat4f *out);
+
+const char *mat4_kernel_name();
+
+}
+
 namespace lt
 {
 
@@ -385,28 +767,55 @@ Mat4f orthographic(f32 left, f32 right, f32 bottom, f32 top);
 
 Mat4f look_at(const Vec3<f32> eye, const Vec3<f32> center, const Vec3<f32> up);
 
-Mat4f translation(const Mat4f &in_mat, Vec3<f32> amount);
+template<typename T> inline Mat4<T>
+translation(const Mat4<T> &in_mat, Vec3<T> amount)
+{
+    return in_mat * Mat4<T>(1, 0, 0, amount.x,
+                            0, 1, 0, amount.y,
+                            0, 0, 1, amount.z,
+                            0, 0, 0,         1);
+}
 
-Mat4f scale(const Mat4f &in_mat, Vec3<f32> scale);
+template<typename T> inline Mat4<T>
+scale(const Mat4<T> &in_mat, Vec3<T> scale)
+{
+    return in_mat * Mat4<T>(scale.x,       0,       0,        0,
+                            0,       scale.y,       0,        0,
+                            0,             0, scale.z,        0,
+                            0,             0,       0,        1);
+}
 
 inline Mat4f
 rotation_x(const Mat4f &in_mat, f32 degrees)
 {
-	f32 rad = lt::radians(degrees);
-	return in_mat * Mat4f(1,        0,         0,    0,
-						  0, cos(rad), -sin(rad),    0,
-						  0, sin(rad),  cos(rad),    0,
-						  0,        0,         0,    1);
+	f32 s, c;
+	lt::math_sincos(lt::radians(degrees), &s, &c);
+	return in_mat * Mat4f(1, 0,  0, 0,
+						  0, c, -s, 0,
+						  0, s,  c, 0,
+						  0, 0,  0, 1);
 }
 
 inline Mat4f
 rotation_y(const Mat4f &in_mat, f32 degrees)
 {
-	f32 rad = lt::radians(degrees);
-	return in_mat * Mat4f(cos(rad), 0, sin(rad), 0,
-						  0, 1, 0, 0,
-						  -sin(rad), 0, cos(rad), 0,
-						  0, 0, 0, 1);
+	f32 s, c;
+	lt::math_sincos(lt::radians(degrees), &s, &c);
+	return in_mat * Mat4f( c, 0, s, 0,
+						   0, 1, 0, 0,
+						  -s, 0, c, 0,
+						   0, 0, 0, 1);
+}
+
+inline Mat4f
+rotation_z(const Mat4f &in_mat, f32 degrees)
+{
+	f32 s, c;
+	lt::math_sincos(lt::radians(degrees), &s, &c);
+	return in_mat * Mat4f(c, -s, 0, 0,
+						  s,  c, 0, 0,
+						  0,  0, 1, 0,
+						  0,  0, 0, 1);
 }
 
 }
@@ -486,12 +895,29 @@ operator*(const Quat<T>& lhs, const Quat<T>& rhs)
                    rhs.s*lhs.v + lhs.s*rhs.v + lt::cross(lhs.v, rhs.v));
 }
 
+namespace lt
+{
+
+// Components with 3 significant digits.
+template<typename T> inline void
+format_append(FormatBuffer *buf, const Quat<T> &q)
+{
+    char tmp[LT_FORMAT_FLOAT_SIZE];
+    format_append(buf, '(');
+    for (i32 i = 0; i < 4; i++)
+    {
+        if (i > 0) format_append(buf, ", ");
+        format_append(buf, tmp, (usize)(format_f64_digits(tmp, (f64)q.val[i], 3) - tmp));
+    }
+    format_append(buf, ')');
+}
+
+}
+
 template<typename T> inline std::ostream &
 operator<<(std::ostream &os, const Quat<T> &q)
 {
-    os << "(" << std::setprecision(3) << q.val[0] << ", ";
-    os << q.val[1] << ", " << q.val[2] << ", " << q.val[3] << ")";
-    return os;
+    return lt::format_to_stream(os, q);
 }
 
 template<typename T> inline bool
@@ -544,6 +970,15 @@ normalize(const Quat<T> &q)
     return Quat<T>(q.s/lt::norm(q), q.v.i/lt::norm(q), q.v.j/lt::norm(q), q.v.k/lt::norm(q));
 }
 
+#ifdef LT_MATH_USE_FASTMATH
+inline Quat<f32>
+normalize(const Quat<f32> &q)
+{
+    f32 inv_norm = lt::fast_rsqrt<LT_MATH_FASTMATH_PRECISION>(lt::sqr_norm(q));
+    return Quat<f32>(q.s*inv_norm, q.v.i*inv_norm, q.v.j*inv_norm, q.v.k*inv_norm);
+}
+#endif
+
 template<typename T> inline Quat<T>
 conjugate(const Quat<T> &q)
 {
@@ -582,10 +1017,10 @@ slerp(const Quat<T> &start_q, const Quat<T> &end_q, T t)
 
     if (start_dot_end < 1-EPSILON)
     {
-        T angle = std::acos(start_dot_end);
+        T angle = lt::math_acos(start_dot_end);
         LT_Assert(angle != static_cast<T>(0));
-        return (std::sin((static_cast<T>(1) - t) * angle) * start_q + std::sin(t * angle) * end_q) /
-            std::sin(angle);
+        return (lt::math_sin((static_cast<T>(1) - t) * angle) * start_q + lt::math_sin(t * angle) * end_q) /
+            lt::math_sin(angle);
     }
     else
     {
@@ -595,13 +1030,185 @@ slerp(const Quat<T> &start_q, const Quat<T> &end_q, T t)
 
 }
 
+/////////////////////////////////////////////////////////
+//
+// Conversions between rotations, matrices and transforms
+//
+
+namespace lt
+{
+
+// Rotation matrix of a unit quaternion. Quat::to_mat4 is the matrix of the product q*p, this is
+// the one that rotates vectors like q*v*conjugate(q).
+template<typename T> inline Mat3<T>
+rotation_matrix(const Quat<T> &q)
+{
+    const T w = q.s, x = q.v.i, y = q.v.j, z = q.v.k;
+    return Mat3<T>(1 - 2*(y*y + z*z), 2*(x*y - w*z),     2*(x*z + w*y),
+                   2*(x*y + w*z),     1 - 2*(x*x + z*z), 2*(y*z - w*x),
+                   2*(x*z - w*y),     2*(y*z + w*x),     1 - 2*(x*x + y*y));
+}
+
+// Quaternion of a rotation matrix (orthonormal, determinant 1), with a non-negative real part.
+// Shepperd's method: the square root is taken of the largest of the four candidates, so it
+// never comes close to zero.
+template<typename T> inline Quat<T>
+quat_from_matrix(const Mat3<T> &m)
+{
+    const T trace = m(0,0) + m(1,1) + m(2,2);
+    Quat<T> q;
+    if (trace > 0)
+    {
+        const T s = std::sqrt(trace + 1) * 2;
+        q = Quat<T>(s/4, (m(2,1) - m(1,2))/s, (m(0,2) - m(2,0))/s, (m(1,0) - m(0,1))/s);
+    }
+    else if (m(0,0) > m(1,1) && m(0,0) > m(2,2))
+    {
+        const T s = std::sqrt(1 + m(0,0) - m(1,1) - m(2,2)) * 2;
+        q = Quat<T>((m(2,1) - m(1,2))/s, s/4, (m(0,1) + m(1,0))/s, (m(0,2) + m(2,0))/s);
+    }
+    else if (m(1,1) > m(2,2))
+    {
+        const T s = std::sqrt(1 + m(1,1) - m(0,0) - m(2,2)) * 2;
+        q = Quat<T>((m(0,2) - m(2,0))/s, (m(0,1) + m(1,0))/s, s/4, (m(1,2) + m(2,1))/s);
+    }
+    else
+    {
+        const T s = std::sqrt(1 + m(2,2) - m(0,0) - m(1,1)) * 2;
+        q = Quat<T>((m(1,0) - m(0,1))/s, (m(0,2) + m(2,0))/s, (m(1,2) + m(2,1))/s, s/4);
+    }
+
+    const T inv_norm = ((q.s < 0) ? -1 : 1) / lt::norm(q);
+    return Quat<T>(q.s*inv_norm, q.v.i*inv_norm, q.v.j*inv_norm, q.v.k*inv_norm);
+}
+
+// Of the upper-left 3x3 block, which must be a rotation, see decompose otherwise.
+template<typename T> inline Quat<T>
+quat_from_matrix(const Mat4<T> &m)
+{
+    return quat_from_matrix(Mat3<T>(m));
+}
+
+// T * R * S
+template<typename T> inline Mat4<T>
+trs_matrix(const Vec3<T> &translation, const Quat<T> &rotation, const Vec3<T> &scale)
+{
+    const Mat3<T> r = rotation_matrix(rotation);
+    return Mat4<T>(r(0,0)*scale.x, r(0,1)*scale.y, r(0,2)*scale.z, translation.x,
+                   r(1,0)*scale.x, r(1,1)*scale.y, r(1,2)*scale.z, translation.y,
+                   r(2,0)*scale.x, r(2,1)*scale.y, r(2,2)*scale.z, translation.z,
+                   0,              0,              0,              1);
+}
+
+// Splits an affine matrix into translation, rotation and scale, with m = T * R * S when m has
+// no shear. The rotation is the orthonormal basis of the columns taken in order (Gram-Schmidt
+// from x, z = cross(x, y)), and the scales are the columns projected on it, so:
+//   - shear is dropped,
+//   - a mirroring matrix gets a negative z scale,
+//   - columns of zero length get a zero scale and an axis completed from the other ones,
+//     the identity rotation when all of them are zero.
+// The projective row is ignored.
+void decompose(const Mat4f &m, Vec3<f32> *translation, Quat<f32> *rotation, Vec3<f32> *scale);
+void decompose(const Mat4f *in, Vec3<f32> *translation, Quat<f32> *rotation, Vec3<f32> *scale, usize count);
+
+}
+
+/////////////////////////////////////////////////////////
+//
+// Dual quaternion
+//
+// Rigid transform (rotation and translation, no scale) as real + eps * dual, with the rotation
+// as the real part and dual = (0, translation) * real / 2. Unit dual quaternions compose by
+// multiplication and blend linearly (normalize after the weighted sum), which makes them the
+// transform of lt_skinning.
+//
+template<typename T>
+struct DualQuat
+{
+    Quat<T> real;
+    Quat<T> dual;
+
+    DualQuat() : real(Quat<T>::identity()), dual() {}
+    explicit DualQuat(const Quat<T> &real, const Quat<T> &dual) : real(real), dual(dual) {}
+};
+
+// Applies rhs first, like the matrices.
+template<typename T> inline DualQuat<T>
+operator*(const DualQuat<T> &lhs, const DualQuat<T> &rhs)
+{
+    return DualQuat<T>(lhs.real * rhs.real, lhs.real * rhs.dual + lhs.dual * rhs.real);
+}
+
+namespace lt
+{
+
+template<typename T> inline DualQuat<T>
+dual_quat(const Quat<T> &rotation, const Vec3<T> &translation)
+{
+    const Quat<T> t(0, translation.x, translation.y, translation.z);
+    return DualQuat<T>(rotation, (t * rotation) * static_cast<T>(0.5));
+}
+
+template<typename T> inline Vec3<T>
+dual_quat_translation(const DualQuat<T> &dq)
+{
+    const Quat<T> t = dq.dual * lt::conjugate(dq.real);
+    return Vec3<T>(2*t.v.i, 2*t.v.j, 2*t.v.k);
+}
+
+// Divides both parts by the norm of the real part.
+template<typename T> inline DualQuat<T>
+normalize(const DualQuat<T> &dq)
+{
+    const T inv_norm = 1 / lt::norm(dq.real);
+    return DualQuat<T>(dq.real * inv_norm, dq.dual * inv_norm);
+}
+
+template<typename T> inline DualQuat<T>
+conjugate(const DualQuat<T> &dq)
+{
+    return DualQuat<T>(lt::conjugate(dq.real), lt::conjugate(dq.dual));
+}
+
+// For unit dual quaternions.
+template<typename T> inline Vec3<T>
+transform_direction(const DualQuat<T> &dq, const Vec3<T> &v)
+{
+    const Vec3<T> &r = dq.real.v;
+    const Vec3<T> a = lt::cross(r, v) + Vec3<T>(dq.real.s*v.x, dq.real.s*v.y, dq.real.s*v.z);
+    const Vec3<T> b = lt::cross(r, a);
+    return Vec3<T>(v.x + 2*b.x, v.y + 2*b.y, v.z + 2*b.z);
+}
+
+template<typename T> inline Vec3<T>
+transform_point(const DualQuat<T> &dq, const Vec3<T> &p)
+{
+    return transform_direction(dq, p) + dual_quat_translation(dq);
+}
+
+// Rigid part of an affine matrix, see decompose.
+inline DualQuat<f32>
+dual_quat(const Mat4f &m)
+{
+    Vec3<f32> translation, scale;
+    Quat<f32> rotation;
+    decompose(m, &translation, &rotation, &scale);
+    return dual_quat(rotation, translation);
+}
+
+}
+
 typedef Vec2<i32> Vec2i;
 typedef Vec2<f32> Vec2f;
 typedef Vec3<i32> Vec3i;
 typedef Vec3<f32> Vec3f;
+typedef Vec3<f64> Vec3d;
 typedef Vec4<i32> Vec4i;
 typedef Vec4<f32> Vec4f;
+typedef Vec4<f64> Vec4d;
 typedef Quat<f32> Quatf;
 typedef Quat<f64> Quatd;
+typedef DualQuat<f32> DualQuatf;
+typedef DualQuat<f64> DualQuatd;
 
 #endif // LT_MATH_HPP
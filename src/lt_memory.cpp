@@ -0,0 +1,381 @@
+#include "lt_memory.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+lt_global_variable const char *g_tag_names[MemoryTag_Count] = {
+    "General",
+    "File",
+    "Logging",
+    "Math",
+    "Geometry",
+    "Spatial",
+    "Animation",
+    "Ecs",
+};
+
+const char *
+lt::memory_tag_name(MemoryTag tag)
+{
+    return (tag >= 0 && tag < MemoryTag_Count) ? g_tag_names[tag] : "Unknown";
+}
+
+#if LT_MEMORY_TRACKING
+
+#define MEMORY_SHARDS    64
+#define MEMORY_ALIGNMENT 16
+
+struct alignas(MEMORY_ALIGNMENT) AllocHeader
+{
+    AllocHeader *prev;
+    AllocHeader *next;
+    const char  *file;
+    u64          size;
+    u32          line;
+    u16          tag;
+    u16          offset;  // From the start of the block to the user pointer.
+};
+
+struct alignas(LT_CACHE_LINE_SIZE) MemoryShard
+{
+    std::atomic<bool> locked{false};
+    AllocHeader      *head = nullptr;
+};
+
+// Written only by the owning thread, read by memory_stats.
+struct MemoryThreadCounters
+{
+    std::atomic<i64>      current_bytes[MemoryTag_Count];
+    std::atomic<i64>      current_count[MemoryTag_Count];
+    std::atomic<u64>      total_allocations[MemoryTag_Count];
+    std::atomic<u64>      total_bytes[MemoryTag_Count];
+    std::atomic<u64>      histogram[MemoryTag_Count][LT_MEMORY_HISTOGRAM_BUCKETS];
+    i64                   pending[MemoryTag_Count];
+    MemoryThreadCounters *next;
+};
+
+lt_global_variable MemoryShard g_shards[MEMORY_SHARDS];
+lt_global_variable std::atomic<MemoryThreadCounters*> g_threads{nullptr};
+lt_global_variable std::atomic<i64> g_shared_bytes[MemoryTag_Count];
+lt_global_variable std::atomic<i64> g_shared_peak[MemoryTag_Count];
+lt_global_variable std::atomic<i64> g_shared_total{0};
+lt_global_variable std::atomic<i64> g_shared_total_peak{0};
+
+lt_internal inline void
+atomic_max(std::atomic<i64> &a, i64 v)
+{
+    i64 cur = a.load(std::memory_order_relaxed);
+    while (v > cur && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+
+// Single writer, so a plain load and store is enough.
+template<typename T> lt_internal inline void
+bump(std::atomic<T> &a, T delta)
+{
+    a.store(a.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+lt_internal void
+flush_pending(MemoryThreadCounters *counters, i32 tag)
+{
+    const i64 delta = counters->pending[tag];
+    counters->pending[tag] = 0;
+    atomic_max(g_shared_peak[tag], g_shared_bytes[tag].fetch_add(delta, std::memory_order_relaxed) + delta);
+    atomic_max(g_shared_total_peak, g_shared_total.fetch_add(delta, std::memory_order_relaxed) + delta);
+}
+
+struct MemoryThreadSlot
+{
+    MemoryThreadCounters *counters = nullptr;
+
+    ~MemoryThreadSlot()
+    {
+        if (!counters) return;
+        for (i32 tag = 0; tag < MemoryTag_Count; tag++) flush_pending(counters, tag);
+    }
+};
+
+lt_internal thread_local MemoryThreadSlot t_slot;
+
+// Counters outlive their thread: memory_stats keeps adding them up, and memory freed later
+// by another thread is subtracted from that thread's counters instead.
+lt_internal MemoryThreadCounters *
+thread_counters()
+{
+    MemoryThreadCounters *counters = t_slot.counters;
+    if (counters) return counters;
+
+    counters = (MemoryThreadCounters*)calloc(1, sizeof(MemoryThreadCounters));
+    if (!counters)
+    {
+        LT_Panic("Failed allocating memory\n");
+    }
+    counters->next = g_threads.load(std::memory_order_relaxed);
+    while (!g_threads.compare_exchange_weak(counters->next, counters, std::memory_order_release,
+                                            std::memory_order_relaxed)) {}
+    t_slot.counters = counters;
+    return counters;
+}
+
+lt_internal inline u32
+histogram_bucket(usize size)
+{
+    if (size < 2) return 0;
+    const u32 b = 63 - (u32)__builtin_clzll((u64)size);
+    return (b < LT_MEMORY_HISTOGRAM_BUCKETS) ? b : LT_MEMORY_HISTOGRAM_BUCKETS - 1;
+}
+
+lt_internal void
+record(MemoryTag tag, i64 bytes, bool allocated)
+{
+    MemoryThreadCounters *counters = thread_counters();
+    bump(counters->current_bytes[tag], bytes);
+    bump(counters->current_count[tag], allocated ? (i64)1 : (i64)-1);
+    if (allocated)
+    {
+        bump(counters->total_allocations[tag], (u64)1);
+        bump(counters->total_bytes[tag], (u64)bytes);
+        bump(counters->histogram[tag][histogram_bucket((usize)bytes)], (u64)1);
+    }
+
+    counters->pending[tag] += bytes;
+    if (LT_Abs(counters->pending[tag]) >= (i64)LT_MEMORY_FLUSH_BYTES) flush_pending(counters, tag);
+}
+
+lt_internal inline MemoryShard &
+shard_of(const AllocHeader *h)
+{
+    return g_shards[((uintptr_t)h / sizeof(AllocHeader)) % MEMORY_SHARDS];
+}
+
+lt_internal inline void
+shard_lock(MemoryShard &shard)
+{
+    while (shard.locked.exchange(true, std::memory_order_acquire))
+        while (shard.locked.load(std::memory_order_relaxed)) lt::cpu_relax();
+}
+
+lt_internal inline void
+shard_unlock(MemoryShard &shard)
+{
+    shard.locked.store(false, std::memory_order_release);
+}
+
+lt_internal void
+link(AllocHeader *h)
+{
+    MemoryShard &shard = shard_of(h);
+    shard_lock(shard);
+    h->prev = nullptr;
+    h->next = shard.head;
+    if (shard.head) shard.head->prev = h;
+    shard.head = h;
+    shard_unlock(shard);
+}
+
+lt_internal void
+unlink(AllocHeader *h)
+{
+    MemoryShard &shard = shard_of(h);
+    shard_lock(shard);
+    if (h->prev) h->prev->next = h->next;
+    else shard.head = h->next;
+    if (h->next) h->next->prev = h->prev;
+    shard_unlock(shard);
+}
+
+lt_internal inline usize
+header_size(usize alignment)
+{
+    return (sizeof(AllocHeader) + alignment - 1) & ~(alignment - 1);
+}
+
+void *
+lt::tracked_alloc(usize size, usize alignment, bool zero, MemoryTag tag, const char *file, int line)
+{
+    if (alignment < MEMORY_ALIGNMENT) alignment = MEMORY_ALIGNMENT;
+    LT_Assert((alignment & (alignment - 1)) == 0 && alignment <= 32768);
+
+    const usize offset = header_size(alignment);
+    char *block = (alignment == MEMORY_ALIGNMENT)
+        ? (char*)malloc(offset + size)
+        : (char*)aligned_alloc(alignment, (offset + size + alignment - 1) & ~(alignment - 1));
+    if (!block) return NULL;
+
+    char *user = block + offset;
+    AllocHeader *h = (AllocHeader*)user - 1;
+    h->file = file;
+    h->line = (u32)line;
+    h->size = size;
+    h->tag = (u16)tag;
+    h->offset = (u16)offset;
+    if (zero) memset(user, 0, size);
+
+    link(h);
+    record(tag, (i64)size, true);
+    return user;
+}
+
+void *
+lt::tracked_realloc(void *p, usize size, MemoryTag tag, const char *file, int line)
+{
+    if (!p) return tracked_alloc(size, 0, false, tag, file, line);
+
+    AllocHeader *h = (AllocHeader*)p - 1;
+    LT_Assert(h->offset == header_size(MEMORY_ALIGNMENT));
+    const usize offset = h->offset;
+    const MemoryTag old_tag = (MemoryTag)h->tag;
+    const usize old_size = h->size;
+
+    unlink(h);
+    char *block = (char*)realloc((char*)p - offset, offset + size);
+    if (!block)
+    {
+        link(h);
+        return NULL;
+    }
+
+    h = (AllocHeader*)(block + offset) - 1;
+    h->file = file;
+    h->line = (u32)line;
+    h->size = size;
+    h->tag = (u16)tag;
+    link(h);
+
+    record(old_tag, -(i64)old_size, false);
+    record(tag, (i64)size, true);
+    return block + offset;
+}
+
+void
+lt::tracked_free(void *p)
+{
+    if (!p) return;
+    AllocHeader *h = (AllocHeader*)p - 1;
+    unlink(h);
+    record((MemoryTag)h->tag, -(i64)h->size, false);
+    free((char*)p - h->offset);
+}
+
+void
+lt::memory_stats(MemoryStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (MemoryThreadCounters *c = g_threads.load(std::memory_order_acquire); c; c = c->next)
+    {
+        for (i32 tag = 0; tag < MemoryTag_Count; tag++)
+        {
+            MemoryTagStats &t = stats->tags[tag];
+            t.current_bytes += c->current_bytes[tag].load(std::memory_order_relaxed);
+            t.current_count += c->current_count[tag].load(std::memory_order_relaxed);
+            t.total_allocations += c->total_allocations[tag].load(std::memory_order_relaxed);
+            t.total_bytes += c->total_bytes[tag].load(std::memory_order_relaxed);
+            for (i32 b = 0; b < LT_MEMORY_HISTOGRAM_BUCKETS; b++)
+                t.histogram[b] += c->histogram[tag][b].load(std::memory_order_relaxed);
+        }
+    }
+
+    for (i32 tag = 0; tag < MemoryTag_Count; tag++)
+    {
+        MemoryTagStats &t = stats->tags[tag];
+        t.peak_bytes = std::max(g_shared_peak[tag].load(std::memory_order_relaxed), t.current_bytes);
+        stats->current_bytes += t.current_bytes;
+    }
+    stats->peak_bytes = std::max(g_shared_total_peak.load(std::memory_order_relaxed), stats->current_bytes);
+}
+
+void
+lt::memory_report(FILE *out)
+{
+    MemoryStats stats;
+    memory_stats(&stats);
+    fprintf(out, "[memory] current %lld bytes, peak %lld bytes\n",
+            (long long)stats.current_bytes, (long long)stats.peak_bytes);
+
+    for (i32 tag = 0; tag < MemoryTag_Count; tag++)
+    {
+        const MemoryTagStats &t = stats.tags[tag];
+        if (t.total_allocations == 0) continue;
+
+        fprintf(out, "[memory] %-10s current %lld bytes in %lld, peak %lld bytes, total %llu bytes in %llu\n",
+                g_tag_names[tag], (long long)t.current_bytes, (long long)t.current_count,
+                (long long)t.peak_bytes, (unsigned long long)t.total_bytes,
+                (unsigned long long)t.total_allocations);
+        fprintf(out, "[memory] %-10s sizes", "");
+        for (i32 b = 0; b < LT_MEMORY_HISTOGRAM_BUCKETS; b++)
+            if (t.histogram[b]) fprintf(out, " 2^%d:%llu", b, (unsigned long long)t.histogram[b]);
+        fprintf(out, "\n");
+    }
+}
+
+usize
+lt::memory_dump_leaks(FILE *out)
+{
+    struct Leak
+    {
+        const void *ptr;
+        const char *file;
+        u64         size;
+        u32         line;
+        u16         tag;
+    };
+
+    std::vector<Leak> leaks;
+    for (MemoryShard &shard : g_shards)
+    {
+        shard_lock(shard);
+        for (const AllocHeader *h = shard.head; h; h = h->next)
+            leaks.push_back(Leak{h + 1, h->file, h->size, h->line, h->tag});
+        shard_unlock(shard);
+    }
+
+    std::sort(leaks.begin(), leaks.end(), [](const Leak &a, const Leak &b) { return a.size > b.size; });
+    for (const Leak &leak : leaks)
+    {
+        fprintf(out, "[memory] leak: %llu bytes, %s, %s:%u (%p)\n", (unsigned long long)leak.size,
+                g_tag_names[leak.tag], leak.file, leak.line, leak.ptr);
+    }
+    return leaks.size();
+}
+
+// Runs after main returns. Memory released by other static destructors that run later is
+// reported as well.
+struct MemoryLeakCheck
+{
+    ~MemoryLeakCheck()
+    {
+        MemoryStats stats;
+        lt::memory_stats(&stats);
+        i64 count = 0;
+        for (const MemoryTagStats &t : stats.tags) count += t.current_count;
+        if (count == 0) return;
+        fprintf(stderr, "[memory] %lld allocations (%lld bytes) still live at exit\n", (long long)count,
+                (long long)stats.current_bytes);
+        lt::memory_dump_leaks(stderr);
+    }
+};
+
+lt_global_variable MemoryLeakCheck g_leak_check;
+
+#else
+
+void
+lt::memory_stats(MemoryStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+void
+lt::memory_report(FILE *out)
+{
+    fprintf(out, "[memory] tracking disabled, build with LT_MEMORY_TRACKING\n");
+}
+
+usize
+lt::memory_dump_leaks(FILE *)
+{
+    return 0;
+}
+
+#endif // LT_MEMORY_TRACKING
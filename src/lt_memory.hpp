@@ -0,0 +1,69 @@
+#ifndef LT_MEMORY_HPP
+#define LT_MEMORY_HPP
+
+#include <cstdio>
+#include "lt_core.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Memory tracking
+//
+// Statistics for the allocations made through LT_Malloc and friends (see lt_core.hpp), kept
+// per MemoryTag. Only active when LT_MEMORY_TRACKING is defined for the whole build; otherwise
+// the macros are the plain C allocator and these functions report nothing.
+//
+// Each thread counts its own allocations without atomic read-modify-writes, and
+// memory_stats adds the threads up. High-water marks come from shared totals that every
+// thread updates in batches, so they can trail the true peak by up to
+// LT_MEMORY_FLUSH_BYTES per thread. Live allocations are kept in lists behind sharded
+// spinlocks for the leak report, which is also printed to stderr at exit when anything is
+// still allocated.
+//
+
+#define LT_MEMORY_HISTOGRAM_BUCKETS 32
+#define LT_MEMORY_FLUSH_BYTES       Kilobytes(64)
+
+struct MemoryTagStats
+{
+    i64 current_bytes;
+    i64 current_count;
+    i64 peak_bytes;
+    u64 total_allocations;
+    u64 total_bytes;
+    // Bucket i counts allocations of [2^i, 2^(i+1)) bytes, bucket 0 includes empty ones and
+    // the last bucket everything larger.
+    u64 histogram[LT_MEMORY_HISTOGRAM_BUCKETS];
+};
+
+struct MemoryStats
+{
+    MemoryTagStats tags[MemoryTag_Count];
+    i64            current_bytes;
+    i64            peak_bytes;
+};
+
+namespace lt
+{
+
+constexpr bool memory_tracking_enabled()
+{
+#if LT_MEMORY_TRACKING
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char *memory_tag_name(MemoryTag tag);
+
+void memory_stats(MemoryStats *stats);
+// Prints one line per tag with current, peak and total usage, and the non-empty histogram
+// buckets.
+void memory_report(FILE *out);
+// Prints every live allocation with its tag, size and allocation site, largest first. Returns
+// the number of live allocations.
+usize memory_dump_leaks(FILE *out);
+
+}
+
+#endif // LT_MEMORY_HPP
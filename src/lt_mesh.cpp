@@ -0,0 +1,1436 @@
+#include "lt_mesh.hpp"
+#include "lt_format.hpp"
+#include "lt_parallel.hpp"
+#include "lt_perf.hpp"
+#include "lt_scan.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#if LT_PLATFORM_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define LT_MESH_NONE 0xffffffffu
+
+lt_internal bool
+mesh_fail(Mesh *mesh, MeshError error)
+{
+    lt::mesh_destroy(mesh);
+    mesh->error = error;
+    return false;
+}
+
+// The options that work on the loaded mesh, the same for every format.
+lt_internal bool
+mesh_finish_load(Mesh *mesh, const MeshLoadOptions &options)
+{
+    if (options.optimize_vertex_cache && !lt::mesh_optimize_vertex_cache(mesh)) return mesh_fail(mesh, MeshError_Memory);
+    return true;
+}
+
+lt_internal inline usize
+padded_size(usize count, usize element_size)
+{
+    return (count * element_size + LT_MESH_ALIGNMENT - 1) & ~(usize)(LT_MESH_ALIGNMENT - 1);
+}
+
+// Carves the streams out of a single allocation and clears their padding.
+lt_internal bool
+mesh_allocate(Mesh *mesh, u32 num_vertices, u32 num_indices, bool normals, bool uvs)
+{
+    const usize stream_size = padded_size(num_vertices, sizeof(f32));
+    const usize index_size = padded_size(num_indices, sizeof(u32));
+    const usize num_streams = 3 + (normals ? 3 : 0) + (uvs ? 2 : 0);
+    usize size = num_streams * stream_size + index_size;
+    if (size == 0) size = LT_MESH_ALIGNMENT;
+
+    u8 *p = (u8*)LT_AlignedAlloc(LT_MESH_ALIGNMENT, size, MemoryTag_Geometry);
+    if (!p) return false;
+
+    f32 **streams[8] = {&mesh->x, &mesh->y, &mesh->z, &mesh->nx, &mesh->ny, &mesh->nz, &mesh->u, &mesh->v};
+    usize offset = 0;
+    for (i32 s = 0; s < 8; s++)
+    {
+        if ((s >= 3 && s < 6 && !normals) || (s >= 6 && !uvs)) continue;
+        *streams[s] = (f32*)(p + offset);
+        memset(*streams[s] + num_vertices, 0, stream_size - num_vertices * sizeof(f32));
+        offset += stream_size;
+    }
+    mesh->indices = (u32*)(p + offset);
+    memset(mesh->indices + num_indices, 0, index_size - num_indices * sizeof(u32));
+
+    mesh->storage = p;
+    mesh->num_vertices = num_vertices;
+    mesh->num_indices = num_indices;
+    return true;
+}
+
+lt_internal inline const char *
+skip_blanks(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+// Number after optional blanks and '+'. Null when there is none.
+lt_internal inline const char *
+parse_text_f64(const char *p, const char *end, f64 *value)
+{
+    p = skip_blanks(p, end);
+    if (p < end && *p == '+') p++;
+    const char *next = lt::parse_f64(p, end, value);
+    return (next != p) ? next : nullptr;
+}
+
+lt_internal inline const char *
+parse_text_f32(const char *p, const char *end, f32 *value)
+{
+    p = skip_blanks(p, end);
+    if (p < end && *p == '+') p++;
+    const char *next = lt::parse_f32(p, end, value);
+    return (next != p) ? next : nullptr;
+}
+
+/////////////////////////////////////////////////////////
+//
+// OBJ
+//
+// Every chunk of text is parsed into its own arrays. Face indices are stored 0-based, except
+// negative ones: those are relative to what the chunk had read so far and are tagged with
+// LT_OBJ_RELATIVE until the counts of the chunks before are known.
+//
+// Vertices are the distinct (v, vt, vn) corners. Each position keeps a chain of the (vt, vn)
+// pairs it was used with, a thread owns a range of positions, and vertices are numbered in
+// order of first use, so the result does not depend on the number of threads. When no face
+// references a normal or a texcoord the vertices are the positions and there is nothing to
+// deduplicate.
+//
+
+#define LT_OBJ_RELATIVE      0x80000000u
+#define LT_OBJ_RELATIVE_BIAS 0x40000000
+
+struct ObjCorner
+{
+    u32 v, t, n;
+};
+
+struct ObjChunk
+{
+    std::vector<f32>       positions;   // x, y, z
+    std::vector<f32>       normals;     // x, y, z
+    std::vector<f32>       texcoords;   // u, v
+    std::vector<ObjCorner> corners;     // 3 per triangle.
+    bool                   has_normals = false;   // Some corner references a normal.
+    bool                   has_uvs = false;
+    MeshError              error = MeshError_None;
+    // Counts of the chunks before.
+    usize                  base_position = 0;
+    usize                  base_normal = 0;
+    usize                  base_texcoord = 0;
+    usize                  base_corner = 0;
+};
+
+lt_internal bool
+parse_obj_floats(const char *p, const char *end, u32 required, u32 count, std::vector<f32> *out)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        f32 value = 0;
+        const char *next = p ? parse_text_f32(p, end, &value) : nullptr;
+        if (!next && i < required) return false;
+        p = next;
+        out->push_back(value);
+    }
+    return true;
+}
+
+// `count` is the number of elements the chunk has read so far.
+lt_internal inline bool
+encode_obj_index(i64 index, usize count, u32 *out)
+{
+    if (index > 0 && index <= (i64)LT_OBJ_RELATIVE - 1)
+    {
+        *out = (u32)(index - 1);
+        return true;
+    }
+    if (index < 0 && index >= -(i64)LT_OBJ_RELATIVE_BIAS && count < (usize)LT_OBJ_RELATIVE_BIAS)
+    {
+        *out = LT_OBJ_RELATIVE | (u32)((i64)count + index + LT_OBJ_RELATIVE_BIAS);
+        return true;
+    }
+    return false;
+}
+
+// Reads up to 8 digits at once when 8 bytes are readable: the digits are found with byte-wise
+// range checks on a u64 and converted with three multiplies that each merge pairs of lanes.
+// Returns the end of the digits.
+lt_internal inline const char *
+parse_digits(const char *p, const char *end, u64 *value)
+{
+    u64 result = 0;
+    while (end - p >= 8)
+    {
+        u64 chunk;
+        memcpy(&chunk, p, sizeof(chunk));
+        const u64 high = chunk & 0xF0F0F0F0F0F0F0F0ull;
+        const u64 carry = (chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull;
+        const u64 other = (high ^ 0x3030303030303030ull) | (carry ^ 0x3030303030303030ull);
+        const u64 other_bytes = (((other & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full) | other) & 0x8080808080808080ull;
+        const u32 len = other_bytes ? (u32)__builtin_ctzll(other_bytes) >> 3 : 8;
+        if (len == 0) break;
+
+        u64 digits = (chunk - 0x3030303030303030ull) << (8 * (8 - len));
+        digits = ((digits & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+        digits = ((digits & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+        digits = ((digits & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32;
+
+        lt_local_persist const u64 scale[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+        result = result * scale[len] + digits;
+        p += len;
+        if (len < 8 || result >= 100000000000ull) break;
+    }
+    for (; p < end && (u32)(*p - '0') < 10 && result < 100000000000ull; p++) result = 10 * result + (u32)(*p - '0');
+    *value = result;
+    return p;
+}
+
+// Faces are most of an OBJ file, their indices are read inline rather than with parse_i64.
+// Null when there is no index or it is out of range.
+lt_internal inline const char *
+parse_obj_index(const char *p, const char *end, usize count, u32 *out)
+{
+    const bool negative = p < end && *p == '-';
+    const char *digits = p + negative;
+    u64 value;
+    const char *q = parse_digits(digits, end, &value);
+    if (q == digits || (q < end && (u32)(*q - '0') < 10)) return nullptr;
+    if (!encode_obj_index(negative ? -(i64)value : (i64)value, count, out)) return nullptr;
+    return q;
+}
+
+// Corners v, v/vt, v//vn or v/vt/vn. Polygons are cut into fans, faces of less than three
+// corners are skipped.
+lt_internal bool
+parse_obj_face(ObjChunk *chunk, const char *p, const char *end, const MeshLoadOptions &options)
+{
+    ObjCorner first = {}, prev = {};
+    u32 num_corners = 0;
+    for (;;)
+    {
+        p = skip_blanks(p, end);
+        if (p == end) break;
+
+        ObjCorner c = {LT_MESH_NONE, LT_MESH_NONE, LT_MESH_NONE};
+        p = parse_obj_index(p, end, chunk->positions.size() / 3, &c.v);
+        if (!p) return false;
+        if (p < end && *p == '/')
+        {
+            p++;
+            if (p < end && *p != '/')
+            {
+                p = parse_obj_index(p, end, chunk->texcoords.size() / 2, &c.t);
+                if (!p) return false;
+            }
+            if (p < end && *p == '/')
+            {
+                p = parse_obj_index(p + 1, end, chunk->normals.size() / 3, &c.n);
+                if (!p) return false;
+            }
+        }
+        if (p < end && *p != ' ' && *p != '\t') return false;
+
+        if (!options.uvs) c.t = LT_MESH_NONE;
+        if (!options.normals) c.n = LT_MESH_NONE;
+        chunk->has_uvs |= c.t != LT_MESH_NONE;
+        chunk->has_normals |= c.n != LT_MESH_NONE;
+
+        if (num_corners == 0) first = c;
+        else if (num_corners >= 2)
+        {
+            chunk->corners.push_back(first);
+            chunk->corners.push_back(prev);
+            chunk->corners.push_back(c);
+        }
+        prev = c;
+        num_corners++;
+    }
+    return true;
+}
+
+lt_internal bool
+parse_obj_line(ObjChunk *chunk, const char *p, const char *end, const MeshLoadOptions &options)
+{
+    p = skip_blanks(p, end);
+    if (end - p < 2) return true;
+
+    const bool blank = p[1] == ' ' || p[1] == '\t';
+    if (p[0] == 'f' && blank) return parse_obj_face(chunk, p + 2, end, options);
+    if (p[0] != 'v') return true;
+    if (blank) return parse_obj_floats(p + 2, end, 3, 3, &chunk->positions);
+
+    if (end - p < 3 || (p[2] != ' ' && p[2] != '\t')) return true;
+    if (p[1] == 'n') return !options.normals || parse_obj_floats(p + 3, end, 3, 3, &chunk->normals);
+    if (p[1] == 't') return !options.uvs || parse_obj_floats(p + 3, end, 1, 2, &chunk->texcoords);
+    return true;
+}
+
+lt_internal void
+parse_obj_chunk(ObjChunk *chunk, TextChunk text, const MeshLoadOptions &options)
+{
+    lt::scan_records(text.begin, (usize)(text.end - text.begin), ScanOptions(), [&](const char *line, usize len) {
+        if (chunk->error == MeshError_None && !parse_obj_line(chunk, line, line + len, options))
+            chunk->error = MeshError_Format;
+    });
+}
+
+// Turns a chunk index into a file index and checks it. Missing indices stay LT_MESH_NONE.
+lt_internal inline bool
+resolve_obj_index(u32 *index, usize base, usize count)
+{
+    if (*index == LT_MESH_NONE) return true;
+    i64 value = (i64)*index;
+    if (*index & LT_OBJ_RELATIVE) value = (i64)base + (i64)(*index & ~LT_OBJ_RELATIVE) - LT_OBJ_RELATIVE_BIAS;
+    if (value < 0 || value >= (i64)count) return false;
+    *index = (u32)value;
+    return true;
+}
+
+// Vertex of a position: the (vt, vn) pair of its first corner. Every position has a chain of
+// them, usually a single one.
+struct CornerVertex
+{
+    u32 t, n;
+    u32 next;     // In the same partition, LT_MESH_NONE ends the chain.
+    u32 corner;   // First use.
+};
+
+// Deduplicates the corners into the mesh vertices. The attribute arrays are those of the
+// whole file, interleaved.
+lt_internal bool
+build_obj_vertices(Mesh *mesh, const std::vector<ObjCorner> &corners, const std::vector<f32> &positions,
+                   const std::vector<f32> &normals, const std::vector<f32> &texcoords, bool has_normals, bool has_uvs)
+{
+    const usize n = corners.size();
+    const usize num_positions = positions.size() / 3;
+    const u32 num_partitions = (lt::worker_count() < 256) ? lt::worker_count() : 256;
+    const usize positions_per_partition = num_positions / num_partitions + 1;
+
+    // Partitions own contiguous ranges of positions, so the chain heads they touch are close
+    // together when the faces are. Every partition walks the partition bytes of all corners.
+    std::vector<u8> partition((num_partitions > 1) ? n : 0);
+    lt::parallel_for(partition.size(), 1 << 16, [&](usize begin, usize end) {
+        for (usize c = begin; c < end; c++) partition[c] = (u8)(corners[c].v / positions_per_partition);
+    });
+
+    std::vector<u32> head(num_positions, LT_MESH_NONE);
+    std::vector<std::vector<CornerVertex>> vertices(num_partitions);
+    std::vector<u32> first_use(n);
+    lt::parallel_for(num_partitions, 1, [&](usize begin, usize end) {
+        for (usize p = begin; p < end; p++)
+        {
+            std::vector<CornerVertex> *list = &vertices[p];
+            list->reserve(num_positions / num_partitions + 1);
+            for (usize c = 0; c < n; c++)
+            {
+                if (num_partitions > 1 && partition[c] != p) continue;
+                const ObjCorner k = corners[c];
+                u32 i = head[k.v];
+                while (i != LT_MESH_NONE && ((*list)[i].t != k.t || (*list)[i].n != k.n)) i = (*list)[i].next;
+                if (i == LT_MESH_NONE)
+                {
+                    list->push_back(CornerVertex{k.t, k.n, head[k.v], (u32)c});
+                    head[k.v] = (u32)list->size() - 1;
+                    first_use[c] = (u32)c;
+                }
+                else first_use[c] = (*list)[i].corner;
+            }
+        }
+    });
+
+    usize num_vertices = 0;
+    for (const std::vector<CornerVertex> &list : vertices) num_vertices += list.size();
+    if (!mesh_allocate(mesh, (u32)num_vertices, (u32)n, has_normals, has_uvs)) return false;
+
+    // Vertices are numbered by their first corner: a count per block, then the prefix sum.
+    const usize block = 1 << 16;
+    const usize num_blocks = (n + block - 1) / block;
+    std::vector<u32> block_base(num_blocks + 1, 0);
+    lt::parallel_for(num_blocks, 1, [&](usize begin, usize end) {
+        for (usize b = begin; b < end; b++)
+        {
+            u32 count = 0;
+            for (usize c = b * block; c < n && c < (b + 1) * block; c++) count += first_use[c] == c;
+            block_base[b + 1] = count;
+        }
+    });
+    for (usize b = 0; b < num_blocks; b++) block_base[b + 1] += block_base[b];
+
+    lt::parallel_for(num_blocks, 1, [&](usize begin, usize end) {
+        for (usize b = begin; b < end; b++)
+        {
+            u32 vertex = block_base[b];
+            for (usize c = b * block; c < n && c < (b + 1) * block; c++)
+            {
+                if (first_use[c] != c) continue;
+                const ObjCorner k = corners[c];
+                mesh->indices[c] = vertex;
+                mesh->x[vertex] = positions[3 * (usize)k.v];
+                mesh->y[vertex] = positions[3 * (usize)k.v + 1];
+                mesh->z[vertex] = positions[3 * (usize)k.v + 2];
+                if (has_normals)
+                {
+                    const bool valid = k.n != LT_MESH_NONE;
+                    mesh->nx[vertex] = valid ? normals[3 * (usize)k.n] : 0;
+                    mesh->ny[vertex] = valid ? normals[3 * (usize)k.n + 1] : 0;
+                    mesh->nz[vertex] = valid ? normals[3 * (usize)k.n + 2] : 0;
+                }
+                if (has_uvs)
+                {
+                    const bool valid = k.t != LT_MESH_NONE;
+                    mesh->u[vertex] = valid ? texcoords[2 * (usize)k.t] : 0;
+                    mesh->v[vertex] = valid ? texcoords[2 * (usize)k.t + 1] : 0;
+                }
+                vertex++;
+            }
+        }
+    });
+
+    // The other corners take the vertex of their first use, numbered by the pass before.
+    lt::parallel_for(n, block, [&](usize begin, usize end) {
+        for (usize c = begin; c < end; c++)
+            if (first_use[c] != c) mesh->indices[c] = mesh->indices[first_use[c]];
+    });
+    return true;
+}
+
+lt_internal bool
+load_obj(Mesh *mesh, const char *data, usize size, const MeshLoadOptions &options)
+{
+    LT_PERF_SCOPE("mesh_load_obj", size);
+    *mesh = Mesh();
+
+    usize max_chunks = size / (options.min_chunk_size > 0 ? options.min_chunk_size : 1);
+    if (max_chunks > lt::worker_count()) max_chunks = lt::worker_count();
+    if (max_chunks == 0) max_chunks = 1;
+
+    std::vector<TextChunk> text(max_chunks);
+    const usize num_chunks = lt::scan_split(data, size, ScanOptions(), text.data(), max_chunks);
+    std::vector<ObjChunk> chunks(num_chunks);
+    lt::parallel_for(num_chunks, 1, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) parse_obj_chunk(&chunks[i], text[i], options);
+    });
+
+    usize num_positions = 0, num_normals = 0, num_texcoords = 0, num_corners = 0;
+    bool has_normals = false, has_uvs = false;
+    for (ObjChunk &c : chunks)
+    {
+        if (c.error != MeshError_None) return mesh_fail(mesh, c.error);
+        c.base_position = num_positions;
+        c.base_normal = num_normals;
+        c.base_texcoord = num_texcoords;
+        c.base_corner = num_corners;
+        num_positions += c.positions.size() / 3;
+        num_normals += c.normals.size() / 3;
+        num_texcoords += c.texcoords.size() / 2;
+        num_corners += c.corners.size();
+        has_normals |= c.has_normals;
+        has_uvs |= c.has_uvs;
+    }
+    if (num_positions > LT_MESH_NONE - 1 || num_corners > LT_MESH_NONE - 1) return mesh_fail(mesh, MeshError_Unsupported);
+
+    auto resolve = [&](ObjChunk *c, ObjCorner *k) {
+        return resolve_obj_index(&k->v, c->base_position, num_positions) &&
+               resolve_obj_index(&k->n, c->base_normal, num_normals) &&
+               resolve_obj_index(&k->t, c->base_texcoord, num_texcoords);
+    };
+    std::vector<u8> index_error(num_chunks, 0);
+
+    if (!has_normals && !has_uvs)
+    {
+        // The positions are the vertices.
+        if (!mesh_allocate(mesh, (u32)num_positions, (u32)num_corners, false, false))
+            return mesh_fail(mesh, MeshError_Memory);
+
+        lt::parallel_for(num_chunks, 1, [&](usize begin, usize end) {
+            for (usize i = begin; i < end; i++)
+            {
+                ObjChunk *c = &chunks[i];
+                const usize count = c->positions.size() / 3;
+                for (usize p = 0; p < count; p++)
+                {
+                    mesh->x[c->base_position + p] = c->positions[3*p];
+                    mesh->y[c->base_position + p] = c->positions[3*p + 1];
+                    mesh->z[c->base_position + p] = c->positions[3*p + 2];
+                }
+                u32 *indices = mesh->indices + c->base_corner;
+                for (usize k = 0; k < c->corners.size(); k++)
+                {
+                    ObjCorner corner = c->corners[k];
+                    if (!resolve(c, &corner)) index_error[i] = 1;
+                    indices[k] = corner.v;
+                }
+            }
+        });
+        for (u8 e : index_error) if (e) return mesh_fail(mesh, MeshError_Index);
+        return true;
+    }
+
+    std::vector<ObjCorner> corners(num_corners);
+    std::vector<f32> positions(3 * num_positions), normals(3 * num_normals), texcoords(2 * num_texcoords);
+    lt::parallel_for(num_chunks, 1, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++)
+        {
+            ObjChunk *c = &chunks[i];
+            for (usize k = 0; k < c->corners.size(); k++)
+            {
+                ObjCorner corner = c->corners[k];
+                if (!resolve(c, &corner)) index_error[i] = 1;
+                corners[c->base_corner + k] = corner;
+            }
+            if (!c->positions.empty()) memcpy(&positions[3 * c->base_position], c->positions.data(), c->positions.size() * sizeof(f32));
+            if (!c->normals.empty()) memcpy(&normals[3 * c->base_normal], c->normals.data(), c->normals.size() * sizeof(f32));
+            if (!c->texcoords.empty()) memcpy(&texcoords[2 * c->base_texcoord], c->texcoords.data(), c->texcoords.size() * sizeof(f32));
+            *c = ObjChunk();
+        }
+    });
+    for (u8 e : index_error) if (e) return mesh_fail(mesh, MeshError_Index);
+
+    if (!build_obj_vertices(mesh, corners, positions, normals, texcoords, has_normals, has_uvs))
+        return mesh_fail(mesh, MeshError_Memory);
+    return true;
+}
+
+bool
+lt::mesh_load_obj(Mesh *mesh, const char *data, usize size, const MeshLoadOptions &options)
+{
+    return load_obj(mesh, data, size, options) && mesh_finish_load(mesh, options);
+}
+
+/////////////////////////////////////////////////////////
+//
+// PLY
+//
+// The header describes elements made of scalar and list properties. Only the `vertex` and
+// `face` elements are read, the others are skipped. Binary vertices are converted from the
+// mapping into the streams in parallel. Faces are lists, so their records have no fixed size:
+// files where they are all triangles are checked and copied in parallel, anything else is
+// walked once to count the triangles and once to cut the fans.
+//
+// Ascii files are read with one line per record, on a single thread.
+//
+
+enum PlyType
+{
+    PlyType_None,
+    PlyType_I8,
+    PlyType_U8,
+    PlyType_I16,
+    PlyType_U16,
+    PlyType_I32,
+    PlyType_U32,
+    PlyType_F32,
+    PlyType_F64,
+
+    PlyType_Count,
+};
+
+enum PlyEncoding
+{
+    PlyEncoding_Ascii,
+    PlyEncoding_LittleEndian,
+    PlyEncoding_BigEndian,
+};
+
+enum PlyAttribute
+{
+    PlyAttribute_X,
+    PlyAttribute_Y,
+    PlyAttribute_Z,
+    PlyAttribute_NX,
+    PlyAttribute_NY,
+    PlyAttribute_NZ,
+    PlyAttribute_U,
+    PlyAttribute_V,
+
+    PlyAttribute_Count,
+};
+
+lt_global_variable const u32 g_ply_type_size[PlyType_Count] = {0, 1, 1, 2, 2, 4, 4, 4, 8};
+
+struct PlyProperty
+{
+    std::string_view name;
+    PlyType          type;
+    PlyType          count_type;   // PlyType_None for scalars.
+    u32              offset;       // In the record, for elements of fixed size.
+};
+
+struct PlyElement
+{
+    std::string_view         name;
+    u64                      count;
+    std::vector<PlyProperty> properties;
+    u32                      size;       // Bytes per record, 0 when it has lists.
+};
+
+struct PlyHeader
+{
+    PlyEncoding             encoding;
+    std::vector<PlyElement> elements;
+    usize                   body;        // Offset of the data.
+};
+
+lt_internal inline std::string_view
+next_token(const char **p, const char *end)
+{
+    const char *begin = skip_blanks(*p, end);
+    const char *e = begin;
+    while (e < end && *e != ' ' && *e != '\t') e++;
+    *p = e;
+    return std::string_view(begin, (usize)(e - begin));
+}
+
+lt_internal PlyType
+ply_type(std::string_view name)
+{
+    if (name == "char" || name == "int8") return PlyType_I8;
+    if (name == "uchar" || name == "uint8") return PlyType_U8;
+    if (name == "short" || name == "int16") return PlyType_I16;
+    if (name == "ushort" || name == "uint16") return PlyType_U16;
+    if (name == "int" || name == "int32") return PlyType_I32;
+    if (name == "uint" || name == "uint32") return PlyType_U32;
+    if (name == "float" || name == "float32") return PlyType_F32;
+    if (name == "double" || name == "float64") return PlyType_F64;
+    return PlyType_None;
+}
+
+lt_internal i32
+ply_attribute(std::string_view name)
+{
+    if (name == "x") return PlyAttribute_X;
+    if (name == "y") return PlyAttribute_Y;
+    if (name == "z") return PlyAttribute_Z;
+    if (name == "nx") return PlyAttribute_NX;
+    if (name == "ny") return PlyAttribute_NY;
+    if (name == "nz") return PlyAttribute_NZ;
+    if (name == "u" || name == "s" || name == "texture_u" || name == "texture_s") return PlyAttribute_U;
+    if (name == "v" || name == "t" || name == "texture_v" || name == "texture_t") return PlyAttribute_V;
+    return -1;
+}
+
+lt_internal MeshError
+parse_ply_header(const char *data, usize size, PlyHeader *header)
+{
+    const char *end = data + size;
+    const char *p = data;
+    bool has_format = false;
+    for (u32 line_number = 0;; line_number++)
+    {
+        if (p >= end) return MeshError_Format;
+        const char *line_end = lt::scan_find(p, end, '\n');
+        const char *next = (line_end < end) ? line_end + 1 : end;
+        if (line_end > p && line_end[-1] == '\r') line_end--;
+
+        const char *q = p;
+        const std::string_view keyword = next_token(&q, line_end);
+        p = next;
+
+        if (line_number == 0)
+        {
+            if (keyword != "ply") return MeshError_Format;
+            continue;
+        }
+
+        if (keyword == "end_header")
+        {
+            header->body = (usize)(p - data);
+            return has_format ? MeshError_None : MeshError_Format;
+        }
+        if (keyword == "format")
+        {
+            const std::string_view encoding = next_token(&q, line_end);
+            if (encoding == "ascii") header->encoding = PlyEncoding_Ascii;
+            else if (encoding == "binary_little_endian") header->encoding = PlyEncoding_LittleEndian;
+            else if (encoding == "binary_big_endian") header->encoding = PlyEncoding_BigEndian;
+            else return MeshError_Format;
+            has_format = true;
+        }
+        else if (keyword == "element")
+        {
+            PlyElement element = {};
+            element.name = next_token(&q, line_end);
+            const std::string_view count = next_token(&q, line_end);
+            if (lt::parse_u64(count.data(), count.data() + count.size(), &element.count) != count.data() + count.size() ||
+                count.empty())
+                return MeshError_Format;
+            header->elements.push_back(element);
+        }
+        else if (keyword == "property")
+        {
+            if (header->elements.empty()) return MeshError_Format;
+            PlyElement *element = &header->elements.back();
+            PlyProperty property = {};
+            std::string_view type = next_token(&q, line_end);
+            if (type == "list")
+            {
+                property.count_type = ply_type(next_token(&q, line_end));
+                type = next_token(&q, line_end);
+                if (property.count_type == PlyType_None || property.count_type >= PlyType_F32) return MeshError_Format;
+            }
+            property.type = ply_type(type);
+            property.name = next_token(&q, line_end);
+            if (property.type == PlyType_None || property.name.empty()) return MeshError_Format;
+            element->properties.push_back(property);
+        }
+        else if (keyword != "comment" && keyword != "obj_info" && !keyword.empty())
+            return MeshError_Format;
+    }
+}
+
+lt_internal inline void
+load_swapped(u8 *dst, const u8 *src, u32 size, bool swap)
+{
+    if (!swap) memcpy(dst, src, size);
+    else for (u32 i = 0; i < size; i++) dst[i] = src[size - 1 - i];
+}
+
+lt_internal inline f64
+ply_read(const u8 *p, PlyType type, bool swap)
+{
+    alignas(8) u8 b[8] = {};
+    load_swapped(b, p, g_ply_type_size[type], swap);
+    switch (type)
+    {
+    case PlyType_I8:  { i8 x;  memcpy(&x, b, 1); return x; }
+    case PlyType_U8:  { u8 x;  memcpy(&x, b, 1); return x; }
+    case PlyType_I16: { i16 x; memcpy(&x, b, 2); return x; }
+    case PlyType_U16: { u16 x; memcpy(&x, b, 2); return x; }
+    case PlyType_I32: { i32 x; memcpy(&x, b, 4); return x; }
+    case PlyType_U32: { u32 x; memcpy(&x, b, 4); return x; }
+    case PlyType_F32: { f32 x; memcpy(&x, b, 4); return x; }
+    case PlyType_F64: { f64 x; memcpy(&x, b, 8); return x; }
+    default: return 0;
+    }
+}
+
+lt_internal inline f32
+ply_read_f32(const u8 *p, PlyType type, bool swap)
+{
+    if (type == PlyType_F32 && !swap)
+    {
+        f32 x;
+        memcpy(&x, p, sizeof(x));
+        return x;
+    }
+    return (f32)ply_read(p, type, swap);
+}
+
+// Size of the record at `p`, 0 when it runs past `end`.
+lt_internal usize
+ply_record_size(const PlyElement &element, const u8 *p, const u8 *end, bool swap)
+{
+    const u8 *q = p;
+    for (const PlyProperty &property : element.properties)
+    {
+        if (property.count_type == PlyType_None)
+        {
+            if ((usize)(end - q) < g_ply_type_size[property.type]) return 0;
+            q += g_ply_type_size[property.type];
+            continue;
+        }
+        if ((usize)(end - q) < g_ply_type_size[property.count_type]) return 0;
+        const f64 count = ply_read(q, property.count_type, swap);
+        q += g_ply_type_size[property.count_type];
+        if (count < 0 || (u64)(end - q) / g_ply_type_size[property.type] < (u64)count) return 0;
+        q += (usize)count * g_ply_type_size[property.type];
+    }
+    return (usize)(q - p);
+}
+
+// NaN and fractions are not indices.
+lt_internal inline bool
+ply_valid_index(f64 index, u32 num_vertices)
+{
+    return index >= 0 && index < num_vertices && index == (f64)(u32)index;
+}
+
+lt_internal const PlyProperty *
+find_face_indices(const PlyElement &face)
+{
+    for (const PlyProperty &property : face.properties)
+        if (property.count_type != PlyType_None && (property.name == "vertex_indices" || property.name == "vertex_index"))
+            return &property;
+    return nullptr;
+}
+
+lt_internal void
+find_vertex_attributes(const PlyElement &vertex, const PlyProperty *attributes[PlyAttribute_Count])
+{
+    for (i32 a = 0; a < PlyAttribute_Count; a++) attributes[a] = nullptr;
+    for (const PlyProperty &property : vertex.properties)
+    {
+        const i32 a = ply_attribute(property.name);
+        if (a >= 0 && property.count_type == PlyType_None) attributes[a] = &property;
+    }
+}
+
+// Fast path for faces that are all triangles and have no other property. Returns false
+// (without errors) when some face is not a triangle.
+lt_internal bool
+copy_ply_triangles(Mesh *mesh, const PlyElement &face, const u8 *p, bool swap, bool *index_error)
+{
+    const PlyProperty &property = face.properties[0];
+    const u32 count_size = g_ply_type_size[property.count_type];
+    const u32 index_size = g_ply_type_size[property.type];
+    const usize record = count_size + 3 * (usize)index_size;
+
+    std::vector<u8> bad_count((face.count + (1 << 16) - 1) >> 16, 0), bad_index(bad_count.size(), 0);
+    lt::parallel_for(bad_count.size(), 1, [&](usize begin, usize end) {
+        for (usize b = begin; b < end; b++)
+        {
+            const usize last = ((b + 1) << 16 < face.count) ? (b + 1) << 16 : (usize)face.count;
+            for (usize f = b << 16; f < last; f++)
+            {
+                const u8 *r = p + f * record;
+                if (ply_read(r, property.count_type, swap) != 3)
+                {
+                    bad_count[b] = 1;
+                    break;
+                }
+                for (u32 k = 0; k < 3; k++)
+                {
+                    const f64 index = ply_read(r + count_size + k * index_size, property.type, swap);
+                    if (!ply_valid_index(index, mesh->num_vertices))
+                    {
+                        bad_index[b] = 1;
+                        continue;
+                    }
+                    mesh->indices[3 * f + k] = (u32)index;
+                }
+            }
+        }
+    });
+    for (usize b = 0; b < bad_count.size(); b++)
+    {
+        if (bad_count[b]) return false;
+        if (bad_index[b]) *index_error = true;
+    }
+    return true;
+}
+
+// Triangles of the faces, cut into fans. Returns the number of triangles, with `out` null
+// only counts them.
+lt_internal usize
+walk_ply_faces(const PlyElement &face, const PlyProperty *indices, const u8 *p, bool swap,
+               u32 num_vertices, u32 *out, bool *error)
+{
+    usize num_triangles = 0;
+    for (u64 f = 0; f < face.count; f++)
+    {
+        for (const PlyProperty &property : face.properties)
+        {
+            if (property.count_type == PlyType_None)
+            {
+                p += g_ply_type_size[property.type];
+                continue;
+            }
+            const u32 item_size = g_ply_type_size[property.type];
+            const u64 count = (u64)ply_read(p, property.count_type, swap);
+            p += g_ply_type_size[property.count_type];
+            if (&property == indices && count >= 3)
+            {
+                if (out)
+                {
+                    const f64 first = ply_read(p, property.type, swap);
+                    f64 prev = ply_read(p + item_size, property.type, swap);
+                    for (u64 k = 2; k < count; k++)
+                    {
+                        const f64 next = ply_read(p + k * item_size, property.type, swap);
+                        u32 *t = out + 3 * num_triangles;
+                        if (ply_valid_index(first, num_vertices) && ply_valid_index(prev, num_vertices) &&
+                            ply_valid_index(next, num_vertices))
+                        {
+                            t[0] = (u32)first;
+                            t[1] = (u32)prev;
+                            t[2] = (u32)next;
+                        }
+                        else *error = true;
+                        prev = next;
+                        num_triangles++;
+                    }
+                }
+                else num_triangles += count - 2;
+            }
+            p += count * item_size;
+        }
+    }
+    return num_triangles;
+}
+
+// Checks that the face records are within the data and counts their triangles.
+lt_internal bool
+count_ply_triangles(const PlyElement &face, const PlyProperty *indices, const u8 *p, const u8 *end, bool swap,
+                    usize *num_triangles)
+{
+    const u8 *q = p;
+    for (u64 f = 0; f < face.count; f++)
+    {
+        const usize record = ply_record_size(face, q, end, swap);
+        if (record == 0) return false;
+        q += record;
+    }
+    bool error = false;
+    *num_triangles = walk_ply_faces(face, indices, p, swap, 0, nullptr, &error);
+    return true;
+}
+
+lt_internal bool
+load_ply_binary(Mesh *mesh, const PlyHeader &header, const u8 *data, usize size, const MeshLoadOptions &options)
+{
+    const bool swap = (header.encoding == PlyEncoding_BigEndian) == lt::is_little_endian();
+    const u8 *end = data + size;
+
+    // Where the vertex and face records start, skipping the elements before.
+    const PlyElement *vertex = nullptr, *face = nullptr;
+    const u8 *vertex_data = nullptr, *face_data = nullptr;
+    const u8 *p = data + header.body;
+    for (const PlyElement &element : header.elements)
+    {
+        if (element.name == "vertex")
+        {
+            vertex = &element;
+            vertex_data = p;
+        }
+        else if (element.name == "face")
+        {
+            face = &element;
+            face_data = p;
+        }
+        if (vertex && face) break;
+
+        if (element.size > 0)
+        {
+            if ((u64)(end - p) / element.size < element.count) return mesh_fail(mesh, MeshError_Format);
+            p += element.count * element.size;
+            continue;
+        }
+        for (u64 r = 0; r < element.count; r++)
+        {
+            const usize record = ply_record_size(element, p, end, swap);
+            if (record == 0) return mesh_fail(mesh, MeshError_Format);
+            p += record;
+        }
+    }
+    if (!vertex) return mesh_fail(mesh, MeshError_Format);
+    if (vertex->size == 0) return mesh_fail(mesh, MeshError_Unsupported);
+    if ((u64)(end - vertex_data) / vertex->size < vertex->count) return mesh_fail(mesh, MeshError_Format);
+    if (vertex->count > LT_MESH_NONE - 1) return mesh_fail(mesh, MeshError_Unsupported);
+
+    const PlyProperty *attributes[PlyAttribute_Count];
+    find_vertex_attributes(*vertex, attributes);
+    if (!attributes[PlyAttribute_X] || !attributes[PlyAttribute_Y] || !attributes[PlyAttribute_Z])
+        return mesh_fail(mesh, MeshError_Format);
+    const bool normals = options.normals && attributes[PlyAttribute_NX] && attributes[PlyAttribute_NY] && attributes[PlyAttribute_NZ];
+    const bool uvs = options.uvs && attributes[PlyAttribute_U] && attributes[PlyAttribute_V];
+
+    const PlyProperty *indices = face ? find_face_indices(*face) : nullptr;
+    if (face && !indices) return mesh_fail(mesh, MeshError_Format);
+
+    // Triangles only: the records have a fixed size if the counts are all 3.
+    const bool maybe_triangles = face && face->properties.size() == 1 &&
+        (u64)(end - face_data) / (g_ply_type_size[indices->count_type] + 3 * g_ply_type_size[indices->type]) >= face->count;
+    usize num_triangles = 0;
+    if (maybe_triangles) num_triangles = (usize)face->count;
+    else if (face)
+    {
+        if (!count_ply_triangles(*face, indices, face_data, end, swap, &num_triangles))
+            return mesh_fail(mesh, MeshError_Format);
+    }
+    if (3 * (u64)num_triangles > LT_MESH_NONE - 1) return mesh_fail(mesh, MeshError_Unsupported);
+
+    if (!mesh_allocate(mesh, (u32)vertex->count, (u32)(3 * num_triangles), normals, uvs))
+        return mesh_fail(mesh, MeshError_Memory);
+
+    f32 *streams[PlyAttribute_Count] = {mesh->x, mesh->y, mesh->z, mesh->nx, mesh->ny, mesh->nz, mesh->u, mesh->v};
+    lt::parallel_for((usize)vertex->count, 1 << 14, [&](usize first, usize last) {
+        for (i32 a = 0; a < PlyAttribute_Count; a++)
+        {
+            if (!streams[a]) continue;
+            const u8 *src = vertex_data + attributes[a]->offset;
+            const PlyType type = attributes[a]->type;
+            for (usize i = first; i < last; i++) streams[a][i] = ply_read_f32(src + i * vertex->size, type, swap);
+        }
+    });
+
+    bool index_error = false;
+    if (maybe_triangles && !copy_ply_triangles(mesh, *face, face_data, swap, &index_error))
+    {
+        // Some face is not a triangle after all, the index buffer has the wrong size.
+        if (!count_ply_triangles(*face, indices, face_data, end, swap, &num_triangles))
+            return mesh_fail(mesh, MeshError_Format);
+        if (3 * (u64)num_triangles > LT_MESH_NONE - 1) return mesh_fail(mesh, MeshError_Unsupported);
+
+        Mesh resized;
+        if (!mesh_allocate(&resized, mesh->num_vertices, (u32)(3 * num_triangles), normals, uvs))
+            return mesh_fail(mesh, MeshError_Memory);
+        f32 *dst[PlyAttribute_Count] = {resized.x, resized.y, resized.z, resized.nx, resized.ny, resized.nz, resized.u, resized.v};
+        for (i32 a = 0; a < PlyAttribute_Count; a++)
+            if (streams[a]) memcpy(dst[a], streams[a], mesh->num_vertices * sizeof(f32));
+        lt::mesh_destroy(mesh);
+        *mesh = resized;
+        walk_ply_faces(*face, indices, face_data, swap, mesh->num_vertices, mesh->indices, &index_error);
+    }
+    else if (face && !maybe_triangles)
+    {
+        walk_ply_faces(*face, indices, face_data, swap, mesh->num_vertices, mesh->indices, &index_error);
+    }
+    if (index_error) return mesh_fail(mesh, MeshError_Index);
+    return true;
+}
+
+// Record of an ascii element, the numbers of the properties in order. Lists are kept for the
+// face indices only.
+lt_internal bool
+parse_ply_ascii_record(const PlyElement &element, const PlyProperty *indices, const char *p, const char *end,
+                       f64 *scalars, std::vector<f64> *list)
+{
+    list->clear();
+    for (usize i = 0; i < element.properties.size(); i++)
+    {
+        const PlyProperty &property = element.properties[i];
+        f64 value;
+        p = parse_text_f64(p, end, &value);
+        if (!p) return false;
+        if (property.count_type == PlyType_None)
+        {
+            scalars[i] = value;
+            continue;
+        }
+        // Every item takes at least a character, which also bounds the count.
+        if (!(value >= 0 && value <= (f64)(end - p)) || value != (f64)(u64)value) return false;
+        for (u64 k = 0; k < (u64)value; k++)
+        {
+            f64 item;
+            p = parse_text_f64(p, end, &item);
+            if (!p) return false;
+            if (&property == indices) list->push_back(item);
+        }
+    }
+    return true;
+}
+
+lt_internal bool
+load_ply_ascii(Mesh *mesh, const PlyHeader &header, const char *data, usize size, const MeshLoadOptions &options)
+{
+    const PlyElement *vertex = nullptr, *face = nullptr;
+    for (const PlyElement &element : header.elements)
+    {
+        if (element.name == "vertex" && !vertex) vertex = &element;
+        if (element.name == "face" && !face) face = &element;
+    }
+    if (!vertex) return mesh_fail(mesh, MeshError_Format);
+    if (vertex->count > LT_MESH_NONE - 1) return mesh_fail(mesh, MeshError_Unsupported);
+
+    const PlyProperty *attributes[PlyAttribute_Count];
+    find_vertex_attributes(*vertex, attributes);
+    if (!attributes[PlyAttribute_X] || !attributes[PlyAttribute_Y] || !attributes[PlyAttribute_Z])
+        return mesh_fail(mesh, MeshError_Format);
+    const bool normals = options.normals && attributes[PlyAttribute_NX] && attributes[PlyAttribute_NY] && attributes[PlyAttribute_NZ];
+    const bool uvs = options.uvs && attributes[PlyAttribute_U] && attributes[PlyAttribute_V];
+    const PlyProperty *indices = face ? find_face_indices(*face) : nullptr;
+    if (face && !indices) return mesh_fail(mesh, MeshError_Format);
+
+    // The index count is only known at the end, the vertices are kept aside until then.
+    std::vector<f32> streams[PlyAttribute_Count];
+    i32 columns[PlyAttribute_Count];
+    for (i32 a = 0; a < PlyAttribute_Count; a++)
+    {
+        const bool wanted = a < PlyAttribute_NX || (a < PlyAttribute_U ? normals : uvs);
+        columns[a] = wanted ? (i32)(attributes[a] - vertex->properties.data()) : -1;
+        if (wanted) streams[a].reserve((usize)vertex->count);
+    }
+    std::vector<u32> triangles;
+
+    usize element = 0;
+    u64 record = 0;
+    bool error = false, index_error = false;
+    std::vector<f64> scalars, list;
+    lt::scan_records(data + header.body, size - header.body, ScanOptions(), [&](const char *line, usize len) {
+        while (element < header.elements.size() && record == header.elements[element].count)
+        {
+            element++;
+            record = 0;
+        }
+        if (error || element == header.elements.size()) return;
+
+        const PlyElement &e = header.elements[element];
+        record++;
+        if (&e != vertex && &e != face) return;
+
+        scalars.resize(e.properties.size());
+        if (!parse_ply_ascii_record(e, indices, line, line + len, scalars.data(), &list))
+        {
+            error = true;
+            return;
+        }
+        if (&e == vertex)
+        {
+            for (i32 a = 0; a < PlyAttribute_Count; a++)
+                if (columns[a] >= 0) streams[a].push_back((f32)scalars[(usize)columns[a]]);
+            return;
+        }
+        for (usize k = 2; k < list.size(); k++)
+        {
+            const f64 corners[3] = {list[0], list[k - 1], list[k]};
+            for (f64 c : corners)
+            {
+                if (!ply_valid_index(c, (u32)vertex->count)) index_error = true;
+                triangles.push_back(index_error ? 0 : (u32)c);
+            }
+        }
+    });
+    while (element < header.elements.size() && record == header.elements[element].count)
+    {
+        element++;
+        record = 0;
+    }
+    if (error || element != header.elements.size()) return mesh_fail(mesh, MeshError_Format);
+    if (index_error) return mesh_fail(mesh, MeshError_Index);
+    if (triangles.size() > LT_MESH_NONE - 1) return mesh_fail(mesh, MeshError_Unsupported);
+
+    if (!mesh_allocate(mesh, (u32)vertex->count, (u32)triangles.size(), normals, uvs))
+        return mesh_fail(mesh, MeshError_Memory);
+    f32 *dst[PlyAttribute_Count] = {mesh->x, mesh->y, mesh->z, mesh->nx, mesh->ny, mesh->nz, mesh->u, mesh->v};
+    for (i32 a = 0; a < PlyAttribute_Count; a++)
+        if (dst[a] && !streams[a].empty()) memcpy(dst[a], streams[a].data(), streams[a].size() * sizeof(f32));
+    if (!triangles.empty()) memcpy(mesh->indices, triangles.data(), triangles.size() * sizeof(u32));
+    return true;
+}
+
+bool
+lt::mesh_load_ply(Mesh *mesh, const void *data, usize size, const MeshLoadOptions &options)
+{
+    LT_PERF_SCOPE("mesh_load_ply", size);
+    *mesh = Mesh();
+
+    PlyHeader header = {};
+    const MeshError error = parse_ply_header((const char*)data, size, &header);
+    if (error != MeshError_None) return mesh_fail(mesh, error);
+
+    for (PlyElement &element : header.elements)
+    {
+        u32 offset = 0;
+        bool fixed = true;
+        for (PlyProperty &property : element.properties)
+        {
+            property.offset = offset;
+            offset += g_ply_type_size[property.type];
+            fixed &= property.count_type == PlyType_None;
+        }
+        element.size = fixed ? offset : 0;
+    }
+
+    const bool ok = (header.encoding == PlyEncoding_Ascii)
+        ? load_ply_ascii(mesh, header, (const char*)data, size, options)
+        : load_ply_binary(mesh, header, (const u8*)data, size, options);
+    return ok && mesh_finish_load(mesh, options);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Vertex cache optimization
+//
+// Tom Forsyth, "Linear-speed vertex cache optimisation". Triangles are emitted greedily: the
+// next one is the best scored among those using a vertex of the simulated LRU cache, and when
+// there is none, the first one not emitted yet. A vertex scores by its position in the cache
+// (the three of the last triangle get a fixed lower score, so strips do not turn back on
+// themselves) plus a bonus for having few triangles left, so that lone triangles are not left
+// behind to cost a miss each at the end.
+//
+
+#define LT_MESH_MAX_VALENCE_SCORE 32
+
+lt_internal inline f32
+forsyth_vertex_score(i32 cache_position, u32 remaining, const f32 *cache_score, const f32 *valence_score)
+{
+    if (remaining == 0) return -1.0f;
+    const f32 score = (cache_position >= 0) ? cache_score[cache_position] : 0;
+    return score + valence_score[(remaining < LT_MESH_MAX_VALENCE_SCORE) ? remaining : LT_MESH_MAX_VALENCE_SCORE - 1];
+}
+
+void
+lt::optimize_vertex_cache(u32 *indices, usize num_indices, u32 num_vertices, u32 cache_size)
+{
+    LT_PERF_SCOPE("optimize_vertex_cache", num_indices / 3);
+    LT_Assert(num_indices % 3 == 0);
+    if (cache_size < 4) cache_size = 4;
+    if (cache_size > 64) cache_size = 64;
+
+    const usize num_triangles = num_indices / 3;
+    if (num_triangles == 0) return;
+
+    f32 cache_score[64];
+    for (u32 i = 0; i < cache_size; i++)
+        cache_score[i] = (i < 3) ? 0.75f : std::pow(1.0f - (f32)(i - 3) / (f32)(cache_size - 3), 1.5f);
+    f32 valence_score[LT_MESH_MAX_VALENCE_SCORE];
+    valence_score[0] = 0;
+    for (u32 k = 1; k < LT_MESH_MAX_VALENCE_SCORE; k++) valence_score[k] = 2.0f / std::sqrt((f32)k);
+
+    // Triangles of every vertex. The ones still to emit are kept at the front of each list.
+    std::vector<u32> remaining(num_vertices, 0);
+    for (usize i = 0; i < num_indices; i++)
+    {
+        LT_Assert(indices[i] < num_vertices);
+        remaining[indices[i]]++;
+    }
+    std::vector<u32> offsets(num_vertices + 1, 0);
+    for (u32 v = 0; v < num_vertices; v++) offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<u32> adjacency(num_indices);
+    {
+        std::vector<u32> cursor(offsets.begin(), offsets.end() - 1);
+        for (usize i = 0; i < num_indices; i++) adjacency[cursor[indices[i]]++] = (u32)(i / 3);
+    }
+
+    std::vector<i32> cache_position(num_vertices, -1);
+    std::vector<f32> vertex_score(num_vertices);
+    for (u32 v = 0; v < num_vertices; v++)
+        vertex_score[v] = forsyth_vertex_score(-1, remaining[v], cache_score, valence_score);
+
+    std::vector<u8>  emitted(num_triangles, 0);
+    std::vector<u32> out(num_indices);
+    u32 cache[64 + 3];
+    u32 cache_count = 0;
+    usize cursor = 0;
+    i64 best = -1;
+
+    for (usize k = 0; k < num_triangles; k++)
+    {
+        if (best < 0)
+        {
+            while (emitted[cursor]) cursor++;
+            best = (i64)cursor;
+        }
+        const usize t = (usize)best;
+        emitted[t] = 1;
+        const u32 tri[3] = {indices[3*t], indices[3*t + 1], indices[3*t + 2]};
+        memcpy(&out[3*k], tri, sizeof(tri));
+
+        // Takes the triangle out of the lists of its vertices.
+        for (u32 v : tri)
+        {
+            u32 *list = &adjacency[offsets[v]];
+            for (u32 i = 0; i < remaining[v]; i++)
+            {
+                if (list[i] == t)
+                {
+                    list[i] = list[remaining[v] - 1];
+                    list[remaining[v] - 1] = (u32)t;
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // The triangle's vertices go to the front of the cache, the rest moves back.
+        u32 next[64 + 3];
+        u32 next_count = 0;
+        for (u32 v : tri)
+            if (next_count == 0 || (next[0] != v && (next_count < 2 || next[1] != v))) next[next_count++] = v;
+        for (u32 i = 0; i < cache_count; i++)
+        {
+            const u32 v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) next[next_count++] = v;
+        }
+
+        for (u32 i = 0; i < next_count; i++)
+        {
+            const u32 v = next[i];
+            cache_position[v] = (i < cache_size) ? (i32)i : -1;
+            vertex_score[v] = forsyth_vertex_score(cache_position[v], remaining[v], cache_score, valence_score);
+        }
+
+        best = -1;
+        f32 best_score = -1.0f;
+        for (u32 i = 0; i < next_count; i++)
+        {
+            const u32 v = next[i];
+            const u32 *list = &adjacency[offsets[v]];
+            for (u32 j = 0; j < remaining[v]; j++)
+            {
+                const u32 n = list[j];
+                const f32 score = vertex_score[indices[3*n]] + vertex_score[indices[3*n + 1]] + vertex_score[indices[3*n + 2]];
+                if (score > best_score)
+                {
+                    best_score = score;
+                    best = n;
+                }
+            }
+        }
+
+        cache_count = (next_count < cache_size) ? next_count : cache_size;
+        memcpy(cache, next, cache_count * sizeof(u32));
+    }
+
+    memcpy(indices, out.data(), num_indices * sizeof(u32));
+}
+
+bool
+lt::mesh_optimize_vertex_cache(Mesh *mesh, u32 cache_size)
+{
+    LT_PERF_SCOPE("mesh_optimize_vertex_cache", mesh->num_vertices);
+    optimize_vertex_cache(mesh->indices, mesh->num_indices, mesh->num_vertices, cache_size);
+
+    // Vertices in order of first use, the unused ones at the end.
+    std::vector<u32> remap(mesh->num_vertices, LT_MESH_NONE);
+    u32 next = 0;
+    for (u32 i = 0; i < mesh->num_indices; i++)
+        if (remap[mesh->indices[i]] == LT_MESH_NONE) remap[mesh->indices[i]] = next++;
+    for (u32 v = 0; v < mesh->num_vertices; v++)
+        if (remap[v] == LT_MESH_NONE) remap[v] = next++;
+
+    Mesh sorted;
+    if (!mesh_allocate(&sorted, mesh->num_vertices, mesh->num_indices, mesh->nx != nullptr, mesh->u != nullptr))
+        return false;
+
+    const f32 *src[8] = {mesh->x, mesh->y, mesh->z, mesh->nx, mesh->ny, mesh->nz, mesh->u, mesh->v};
+    f32 *dst[8] = {sorted.x, sorted.y, sorted.z, sorted.nx, sorted.ny, sorted.nz, sorted.u, sorted.v};
+    for (i32 s = 0; s < 8; s++)
+    {
+        if (!src[s]) continue;
+        for (u32 v = 0; v < mesh->num_vertices; v++) dst[s][remap[v]] = src[s][v];
+    }
+    for (u32 i = 0; i < mesh->num_indices; i++) sorted.indices[i] = remap[mesh->indices[i]];
+
+    mesh_destroy(mesh);
+    *mesh = sorted;
+    return true;
+}
+
+f32
+lt::vertex_cache_acmr(const u32 *indices, usize num_indices, u32 num_vertices, u32 cache_size)
+{
+    if (num_indices < 3) return 0;
+
+    // FIFO: a vertex is in the cache when fewer than cache_size misses happened since it was
+    // loaded.
+    std::vector<u64> loaded(num_vertices, 0);
+    u64 misses = 0;
+    for (usize i = 0; i < num_indices; i++)
+    {
+        const u32 v = indices[i];
+        LT_Assert(v < num_vertices);
+        if (loaded[v] == 0 || misses - loaded[v] >= cache_size) loaded[v] = ++misses;
+    }
+    return (f32)misses / (f32)(num_indices / 3);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Files
+//
+
+lt_internal bool
+has_extension(const char *path, const char *extension)
+{
+    const usize len = strlen(path), ext_len = strlen(extension);
+    if (len < ext_len) return false;
+    for (usize i = 0; i < ext_len; i++)
+    {
+        char c = path[len - ext_len + i];
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        if (c != extension[i]) return false;
+    }
+    return true;
+}
+
+MeshFormat
+lt::mesh_detect_format(const char *path, const void *data, usize size)
+{
+    if (path && has_extension(path, ".obj")) return MeshFormat_Obj;
+    if (path && has_extension(path, ".ply")) return MeshFormat_Ply;
+
+    const char *text = (const char*)data;
+    if (size >= 4 && memcmp(text, "ply", 3) == 0 && (text[3] == '\n' || text[3] == '\r')) return MeshFormat_Ply;
+
+    // OBJ has no magic, the first line that is not blank should start with a known keyword.
+    const char *end = text + size;
+    const char *p = text;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+    if (p < end && strchr("#vfgosmul", *p)) return MeshFormat_Obj;
+    return MeshFormat_Unknown;
+}
+
+bool
+lt::mesh_load(Mesh *mesh, const char *path, const MeshLoadOptions &options)
+{
+    *mesh = Mesh();
+
+#if LT_PLATFORM_UNIX
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return mesh_fail(mesh, MeshError_Open);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return mesh_fail(mesh, MeshError_Open);
+    }
+    if (st.st_size <= 0)
+    {
+        close(fd);
+        return mesh_fail(mesh, (st.st_size == 0) ? MeshError_Format : MeshError_Open);
+    }
+
+    // The whole file is read, so the mapping is populated up front with large reads instead of
+    // one page fault at a time.
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    const usize size = (usize)st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return mesh_fail(mesh, MeshError_Open);
+
+    bool ok = false;
+    switch (mesh_detect_format(path, data, size))
+    {
+    case MeshFormat_Obj: ok = mesh_load_obj(mesh, (const char*)data, size, options); break;
+    case MeshFormat_Ply: ok = mesh_load_ply(mesh, data, size, options); break;
+    default:             ok = mesh_fail(mesh, MeshError_Format); break;
+    }
+    munmap(data, size);
+#else
+#error "Currently only implemented on UNIX systems."
+#endif
+
+    return ok;
+}
+
+void
+lt::mesh_destroy(Mesh *mesh)
+{
+    LT_Free(mesh->storage);
+    *mesh = Mesh();
+}
+
+const char *
+lt::mesh_error_name(MeshError error)
+{
+    switch (error)
+    {
+    case MeshError_None:        return "none";
+    case MeshError_Open:        return "open";
+    case MeshError_Format:      return "format";
+    case MeshError_Unsupported: return "unsupported";
+    case MeshError_Index:       return "index";
+    case MeshError_Memory:      return "memory";
+    default:                    return "unknown";
+    }
+}
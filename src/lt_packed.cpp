@@ -0,0 +1,723 @@
+#include "lt_packed.hpp"
+#include "lt_cpu.hpp"
+
+static_assert(sizeof(Vec3f) == 3*sizeof(f32), "Vec3f is expected to be tightly packed");
+static_assert(sizeof(Vec4f) == 4*sizeof(f32), "Vec4f is expected to be tightly packed");
+static_assert(sizeof(Quatf) == 4*sizeof(f32), "Quatf is expected to be tightly packed");
+static_assert(sizeof(Vec3h) == 3*sizeof(u16) && sizeof(Vec4h) == 4*sizeof(u16), "");
+static_assert(sizeof(Snorm16x3) == 3*sizeof(i16) && sizeof(Quat48) == 6, "");
+
+// The SIMD kernels work on blocks of 4 items. The tail of a batch is copied into a padded
+// block, so single values go through exactly the same code as arrays.
+template<typename In, typename Out, typename F> lt_internal inline void
+for_each_block4(const In *in, Out *out, usize count, const F &block)
+{
+    usize i = 0;
+    for (; i + 4 <= count; i += 4) block(in + i, out + i);
+    if (i < count)
+    {
+        In tmp_in[4];
+        Out tmp_out[4];
+        for (usize k = 0; k < 4; k++) tmp_in[k] = in[(i + k < count) ? i + k : i];
+        block(tmp_in, tmp_out);
+        for (usize k = 0; i + k < count; k++) out[i + k] = tmp_out[k];
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// Half floats
+//
+
+lt_internal inline u32 f32_bits(f32 f) { u32 u; memcpy(&u, &f, 4); return u; }
+lt_internal inline f32 bits_f32(u32 u) { f32 f; memcpy(&f, &u, 4); return f; }
+
+// Round to nearest even conversions without F16C, they give the same bits as the hardware.
+lt_internal u16
+f32_to_f16_soft(f32 f)
+{
+    const u32 f32_inf = 255u << 23;
+    const u32 f16_max = (127u + 16) << 23;
+    const u32 denorm_magic = ((127u - 15) + (23 - 10) + 1) << 23;
+
+    u32 u = f32_bits(f);
+    const u32 sign = u & 0x80000000u;
+    u ^= sign;
+
+    u16 h;
+    if (u >= f16_max)
+    {
+        // NaN stays quiet NaN with the top of its payload, like the hardware.
+        h = (u > f32_inf) ? (u16)(0x7e00 | ((u >> 13) & 0x3ff)) : 0x7c00;
+    }
+    else if (u < (113u << 23))
+    {
+        // Subnormal or zero: the float add aligns the 10 mantissa bits at the bottom and
+        // rounds to nearest even.
+        h = (u16)(f32_bits(bits_f32(u) + bits_f32(denorm_magic)) - denorm_magic);
+    }
+    else
+    {
+        const u32 mant_odd = (u >> 13) & 1;
+        u += ((u32)(15 - 127) << 23) + 0xfff;
+        u += mant_odd;
+        h = (u16)(u >> 13);
+    }
+    return (u16)(h | (sign >> 16));
+}
+
+lt_internal f32
+f16_to_f32_soft(u16 h)
+{
+    const u32 shifted_exp = 0x7c00u << 13;
+
+    u32 u = ((u32)h & 0x7fff) << 13;
+    const u32 exp = shifted_exp & u;
+    u += (127u - 15) << 23;
+
+    if (exp == shifted_exp)
+    {
+        u += (128u - 16) << 23;
+        if (h & 0x3ff) u |= 1u << 22;   // Signaling NaN comes back quiet.
+    }
+    else if (exp == 0)
+    {
+        u += 1u << 23;
+        u = f32_bits(bits_f32(u) - bits_f32(113u << 23));
+    }
+    return bits_f32(u | (((u32)h & 0x8000) << 16));
+}
+
+lt_internal void
+f32_to_f16_scalar(const f32 *in, u16 *out, usize count)
+{
+    for (usize i = 0; i < count; i++) out[i] = f32_to_f16_soft(in[i]);
+}
+
+lt_internal void
+f16_to_f32_scalar(const u16 *in, f32 *out, usize count)
+{
+    for (usize i = 0; i < count; i++) out[i] = f16_to_f32_soft(in[i]);
+}
+
+// F16C comes with every CPU of the AVX2 tier. Without dispatch the build flags must enable
+// it as well.
+#if LT_CPU_HAS_AVX2 && (LT_CPU_DISPATCH || defined(__F16C__))
+#define LT_PACKED_HAS_F16C 1
+
+LT_TARGET_AVX2 lt_internal void
+f32_to_f16_f16c(const f32 *in, u16 *out, usize count)
+{
+    usize i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm_storeu_si128((__m128i*)(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+    for (; i + 4 <= count; i += 4)
+        _mm_storel_epi64((__m128i*)(out + i), _mm_cvtps_ph(_mm_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+    for (; i < count; i++) out[i] = (u16)_cvtss_sh(in[i], _MM_FROUND_TO_NEAREST_INT);
+}
+
+LT_TARGET_AVX2 lt_internal void
+f16_to_f32_f16c(const u16 *in, f32 *out, usize count)
+{
+    usize i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(in + i))));
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(in + i))));
+    for (; i < count; i++) out[i] = _cvtsh_ss(in[i]);
+}
+#endif
+
+// Both kernels give the same bits.
+struct HalfKernel
+{
+    CpuIsa isa;
+    void (*to_f16)(const f32 *in, u16 *out, usize count);
+    void (*to_f32)(const u16 *in, f32 *out, usize count);
+};
+
+lt_global_variable const HalfKernel g_half_kernels[] = {
+    {CpuIsa_Scalar, f32_to_f16_scalar, f16_to_f32_scalar},
+#if LT_PACKED_HAS_F16C
+    {CpuIsa_AVX2,   f32_to_f16_f16c,   f16_to_f32_f16c},
+#endif
+};
+lt_global_variable CpuDispatchCache g_half_dispatch;
+
+u16
+lt::f32_to_f16(f32 f)
+{
+    u16 h;
+    cpu_select(g_half_kernels, &g_half_dispatch)->to_f16(&f, &h, 1);
+    return h;
+}
+
+f32
+lt::f16_to_f32(u16 h)
+{
+    f32 f;
+    cpu_select(g_half_kernels, &g_half_dispatch)->to_f32(&h, &f, 1);
+    return f;
+}
+
+void
+lt::f32_to_f16(const f32 *in, u16 *out, usize count)
+{
+    cpu_select(g_half_kernels, &g_half_dispatch)->to_f16(in, out, count);
+}
+
+void
+lt::f16_to_f32(const u16 *in, f32 *out, usize count)
+{
+    cpu_select(g_half_kernels, &g_half_dispatch)->to_f32(in, out, count);
+}
+
+const char *
+lt::half_kernel_name()
+{
+    return cpu_isa_name(cpu_select(g_half_kernels, &g_half_dispatch)->isa);
+}
+
+Vec3h
+lt::pack_vec3h(Vec3f v)
+{
+    return Vec3h{lt::f32_to_f16(v.x), lt::f32_to_f16(v.y), lt::f32_to_f16(v.z)};
+}
+
+Vec3f
+lt::unpack_vec3h(Vec3h v)
+{
+    return Vec3f(lt::f16_to_f32(v.x), lt::f16_to_f32(v.y), lt::f16_to_f32(v.z));
+}
+
+Vec4h
+lt::pack_vec4h(Vec4f v)
+{
+    return Vec4h{lt::f32_to_f16(v.x), lt::f32_to_f16(v.y), lt::f32_to_f16(v.z), lt::f32_to_f16(v.w)};
+}
+
+Vec4f
+lt::unpack_vec4h(Vec4h v)
+{
+    return Vec4f(lt::f16_to_f32(v.x), lt::f16_to_f32(v.y), lt::f16_to_f32(v.z), lt::f16_to_f32(v.w));
+}
+
+void
+lt::pack_vec3h(const Vec3f *in, Vec3h *out, usize count)
+{
+    lt::f32_to_f16(&in->x, &out->x, 3*count);
+}
+
+void
+lt::unpack_vec3h(const Vec3h *in, Vec3f *out, usize count)
+{
+    lt::f16_to_f32(&in->x, &out->x, 3*count);
+}
+
+void
+lt::pack_vec4h(const Vec4f *in, Vec4h *out, usize count)
+{
+    lt::f32_to_f16(&in->x, &out->x, 4*count);
+}
+
+void
+lt::unpack_vec4h(const Vec4h *in, Vec4f *out, usize count)
+{
+    lt::f16_to_f32(&in->x, &out->x, 4*count);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Snorm16
+//
+
+#define SNORM16_SCALE     32767.0f
+#define SNORM16_INV_SCALE (1.0f / 32767.0f)
+
+// NaN packs to 0.
+lt_internal inline i16
+snorm16_from_f32(f32 x)
+{
+    if (x != x) return 0;
+    x = (x < -1.0f) ? -1.0f : ((x > 1.0f) ? 1.0f : x);
+    return (i16)std::nearbyint(x * SNORM16_SCALE);
+}
+
+lt_internal inline f32
+snorm16_to_f32(i16 q)
+{
+    const f32 x = (f32)q * SNORM16_INV_SCALE;
+    return (x < -1.0f) ? -1.0f : x;
+}
+
+// Works on the flat component arrays, the layout of the vectors does not matter.
+lt_internal void
+snorm16_pack_array(const f32 *in, i16 *out, usize count)
+{
+    usize i = 0;
+#if defined(__SSE2__)
+    const __m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f), scale = _mm_set1_ps(SNORM16_SCALE);
+    // The clamp turns NaN into -1, the ordered mask then zeroes it like snorm16_from_f32.
+    auto clamp = [&](__m128 x) { return _mm_and_ps(_mm_min_ps(_mm_max_ps(x, lo), hi), _mm_cmpord_ps(x, x)); };
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128 a = clamp(_mm_loadu_ps(in + i));
+        const __m128 b = clamp(_mm_loadu_ps(in + i + 4));
+        const __m128i q = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(a, scale)), _mm_cvtps_epi32(_mm_mul_ps(b, scale)));
+        _mm_storeu_si128((__m128i*)(out + i), q);
+    }
+#endif
+    for (; i < count; i++) out[i] = snorm16_from_f32(in[i]);
+}
+
+lt_internal void
+snorm16_unpack_array(const i16 *in, f32 *out, usize count)
+{
+    usize i = 0;
+#if defined(__SSE2__)
+    const __m128 lo = _mm_set1_ps(-1.0f), inv_scale = _mm_set1_ps(SNORM16_INV_SCALE);
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i q = _mm_loadu_si128((const __m128i*)(in + i));
+        const __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(q, q), 16);
+        const __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(q, q), 16);
+        _mm_storeu_ps(out + i, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(a), inv_scale), lo));
+        _mm_storeu_ps(out + i + 4, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(b), inv_scale), lo));
+    }
+#endif
+    for (; i < count; i++) out[i] = snorm16_to_f32(in[i]);
+}
+
+Snorm16x3
+lt::pack_snorm16(Vec3f v)
+{
+    return Snorm16x3{snorm16_from_f32(v.x), snorm16_from_f32(v.y), snorm16_from_f32(v.z)};
+}
+
+Vec3f
+lt::unpack_snorm16(Snorm16x3 v)
+{
+    return Vec3f(snorm16_to_f32(v.x), snorm16_to_f32(v.y), snorm16_to_f32(v.z));
+}
+
+void
+lt::pack_snorm16(const Vec3f *in, Snorm16x3 *out, usize count)
+{
+    snorm16_pack_array(&in->x, &out->x, 3*count);
+}
+
+void
+lt::unpack_snorm16(const Snorm16x3 *in, Vec3f *out, usize count)
+{
+    snorm16_unpack_array(&in->x, &out->x, 3*count);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Octahedral
+//
+// The unit vector is projected on the octahedron |x| + |y| + |z| = 1, the lower half is
+// folded over the upper one, and the resulting square is stored as two snorm16.
+//
+
+#if defined(__SSE2__)
+lt_internal inline __m128
+sse_copysign(__m128 mag, __m128 sign)
+{
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    return _mm_or_ps(_mm_andnot_ps(sign_mask, mag), _mm_and_ps(sign_mask, sign));
+}
+
+lt_internal inline __m128
+sse_abs(__m128 x)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+}
+
+lt_internal inline __m128
+sse_select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+lt_internal void
+octahedral_pack_block4(const Vec3f *in, Octahedral32 *out)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 x = _mm_setr_ps(in[0].x, in[1].x, in[2].x, in[3].x);
+    const __m128 y = _mm_setr_ps(in[0].y, in[1].y, in[2].y, in[3].y);
+    const __m128 z = _mm_setr_ps(in[0].z, in[1].z, in[2].z, in[3].z);
+
+    const __m128 inv = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(sse_abs(x), sse_abs(y)), sse_abs(z)));
+    const __m128 px = _mm_mul_ps(x, inv);
+    const __m128 py = _mm_mul_ps(y, inv);
+    const __m128 fx = _mm_mul_ps(_mm_sub_ps(one, sse_abs(py)), sse_copysign(one, px));
+    const __m128 fy = _mm_mul_ps(_mm_sub_ps(one, sse_abs(px)), sse_copysign(one, py));
+    const __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+
+    const __m128 lo = _mm_set1_ps(-1.0f), scale = _mm_set1_ps(SNORM16_SCALE);
+    const __m128 ox = _mm_min_ps(_mm_max_ps(sse_select(lower, fx, px), lo), one);
+    const __m128 oy = _mm_min_ps(_mm_max_ps(sse_select(lower, fy, py), lo), one);
+    const __m128i qx = _mm_cvtps_epi32(_mm_mul_ps(ox, scale));
+    const __m128i qy = _mm_cvtps_epi32(_mm_mul_ps(oy, scale));
+    // Interleave x and y, then saturate to 16 bits: x0 y0 x1 y1 ...
+    const __m128i q = _mm_packs_epi32(_mm_unpacklo_epi32(qx, qy), _mm_unpackhi_epi32(qx, qy));
+    _mm_storeu_si128((__m128i*)out, q);
+}
+
+lt_internal void
+octahedral_unpack_block4(const Octahedral32 *in, Vec3f *out)
+{
+    const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+    const __m128i q = _mm_loadu_si128((const __m128i*)in);
+    // Sign extend x (low half of every 32 bits) and y (high half).
+    const __m128i qx = _mm_srai_epi32(_mm_slli_epi32(q, 16), 16);
+    const __m128i qy = _mm_srai_epi32(q, 16);
+
+    const __m128 lo = _mm_set1_ps(-1.0f), inv_scale = _mm_set1_ps(SNORM16_INV_SCALE);
+    __m128 x = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(qx), inv_scale), lo);
+    __m128 y = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(qy), inv_scale), lo);
+    const __m128 z = _mm_sub_ps(_mm_sub_ps(one, sse_abs(x)), sse_abs(y));
+    const __m128 t = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+    x = _mm_sub_ps(x, sse_copysign(t, x));
+    y = _mm_sub_ps(y, sse_copysign(t, y));
+
+    const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+    const __m128 inv_len = _mm_div_ps(one, len);
+
+    alignas(16) f32 rx[4], ry[4], rz[4];
+    _mm_store_ps(rx, _mm_mul_ps(x, inv_len));
+    _mm_store_ps(ry, _mm_mul_ps(y, inv_len));
+    _mm_store_ps(rz, _mm_mul_ps(z, inv_len));
+    for (i32 i = 0; i < 4; i++) out[i] = Vec3f(rx[i], ry[i], rz[i]);
+}
+#else
+lt_internal void
+octahedral_pack_block4(const Vec3f *in, Octahedral32 *out)
+{
+    for (i32 i = 0; i < 4; i++)
+    {
+        const Vec3f v = in[i];
+        const f32 inv = 1.0f / (std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z));
+        f32 px = v.x * inv;
+        f32 py = v.y * inv;
+        if (v.z < 0)
+        {
+            const f32 fx = (1.0f - std::fabs(py)) * std::copysign(1.0f, px);
+            const f32 fy = (1.0f - std::fabs(px)) * std::copysign(1.0f, py);
+            px = fx;
+            py = fy;
+        }
+        out[i] = Octahedral32{snorm16_from_f32(px), snorm16_from_f32(py)};
+    }
+}
+
+lt_internal void
+octahedral_unpack_block4(const Octahedral32 *in, Vec3f *out)
+{
+    for (i32 i = 0; i < 4; i++)
+    {
+        f32 x = snorm16_to_f32(in[i].x);
+        f32 y = snorm16_to_f32(in[i].y);
+        const f32 z = (1.0f - std::fabs(x)) - std::fabs(y);
+        const f32 t = std::max(0.0f - z, 0.0f);
+        x -= std::copysign(t, x);
+        y -= std::copysign(t, y);
+        const f32 inv_len = 1.0f / std::sqrt(x*x + y*y + z*z);
+        out[i] = Vec3f(x * inv_len, y * inv_len, z * inv_len);
+    }
+}
+#endif
+
+Octahedral32
+lt::pack_octahedral(Vec3f v)
+{
+    Octahedral32 ret;
+    for_each_block4(&v, &ret, 1, octahedral_pack_block4);
+    return ret;
+}
+
+Vec3f
+lt::unpack_octahedral(Octahedral32 v)
+{
+    Vec3f ret;
+    for_each_block4(&v, &ret, 1, octahedral_unpack_block4);
+    return ret;
+}
+
+void
+lt::pack_octahedral(const Vec3f *in, Octahedral32 *out, usize count)
+{
+    for_each_block4(in, out, count, octahedral_pack_block4);
+}
+
+void
+lt::unpack_octahedral(const Octahedral32 *in, Vec3f *out, usize count)
+{
+    for_each_block4(in, out, count, octahedral_unpack_block4);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Smallest three quaternions
+//
+// The component with the largest magnitude is dropped (the quaternion is negated to make it
+// positive) and rebuilt from the unit length on unpack. The other three are within
+// [-1/sqrt(2), 1/sqrt(2)] and are quantized to `bits` each, in w, x, y, z order.
+//
+// Quat32: index << 30 | a << 20 | b << 10 | c
+// Quat48: index << 45 | a << 30 | b << 15 | c, stored as three little endian u16.
+//
+
+#define QUAT_RANGE     1.41421356f // sqrt(2)
+#define QUAT_INV_RANGE 0.70710678f
+
+struct QuatQuantized
+{
+    alignas(16) i32 index[4];
+    alignas(16) i32 a[4], b[4], c[4];
+};
+
+struct QuatComponents
+{
+    alignas(16) i32 index[4];
+    alignas(16) f32 a[4], b[4], c[4];
+};
+
+#if defined(__SSE2__)
+lt_internal void
+quat_quantize_block4(const Quatf *in, i32 bits, QuatQuantized *out)
+{
+    __m128 w = _mm_loadu_ps(in[0].val);
+    __m128 x = _mm_loadu_ps(in[1].val);
+    __m128 y = _mm_loadu_ps(in[2].val);
+    __m128 z = _mm_loadu_ps(in[3].val);
+    _MM_TRANSPOSE4_PS(w, x, y, z);
+
+    // Largest magnitude, the first one wins on ties.
+    __m128 m = sse_abs(w), largest = w;
+    __m128i index = _mm_setzero_si128();
+    __m128 gt = _mm_cmpgt_ps(sse_abs(x), m);
+    m = sse_select(gt, sse_abs(x), m); largest = sse_select(gt, x, largest);
+    index = _mm_or_si128(_mm_andnot_si128(_mm_castps_si128(gt), index), _mm_and_si128(_mm_castps_si128(gt), _mm_set1_epi32(1)));
+    gt = _mm_cmpgt_ps(sse_abs(y), m);
+    m = sse_select(gt, sse_abs(y), m); largest = sse_select(gt, y, largest);
+    index = _mm_or_si128(_mm_andnot_si128(_mm_castps_si128(gt), index), _mm_and_si128(_mm_castps_si128(gt), _mm_set1_epi32(2)));
+    gt = _mm_cmpgt_ps(sse_abs(z), m);
+    largest = sse_select(gt, z, largest);
+    index = _mm_or_si128(_mm_andnot_si128(_mm_castps_si128(gt), index), _mm_and_si128(_mm_castps_si128(gt), _mm_set1_epi32(3)));
+
+    // Negate when the dropped component is negative.
+    const __m128 flip = _mm_and_ps(largest, _mm_set1_ps(-0.0f));
+    w = _mm_xor_ps(w, flip); x = _mm_xor_ps(x, flip); y = _mm_xor_ps(y, flip); z = _mm_xor_ps(z, flip);
+
+    const __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_setzero_si128()));
+    const __m128 le1 = _mm_castsi128_ps(_mm_cmplt_epi32(index, _mm_set1_epi32(2)));
+    const __m128 le2 = _mm_castsi128_ps(_mm_cmplt_epi32(index, _mm_set1_epi32(3)));
+    const __m128 a = sse_select(is0, x, w);
+    const __m128 b = sse_select(le1, y, x);
+    const __m128 c = sse_select(le2, z, y);
+
+    const f32 max_q = (f32)((1 << bits) - 1);
+    const __m128 k = _mm_set1_ps(QUAT_INV_RANGE * max_q);
+    const __m128 half = _mm_set1_ps(0.5f * max_q);
+    const __m128 zero = _mm_setzero_ps(), top = _mm_set1_ps(max_q);
+    auto quantize = [&](__m128 v) {
+        return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(v, k), half), zero), top));
+    };
+    _mm_store_si128((__m128i*)out->index, index);
+    _mm_store_si128((__m128i*)out->a, quantize(a));
+    _mm_store_si128((__m128i*)out->b, quantize(b));
+    _mm_store_si128((__m128i*)out->c, quantize(c));
+}
+
+lt_internal void
+quat_dequantize_block4(const QuatQuantized *in, i32 bits, Quatf *out)
+{
+    const f32 max_q = (f32)((1 << bits) - 1);
+    const __m128 k = _mm_set1_ps(QUAT_RANGE / max_q);
+    const __m128 offset = _mm_set1_ps(QUAT_INV_RANGE);
+    auto dequantize = [&](const i32 *q) {
+        return _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128((const __m128i*)q)), k), offset);
+    };
+    const __m128 a = dequantize(in->a);
+    const __m128 b = dequantize(in->b);
+    const __m128 c = dequantize(in->c);
+    const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c));
+    const __m128 l = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), sum), _mm_setzero_ps()));
+
+    const __m128i index = _mm_load_si128((const __m128i*)in->index);
+    const __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_setzero_si128()));
+    const __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(1)));
+    const __m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(2)));
+    const __m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(3)));
+    const __m128 le1 = _mm_or_ps(is0, is1);
+
+    __m128 w = sse_select(is0, l, a);
+    __m128 x = sse_select(is0, a, sse_select(is1, l, b));
+    __m128 y = sse_select(le1, b, sse_select(is2, l, c));
+    __m128 z = sse_select(is3, l, c);
+    _MM_TRANSPOSE4_PS(w, x, y, z);
+    _mm_storeu_ps(out[0].val, w);
+    _mm_storeu_ps(out[1].val, x);
+    _mm_storeu_ps(out[2].val, y);
+    _mm_storeu_ps(out[3].val, z);
+}
+#else
+lt_internal void
+quat_quantize_block4(const Quatf *in, i32 bits, QuatQuantized *out)
+{
+    const f32 max_q = (f32)((1 << bits) - 1);
+    const f32 k = QUAT_INV_RANGE * max_q;
+    const f32 half = 0.5f * max_q;
+    auto quantize = [&](f32 v) {
+        return (i32)std::nearbyint(std::min(std::max(v * k + half, 0.0f), max_q));
+    };
+
+    for (i32 i = 0; i < 4; i++)
+    {
+        const f32 *q = in[i].val;
+        i32 index = 0;
+        for (i32 j = 1; j < 4; j++)
+            if (std::fabs(q[j]) > std::fabs(q[index])) index = j;
+        const f32 sign = (q[index] < 0) ? -1.0f : 1.0f;
+
+        f32 rest[3];
+        for (i32 j = 0, r = 0; j < 4; j++)
+            if (j != index) rest[r++] = q[j] * sign;
+
+        out->index[i] = index;
+        out->a[i] = quantize(rest[0]);
+        out->b[i] = quantize(rest[1]);
+        out->c[i] = quantize(rest[2]);
+    }
+}
+
+lt_internal void
+quat_dequantize_block4(const QuatQuantized *in, i32 bits, Quatf *out)
+{
+    const f32 max_q = (f32)((1 << bits) - 1);
+    const f32 k = QUAT_RANGE / max_q;
+    for (i32 i = 0; i < 4; i++)
+    {
+        const f32 a = (f32)in->a[i] * k - QUAT_INV_RANGE;
+        const f32 b = (f32)in->b[i] * k - QUAT_INV_RANGE;
+        const f32 c = (f32)in->c[i] * k - QUAT_INV_RANGE;
+        const f32 l = std::sqrt(std::max(1.0f - (a*a + b*b + c*c), 0.0f));
+
+        const i32 index = in->index[i];
+        f32 rest[3] = {a, b, c};
+        for (i32 j = 0, r = 0; j < 4; j++)
+            out[i].val[j] = (j == index) ? l : rest[r++];
+    }
+}
+#endif
+
+lt_internal void
+quat32_pack_block4(const Quatf *in, Quat32 *out)
+{
+    QuatQuantized q;
+    quat_quantize_block4(in, 10, &q);
+    for (i32 i = 0; i < 4; i++)
+        out[i].bits = ((u32)q.index[i] << 30) | ((u32)q.a[i] << 20) | ((u32)q.b[i] << 10) | (u32)q.c[i];
+}
+
+lt_internal void
+quat32_unpack_block4(const Quat32 *in, Quatf *out)
+{
+    QuatQuantized q;
+    for (i32 i = 0; i < 4; i++)
+    {
+        const u32 bits = in[i].bits;
+        q.index[i] = (i32)(bits >> 30);
+        q.a[i] = (i32)((bits >> 20) & 1023);
+        q.b[i] = (i32)((bits >> 10) & 1023);
+        q.c[i] = (i32)(bits & 1023);
+    }
+    quat_dequantize_block4(&q, 10, out);
+}
+
+lt_internal void
+quat48_pack_block4(const Quatf *in, Quat48 *out)
+{
+    QuatQuantized q;
+    quat_quantize_block4(in, 15, &q);
+    for (i32 i = 0; i < 4; i++)
+    {
+        const u64 bits = ((u64)q.index[i] << 45) | ((u64)q.a[i] << 30) | ((u64)q.b[i] << 15) | (u64)q.c[i];
+        out[i].bits[0] = (u16)bits;
+        out[i].bits[1] = (u16)(bits >> 16);
+        out[i].bits[2] = (u16)(bits >> 32);
+    }
+}
+
+lt_internal void
+quat48_unpack_block4(const Quat48 *in, Quatf *out)
+{
+    QuatQuantized q;
+    for (i32 i = 0; i < 4; i++)
+    {
+        const u64 bits = (u64)in[i].bits[0] | ((u64)in[i].bits[1] << 16) | ((u64)in[i].bits[2] << 32);
+        q.index[i] = (i32)(bits >> 45);
+        q.a[i] = (i32)((bits >> 30) & 32767);
+        q.b[i] = (i32)((bits >> 15) & 32767);
+        q.c[i] = (i32)(bits & 32767);
+    }
+    quat_dequantize_block4(&q, 15, out);
+}
+
+Quat32
+lt::pack_quat32(const Quatf &q)
+{
+    Quat32 ret;
+    for_each_block4(&q, &ret, 1, quat32_pack_block4);
+    return ret;
+}
+
+Quatf
+lt::unpack_quat32(Quat32 q)
+{
+    Quatf ret;
+    for_each_block4(&q, &ret, 1, quat32_unpack_block4);
+    return ret;
+}
+
+Quat48
+lt::pack_quat48(const Quatf &q)
+{
+    Quat48 ret;
+    for_each_block4(&q, &ret, 1, quat48_pack_block4);
+    return ret;
+}
+
+Quatf
+lt::unpack_quat48(Quat48 q)
+{
+    Quatf ret;
+    for_each_block4(&q, &ret, 1, quat48_unpack_block4);
+    return ret;
+}
+
+void
+lt::pack_quat32(const Quatf *in, Quat32 *out, usize count)
+{
+    for_each_block4(in, out, count, quat32_pack_block4);
+}
+
+void
+lt::unpack_quat32(const Quat32 *in, Quatf *out, usize count)
+{
+    for_each_block4(in, out, count, quat32_unpack_block4);
+}
+
+void
+lt::pack_quat48(const Quatf *in, Quat48 *out, usize count)
+{
+    for_each_block4(in, out, count, quat48_pack_block4);
+}
+
+void
+lt::unpack_quat48(const Quat48 *in, Quatf *out, usize count)
+{
+    for_each_block4(in, out, count, quat48_unpack_block4);
+}
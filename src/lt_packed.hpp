@@ -0,0 +1,103 @@
+#ifndef LT_PACKED_HPP
+#define LT_PACKED_HPP
+
+#include "lt_core.hpp"
+#include "lt_math.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Packed formats
+//
+// Compact storage for vectors and rotations. Every format has a single value version and a
+// batch version working on arrays. Halves use F16C when the CPU has it (picked at run time,
+// see half_kernel_name), the rest SSE2. Both give the same bits as the single value versions.
+//
+// Precision (worst cases, see each format for the exact rule):
+//
+//   Vec3h / Vec4h    IEEE half, round to nearest even. Relative error <= 2^-11 (4.9e-4) for
+//                    |x| in [6.1e-5, 65504], absolute error <= 2^-25 below that, larger
+//                    values become inf. NaN keeps the top of its payload.
+//   Snorm16x3        Components clamped to [-1, 1], NaN becomes 0. Absolute error <= 1.54e-5
+//                    (half a step, 1/65534, plus the float rounding).
+//   Octahedral32     Unit vectors in 2x16 bits. Angular error <= 0.004 degrees.
+//   Quat32           Smallest three, 2 + 3x10 bits. Component error <= 2.1e-3 (the rebuilt
+//                    component takes the error of the other three), angular error <= 0.28
+//                    degrees. Random rotations stay around 1.8e-3 and 0.25 degrees.
+//   Quat48           Smallest three, 2 + 3x15 bits. Component error <= 6.5e-5, angular error
+//                    <= 0.0086 degrees. Random rotations stay around 5.5e-5 and 0.0075 degrees.
+//
+// Quaternions must be normalized. q and -q are the same rotation, and the unpacked
+// quaternion may come back as either.
+//
+
+struct Vec3h
+{
+    u16 x, y, z;
+};
+
+struct Vec4h
+{
+    u16 x, y, z, w;
+};
+
+struct Snorm16x3
+{
+    i16 x, y, z;
+};
+
+struct Octahedral32
+{
+    i16 x, y;
+};
+
+struct Quat32
+{
+    u32 bits;
+};
+
+struct Quat48
+{
+    u16 bits[3];
+};
+
+namespace lt
+{
+
+u16 f32_to_f16(f32 f);
+f32 f16_to_f32(u16 h);
+void f32_to_f16(const f32 *in, u16 *out, usize count);
+void f16_to_f32(const u16 *in, f32 *out, usize count);
+const char *half_kernel_name();
+
+Vec3h pack_vec3h(Vec3f v);
+Vec3f unpack_vec3h(Vec3h v);
+Vec4h pack_vec4h(Vec4f v);
+Vec4f unpack_vec4h(Vec4h v);
+void  pack_vec3h(const Vec3f *in, Vec3h *out, usize count);
+void  unpack_vec3h(const Vec3h *in, Vec3f *out, usize count);
+void  pack_vec4h(const Vec4f *in, Vec4h *out, usize count);
+void  unpack_vec4h(const Vec4h *in, Vec4f *out, usize count);
+
+Snorm16x3 pack_snorm16(Vec3f v);
+Vec3f     unpack_snorm16(Snorm16x3 v);
+void      pack_snorm16(const Vec3f *in, Snorm16x3 *out, usize count);
+void      unpack_snorm16(const Snorm16x3 *in, Vec3f *out, usize count);
+
+// `v` must be normalized, the unpacked vector is normalized.
+Octahedral32 pack_octahedral(Vec3f v);
+Vec3f        unpack_octahedral(Octahedral32 v);
+void         pack_octahedral(const Vec3f *in, Octahedral32 *out, usize count);
+void         unpack_octahedral(const Octahedral32 *in, Vec3f *out, usize count);
+
+Quat32 pack_quat32(const Quatf &q);
+Quatf  unpack_quat32(Quat32 q);
+Quat48 pack_quat48(const Quatf &q);
+Quatf  unpack_quat48(Quat48 q);
+void   pack_quat32(const Quatf *in, Quat32 *out, usize count);
+void   unpack_quat32(const Quat32 *in, Quatf *out, usize count);
+void   pack_quat48(const Quatf *in, Quat48 *out, usize count);
+void   unpack_quat48(const Quat48 *in, Quatf *out, usize count);
+
+}
+
+#endif // LT_PACKED_HPP
@@ -0,0 +1,55 @@
+#ifndef LT_PARALLEL_HPP
+#define LT_PARALLEL_HPP
+
+#include <thread>
+#include <vector>
+#include "lt_core.hpp"
+
+namespace lt
+{
+
+inline u32
+worker_count()
+{
+    u32 n = std::thread::hardware_concurrency();
+    return (n > 0) ? n : 1;
+}
+
+// Splits [0, count) into contiguous ranges of at least `grain` items and calls fn(begin, end)
+// for each one. The calling thread always takes the first range, so a single range never
+// spawns a thread.
+template<typename F> void
+parallel_for(usize count, usize grain, const F &fn)
+{
+    if (count == 0) return;
+    if (grain == 0) grain = 1;
+
+    usize num_ranges = (count + grain - 1) / grain;
+    if (num_ranges > worker_count()) num_ranges = worker_count();
+
+    if (num_ranges <= 1)
+    {
+        fn((usize)0, count);
+        return;
+    }
+
+    const usize per_range = (count + num_ranges - 1) / num_ranges;
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_ranges - 1);
+    for (usize r = 1; r < num_ranges; r++)
+    {
+        usize begin = r * per_range;
+        usize end = (begin + per_range < count) ? begin + per_range : count;
+        if (begin >= end) break;
+        threads.emplace_back([&fn, begin, end]() { fn(begin, end); });
+    }
+
+    fn((usize)0, (per_range < count) ? per_range : count);
+
+    for (auto &t : threads) t.join();
+}
+
+}
+
+#endif // LT_PARALLEL_HPP
@@ -0,0 +1,489 @@
+#include "lt_perf.hpp"
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#if LT_FLIGHT_RECORDER
+#include "lt_flight.hpp"
+#endif
+
+#if LT_OS_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+lt_global_variable const char *g_counter_names[PerfCounter_Count] = {
+    "cycles",
+    "instructions",
+    "cache-misses",
+    "branch-misses",
+    "stalled-cycles-frontend",
+    "stalled-cycles-backend",
+};
+
+lt_global_variable std::atomic<PerfRegion*> g_regions{nullptr};
+lt_global_variable std::atomic<u32>         g_num_regions{0};
+
+PerfRegion::PerfRegion(const char *name)
+    : name(name), index(g_num_regions.fetch_add(1, std::memory_order_relaxed))
+{
+    next = g_regions.load(std::memory_order_relaxed);
+    while (!g_regions.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+const char *
+lt::perf_counter_name(PerfCounter counter)
+{
+    return (counter >= 0 && counter < PerfCounter_Count) ? g_counter_names[counter] : "unknown";
+}
+
+#if LT_OS_LINUX
+
+struct PerfEvent
+{
+    u32 type;
+    u64 config;
+};
+
+lt_global_variable const PerfEvent g_events[PerfCounter_Count] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+};
+
+// Counters of the calling thread, all in one group so they are scheduled together.
+struct PerfThreadGroup
+{
+    bool                   opened = false;
+    int                    leader = -1;
+    int                    fds[PerfCounter_Count];
+    perf_event_mmap_page  *pages[PerfCounter_Count] = {};
+    u32                    slot[PerfCounter_Count] = {};  // Position in the group read.
+    u32                    num_events = 0;
+    u32                    available = 0;
+
+    PerfThreadGroup()
+    {
+        for (int &fd : fds) fd = -1;
+    }
+
+    ~PerfThreadGroup()
+    {
+        const long page_size = sysconf(_SC_PAGESIZE);
+        for (i32 c = 0; c < PerfCounter_Count; c++)
+        {
+            if (pages[c]) munmap(pages[c], (usize)page_size);
+            if (fds[c] >= 0) close(fds[c]);
+        }
+    }
+};
+
+lt_internal thread_local PerfThreadGroup t_group;
+
+lt_internal void
+open_group(PerfThreadGroup *group)
+{
+    group->opened = true;
+    const long page_size = sysconf(_SC_PAGESIZE);
+
+    for (i32 c = 0; c < PerfCounter_Count; c++)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = g_events[c].type;
+        attr.config = g_events[c].config;
+        attr.disabled = (group->leader < 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // Unsupported events fail here (ENOENT, EOPNOTSUPP) and are left out of the group. The
+        // first event that opens leads it.
+        const int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group->leader, PERF_FLAG_FD_CLOEXEC);
+        if (fd < 0) continue;
+
+        if (group->leader < 0) group->leader = fd;
+        group->fds[c] = fd;
+        group->slot[c] = group->num_events++;
+        group->available |= 1u << c;
+
+        void *page = mmap(NULL, (usize)page_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (page != MAP_FAILED) group->pages[c] = (perf_event_mmap_page*)page;
+    }
+
+    if (group->leader >= 0) ioctl(group->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+lt_internal inline PerfThreadGroup *
+thread_group()
+{
+    if (!t_group.opened) open_group(&t_group);
+    return &t_group;
+}
+
+#if LT_ARCH_X86
+lt_internal inline u64
+read_pmc(u32 index)
+{
+    u32 lo, hi;
+    __asm__ volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(index));
+    return (u64)lo | ((u64)hi << 32);
+}
+#endif
+
+// User space read through the mapped page. Fails when the kernel does not allow rdpmc or the
+// counter is not on a hardware register right now (index 0).
+lt_internal bool
+read_with_rdpmc(const perf_event_mmap_page *page, u64 *value)
+{
+#if LT_ARCH_X86
+    if (!page) return false;
+    u32 seq;
+    u64 count;
+    do
+    {
+        seq = page->lock;
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        const u32 index = page->index;
+        if (!page->cap_user_rdpmc || index == 0) return false;
+
+        const u32 width = page->pmc_width;
+        i64 pmc = (i64)read_pmc(index - 1);
+        pmc = (i64)((u64)pmc << (64 - width)) >> (64 - width);
+        count = (u64)((i64)page->offset + pmc);
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    } while (page->lock != seq);
+
+    *value = count;
+    return true;
+#else
+    LT_Unused(page);
+    LT_Unused(value);
+    return false;
+#endif
+}
+
+// One read() for the whole group. The values are the raw counts of the time the group was on
+// the PMU, scale them with the time fields.
+lt_internal bool
+read_group(const PerfThreadGroup *group, PerfSample *sample)
+{
+    u64 buffer[3 + PerfCounter_Count];
+    const ssize_t n = read(group->leader, buffer, sizeof(buffer));
+    if (n < (ssize_t)(3 * sizeof(u64)) || buffer[0] != group->num_events) return false;
+
+    sample->time_enabled = buffer[1];
+    sample->time_running = buffer[2];
+    for (i32 c = 0; c < PerfCounter_Count; c++)
+    {
+        if (!(group->available & (1u << c))) continue;
+        sample->values[c] = buffer[3 + group->slot[c]];
+        sample->valid |= 1u << c;
+    }
+    sample->source = PerfSource_Read;
+    return true;
+}
+
+// Reads the group with rdpmc (PerfSource_Rdpmc), with read() (PerfSource_Read), or with rdpmc
+// falling back to read() when the kernel does not allow it right now (PerfSource_None).
+lt_internal bool
+read_counters(u32 source, PerfSample *sample)
+{
+    memset(sample, 0, sizeof(*sample));
+    PerfThreadGroup *group = thread_group();
+    sample->ticks = lt::rdtsc();
+    if (!group->available) return false;
+
+    if (source != PerfSource_Read)
+    {
+        bool all_rdpmc = true;
+        for (i32 c = 0; c < PerfCounter_Count && all_rdpmc; c++)
+        {
+            if (!(group->available & (1u << c))) continue;
+            all_rdpmc = read_with_rdpmc(group->pages[c], &sample->values[c]);
+        }
+        if (all_rdpmc)
+        {
+            sample->valid = group->available;
+            sample->source = PerfSource_Rdpmc;
+            return true;
+        }
+        if (source == PerfSource_Rdpmc) return false;
+    }
+    return read_group(group, sample);
+}
+
+u32
+lt::perf_available()
+{
+    return thread_group()->available;
+}
+
+bool
+lt::perf_read(PerfSample *sample)
+{
+    if (!read_counters(PerfSource_None, sample)) return false;
+    if (sample->source == PerfSource_Read)
+    {
+        if (sample->time_running == 0) return false;
+        if (sample->time_running < sample->time_enabled)
+        {
+            const f64 scale = (f64)sample->time_enabled / (f64)sample->time_running;
+            for (u64 &v : sample->values) v = (u64)((f64)v * scale);
+        }
+    }
+    return true;
+}
+
+#else
+
+lt_internal bool
+read_counters(u32 source, PerfSample *sample)
+{
+    LT_Unused(source);
+    memset(sample, 0, sizeof(*sample));
+    sample->ticks = lt::rdtsc();
+    return false;
+}
+
+u32
+lt::perf_available()
+{
+    return 0;
+}
+
+bool
+lt::perf_read(PerfSample *sample)
+{
+    memset(sample, 0, sizeof(*sample));
+    sample->ticks = rdtsc();
+    return false;
+}
+
+#endif // LT_OS_LINUX
+
+/////////////////////////////////////////////////////////
+//
+// Per thread totals
+//
+// Every thread gets a PerfTotals per region index the first time it closes a scope. Only the
+// owner writes them, with plain relaxed loads and stores, and perf_report reads them under
+// g_threads_mutex. An exiting thread adds its totals to the regions' shared ones.
+//
+
+struct PerfThreadTotals
+{
+    PerfTotals        regions[LT_PERF_MAX_REGIONS];
+    PerfThreadTotals *next = nullptr;
+};
+
+lt_global_variable std::mutex        g_threads_mutex;
+lt_global_variable PerfThreadTotals *g_threads = nullptr;
+
+lt_internal void
+totals_add(std::atomic<u64> *a, u64 v, bool shared)
+{
+    if (shared) a->fetch_add(v, std::memory_order_relaxed);
+    else a->store(a->load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+lt_internal void
+totals_merge(PerfTotals *to, const PerfTotals &from)
+{
+    to->calls.fetch_add(from.calls.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    to->elements.fetch_add(from.elements.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    to->ticks.fetch_add(from.ticks.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    to->counted_elements.fetch_add(from.counted_elements.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    to->failed.fetch_add(from.failed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    for (i32 c = 0; c < PerfCounter_Count; c++)
+        to->values[c].fetch_add(from.values[c].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    to->counted.fetch_or(from.counted.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+lt_internal void
+totals_clear(PerfTotals *t)
+{
+    t->calls.store(0, std::memory_order_relaxed);
+    t->elements.store(0, std::memory_order_relaxed);
+    t->ticks.store(0, std::memory_order_relaxed);
+    t->counted_elements.store(0, std::memory_order_relaxed);
+    t->failed.store(0, std::memory_order_relaxed);
+    for (auto &v : t->values) v.store(0, std::memory_order_relaxed);
+    t->counted.store(0, std::memory_order_relaxed);
+}
+
+struct PerfThreadTotalsOwner
+{
+    PerfThreadTotals *totals = nullptr;
+    bool              failed = false;  // Allocation failed, use the shared totals.
+
+    ~PerfThreadTotalsOwner()
+    {
+        if (!totals) return;
+        std::lock_guard<std::mutex> lock(g_threads_mutex);
+        PerfThreadTotals **link = &g_threads;
+        while (*link != totals) link = &(*link)->next;
+        *link = totals->next;
+        for (PerfRegion *r = g_regions.load(std::memory_order_acquire); r; r = r->next)
+            if (r->index < LT_PERF_MAX_REGIONS) totals_merge(&r->totals, totals->regions[r->index]);
+        totals->~PerfThreadTotals();
+        LT_Free(totals);
+    }
+};
+
+lt_internal thread_local PerfThreadTotalsOwner t_totals;
+
+// The calling thread's totals of `region`, or the shared ones (`*shared` set).
+lt_internal PerfTotals *
+thread_totals(PerfRegion *region, bool *shared)
+{
+    *shared = true;
+    if (region->index >= LT_PERF_MAX_REGIONS) return &region->totals;
+    if (!t_totals.totals && !t_totals.failed)
+    {
+        void *memory = LT_Malloc(sizeof(PerfThreadTotals), MemoryTag_General);
+        if (!memory)
+        {
+            t_totals.failed = true;
+            return &region->totals;
+        }
+        PerfThreadTotals *totals = new (memory) PerfThreadTotals();
+        std::lock_guard<std::mutex> lock(g_threads_mutex);
+        totals->next = g_threads;
+        g_threads = totals;
+        t_totals.totals = totals;
+    }
+    if (!t_totals.totals) return &region->totals;
+    *shared = false;
+    return &t_totals.totals->regions[region->index];
+}
+
+lt::PerfScope::PerfScope(PerfRegion *region, u64 elements)
+    : m_region(region), m_elements(elements)
+{
+#if LT_FLIGHT_RECORDER
+    flight_event(FlightEvent_ScopeBegin, region->name, 0);
+#endif
+    read_counters(PerfSource_None, &m_start);
+}
+
+lt::PerfScope::~PerfScope()
+{
+    // The end goes through the same path as the start: a raw rdpmc count minus a scaled group
+    // read is meaningless.
+    const u32 expected = perf_available();
+    PerfSample end;
+    const bool read = read_counters(m_start.source, &end) && m_start.source != PerfSource_None &&
+        end.source == m_start.source;
+#if LT_FLIGHT_RECORDER
+    flight_event(FlightEvent_ScopeEnd, m_region->name, end.ticks - m_start.ticks);
+#endif
+
+    // Group reads are scaled by the share of the scope the group spent on the PMU.
+    u64 deltas[PerfCounter_Count] = {};
+    bool ok = read && (m_start.valid & end.valid) == expected;
+    f64 scale = 1.0;
+    if (ok && end.source == PerfSource_Read)
+    {
+        const u64 enabled = end.time_enabled - m_start.time_enabled;
+        const u64 running = end.time_running - m_start.time_running;
+        ok = running > 0;
+        if (running < enabled) scale = (f64)enabled / (f64)running;
+    }
+    for (i32 c = 0; c < PerfCounter_Count && ok; c++)
+    {
+        if (!(expected & (1u << c))) continue;
+        ok = end.values[c] >= m_start.values[c];
+        deltas[c] = (u64)((f64)(end.values[c] - m_start.values[c]) * scale);
+    }
+
+    bool shared;
+    PerfTotals *t = thread_totals(m_region, &shared);
+    totals_add(&t->calls, 1, shared);
+    totals_add(&t->elements, m_elements, shared);
+    totals_add(&t->ticks, end.ticks - m_start.ticks, shared);
+    if (!expected) return;
+    if (!ok)
+    {
+        totals_add(&t->failed, 1, shared);
+        return;
+    }
+    totals_add(&t->counted_elements, m_elements, shared);
+    for (i32 c = 0; c < PerfCounter_Count; c++)
+        if (expected & (1u << c)) totals_add(&t->values[c], deltas[c], shared);
+    if ((t->counted.load(std::memory_order_relaxed) & expected) != expected)
+        t->counted.fetch_or(expected, std::memory_order_relaxed);
+}
+
+void
+lt::perf_reset()
+{
+    std::lock_guard<std::mutex> lock(g_threads_mutex);
+    for (PerfRegion *r = g_regions.load(std::memory_order_acquire); r; r = r->next)
+    {
+        totals_clear(&r->totals);
+        if (r->index >= LT_PERF_MAX_REGIONS) continue;
+        for (PerfThreadTotals *t = g_threads; t; t = t->next) totals_clear(&t->regions[r->index]);
+    }
+}
+
+// Prints `num / den` with the given precision, or n/a when the counter is missing.
+lt_internal void
+print_ratio(FILE *out, bool valid, f64 num, f64 den, const char *format)
+{
+    if (valid && den > 0) fprintf(out, format, num / den);
+    else fprintf(out, " %10s", "n/a");
+}
+
+void
+lt::perf_report(FILE *out)
+{
+    const u32 available = perf_available();
+    fprintf(out, "[perf] counters:");
+    for (i32 c = 0; c < PerfCounter_Count; c++)
+        fprintf(out, " %s%s", g_counter_names[c], (available & (1u << c)) ? "" : " (n/a)");
+    fprintf(out, "\n");
+
+    fprintf(out, "[perf] %-24s %10s %12s %10s %10s %10s %10s %10s %10s %10s %10s\n", "region", "calls", "elements",
+            "ticks/el", "cycles/el", "IPC", "cmiss/el", "bmiss/el", "fe-stall%", "be-stall%", "failed");
+
+    std::lock_guard<std::mutex> lock(g_threads_mutex);
+    for (PerfRegion *r = g_regions.load(std::memory_order_acquire); r; r = r->next)
+    {
+        PerfTotals sum;
+        totals_merge(&sum, r->totals);
+        if (r->index < LT_PERF_MAX_REGIONS)
+            for (PerfThreadTotals *t = g_threads; t; t = t->next) totals_merge(&sum, t->regions[r->index]);
+
+        const u64 calls = sum.calls.load(std::memory_order_relaxed);
+        if (calls == 0) continue;
+
+        // Counter ratios are over the scopes that read the counters.
+        const f64 elements = (f64)sum.elements.load(std::memory_order_relaxed);
+        const f64 counted_elements = (f64)sum.counted_elements.load(std::memory_order_relaxed);
+        const u32 counted = sum.counted.load(std::memory_order_relaxed);
+        f64 v[PerfCounter_Count];
+        for (i32 c = 0; c < PerfCounter_Count; c++) v[c] = (f64)sum.values[c].load(std::memory_order_relaxed);
+        auto has = [&](PerfCounter c) { return (counted & (1u << c)) != 0; };
+
+        fprintf(out, "[perf] %-24s %10llu %12.0f", r->name, (unsigned long long)calls, elements);
+        print_ratio(out, true, (f64)sum.ticks.load(std::memory_order_relaxed), elements, " %10.2f");
+        print_ratio(out, has(PerfCounter_Cycles), v[PerfCounter_Cycles], counted_elements, " %10.2f");
+        print_ratio(out, has(PerfCounter_Cycles) && has(PerfCounter_Instructions),
+                    v[PerfCounter_Instructions], v[PerfCounter_Cycles], " %10.2f");
+        print_ratio(out, has(PerfCounter_CacheMisses), v[PerfCounter_CacheMisses], counted_elements, " %10.4f");
+        print_ratio(out, has(PerfCounter_BranchMisses), v[PerfCounter_BranchMisses], counted_elements, " %10.4f");
+        print_ratio(out, has(PerfCounter_Cycles) && has(PerfCounter_StalledCyclesFrontend),
+                    100.0 * v[PerfCounter_StalledCyclesFrontend], v[PerfCounter_Cycles], " %10.1f");
+        print_ratio(out, has(PerfCounter_Cycles) && has(PerfCounter_StalledCyclesBackend),
+                    100.0 * v[PerfCounter_StalledCyclesBackend], v[PerfCounter_Cycles], " %10.1f");
+        fprintf(out, " %10llu\n", (unsigned long long)sum.failed.load(std::memory_order_relaxed));
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef LT_PERF_HPP
+#define LT_PERF_HPP
+
+#include <atomic>
+#include <cstdio>
+#include "lt_core.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Performance counters
+//
+// Scoped hardware counter collection with perf_event_open (Linux). Every thread opens one
+// counter group the first time it enters a scope, and the group is read with rdpmc when the
+// kernel allows user space reads, or with a single read() of the whole group otherwise.
+// Both ends of a scope are read the same way, so rdpmc counts never mix with scaled group
+// reads. Scopes add their deltas to their thread's own totals of the PerfRegion (no shared
+// cache lines on the way out), and perf_report sums the threads and prints per-region
+// totals, IPC and events per element.
+//
+// When counters are not permitted (perf_event_paranoid, containers, VMs without a PMU) or an
+// event is not supported by the CPU, the missing counters are reported as unavailable and the
+// scopes still count calls, elements and rdtsc ticks. A scope whose counters cannot be read
+// consistently (the group was never on the PMU during it, a read failed) is counted as
+// failed and left out of the counter totals, the report shows how many there were.
+//
+// LT_PERF_SCOPE compiles to nothing unless LT_PERF_COUNTERS is defined, so instrumented
+// kernels cost nothing in normal builds. With LT_FLIGHT_RECORDER the scopes are also recorded
+// as flight events.
+//
+
+enum PerfCounter
+{
+    PerfCounter_Cycles,
+    PerfCounter_Instructions,
+    PerfCounter_CacheMisses,
+    PerfCounter_BranchMisses,
+    PerfCounter_StalledCyclesFrontend,
+    PerfCounter_StalledCyclesBackend,
+
+    PerfCounter_Count,
+};
+
+// How a sample was read.
+enum PerfSource
+{
+    PerfSource_None,
+    PerfSource_Rdpmc,
+    PerfSource_Read,
+};
+
+struct PerfSample
+{
+    u64 values[PerfCounter_Count];
+    u64 ticks;
+    u64 time_enabled;  // Group reads: time the group was enabled and on the PMU, for scaling.
+    u64 time_running;
+    u32 valid;         // Bit i set when values[i] was read.
+    u32 source;        // PerfSource.
+};
+
+// Totals of one region. Each thread adds to its own copy and perf_report sums them.
+struct PerfTotals
+{
+    std::atomic<u64> calls{0};
+    std::atomic<u64> elements{0};
+    std::atomic<u64> ticks{0};
+    std::atomic<u64> counted_elements{0};  // Elements of the scopes that read the counters.
+    std::atomic<u64> failed{0};            // Scopes whose counters could not be read.
+    std::atomic<u64> values[PerfCounter_Count] = {};
+    std::atomic<u32> counted{0};           // Counters read by at least one scope.
+};
+
+// Regions with a per thread slot. Any past it add to their shared totals with atomics.
+#define LT_PERF_MAX_REGIONS 128
+
+struct PerfRegion
+{
+    const char *name;
+    u32         index;
+    PerfTotals  totals;  // Threads that exited, and every thread when index >= LT_PERF_MAX_REGIONS.
+    PerfRegion *next = nullptr;
+
+    // Regions register themselves for perf_report and must outlive it, usually as globals
+    // or function statics.
+    explicit PerfRegion(const char *name);
+};
+
+namespace lt
+{
+
+const char *perf_counter_name(PerfCounter counter);
+
+// Mask of the counters that could be opened on the calling thread.
+u32  perf_available();
+// Reads the calling thread's counters, scaled when the group was multiplexed. Returns false
+// when none are available.
+bool perf_read(PerfSample *sample);
+
+// Not meant to be called while scopes are running.
+void perf_reset();
+void perf_report(FILE *out);
+
+struct PerfScope
+{
+    PerfScope(PerfRegion *region, u64 elements = 1);
+    ~PerfScope();
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope &operator=(const PerfScope&) = delete;
+
+private:
+    PerfRegion *m_region;
+    u64         m_elements;
+    PerfSample  m_start;
+};
+
+}
+
+#define LT_PERF_CONCAT2(a, b) a##b
+#define LT_PERF_CONCAT(a, b)  LT_PERF_CONCAT2(a, b)
+
+#if LT_PERF_COUNTERS
+#  define LT_PERF_SCOPE(name, elements)                                                        \
+    static PerfRegion LT_PERF_CONCAT(lt_perf_region_, __LINE__)(name);                         \
+    lt::PerfScope LT_PERF_CONCAT(lt_perf_scope_, __LINE__)(&LT_PERF_CONCAT(lt_perf_region_, __LINE__), (elements))
+#else
+#  define LT_PERF_SCOPE(name, elements) do { } while (0)
+#endif
+
+#endif // LT_PERF_HPP
@@ -0,0 +1,593 @@
+#ifndef LT_QUEUE_HPP
+#define LT_QUEUE_HPP
+
+#include <atomic>
+#include <climits>
+#include <new>
+#include <thread>
+#include <utility>
+#include "lt_core.hpp"
+
+#if LT_OS_LINUX
+#include <linux/futex.h>
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// Concurrent queues
+//
+// - SpscQueue: bounded ring, one producer and one consumer.
+// - MpmcQueue: bounded ring with per-cell sequence numbers (Dmitry Vyukov's design).
+// - MpscQueue: unbounded linked queue, many producers and one consumer.
+//
+// try_* functions never block. The blocking variants spin for a short while and then sleep
+// on a futex until the other side signals progress.
+//
+
+namespace lt
+{
+
+inline void
+futex_wait(std::atomic<u32> *addr, u32 expected)
+{
+#if LT_OS_LINUX
+    syscall(SYS_futex, (u32*)addr, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    if (addr->load(std::memory_order_relaxed) == expected) std::this_thread::yield();
+#endif
+}
+
+inline void
+futex_wake(std::atomic<u32> *addr, i32 count)
+{
+#if LT_OS_LINUX
+    syscall(SYS_futex, (u32*)addr, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+    LT_Unused(addr);
+    LT_Unused(count);
+#endif
+}
+
+// Asymmetric fences. The queues signal progress on every push and pop, but a thread only
+// sleeps after spinning, so the fence that orders "publish the item, then look for waiters"
+// against "count myself as a waiter, then recheck the queue" is paid on the wrong side. With
+// membarrier the sleeping side forces a full barrier on every running thread of the process,
+// and the notifying side only has to keep the compiler from reordering. Without it (other
+// systems, old kernels) both sides use a seq_cst fence.
+inline bool
+membarrier_registered()
+{
+#if LT_OS_LINUX && defined(SYS_membarrier)
+    static const bool registered = []() {
+        const long commands = syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0, 0);
+        if (commands < 0 || !(commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) return false;
+        return syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+    }();
+    return registered;
+#else
+    return false;
+#endif
+}
+
+// Cheap side, runs on every notify.
+inline void
+light_fence()
+{
+    if (membarrier_registered()) std::atomic_signal_fence(std::memory_order_seq_cst);
+    else std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+// Expensive side, runs once before a thread goes to sleep.
+inline void
+heavy_fence()
+{
+#if LT_OS_LINUX && defined(SYS_membarrier)
+    if (membarrier_registered())
+    {
+        // Does not fail once the process is registered.
+        syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+        return;
+    }
+#endif
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+// Event count: waiters snapshot the epoch, recheck their condition and sleep on the epoch.
+// `waiters` is set by every thread that prepares to wait and cleared by the notify that wakes
+// them all, so a burst of pushes costs one wake and not one per push. Notifying is a compiler
+// barrier and a relaxed load when nobody waits, the heavy fence of prepare_wait makes that safe.
+struct WaitSignal
+{
+    std::atomic<u32> epoch{0};
+    std::atomic<u32> waiters{0};
+
+    u32
+    prepare_wait()
+    {
+        // The epoch is read first: a notify that clears the flag set here bumps it afterwards,
+        // so commit_wait does not sleep through that notify.
+        const u32 e = epoch.load(std::memory_order_seq_cst);
+        waiters.store(1, std::memory_order_seq_cst);
+        heavy_fence();
+        return e;
+    }
+
+    // The flag stays set, the next notify makes one needless futex call.
+    void cancel_wait() {}
+
+    void commit_wait(u32 e) { futex_wait(&epoch, e); }
+
+    void
+    notify_all()
+    {
+        light_fence();
+        if (waiters.load(std::memory_order_relaxed) == 0) return;
+        if (waiters.exchange(0, std::memory_order_seq_cst) == 0) return;
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(&epoch, INT_MAX);
+    }
+};
+
+// Runs `try_op` until it succeeds, sleeping on `signal` between attempts.
+template<typename F> inline void
+wait_until(WaitSignal &signal, const F &try_op)
+{
+    for (i32 spin = 0; spin < 64; spin++)
+    {
+        if (try_op()) return;
+        cpu_relax();
+    }
+    for (;;)
+    {
+        u32 e = signal.prepare_wait();
+        if (try_op())
+        {
+            signal.cancel_wait();
+            return;
+        }
+        signal.commit_wait(e);
+        if (try_op()) return;
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// SpscQueue
+//
+
+template<typename T>
+struct SpscQueue
+{
+    // The capacity is rounded up to a power of two.
+    explicit SpscQueue(usize capacity)
+        : m_capacity(next_power_of_two(capacity < 2 ? 2 : capacity))
+        , m_mask(m_capacity - 1)
+    {
+        m_items = (T*)::operator new(sizeof(T) * m_capacity, std::align_val_t(alignof(T)));
+    }
+
+    ~SpscQueue()
+    {
+        const usize tail = m_tail.load(std::memory_order_acquire);
+        for (usize i = m_head.load(std::memory_order_relaxed); i != tail; i++)
+            m_items[i & m_mask].~T();
+        ::operator delete(m_items, std::align_val_t(alignof(T)));
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    template<typename U> bool
+    try_push(U &&item)
+    {
+        const usize tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head == m_capacity)
+        {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head == m_capacity) return false;
+        }
+        new (&m_items[tail & m_mask]) T(std::forward<U>(item));
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_not_empty.notify_all();
+        return true;
+    }
+
+    bool
+    try_pop(T *out)
+    {
+        const usize head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail)
+        {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail) return false;
+        }
+        T *slot = &m_items[head & m_mask];
+        *out = std::move(*slot);
+        slot->~T();
+        m_head.store(head + 1, std::memory_order_release);
+        m_not_full.notify_all();
+        return true;
+    }
+
+    // Pushes up to `count` items with a single release store, returns how many were pushed.
+    usize
+    try_push_batch(const T *items, usize count)
+    {
+        const usize tail = m_tail.load(std::memory_order_relaxed);
+        usize free_slots = m_capacity - (tail - m_cached_head);
+        if (free_slots < count)
+        {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            free_slots = m_capacity - (tail - m_cached_head);
+        }
+        const usize n = (count < free_slots) ? count : free_slots;
+        if (n == 0) return 0;
+
+        for (usize i = 0; i < n; i++) new (&m_items[(tail + i) & m_mask]) T(items[i]);
+        m_tail.store(tail + n, std::memory_order_release);
+        m_not_empty.notify_all();
+        return n;
+    }
+
+    // Pops up to `max_count` items with a single release store, returns how many were popped.
+    usize
+    try_pop_batch(T *out, usize max_count)
+    {
+        const usize head = m_head.load(std::memory_order_relaxed);
+        usize available = m_cached_tail - head;
+        if (available < max_count)
+        {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            available = m_cached_tail - head;
+        }
+        const usize n = (max_count < available) ? max_count : available;
+        if (n == 0) return 0;
+
+        for (usize i = 0; i < n; i++)
+        {
+            T *slot = &m_items[(head + i) & m_mask];
+            out[i] = std::move(*slot);
+            slot->~T();
+        }
+        m_head.store(head + n, std::memory_order_release);
+        m_not_full.notify_all();
+        return n;
+    }
+
+    template<typename U> void
+    push(U &&item)
+    {
+        wait_until(m_not_full, [&]() { return try_push(std::forward<U>(item)); });
+    }
+
+    void pop(T *out) { wait_until(m_not_empty, [&]() { return try_pop(out); }); }
+
+    usize
+    size_approx() const
+    {
+        return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_relaxed);
+    }
+
+    usize capacity() const { return m_capacity; }
+
+private:
+    alignas(LT_CACHE_LINE_SIZE) std::atomic<usize> m_head{0};   // Written by the consumer.
+    usize                                         m_cached_tail = 0;
+    alignas(LT_CACHE_LINE_SIZE) std::atomic<usize> m_tail{0};   // Written by the producer.
+    usize                                         m_cached_head = 0;
+    alignas(LT_CACHE_LINE_SIZE) WaitSignal         m_not_empty;
+    alignas(LT_CACHE_LINE_SIZE) WaitSignal         m_not_full;
+    alignas(LT_CACHE_LINE_SIZE) const usize        m_capacity;
+    const usize                                   m_mask;
+    T                                            *m_items;
+};
+
+/////////////////////////////////////////////////////////
+//
+// MpmcQueue
+//
+// Every cell carries a sequence number: a producer may write cell `pos & mask` when its
+// sequence equals `pos`, a consumer may read it when it equals `pos + 1`.
+//
+
+template<typename T>
+struct MpmcQueue
+{
+    explicit MpmcQueue(usize capacity)
+        : m_capacity(next_power_of_two(capacity < 2 ? 2 : capacity))
+        , m_mask(m_capacity - 1)
+    {
+        m_cells = (Cell*)::operator new(sizeof(Cell) * m_capacity, std::align_val_t(alignof(Cell)));
+        for (usize i = 0; i < m_capacity; i++)
+            new (&m_cells[i].sequence) std::atomic<usize>(i);
+    }
+
+    ~MpmcQueue()
+    {
+        const usize end = m_enqueue_pos.load(std::memory_order_acquire);
+        for (usize pos = m_dequeue_pos.load(std::memory_order_relaxed); pos != end; pos++)
+        {
+            Cell *cell = &m_cells[pos & m_mask];
+            if (cell->sequence.load(std::memory_order_acquire) == pos + 1) cell->item()->~T();
+        }
+        ::operator delete(m_cells, std::align_val_t(alignof(Cell)));
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    template<typename U> bool
+    try_push(U &&item)
+    {
+        Cell *cell;
+        usize pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            usize seq = cell->sequence.load(std::memory_order_acquire);
+            isize diff = (isize)seq - (isize)pos;
+            if (diff == 0)
+            {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->storage) T(std::forward<U>(item));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        m_not_empty.notify_all();
+        return true;
+    }
+
+    bool
+    try_pop(T *out)
+    {
+        Cell *cell;
+        usize pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            usize seq = cell->sequence.load(std::memory_order_acquire);
+            isize diff = (isize)seq - (isize)(pos + 1);
+            if (diff == 0)
+            {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        T *item = cell->item();
+        *out = std::move(*item);
+        item->~T();
+        cell->sequence.store(pos + m_capacity, std::memory_order_release);
+        m_not_full.notify_all();
+        return true;
+    }
+
+    // Claims a run of consecutive free cells with one CAS. Cells observed as free cannot be
+    // taken by anybody else unless the enqueue position moves, which makes the CAS fail.
+    usize
+    try_push_batch(const T *items, usize count)
+    {
+        usize pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        usize n;
+        for (;;)
+        {
+            n = 0;
+            while (n < count &&
+                   m_cells[(pos + n) & m_mask].sequence.load(std::memory_order_acquire) == pos + n)
+            {
+                n++;
+            }
+            if (n == 0)
+            {
+                usize seq = m_cells[pos & m_mask].sequence.load(std::memory_order_acquire);
+                if ((isize)seq - (isize)pos < 0) return 0;
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) break;
+        }
+
+        for (usize i = 0; i < n; i++)
+        {
+            Cell *cell = &m_cells[(pos + i) & m_mask];
+            new (cell->storage) T(items[i]);
+            cell->sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        m_not_empty.notify_all();
+        return n;
+    }
+
+    usize
+    try_pop_batch(T *out, usize max_count)
+    {
+        usize pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        usize n;
+        for (;;)
+        {
+            n = 0;
+            while (n < max_count &&
+                   m_cells[(pos + n) & m_mask].sequence.load(std::memory_order_acquire) == pos + n + 1)
+            {
+                n++;
+            }
+            if (n == 0)
+            {
+                usize seq = m_cells[pos & m_mask].sequence.load(std::memory_order_acquire);
+                if ((isize)seq - (isize)(pos + 1) < 0) return 0;
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (m_dequeue_pos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) break;
+        }
+
+        for (usize i = 0; i < n; i++)
+        {
+            Cell *cell = &m_cells[(pos + i) & m_mask];
+            T *item = cell->item();
+            out[i] = std::move(*item);
+            item->~T();
+            cell->sequence.store(pos + i + m_capacity, std::memory_order_release);
+        }
+        m_not_full.notify_all();
+        return n;
+    }
+
+    template<typename U> void
+    push(U &&item)
+    {
+        wait_until(m_not_full, [&]() { return try_push(std::forward<U>(item)); });
+    }
+
+    void pop(T *out) { wait_until(m_not_empty, [&]() { return try_pop(out); }); }
+
+    usize capacity() const { return m_capacity; }
+
+private:
+    struct Cell
+    {
+        std::atomic<usize> sequence;
+        alignas(T) u8      storage[sizeof(T)];
+
+        T *item() { return std::launder((T*)storage); }
+    };
+
+    alignas(LT_CACHE_LINE_SIZE) std::atomic<usize> m_enqueue_pos{0};
+    alignas(LT_CACHE_LINE_SIZE) std::atomic<usize> m_dequeue_pos{0};
+    alignas(LT_CACHE_LINE_SIZE) WaitSignal         m_not_empty;
+    alignas(LT_CACHE_LINE_SIZE) WaitSignal         m_not_full;
+    alignas(LT_CACHE_LINE_SIZE) const usize        m_capacity;
+    const usize                                   m_mask;
+    Cell                                         *m_cells;
+};
+
+/////////////////////////////////////////////////////////
+//
+// MpscQueue
+//
+// Producers swap themselves into the head with one atomic exchange. The consumer owns the
+// tail, which always points at a node whose value was already taken (the stub).
+//
+// NOTE: A producer that was preempted between the exchange and linking its node makes the
+// queue look empty to the consumer until it resumes, items behind it are not lost.
+//
+
+template<typename T>
+struct MpscQueue
+{
+    MpscQueue()
+    {
+        Node *stub = new Node;
+        m_head.store(stub, std::memory_order_relaxed);
+        m_tail = stub;
+    }
+
+    ~MpscQueue()
+    {
+        Node *node = m_tail->next.load(std::memory_order_acquire);
+        delete m_tail;
+        while (node)
+        {
+            Node *next = node->next.load(std::memory_order_acquire);
+            node->item()->~T();
+            delete node;
+            node = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    template<typename U> void
+    push(U &&item)
+    {
+        Node *node = new Node;
+        new (node->storage) T(std::forward<U>(item));
+        link(node, node);
+    }
+
+    // Links the whole batch into the queue with a single exchange.
+    void
+    push_batch(const T *items, usize count)
+    {
+        if (count == 0) return;
+
+        Node *first = new Node;
+        new (first->storage) T(items[0]);
+        Node *last = first;
+        for (usize i = 1; i < count; i++)
+        {
+            Node *node = new Node;
+            new (node->storage) T(items[i]);
+            last->next.store(node, std::memory_order_relaxed);
+            last = node;
+        }
+        link(first, last);
+    }
+
+    bool
+    try_pop(T *out)
+    {
+        Node *tail = m_tail;
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+
+        T *item = next->item();
+        *out = std::move(*item);
+        item->~T();
+        m_tail = next;
+        delete tail;
+        return true;
+    }
+
+    usize
+    try_pop_batch(T *out, usize max_count)
+    {
+        usize n = 0;
+        while (n < max_count && try_pop(&out[n])) n++;
+        return n;
+    }
+
+    void pop(T *out) { wait_until(m_not_empty, [&]() { return try_pop(out); }); }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next{nullptr};
+        alignas(T) u8      storage[sizeof(T)];
+
+        T *item() { return std::launder((T*)storage); }
+    };
+
+    void
+    link(Node *first, Node *last)
+    {
+        Node *prev = m_head.exchange(last, std::memory_order_acq_rel);
+        prev->next.store(first, std::memory_order_release);
+        m_not_empty.notify_all();
+    }
+
+    alignas(LT_CACHE_LINE_SIZE) std::atomic<Node*> m_head;
+    alignas(LT_CACHE_LINE_SIZE) Node              *m_tail;
+    alignas(LT_CACHE_LINE_SIZE) WaitSignal         m_not_empty;
+};
+
+}
+
+#endif // LT_QUEUE_HPP
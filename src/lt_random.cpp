@@ -0,0 +1,529 @@
+#include "lt_random.hpp"
+#include "lt_cpu.hpp"
+#include "lt_fastmath.hpp"
+
+#include <cstring>
+
+#if (LT_GCC || LT_CLANG) && LT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+#define LT_RNG_U64_BLOCK 8     // Outputs of one step of every lane.
+#define LT_RNG_F32_BLOCK 16
+#define LT_RNG_CHUNK     256   // Floats per pass of the samplers, kept on the stack.
+
+/////////////////////////////////////////////////////////
+//
+// Scalar generator
+//
+
+lt_global_variable const u64 g_jump[4] = {
+    0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull,
+};
+
+lt_global_variable const u64 g_long_jump[4] = {
+    0x76e15d3efefdcbbfull, 0xc5004e441c522fb3ull, 0x77710069854ee241ull, 0x39109bb02acbe635ull,
+};
+
+lt_internal inline u64
+splitmix64(u64 *x)
+{
+    u64 z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void
+lt::rng_seed(Rng *rng, u64 seed)
+{
+    for (u64 &s : rng->s) s = splitmix64(&seed);
+}
+
+// Multiplies the state by the jump polynomial (a fixed power of the transition matrix).
+lt_internal void
+jump(Rng *rng, const u64 *poly)
+{
+    u64 s[4] = {};
+    for (i32 i = 0; i < 4; i++)
+    {
+        for (i32 b = 0; b < 64; b++)
+        {
+            if (poly[i] & ((u64)1 << b))
+            {
+                for (i32 j = 0; j < 4; j++) s[j] ^= rng->s[j];
+            }
+            lt::rng_next(rng);
+        }
+    }
+    memcpy(rng->s, s, sizeof(s));
+}
+
+void
+lt::rng_jump(Rng *rng)
+{
+    jump(rng, g_jump);
+}
+
+void
+lt::rng_long_jump(Rng *rng)
+{
+    jump(rng, g_long_jump);
+}
+
+void
+lt::rng_batch_seed(RngBatch *batch, u64 seed, u64 stream)
+{
+    Rng rng;
+    rng_seed(&rng, seed);
+    for (u64 i = 0; i < stream; i++) rng_long_jump(&rng);
+
+    for (i32 l = 0; l < LT_RNG_LANES; l++)
+    {
+        for (i32 j = 0; j < 4; j++) batch->s[j][l] = rng.s[j];
+        rng_jump(&rng);
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// Kernels
+//
+// `blocks` steps of every lane. Each block is LT_RNG_U64_BLOCK numbers in lane order, or
+// LT_RNG_F32_BLOCK floats in [0, 1) made from the low and high halves of every lane's number
+// (lane l gives floats 2l and 2l + 1), which is the memory order of the 32-bit words in a
+// vector of lanes: the SIMD kernels convert without shuffles.
+//
+
+lt_internal inline u64
+step_lane(RngBatch *batch, i32 l)
+{
+    u64 (*s)[LT_RNG_LANES] = batch->s;
+    const u64 result = lt::rng_rotl(s[0][l] + s[3][l], 23) + s[0][l];
+    const u64 t = s[1][l] << 17;
+    s[2][l] ^= s[0][l];
+    s[3][l] ^= s[1][l];
+    s[1][l] ^= s[2][l];
+    s[0][l] ^= s[3][l];
+    s[2][l] ^= t;
+    s[3][l] = lt::rng_rotl(s[3][l], 45);
+    return result;
+}
+
+lt_internal inline f32
+unit_f32(u32 bits)
+{
+    return (f32)(bits >> 8) * 0x1.0p-24f;
+}
+
+lt_internal void
+fill_u64_scalar(RngBatch *batch, u64 *out, usize blocks)
+{
+    for (usize b = 0; b < blocks; b++, out += LT_RNG_U64_BLOCK)
+        for (i32 l = 0; l < LT_RNG_LANES; l++) out[l] = step_lane(batch, l);
+}
+
+lt_internal void
+fill_f32_scalar(RngBatch *batch, f32 *out, usize blocks)
+{
+    for (usize b = 0; b < blocks; b++, out += LT_RNG_F32_BLOCK)
+    {
+        for (i32 l = 0; l < LT_RNG_LANES; l++)
+        {
+            const u64 r = step_lane(batch, l);
+            out[2*l] = unit_f32((u32)r);
+            out[2*l + 1] = unit_f32((u32)(r >> 32));
+        }
+    }
+}
+
+#if defined(__SSE2__)
+lt_internal inline __m128i
+rotl_sse2(__m128i x, i32 k)
+{
+    return _mm_or_si128(_mm_slli_epi64(x, k), _mm_srli_epi64(x, 64 - k));
+}
+
+// Two lanes per register, four registers per state word.
+struct RngSse2
+{
+    __m128i s[4][4];
+};
+
+lt_internal inline __m128i
+next_sse2(RngSse2 *g, i32 h)
+{
+    __m128i &s0 = g->s[0][h], &s1 = g->s[1][h], &s2 = g->s[2][h], &s3 = g->s[3][h];
+    const __m128i result = _mm_add_epi64(rotl_sse2(_mm_add_epi64(s0, s3), 23), s0);
+    const __m128i t = _mm_slli_epi64(s1, 17);
+    s2 = _mm_xor_si128(s2, s0);
+    s3 = _mm_xor_si128(s3, s1);
+    s1 = _mm_xor_si128(s1, s2);
+    s0 = _mm_xor_si128(s0, s3);
+    s2 = _mm_xor_si128(s2, t);
+    s3 = rotl_sse2(s3, 45);
+    return result;
+}
+
+lt_internal inline void
+load_sse2(RngSse2 *g, const RngBatch *batch)
+{
+    for (i32 j = 0; j < 4; j++)
+        for (i32 h = 0; h < 4; h++) g->s[j][h] = _mm_load_si128((const __m128i*)&batch->s[j][2*h]);
+}
+
+lt_internal inline void
+store_sse2(const RngSse2 *g, RngBatch *batch)
+{
+    for (i32 j = 0; j < 4; j++)
+        for (i32 h = 0; h < 4; h++) _mm_store_si128((__m128i*)&batch->s[j][2*h], g->s[j][h]);
+}
+
+lt_internal void
+fill_u64_sse2(RngBatch *batch, u64 *out, usize blocks)
+{
+    RngSse2 g;
+    load_sse2(&g, batch);
+    for (usize b = 0; b < blocks; b++, out += LT_RNG_U64_BLOCK)
+        for (i32 h = 0; h < 4; h++) _mm_storeu_si128((__m128i*)(out + 2*h), next_sse2(&g, h));
+    store_sse2(&g, batch);
+}
+
+lt_internal void
+fill_f32_sse2(RngBatch *batch, f32 *out, usize blocks)
+{
+    RngSse2 g;
+    load_sse2(&g, batch);
+    const __m128 scale = _mm_set1_ps(0x1.0p-24f);
+    for (usize b = 0; b < blocks; b++, out += LT_RNG_F32_BLOCK)
+    {
+        for (i32 h = 0; h < 4; h++)
+        {
+            const __m128i r = _mm_srli_epi32(next_sse2(&g, h), 8);
+            _mm_storeu_ps(out + 4*h, _mm_mul_ps(_mm_cvtepi32_ps(r), scale));
+        }
+    }
+    store_sse2(&g, batch);
+}
+#endif
+
+#if LT_CPU_HAS_AVX2
+LT_TARGET_AVX2 lt_internal inline __m256i
+rotl_avx2(__m256i x, i32 k)
+{
+    return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+}
+
+struct RngAvx2
+{
+    __m256i s[4][2];
+};
+
+LT_TARGET_AVX2 lt_internal inline __m256i
+next_avx2(RngAvx2 *g, i32 h)
+{
+    __m256i &s0 = g->s[0][h], &s1 = g->s[1][h], &s2 = g->s[2][h], &s3 = g->s[3][h];
+    const __m256i result = _mm256_add_epi64(rotl_avx2(_mm256_add_epi64(s0, s3), 23), s0);
+    const __m256i t = _mm256_slli_epi64(s1, 17);
+    s2 = _mm256_xor_si256(s2, s0);
+    s3 = _mm256_xor_si256(s3, s1);
+    s1 = _mm256_xor_si256(s1, s2);
+    s0 = _mm256_xor_si256(s0, s3);
+    s2 = _mm256_xor_si256(s2, t);
+    s3 = rotl_avx2(s3, 45);
+    return result;
+}
+
+LT_TARGET_AVX2 lt_internal inline void
+load_avx2(RngAvx2 *g, const RngBatch *batch)
+{
+    for (i32 j = 0; j < 4; j++)
+        for (i32 h = 0; h < 2; h++) g->s[j][h] = _mm256_load_si256((const __m256i*)&batch->s[j][4*h]);
+}
+
+LT_TARGET_AVX2 lt_internal inline void
+store_avx2(const RngAvx2 *g, RngBatch *batch)
+{
+    for (i32 j = 0; j < 4; j++)
+        for (i32 h = 0; h < 2; h++) _mm256_store_si256((__m256i*)&batch->s[j][4*h], g->s[j][h]);
+}
+
+LT_TARGET_AVX2 lt_internal void
+fill_u64_avx2(RngBatch *batch, u64 *out, usize blocks)
+{
+    RngAvx2 g;
+    load_avx2(&g, batch);
+    for (usize b = 0; b < blocks; b++, out += LT_RNG_U64_BLOCK)
+    {
+        _mm256_storeu_si256((__m256i*)out, next_avx2(&g, 0));
+        _mm256_storeu_si256((__m256i*)(out + 4), next_avx2(&g, 1));
+    }
+    store_avx2(&g, batch);
+}
+
+LT_TARGET_AVX2 lt_internal void
+fill_f32_avx2(RngBatch *batch, f32 *out, usize blocks)
+{
+    RngAvx2 g;
+    load_avx2(&g, batch);
+    const __m256 scale = _mm256_set1_ps(0x1.0p-24f);
+    for (usize b = 0; b < blocks; b++, out += LT_RNG_F32_BLOCK)
+    {
+        const __m256i r0 = _mm256_srli_epi32(next_avx2(&g, 0), 8);
+        const __m256i r1 = _mm256_srli_epi32(next_avx2(&g, 1), 8);
+        _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_cvtepi32_ps(r0), scale));
+        _mm256_storeu_ps(out + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(r1), scale));
+    }
+    store_avx2(&g, batch);
+}
+#endif
+
+#if LT_CPU_HAS_AVX512
+#if LT_GCC && !LT_CLANG
+// Same GCC 12 false positive on _mm512_undefined_epi32 as in lt_hash.cpp.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// All the lanes in one register per state word, with a native rotate.
+struct RngAvx512
+{
+    __m512i s0, s1, s2, s3;
+};
+
+LT_TARGET_AVX512 lt_internal inline __m512i
+next_avx512(RngAvx512 *g)
+{
+    const __m512i result = _mm512_add_epi64(_mm512_rol_epi64(_mm512_add_epi64(g->s0, g->s3), 23), g->s0);
+    const __m512i t = _mm512_slli_epi64(g->s1, 17);
+    g->s2 = _mm512_xor_si512(g->s2, g->s0);
+    g->s3 = _mm512_xor_si512(g->s3, g->s1);
+    g->s1 = _mm512_xor_si512(g->s1, g->s2);
+    g->s0 = _mm512_xor_si512(g->s0, g->s3);
+    g->s2 = _mm512_xor_si512(g->s2, t);
+    g->s3 = _mm512_rol_epi64(g->s3, 45);
+    return result;
+}
+
+LT_TARGET_AVX512 lt_internal inline void
+load_avx512(RngAvx512 *g, const RngBatch *batch)
+{
+    g->s0 = _mm512_load_si512(batch->s[0]);
+    g->s1 = _mm512_load_si512(batch->s[1]);
+    g->s2 = _mm512_load_si512(batch->s[2]);
+    g->s3 = _mm512_load_si512(batch->s[3]);
+}
+
+LT_TARGET_AVX512 lt_internal inline void
+store_avx512(const RngAvx512 *g, RngBatch *batch)
+{
+    _mm512_store_si512(batch->s[0], g->s0);
+    _mm512_store_si512(batch->s[1], g->s1);
+    _mm512_store_si512(batch->s[2], g->s2);
+    _mm512_store_si512(batch->s[3], g->s3);
+}
+
+LT_TARGET_AVX512 lt_internal void
+fill_u64_avx512(RngBatch *batch, u64 *out, usize blocks)
+{
+    RngAvx512 g;
+    load_avx512(&g, batch);
+    for (usize b = 0; b < blocks; b++, out += LT_RNG_U64_BLOCK) _mm512_storeu_si512(out, next_avx512(&g));
+    store_avx512(&g, batch);
+}
+
+LT_TARGET_AVX512 lt_internal void
+fill_f32_avx512(RngBatch *batch, f32 *out, usize blocks)
+{
+    RngAvx512 g;
+    load_avx512(&g, batch);
+    const __m512 scale = _mm512_set1_ps(0x1.0p-24f);
+    for (usize b = 0; b < blocks; b++, out += LT_RNG_F32_BLOCK)
+    {
+        const __m512i r = _mm512_srli_epi32(next_avx512(&g), 8);
+        _mm512_storeu_ps(out, _mm512_mul_ps(_mm512_cvtepi32_ps(r), scale));
+    }
+    store_avx512(&g, batch);
+}
+
+#if LT_GCC && !LT_CLANG
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+struct RngKernel
+{
+    CpuIsa isa;
+    void (*fill_u64)(RngBatch *batch, u64 *out, usize blocks);
+    void (*fill_f32)(RngBatch *batch, f32 *out, usize blocks);
+};
+
+lt_global_variable const RngKernel g_rng_kernels[] = {
+    {CpuIsa_Scalar, fill_u64_scalar, fill_f32_scalar},
+#if defined(__SSE2__)
+    {CpuIsa_SSE2,   fill_u64_sse2,   fill_f32_sse2},
+#endif
+#if LT_CPU_HAS_AVX2
+    {CpuIsa_AVX2,   fill_u64_avx2,   fill_f32_avx2},
+#endif
+#if LT_CPU_HAS_AVX512
+    {CpuIsa_AVX512, fill_u64_avx512, fill_f32_avx512},
+#endif
+};
+lt_global_variable CpuDispatchCache g_rng_dispatch;
+
+const char *
+lt::rng_kernel_name()
+{
+    return cpu_isa_name(cpu_select(g_rng_kernels, &g_rng_dispatch)->isa);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Fills
+//
+
+void
+lt::rng_fill_u64(RngBatch *batch, u64 *out, usize count)
+{
+    const RngKernel *kernel = cpu_select(g_rng_kernels, &g_rng_dispatch);
+    const usize blocks = count / LT_RNG_U64_BLOCK;
+    kernel->fill_u64(batch, out, blocks);
+
+    const usize rest = count % LT_RNG_U64_BLOCK;
+    if (rest)
+    {
+        u64 tail[LT_RNG_U64_BLOCK];
+        kernel->fill_u64(batch, tail, 1);
+        memcpy(out + blocks * LT_RNG_U64_BLOCK, tail, rest * sizeof(u64));
+    }
+}
+
+// [0, 1), whole blocks only: `out` must have room for `count` rounded up to a block.
+lt_internal inline void
+fill_unit(const RngKernel *kernel, RngBatch *batch, f32 *out, usize count)
+{
+    kernel->fill_f32(batch, out, (count + LT_RNG_F32_BLOCK - 1) / LT_RNG_F32_BLOCK);
+}
+
+void
+lt::rng_fill_f32(RngBatch *batch, f32 *out, usize count, f32 lo, f32 hi)
+{
+    const RngKernel *kernel = cpu_select(g_rng_kernels, &g_rng_dispatch);
+    const bool unit = (lo == 0.0f && hi == 1.0f);
+    const f32 scale = hi - lo;
+
+    // The scaling is a plain loop outside the kernels so that every tier rounds it the same
+    // way, done per chunk while the numbers are still in L1.
+    const usize chunk = 64 * LT_RNG_CHUNK;
+    for (usize i = 0; i < count; i += chunk)
+    {
+        const usize n = (count - i < chunk) ? count - i : chunk;
+        const usize blocks = n / LT_RNG_F32_BLOCK;
+        kernel->fill_f32(batch, out + i, blocks);
+
+        const usize rest = n % LT_RNG_F32_BLOCK;
+        if (rest)
+        {
+            f32 tail[LT_RNG_F32_BLOCK];
+            kernel->fill_f32(batch, tail, 1);
+            memcpy(out + i + blocks * LT_RNG_F32_BLOCK, tail, rest * sizeof(f32));
+        }
+
+        if (!unit)
+        {
+            f32 *o = out + i;
+            for (usize k = 0; k < n; k++) o[k] = lo + o[k] * scale;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// Samplers
+//
+
+void
+lt::sample_unit_sphere(RngBatch *batch, f32 *x, f32 *y, f32 *z, usize count)
+{
+    const RngKernel *kernel = cpu_select(g_rng_kernels, &g_rng_dispatch);
+    alignas(64) f32 u[LT_RNG_CHUNK];
+    alignas(64) f32 angle[LT_RNG_CHUNK];
+
+    // z uniform in [-1, 1) and an angle around it (Archimedes).
+    for (usize i = 0; i < count; i += LT_RNG_CHUNK)
+    {
+        const usize n = (count - i < LT_RNG_CHUNK) ? count - i : LT_RNG_CHUNK;
+        fill_unit(kernel, batch, u, n);
+        fill_unit(kernel, batch, angle, n);
+        for (usize k = 0; k < n; k++) angle[k] = (2.0f*angle[k] - 1.0f) * (f32)LT_PI;
+
+        fast_sincos(angle, y + i, x + i, n);
+        for (usize k = 0; k < n; k++)
+        {
+            const f32 zk = 1.0f - 2.0f*u[k];
+            const f32 r = std::sqrt(std::fmax(0.0f, 1.0f - zk*zk));
+            x[i + k] *= r;
+            y[i + k] *= r;
+            z[i + k] = zk;
+        }
+    }
+}
+
+void
+lt::sample_hemisphere(RngBatch *batch, Vec3f normal, f32 *x, f32 *y, f32 *z, usize count)
+{
+    // Mirroring the directions of the other half through the center keeps them uniform.
+    sample_unit_sphere(batch, x, y, z, count);
+    for (usize i = 0; i < count; i++)
+    {
+        const f32 d = x[i]*normal.x + y[i]*normal.y + z[i]*normal.z;
+        const f32 s = (d < 0.0f) ? -1.0f : 1.0f;
+        x[i] *= s;
+        y[i] *= s;
+        z[i] *= s;
+    }
+}
+
+void
+lt::sample_aabb(RngBatch *batch, Vec3f min, Vec3f max, f32 *x, f32 *y, f32 *z, usize count)
+{
+    rng_fill_f32(batch, x, count, min.x, max.x);
+    rng_fill_f32(batch, y, count, min.y, max.y);
+    rng_fill_f32(batch, z, count, min.z, max.z);
+}
+
+void
+lt::sample_quat(RngBatch *batch, f32 *w, f32 *x, f32 *y, f32 *z, usize count)
+{
+    const RngKernel *kernel = cpu_select(g_rng_kernels, &g_rng_dispatch);
+    alignas(64) f32 u[LT_RNG_CHUNK];
+    alignas(64) f32 a1[LT_RNG_CHUNK];
+    alignas(64) f32 a2[LT_RNG_CHUNK];
+
+    for (usize i = 0; i < count; i += LT_RNG_CHUNK)
+    {
+        const usize n = (count - i < LT_RNG_CHUNK) ? count - i : LT_RNG_CHUNK;
+        fill_unit(kernel, batch, u, n);
+        fill_unit(kernel, batch, a1, n);
+        fill_unit(kernel, batch, a2, n);
+        for (usize k = 0; k < n; k++)
+        {
+            a1[k] = (2.0f*a1[k] - 1.0f) * (f32)LT_PI;
+            a2[k] = (2.0f*a2[k] - 1.0f) * (f32)LT_PI;
+        }
+
+        fast_sincos(a1, w + i, x + i, n);
+        fast_sincos(a2, y + i, z + i, n);
+        for (usize k = 0; k < n; k++)
+        {
+            const f32 r1 = std::sqrt(1.0f - u[k]);
+            const f32 r2 = std::sqrt(u[k]);
+            w[i + k] *= r1;
+            x[i + k] *= r1;
+            y[i + k] *= r2;
+            z[i + k] *= r2;
+        }
+    }
+}
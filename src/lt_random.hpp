@@ -0,0 +1,101 @@
+#ifndef LT_RANDOM_HPP
+#define LT_RANDOM_HPP
+
+#include "lt_core.hpp"
+#include "lt_math.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Random numbers
+//
+// xoshiro256++ (Blackman and Vigna): 256 bits of state, period 2^256 - 1, and jump functions
+// that advance a generator by 2^128 or 2^192 steps in a few hundred operations.
+//
+// Rng is one generator for scalar code. RngBatch runs LT_RNG_LANES generators side by side
+// and fills arrays with the SSE2, AVX2 or AVX-512 kernel of the active CpuIsa, or a scalar
+// loop; every kernel produces the same numbers. Lane l of a batch starts 2^128 * l steps
+// after lane 0, and stream k of a seed starts 2^192 * k steps after stream 0, so threads that
+// each take their own stream number never overlap and the results only depend on the seed
+// and the stream, not on the thread count or the machine.
+//
+// The fills work in blocks (8 u64 or 16 f32), the rest of the last block of a call is
+// dropped. Calls with whole blocks continue the sequence exactly.
+//
+// The samplers write structure-of-arrays outputs. Their uniforms come from the batch, the
+// trigonometry from the fast math array kernels (2 ULP over the range used), which can differ
+// in the last bit between CpuIsa tiers.
+//
+
+#define LT_RNG_LANES 8
+
+struct Rng
+{
+    u64 s[4];
+};
+
+struct alignas(64) RngBatch
+{
+    u64 s[4][LT_RNG_LANES];   // Word-major, one column per lane.
+};
+
+namespace lt
+{
+
+// The state is expanded from `seed` with splitmix64, any seed (0 included) is fine.
+void rng_seed(Rng *rng, u64 seed);
+void rng_jump(Rng *rng);        // 2^128 steps
+void rng_long_jump(Rng *rng);   // 2^192 steps
+
+lt_internal inline u64
+rng_rotl(u64 x, i32 k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+lt_internal inline u64
+rng_next(Rng *rng)
+{
+    u64 *s = rng->s;
+    const u64 result = rng_rotl(s[0] + s[3], 23) + s[0];
+    const u64 t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return result;
+}
+
+// [0, 1) with 24 and 53 random bits.
+lt_internal inline f32 rng_f32(Rng *rng) { return (f32)(rng_next(rng) >> 40) * 0x1.0p-24f; }
+lt_internal inline f64 rng_f64(Rng *rng) { return (f64)(rng_next(rng) >> 11) * 0x1.0p-53; }
+
+// [0, n) by multiplication, the bias is below n / 2^32.
+lt_internal inline u32
+rng_below(Rng *rng, u32 n)
+{
+    return (u32)(((rng_next(rng) >> 32) * n) >> 32);
+}
+
+// Costs `stream` long jumps.
+void rng_batch_seed(RngBatch *batch, u64 seed, u64 stream = 0);
+
+void rng_fill_u64(RngBatch *batch, u64 *out, usize count);
+// Uniform in [lo, hi) with 24 random bits each, two per generator step. With lo and hi other
+// than 0 and 1, rounding can return hi.
+void rng_fill_f32(RngBatch *batch, f32 *out, usize count, f32 lo = 0.0f, f32 hi = 1.0f);
+
+// Uniform on the unit sphere, and on the half of it around `normal` (unit length).
+void sample_unit_sphere(RngBatch *batch, f32 *x, f32 *y, f32 *z, usize count);
+void sample_hemisphere(RngBatch *batch, Vec3f normal, f32 *x, f32 *y, f32 *z, usize count);
+// Uniform in the box.
+void sample_aabb(RngBatch *batch, Vec3f min, Vec3f max, f32 *x, f32 *y, f32 *z, usize count);
+// Uniform rotations (Shoemake), unit quaternions in the Quat layout (s, i, j, k) = (w, x, y, z).
+void sample_quat(RngBatch *batch, f32 *w, f32 *x, f32 *y, f32 *z, usize count);
+
+const char *rng_kernel_name();
+
+}
+
+#endif // LT_RANDOM_HPP
@@ -0,0 +1,302 @@
+#include "lt_scan.hpp"
+#include "lt_cpu.hpp"
+#include <cstring>
+
+lt_internal inline u64
+tail_bits(usize size)
+{
+    return (size >= 64) ? ~(u64)0 : (((u64)1 << size) - 1);
+}
+
+ScanMasks
+lt::scan_masks_tail(const char *p, usize size, char delimiter)
+{
+    LT_Assert(size < 64);
+    alignas(64) char block[64] = {};
+    memcpy(block, p, size);
+    ScanMasks m = scan_masks64(block, delimiter);
+    const u64 valid = tail_bits(size);
+    m.newline &= valid;
+    m.delimiter &= valid;
+    m.quote &= valid;
+    return m;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Kernels
+//
+// One compare per byte value and block, for `blocks` full blocks. Each tier has its own copy
+// so the wider ones are compiled in even when the build targets the baseline.
+//
+
+lt_internal inline u64
+eq64_scalar(const char *p, char c)
+{
+    u64 mask = 0;
+    for (i32 i = 0; i < 64; i++) mask |= (u64)(p[i] == c) << i;
+    return mask;
+}
+
+lt_internal void
+eq_scalar(const char *p, usize blocks, char c, u64 *out)
+{
+    for (usize b = 0; b < blocks; b++, p += 64) out[b] = eq64_scalar(p, c);
+}
+
+lt_internal void
+masks_scalar(const char *p, usize blocks, char delimiter, ScanMasks *out)
+{
+    for (usize b = 0; b < blocks; b++, p += 64)
+        out[b] = ScanMasks{eq64_scalar(p, '\n'), eq64_scalar(p, delimiter), eq64_scalar(p, '"')};
+}
+
+#if defined(__SSE2__)
+lt_internal inline u64
+eq64_sse2(const char *p, char c)
+{
+    const __m128i k = _mm_set1_epi8(c);
+    u64 mask = 0;
+    for (i32 i = 0; i < 4; i++)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(p + 16*i));
+        mask |= (u64)(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, k)) << (16*i);
+    }
+    return mask;
+}
+
+lt_internal void
+eq_sse2(const char *p, usize blocks, char c, u64 *out)
+{
+    for (usize b = 0; b < blocks; b++, p += 64) out[b] = eq64_sse2(p, c);
+}
+
+lt_internal void
+masks_sse2(const char *p, usize blocks, char delimiter, ScanMasks *out)
+{
+    for (usize b = 0; b < blocks; b++, p += 64)
+        out[b] = ScanMasks{eq64_sse2(p, '\n'), eq64_sse2(p, delimiter), eq64_sse2(p, '"')};
+}
+#endif
+
+#if LT_CPU_HAS_AVX2
+LT_TARGET_AVX2 lt_internal inline u64
+eq64_avx2(const char *p, char c)
+{
+    const __m256i k = _mm256_set1_epi8(c);
+    const __m256i lo = _mm256_loadu_si256((const __m256i*)p);
+    const __m256i hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+    const u32 a = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, k));
+    const u32 b = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, k));
+    return (u64)a | ((u64)b << 32);
+}
+
+LT_TARGET_AVX2 lt_internal void
+eq_avx2(const char *p, usize blocks, char c, u64 *out)
+{
+    for (usize b = 0; b < blocks; b++, p += 64) out[b] = eq64_avx2(p, c);
+}
+
+LT_TARGET_AVX2 lt_internal void
+masks_avx2(const char *p, usize blocks, char delimiter, ScanMasks *out)
+{
+    for (usize b = 0; b < blocks; b++, p += 64)
+        out[b] = ScanMasks{eq64_avx2(p, '\n'), eq64_avx2(p, delimiter), eq64_avx2(p, '"')};
+}
+#endif
+
+#if LT_CPU_HAS_AVX512
+// A block is one register and the compare writes the bitmask directly.
+LT_TARGET_AVX512 lt_internal inline u64
+eq64_avx512(const char *p, char c)
+{
+    return (u64)_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(p), _mm512_set1_epi8(c));
+}
+
+LT_TARGET_AVX512 lt_internal void
+eq_avx512(const char *p, usize blocks, char c, u64 *out)
+{
+    for (usize b = 0; b < blocks; b++, p += 64) out[b] = eq64_avx512(p, c);
+}
+
+LT_TARGET_AVX512 lt_internal void
+masks_avx512(const char *p, usize blocks, char delimiter, ScanMasks *out)
+{
+    for (usize b = 0; b < blocks; b++, p += 64)
+        out[b] = ScanMasks{eq64_avx512(p, '\n'), eq64_avx512(p, delimiter), eq64_avx512(p, '"')};
+}
+#endif
+
+struct ScanKernel
+{
+    CpuIsa isa;
+    void (*eq)(const char *p, usize blocks, char c, u64 *out);
+    void (*masks)(const char *p, usize blocks, char delimiter, ScanMasks *out);
+};
+
+lt_global_variable const ScanKernel g_scan_kernels[] = {
+    {CpuIsa_Scalar, eq_scalar, masks_scalar},
+#if defined(__SSE2__)
+    {CpuIsa_SSE2,   eq_sse2,   masks_sse2},
+#endif
+#if LT_CPU_HAS_AVX2
+    {CpuIsa_AVX2,   eq_avx2,   masks_avx2},
+#endif
+#if LT_CPU_HAS_AVX512
+    {CpuIsa_AVX512, eq_avx512, masks_avx512},
+#endif
+};
+lt_global_variable CpuDispatchCache g_scan_dispatch;
+
+// Runs `kernel` on the zero padded tail block and clears the bits past `size`.
+lt_internal inline u64
+eq_tail(const ScanKernel *kernel, const char *p, usize size, char c)
+{
+    alignas(64) char block[64] = {};
+    memcpy(block, p, size);
+    u64 m;
+    kernel->eq(block, 1, c, &m);
+    return m & tail_bits(size);
+}
+
+usize
+lt::scan_masks_window(const char *p, usize size, char delimiter, ScanMasks *out)
+{
+    const ScanKernel *kernel = cpu_select(g_scan_kernels, &g_scan_dispatch);
+    usize full = size / 64;
+    if (full >= LT_SCAN_WINDOW_BLOCKS) full = LT_SCAN_WINDOW_BLOCKS;
+    kernel->masks(p, full, delimiter, out);
+    if (full == LT_SCAN_WINDOW_BLOCKS || full*64 == size) return full;
+
+    const usize rest = size - full*64;
+    alignas(64) char block[64] = {};
+    memcpy(block, p + full*64, rest);
+    kernel->masks(block, 1, delimiter, &out[full]);
+    const u64 valid = tail_bits(rest);
+    out[full].newline &= valid;
+    out[full].delimiter &= valid;
+    out[full].quote &= valid;
+    return full + 1;
+}
+
+// Matches are often close, so the windows start at one block and grow.
+const char *
+lt::scan_find(const char *begin, const char *end, char c)
+{
+    const ScanKernel *kernel = cpu_select(g_scan_kernels, &g_scan_dispatch);
+    const usize size = (usize)(end - begin);
+    u64 masks[LT_SCAN_WINDOW_BLOCKS];
+    usize window = 1;
+    usize offset = 0;
+    while (offset + 64 <= size)
+    {
+        usize blocks = (size - offset) / 64;
+        if (blocks > window) blocks = window;
+        kernel->eq(begin + offset, blocks, c, masks);
+        for (usize b = 0; b < blocks; b++)
+            if (masks[b]) return begin + offset + 64*b + __builtin_ctzll(masks[b]);
+        offset += 64*blocks;
+        if (window < LT_SCAN_WINDOW_BLOCKS) window *= 2;
+    }
+    if (offset < size)
+    {
+        const u64 m = eq_tail(kernel, begin + offset, size - offset, c);
+        if (m) return begin + offset + __builtin_ctzll(m);
+    }
+    return end;
+}
+
+usize
+lt::scan_count(const char *data, usize size, char c)
+{
+    const ScanKernel *kernel = cpu_select(g_scan_kernels, &g_scan_dispatch);
+    u64 masks[LT_SCAN_WINDOW_BLOCKS];
+    usize count = 0;
+    usize offset = 0;
+    while (offset + 64 <= size)
+    {
+        usize blocks = (size - offset) / 64;
+        if (blocks > LT_SCAN_WINDOW_BLOCKS) blocks = LT_SCAN_WINDOW_BLOCKS;
+        kernel->eq(data + offset, blocks, c, masks);
+        for (usize b = 0; b < blocks; b++) count += (usize)__builtin_popcountll(masks[b]);
+        offset += 64*blocks;
+    }
+    if (offset < size)
+        count += (usize)__builtin_popcountll(eq_tail(kernel, data + offset, size - offset, c));
+    return count;
+}
+
+// Returns the position right after the first newline outside quotes, or `end`.
+lt_internal const char *
+find_record_end(const char *p, const char *end, const ScanOptions &options, bool in_quotes)
+{
+    if (!options.quotes)
+    {
+        const char *nl = lt::scan_find(p, end, '\n');
+        return (nl < end) ? nl + 1 : end;
+    }
+
+    const usize size = (usize)(end - p);
+    u64 carry = in_quotes ? ~(u64)0 : 0;
+    ScanMasks masks[LT_SCAN_WINDOW_BLOCKS];
+    for (usize window = 0; window < size; window += 64*LT_SCAN_WINDOW_BLOCKS)
+    {
+        const usize num_blocks = lt::scan_masks_window(p + window, size - window, options.delimiter, masks);
+        for (usize b = 0; b < num_blocks; b++)
+        {
+            const u64 inside = lt::scan_prefix_xor(masks[b].quote) ^ carry;
+            carry = (u64)((i64)inside >> 63);
+            const u64 newlines = masks[b].newline & ~inside;
+            if (newlines) return p + window + 64*b + __builtin_ctzll(newlines) + 1;
+        }
+    }
+    return end;
+}
+
+usize
+lt::scan_split(const char *data, usize size, const ScanOptions &options,
+               TextChunk *chunks, usize max_chunks)
+{
+    LT_Assert(max_chunks > 0);
+    if (size == 0) return 0;
+
+    const usize n = (max_chunks < size) ? max_chunks : size;
+    auto nominal = [&](usize k) { return data + (size / n) * k + (size % n) * k / n; };
+
+    // Whether each nominal boundary falls inside quotes: the parity of the quotes before it.
+    // Counting them is a full pass over the text, done in parallel.
+    std::vector<u8> starts_quoted(n, 0);
+    if (options.quotes && n > 1)
+    {
+        parallel_for(n - 1, 1, [&](usize begin, usize end) {
+            for (usize k = begin; k < end; k++)
+                starts_quoted[k + 1] = scan_count(nominal(k), (usize)(nominal(k + 1) - nominal(k)), '"') & 1;
+        });
+        for (usize k = 1; k < n; k++) starts_quoted[k] ^= starts_quoted[k - 1];
+    }
+
+    const char *end = data + size;
+    const char *prev = data;
+    usize count = 0;
+    for (usize k = 1; k < n && prev < end; k++)
+    {
+        const char *from = nominal(k);
+        bool in_quotes = starts_quoted[k] != 0;
+        // A long record already swallowed this boundary, the previous record end is outside
+        // quotes by construction.
+        if (from <= prev)
+        {
+            from = prev;
+            in_quotes = false;
+        }
+
+        const char *record_end = find_record_end(from, end, options, in_quotes);
+        if (record_end > prev)
+        {
+            chunks[count++] = TextChunk{prev, record_end};
+            prev = record_end;
+        }
+    }
+    if (prev < end) chunks[count++] = TextChunk{prev, end};
+    return count;
+}
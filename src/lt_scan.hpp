@@ -0,0 +1,214 @@
+#ifndef LT_SCAN_HPP
+#define LT_SCAN_HPP
+
+#include "lt_core.hpp"
+#include "lt_parallel.hpp"
+
+#if (LT_GCC || LT_CLANG) && LT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// Text scanning
+//
+// Splits text into records and fields 64 bytes at a time. Each block is turned into bitmasks
+// (one bit per byte) of newlines, delimiters and quotes with vector compares, and the bits are
+// walked with count-trailing-zeros instead of testing every byte.
+//
+// Bulk scans (scan_records, scan_find, scan_count) compute the masks of up to
+// LT_SCAN_WINDOW_BLOCKS blocks per call with the SSE2, AVX2 or AVX-512 kernel that the active
+// CpuIsa selects (lt_cpu.hpp). The inline scan_eq64/scan_masks64, used for short records,
+// only use what the compiler flags enable.
+//
+// With ScanOptions::quotes set, the text is treated as CSV: newlines and delimiters between
+// double quotes do not end a record or a field. The quoted regions are found with a prefix
+// xor over the quote mask, so escaped quotes ("") need no special handling.
+//
+// None of the functions need a terminating zero, so they work the same on buffers from
+// file_read_contents and on mapped files.
+//
+
+#define LT_SCAN_WINDOW_BLOCKS 64
+
+struct ScanMasks
+{
+    u64 newline;
+    u64 delimiter;
+    u64 quote;
+};
+
+struct ScanOptions
+{
+    char delimiter = ',';
+    bool quotes    = false;
+};
+
+struct TextChunk
+{
+    const char *begin;
+    const char *end;
+};
+
+namespace lt
+{
+
+// Bit i is set when p[i] == c. `p` must have 64 readable bytes.
+inline u64
+scan_eq64(const char *p, char c)
+{
+#if defined(__AVX2__)
+    const __m256i k = _mm256_set1_epi8(c);
+    const __m256i lo = _mm256_loadu_si256((const __m256i*)p);
+    const __m256i hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+    const u32 a = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, k));
+    const u32 b = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, k));
+    return (u64)a | ((u64)b << 32);
+#elif defined(__SSE2__)
+    const __m128i k = _mm_set1_epi8(c);
+    u64 mask = 0;
+    for (i32 i = 0; i < 4; i++)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(p + 16*i));
+        mask |= (u64)(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, k)) << (16*i);
+    }
+    return mask;
+#else
+    u64 mask = 0;
+    for (i32 i = 0; i < 64; i++) mask |= (u64)(p[i] == c) << i;
+    return mask;
+#endif
+}
+
+inline ScanMasks
+scan_masks64(const char *p, char delimiter)
+{
+    return ScanMasks{scan_eq64(p, '\n'), scan_eq64(p, delimiter), scan_eq64(p, '"')};
+}
+
+// Masks for the last `size` (< 64) bytes, the bits past `size` are clear.
+ScanMasks scan_masks_tail(const char *p, usize size, char delimiter);
+
+// Masks for the first LT_SCAN_WINDOW_BLOCKS blocks of [p, p + size) with the runtime selected
+// kernel. The bits past `size` of a last partial block are clear. Returns the number of blocks.
+usize     scan_masks_window(const char *p, usize size, char delimiter, ScanMasks *out);
+
+// Bit i of the result is the xor of bits [0, i] of `m`: set from an opening quote up to (not
+// including) the closing one.
+inline u64
+scan_prefix_xor(u64 m)
+{
+#if defined(__PCLMUL__)
+    const __m128i r = _mm_clmulepi64_si128(_mm_set_epi64x(0, (i64)m), _mm_set1_epi8((char)0xFF), 0);
+    return (u64)_mm_cvtsi128_si64(r);
+#else
+    m ^= m << 1;
+    m ^= m << 2;
+    m ^= m << 4;
+    m ^= m << 8;
+    m ^= m << 16;
+    m ^= m << 32;
+    return m;
+#endif
+}
+
+// Returns `end` when `c` is not found.
+const char *scan_find(const char *begin, const char *end, char c);
+usize       scan_count(const char *data, usize size, char c);
+
+// Calls fn(record, length) for every record, without the newline and a trailing '\r'. A last
+// record with no newline is reported when it is not empty. Returns the number of records.
+template<typename F> usize
+scan_records(const char *data, usize size, const ScanOptions &options, const F &fn)
+{
+    usize count = 0;
+    usize start = 0;
+    u64 in_quotes = 0;
+    auto emit = [&](usize end) {
+        usize len = end - start;
+        if (len > 0 && data[end - 1] == '\r') len--;
+        fn(data + start, len);
+        count++;
+        start = end + 1;
+    };
+
+    ScanMasks masks[LT_SCAN_WINDOW_BLOCKS];
+    for (usize window = 0; window < size; window += 64*LT_SCAN_WINDOW_BLOCKS)
+    {
+        const usize num_blocks = scan_masks_window(data + window, size - window, options.delimiter, masks);
+        for (usize b = 0; b < num_blocks; b++)
+        {
+            const usize offset = window + 64*b;
+            u64 newlines = masks[b].newline;
+            if (options.quotes)
+            {
+                const u64 inside = scan_prefix_xor(masks[b].quote) ^ in_quotes;
+                in_quotes = (u64)((i64)inside >> 63);
+                newlines &= ~inside;
+            }
+            for (; newlines; newlines &= newlines - 1)
+                emit(offset + (usize)__builtin_ctzll(newlines));
+        }
+    }
+    if (start < size) emit(size);
+    return count;
+}
+
+// Calls fn(field, length, column) for every field of a record. Quoted fields are reported as
+// they appear, quotes included. Returns the number of fields.
+template<typename F> u32
+scan_fields(const char *record, usize size, const ScanOptions &options, const F &fn)
+{
+    u32 column = 0;
+    usize start = 0;
+    u64 in_quotes = 0;
+    for (usize offset = 0; offset < size; offset += 64)
+    {
+        const ScanMasks m = (size - offset >= 64)
+            ? scan_masks64(record + offset, options.delimiter)
+            : scan_masks_tail(record + offset, size - offset, options.delimiter);
+
+        u64 delimiters = m.delimiter;
+        if (options.quotes)
+        {
+            const u64 inside = scan_prefix_xor(m.quote) ^ in_quotes;
+            in_quotes = (u64)((i64)inside >> 63);
+            delimiters &= ~inside;
+        }
+        for (; delimiters; delimiters &= delimiters - 1)
+        {
+            const usize end = offset + (usize)__builtin_ctzll(delimiters);
+            fn(record + start, end - start, column++);
+            start = end + 1;
+        }
+    }
+    fn(record + start, size - start, column++);
+    return column;
+}
+
+// Cuts [data, data + size) into at most `max_chunks` chunks of similar size that end right
+// after a record. Chunks never start inside quotes, so each one can be scanned on its own.
+// Returns the number of chunks, 0 for empty input.
+usize scan_split(const char *data, usize size, const ScanOptions &options,
+                 TextChunk *chunks, usize max_chunks);
+
+// Splits the text with scan_split and calls fn(chunk, chunk_index) from the worker threads.
+// Inputs smaller than `min_chunk_size` per worker use fewer threads.
+template<typename F> void
+parallel_scan(const char *data, usize size, const ScanOptions &options, const F &fn,
+              usize min_chunk_size = Megabytes(1))
+{
+    usize max_chunks = size / (min_chunk_size > 0 ? min_chunk_size : 1);
+    if (max_chunks > worker_count()) max_chunks = worker_count();
+    if (max_chunks == 0) max_chunks = 1;
+
+    std::vector<TextChunk> chunks(max_chunks);
+    const usize num_chunks = scan_split(data, size, options, chunks.data(), max_chunks);
+    parallel_for(num_chunks, 1, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) fn(chunks[i], i);
+    });
+}
+
+}
+
+#endif // LT_SCAN_HPP
@@ -0,0 +1,613 @@
+#include "lt_skinning.hpp"
+#include "lt_cpu.hpp"
+
+#include <cmath>
+
+#if (LT_GCC || LT_CLANG) && LT_ARCH_X86
+#include <immintrin.h>
+#endif
+
+static_assert(sizeof(DualQuatf) == 8 * sizeof(f32), "DualQuatf is expected to be tightly packed");
+
+// The kernels see dual quaternions as 8 floats, (w, x, y, z) of the real part then of the dual
+// part, and vertices as lanes: q[c] holds component c of every lane.
+
+void
+lt::skin_palette(const Mat4f *joint_matrices, DualQuatf *palette, usize count)
+{
+    for (usize i = 0; i < count; i++) palette[i] = lt::dual_quat(joint_matrices[i]);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Scalar
+//
+
+lt_internal void
+blend_scalar(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences, f32 q[8])
+{
+    const f32 *first = palette + 8 * (usize)joints[0];
+    for (i32 c = 0; c < 8; c++) q[c] = 0;
+    for (u32 k = 0; k < influences; k++)
+    {
+        const f32 *p = palette + 8 * (usize)joints[k];
+        const f32 dot = p[0]*first[0] + p[1]*first[1] + p[2]*first[2] + p[3]*first[3];
+        const f32 w = (dot < 0) ? -weights[k] : weights[k];
+        for (i32 c = 0; c < 8; c++) q[c] += w * p[c];
+    }
+
+    const f32 inv_norm = 1.0f / std::sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+    for (i32 c = 0; c < 8; c++) q[c] *= inv_norm;
+}
+
+// v + 2 * cross(r, cross(r, v) + w * v), the rotation of v by the real part.
+lt_internal inline void
+rotate_scalar(const f32 q[8], f32 *x, f32 *y, f32 *z)
+{
+    const f32 ax = (q[2]*(*z) - q[3]*(*y)) + q[0]*(*x);
+    const f32 ay = (q[3]*(*x) - q[1]*(*z)) + q[0]*(*y);
+    const f32 az = (q[1]*(*y) - q[2]*(*x)) + q[0]*(*z);
+    *x += 2 * (q[2]*az - q[3]*ay);
+    *y += 2 * (q[3]*ax - q[1]*az);
+    *z += 2 * (q[1]*ay - q[2]*ax);
+}
+
+lt_internal void
+apply_scalar(const f32 q[8], const SkinVertices &in, const SkinVertices &out, usize i)
+{
+    // 2 * dual * conjugate(real)
+    const f32 tx = 2 * (q[0]*q[5] - q[4]*q[1] + q[2]*q[7] - q[3]*q[6]);
+    const f32 ty = 2 * (q[0]*q[6] - q[4]*q[2] + q[3]*q[5] - q[1]*q[7]);
+    const f32 tz = 2 * (q[0]*q[7] - q[4]*q[3] + q[1]*q[6] - q[2]*q[5]);
+
+    f32 x = in.x[i], y = in.y[i], z = in.z[i];
+    rotate_scalar(q, &x, &y, &z);
+    out.x[i] = x + tx;
+    out.y[i] = y + ty;
+    out.z[i] = z + tz;
+
+    if (in.nx)
+    {
+        f32 nx = in.nx[i], ny = in.ny[i], nz = in.nz[i];
+        rotate_scalar(q, &nx, &ny, &nz);
+        out.nx[i] = nx;
+        out.ny[i] = ny;
+        out.nz[i] = nz;
+    }
+}
+
+lt_internal void
+blend_range_scalar(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences, f32 *out,
+                   usize begin, usize count)
+{
+    for (usize i = begin; i < count; i++)
+        blend_scalar(palette, joints + i * influences, weights + i * influences, influences, out + 8 * i);
+}
+
+lt_internal void
+apply_range_scalar(const f32 *transforms, const SkinVertices &in, const SkinVertices &out, usize begin, usize count)
+{
+    for (usize i = begin; i < count; i++) apply_scalar(transforms + 8 * i, in, out, i);
+}
+
+lt_internal void
+skin_range_scalar(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences,
+                  const SkinVertices &in, const SkinVertices &out, usize begin, usize count)
+{
+    for (usize i = begin; i < count; i++)
+    {
+        f32 q[8];
+        blend_scalar(palette, joints + i * influences, weights + i * influences, influences, q);
+        apply_scalar(q, in, out, i);
+    }
+}
+
+lt_internal void
+blend_kernel_scalar(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences, f32 *out, usize count)
+{
+    blend_range_scalar(palette, joints, weights, influences, out, 0, count);
+}
+
+lt_internal void
+apply_kernel_scalar(const f32 *transforms, const SkinVertices &in, const SkinVertices &out, usize count)
+{
+    apply_range_scalar(transforms, in, out, 0, count);
+}
+
+lt_internal void
+skin_kernel_scalar(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences,
+                   const SkinVertices &in, const SkinVertices &out, usize count)
+{
+    skin_range_scalar(palette, joints, weights, influences, in, out, 0, count);
+}
+
+/////////////////////////////////////////////////////////
+//
+// SSE2, 4 vertices. Dual quaternions are moved in and out of the lanes with two 4x4 transposes.
+//
+
+#if defined(__SSE2__)
+lt_internal inline void
+load_rows_sse2(const f32 *const rows[4], __m128 q[8])
+{
+    for (i32 half = 0; half < 2; half++)
+    {
+        __m128 r0 = _mm_loadu_ps(rows[0] + 4*half), r1 = _mm_loadu_ps(rows[1] + 4*half);
+        __m128 r2 = _mm_loadu_ps(rows[2] + 4*half), r3 = _mm_loadu_ps(rows[3] + 4*half);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        q[4*half] = r0;
+        q[4*half + 1] = r1;
+        q[4*half + 2] = r2;
+        q[4*half + 3] = r3;
+    }
+}
+
+lt_internal inline void
+store_rows_sse2(const __m128 q[8], f32 *out)
+{
+    for (i32 half = 0; half < 2; half++)
+    {
+        __m128 r0 = q[4*half], r1 = q[4*half + 1], r2 = q[4*half + 2], r3 = q[4*half + 3];
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(out + 4*half, r0);
+        _mm_storeu_ps(out + 8 + 4*half, r1);
+        _mm_storeu_ps(out + 16 + 4*half, r2);
+        _mm_storeu_ps(out + 24 + 4*half, r3);
+    }
+}
+
+lt_internal inline void
+blend_sse2(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences, __m128 q[8])
+{
+    const usize s = influences;
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 first[4];
+    for (i32 c = 0; c < 8; c++) q[c] = _mm_setzero_ps();   // influences > 0, this only quiets -Wmaybe-uninitialized.
+    for (u32 k = 0; k < influences; k++)
+    {
+        const f32 *rows[4] = {palette + 8 * (usize)joints[k],       palette + 8 * (usize)joints[s + k],
+                              palette + 8 * (usize)joints[2*s + k], palette + 8 * (usize)joints[3*s + k]};
+        __m128 p[8];
+        load_rows_sse2(rows, p);
+        __m128 w = _mm_setr_ps(weights[k], weights[s + k], weights[2*s + k], weights[3*s + k]);
+
+        if (k == 0)
+        {
+            for (i32 c = 0; c < 4; c++) first[c] = p[c];
+            for (i32 c = 0; c < 8; c++) q[c] = _mm_mul_ps(w, p[c]);
+            continue;
+        }
+
+        __m128 dot = _mm_mul_ps(p[0], first[0]);
+        for (i32 c = 1; c < 4; c++) dot = _mm_add_ps(dot, _mm_mul_ps(p[c], first[c]));
+        w = _mm_xor_ps(w, _mm_and_ps(dot, sign));
+        for (i32 c = 0; c < 8; c++) q[c] = _mm_add_ps(q[c], _mm_mul_ps(w, p[c]));
+    }
+
+    __m128 norm2 = _mm_mul_ps(q[0], q[0]);
+    for (i32 c = 1; c < 4; c++) norm2 = _mm_add_ps(norm2, _mm_mul_ps(q[c], q[c]));
+    const __m128 inv_norm = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(norm2));
+    for (i32 c = 0; c < 8; c++) q[c] = _mm_mul_ps(q[c], inv_norm);
+}
+
+lt_internal inline void
+rotate_sse2(const __m128 q[8], __m128 *x, __m128 *y, __m128 *z)
+{
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 ax = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(q[2], *z), _mm_mul_ps(q[3], *y)), _mm_mul_ps(q[0], *x));
+    const __m128 ay = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(q[3], *x), _mm_mul_ps(q[1], *z)), _mm_mul_ps(q[0], *y));
+    const __m128 az = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(q[1], *y), _mm_mul_ps(q[2], *x)), _mm_mul_ps(q[0], *z));
+    *x = _mm_add_ps(*x, _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(q[2], az), _mm_mul_ps(q[3], ay))));
+    *y = _mm_add_ps(*y, _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(q[3], ax), _mm_mul_ps(q[1], az))));
+    *z = _mm_add_ps(*z, _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(q[1], ay), _mm_mul_ps(q[2], ax))));
+}
+
+lt_internal inline void
+apply_sse2(const __m128 q[8], const SkinVertices &in, const SkinVertices &out, usize i)
+{
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 tx = _mm_mul_ps(two, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(q[0], q[5]), _mm_mul_ps(q[4], q[1])),
+                                                 _mm_sub_ps(_mm_mul_ps(q[2], q[7]), _mm_mul_ps(q[3], q[6]))));
+    const __m128 ty = _mm_mul_ps(two, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(q[0], q[6]), _mm_mul_ps(q[4], q[2])),
+                                                 _mm_sub_ps(_mm_mul_ps(q[3], q[5]), _mm_mul_ps(q[1], q[7]))));
+    const __m128 tz = _mm_mul_ps(two, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(q[0], q[7]), _mm_mul_ps(q[4], q[3])),
+                                                 _mm_sub_ps(_mm_mul_ps(q[1], q[6]), _mm_mul_ps(q[2], q[5]))));
+
+    __m128 x = _mm_loadu_ps(in.x + i), y = _mm_loadu_ps(in.y + i), z = _mm_loadu_ps(in.z + i);
+    rotate_sse2(q, &x, &y, &z);
+    _mm_storeu_ps(out.x + i, _mm_add_ps(x, tx));
+    _mm_storeu_ps(out.y + i, _mm_add_ps(y, ty));
+    _mm_storeu_ps(out.z + i, _mm_add_ps(z, tz));
+
+    if (in.nx)
+    {
+        __m128 nx = _mm_loadu_ps(in.nx + i), ny = _mm_loadu_ps(in.ny + i), nz = _mm_loadu_ps(in.nz + i);
+        rotate_sse2(q, &nx, &ny, &nz);
+        _mm_storeu_ps(out.nx + i, nx);
+        _mm_storeu_ps(out.ny + i, ny);
+        _mm_storeu_ps(out.nz + i, nz);
+    }
+}
+
+lt_internal void
+blend_kernel_sse2(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences, f32 *out, usize count)
+{
+    usize i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 q[8];
+        blend_sse2(palette, joints + i * influences, weights + i * influences, influences, q);
+        store_rows_sse2(q, out + 8 * i);
+    }
+    blend_range_scalar(palette, joints, weights, influences, out, i, count);
+}
+
+lt_internal void
+apply_kernel_sse2(const f32 *transforms, const SkinVertices &in, const SkinVertices &out, usize count)
+{
+    usize i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const f32 *t = transforms + 8 * i;
+        const f32 *const rows[4] = {t, t + 8, t + 16, t + 24};
+        __m128 q[8];
+        load_rows_sse2(rows, q);
+        apply_sse2(q, in, out, i);
+    }
+    apply_range_scalar(transforms, in, out, i, count);
+}
+
+lt_internal void
+skin_kernel_sse2(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences,
+                 const SkinVertices &in, const SkinVertices &out, usize count)
+{
+    usize i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 q[8];
+        blend_sse2(palette, joints + i * influences, weights + i * influences, influences, q);
+        apply_sse2(q, in, out, i);
+    }
+    skin_range_scalar(palette, joints, weights, influences, in, out, i, count);
+}
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// AVX2, 8 vertices. A dual quaternion fills a register, so the lanes are an 8x8 transpose of
+// 8 of them.
+//
+
+#if LT_CPU_HAS_AVX2
+LT_TARGET_AVX2 lt_internal inline void
+transpose8_avx2(__m256 r[8])
+{
+    const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+    const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+LT_TARGET_AVX2 lt_internal inline void
+blend_avx2(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences, __m256 q[8])
+{
+    const __m256i stride = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                              _mm256_set1_epi32((i32)influences));
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 first[4];
+    for (i32 c = 0; c < 8; c++) q[c] = _mm256_setzero_ps();   // influences > 0, this only quiets -Wmaybe-uninitialized.
+    for (u32 k = 0; k < influences; k++)
+    {
+        __m256 p[8];
+        for (i32 l = 0; l < 8; l++) p[l] = _mm256_loadu_ps(palette + 8 * (usize)joints[l * influences + k]);
+        transpose8_avx2(p);
+        __m256 w = _mm256_i32gather_ps(weights + k, stride, 4);
+
+        if (k == 0)
+        {
+            for (i32 c = 0; c < 4; c++) first[c] = p[c];
+            for (i32 c = 0; c < 8; c++) q[c] = _mm256_mul_ps(w, p[c]);
+            continue;
+        }
+
+        __m256 dot = _mm256_mul_ps(p[0], first[0]);
+        for (i32 c = 1; c < 4; c++) dot = _mm256_fmadd_ps(p[c], first[c], dot);
+        w = _mm256_xor_ps(w, _mm256_and_ps(dot, sign));
+        for (i32 c = 0; c < 8; c++) q[c] = _mm256_fmadd_ps(w, p[c], q[c]);
+    }
+
+    __m256 norm2 = _mm256_mul_ps(q[0], q[0]);
+    for (i32 c = 1; c < 4; c++) norm2 = _mm256_fmadd_ps(q[c], q[c], norm2);
+    const __m256 inv_norm = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(norm2));
+    for (i32 c = 0; c < 8; c++) q[c] = _mm256_mul_ps(q[c], inv_norm);
+}
+
+LT_TARGET_AVX2 lt_internal inline void
+rotate_avx2(const __m256 q[8], __m256 *x, __m256 *y, __m256 *z)
+{
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 ax = _mm256_fmadd_ps(q[0], *x, _mm256_fmsub_ps(q[2], *z, _mm256_mul_ps(q[3], *y)));
+    const __m256 ay = _mm256_fmadd_ps(q[0], *y, _mm256_fmsub_ps(q[3], *x, _mm256_mul_ps(q[1], *z)));
+    const __m256 az = _mm256_fmadd_ps(q[0], *z, _mm256_fmsub_ps(q[1], *y, _mm256_mul_ps(q[2], *x)));
+    *x = _mm256_fmadd_ps(two, _mm256_fmsub_ps(q[2], az, _mm256_mul_ps(q[3], ay)), *x);
+    *y = _mm256_fmadd_ps(two, _mm256_fmsub_ps(q[3], ax, _mm256_mul_ps(q[1], az)), *y);
+    *z = _mm256_fmadd_ps(two, _mm256_fmsub_ps(q[1], ay, _mm256_mul_ps(q[2], ax)), *z);
+}
+
+LT_TARGET_AVX2 lt_internal inline void
+apply_avx2(const __m256 q[8], const SkinVertices &in, const SkinVertices &out, usize i)
+{
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 tx = _mm256_mul_ps(two, _mm256_add_ps(_mm256_fmsub_ps(q[0], q[5], _mm256_mul_ps(q[4], q[1])),
+                                                       _mm256_fmsub_ps(q[2], q[7], _mm256_mul_ps(q[3], q[6]))));
+    const __m256 ty = _mm256_mul_ps(two, _mm256_add_ps(_mm256_fmsub_ps(q[0], q[6], _mm256_mul_ps(q[4], q[2])),
+                                                       _mm256_fmsub_ps(q[3], q[5], _mm256_mul_ps(q[1], q[7]))));
+    const __m256 tz = _mm256_mul_ps(two, _mm256_add_ps(_mm256_fmsub_ps(q[0], q[7], _mm256_mul_ps(q[4], q[3])),
+                                                       _mm256_fmsub_ps(q[1], q[6], _mm256_mul_ps(q[2], q[5]))));
+
+    __m256 x = _mm256_loadu_ps(in.x + i), y = _mm256_loadu_ps(in.y + i), z = _mm256_loadu_ps(in.z + i);
+    rotate_avx2(q, &x, &y, &z);
+    _mm256_storeu_ps(out.x + i, _mm256_add_ps(x, tx));
+    _mm256_storeu_ps(out.y + i, _mm256_add_ps(y, ty));
+    _mm256_storeu_ps(out.z + i, _mm256_add_ps(z, tz));
+
+    if (in.nx)
+    {
+        __m256 nx = _mm256_loadu_ps(in.nx + i), ny = _mm256_loadu_ps(in.ny + i), nz = _mm256_loadu_ps(in.nz + i);
+        rotate_avx2(q, &nx, &ny, &nz);
+        _mm256_storeu_ps(out.nx + i, nx);
+        _mm256_storeu_ps(out.ny + i, ny);
+        _mm256_storeu_ps(out.nz + i, nz);
+    }
+}
+
+LT_TARGET_AVX2 lt_internal void
+blend_kernel_avx2(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences, f32 *out, usize count)
+{
+    usize i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 q[8];
+        blend_avx2(palette, joints + i * influences, weights + i * influences, influences, q);
+        transpose8_avx2(q);
+        for (i32 l = 0; l < 8; l++) _mm256_storeu_ps(out + 8 * (i + l), q[l]);
+    }
+    blend_range_scalar(palette, joints, weights, influences, out, i, count);
+}
+
+LT_TARGET_AVX2 lt_internal void
+apply_kernel_avx2(const f32 *transforms, const SkinVertices &in, const SkinVertices &out, usize count)
+{
+    usize i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 q[8];
+        for (i32 l = 0; l < 8; l++) q[l] = _mm256_loadu_ps(transforms + 8 * (i + l));
+        transpose8_avx2(q);
+        apply_avx2(q, in, out, i);
+    }
+    apply_range_scalar(transforms, in, out, i, count);
+}
+
+LT_TARGET_AVX2 lt_internal void
+skin_kernel_avx2(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences,
+                 const SkinVertices &in, const SkinVertices &out, usize count)
+{
+    usize i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 q[8];
+        blend_avx2(palette, joints + i * influences, weights + i * influences, influences, q);
+        apply_avx2(q, in, out, i);
+    }
+    skin_range_scalar(palette, joints, weights, influences, in, out, i, count);
+}
+#endif
+
+/////////////////////////////////////////////////////////
+//
+// AVX-512, 16 vertices. Components are gathered into the lanes and scattered back.
+//
+
+#if LT_CPU_HAS_AVX512
+#if LT_GCC && !LT_CLANG
+// Same GCC 12 false positive on _mm512_undefined_epi32 as in lt_hash.cpp.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+LT_TARGET_AVX512 lt_internal inline __m512i
+lane_offsets_avx512(i32 stride)
+{
+    return _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                              _mm512_set1_epi32(stride));
+}
+
+LT_TARGET_AVX512 lt_internal inline void
+blend_avx512(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences, __m512 q[8])
+{
+    const __m512i stride = lane_offsets_avx512((i32)influences);
+    __m512 first[4];
+    for (i32 c = 0; c < 8; c++) q[c] = _mm512_setzero_ps();   // influences > 0, this only quiets -Wmaybe-uninitialized.
+    for (u32 k = 0; k < influences; k++)
+    {
+        alignas(64) i32 offsets[16];
+        for (i32 l = 0; l < 16; l++) offsets[l] = 8 * (i32)joints[l * influences + k];
+        const __m512i index = _mm512_load_si512(offsets);
+
+        __m512 p[8];
+        for (i32 c = 0; c < 8; c++) p[c] = _mm512_i32gather_ps(index, palette + c, 4);
+        __m512 w = _mm512_i32gather_ps(stride, weights + k, 4);
+
+        if (k == 0)
+        {
+            for (i32 c = 0; c < 4; c++) first[c] = p[c];
+            for (i32 c = 0; c < 8; c++) q[c] = _mm512_mul_ps(w, p[c]);
+            continue;
+        }
+
+        __m512 dot = _mm512_mul_ps(p[0], first[0]);
+        for (i32 c = 1; c < 4; c++) dot = _mm512_fmadd_ps(p[c], first[c], dot);
+        w = _mm512_mask_sub_ps(w, _mm512_cmp_ps_mask(dot, _mm512_setzero_ps(), _CMP_LT_OQ), _mm512_setzero_ps(), w);
+        for (i32 c = 0; c < 8; c++) q[c] = _mm512_fmadd_ps(w, p[c], q[c]);
+    }
+
+    __m512 norm2 = _mm512_mul_ps(q[0], q[0]);
+    for (i32 c = 1; c < 4; c++) norm2 = _mm512_fmadd_ps(q[c], q[c], norm2);
+    const __m512 inv_norm = _mm512_div_ps(_mm512_set1_ps(1.0f), _mm512_sqrt_ps(norm2));
+    for (i32 c = 0; c < 8; c++) q[c] = _mm512_mul_ps(q[c], inv_norm);
+}
+
+LT_TARGET_AVX512 lt_internal inline void
+rotate_avx512(const __m512 q[8], __m512 *x, __m512 *y, __m512 *z)
+{
+    const __m512 two = _mm512_set1_ps(2.0f);
+    const __m512 ax = _mm512_fmadd_ps(q[0], *x, _mm512_fmsub_ps(q[2], *z, _mm512_mul_ps(q[3], *y)));
+    const __m512 ay = _mm512_fmadd_ps(q[0], *y, _mm512_fmsub_ps(q[3], *x, _mm512_mul_ps(q[1], *z)));
+    const __m512 az = _mm512_fmadd_ps(q[0], *z, _mm512_fmsub_ps(q[1], *y, _mm512_mul_ps(q[2], *x)));
+    *x = _mm512_fmadd_ps(two, _mm512_fmsub_ps(q[2], az, _mm512_mul_ps(q[3], ay)), *x);
+    *y = _mm512_fmadd_ps(two, _mm512_fmsub_ps(q[3], ax, _mm512_mul_ps(q[1], az)), *y);
+    *z = _mm512_fmadd_ps(two, _mm512_fmsub_ps(q[1], ay, _mm512_mul_ps(q[2], ax)), *z);
+}
+
+LT_TARGET_AVX512 lt_internal inline void
+apply_avx512(const __m512 q[8], const SkinVertices &in, const SkinVertices &out, usize i)
+{
+    const __m512 two = _mm512_set1_ps(2.0f);
+    const __m512 tx = _mm512_mul_ps(two, _mm512_add_ps(_mm512_fmsub_ps(q[0], q[5], _mm512_mul_ps(q[4], q[1])),
+                                                       _mm512_fmsub_ps(q[2], q[7], _mm512_mul_ps(q[3], q[6]))));
+    const __m512 ty = _mm512_mul_ps(two, _mm512_add_ps(_mm512_fmsub_ps(q[0], q[6], _mm512_mul_ps(q[4], q[2])),
+                                                       _mm512_fmsub_ps(q[3], q[5], _mm512_mul_ps(q[1], q[7]))));
+    const __m512 tz = _mm512_mul_ps(two, _mm512_add_ps(_mm512_fmsub_ps(q[0], q[7], _mm512_mul_ps(q[4], q[3])),
+                                                       _mm512_fmsub_ps(q[1], q[6], _mm512_mul_ps(q[2], q[5]))));
+
+    __m512 x = _mm512_loadu_ps(in.x + i), y = _mm512_loadu_ps(in.y + i), z = _mm512_loadu_ps(in.z + i);
+    rotate_avx512(q, &x, &y, &z);
+    _mm512_storeu_ps(out.x + i, _mm512_add_ps(x, tx));
+    _mm512_storeu_ps(out.y + i, _mm512_add_ps(y, ty));
+    _mm512_storeu_ps(out.z + i, _mm512_add_ps(z, tz));
+
+    if (in.nx)
+    {
+        __m512 nx = _mm512_loadu_ps(in.nx + i), ny = _mm512_loadu_ps(in.ny + i), nz = _mm512_loadu_ps(in.nz + i);
+        rotate_avx512(q, &nx, &ny, &nz);
+        _mm512_storeu_ps(out.nx + i, nx);
+        _mm512_storeu_ps(out.ny + i, ny);
+        _mm512_storeu_ps(out.nz + i, nz);
+    }
+}
+
+LT_TARGET_AVX512 lt_internal void
+blend_kernel_avx512(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences, f32 *out, usize count)
+{
+    const __m512i rows = lane_offsets_avx512(8);
+    usize i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 q[8];
+        blend_avx512(palette, joints + i * influences, weights + i * influences, influences, q);
+        for (i32 c = 0; c < 8; c++) _mm512_i32scatter_ps(out + 8 * i + c, rows, q[c], 4);
+    }
+    blend_range_scalar(palette, joints, weights, influences, out, i, count);
+}
+
+LT_TARGET_AVX512 lt_internal void
+apply_kernel_avx512(const f32 *transforms, const SkinVertices &in, const SkinVertices &out, usize count)
+{
+    const __m512i rows = lane_offsets_avx512(8);
+    usize i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 q[8];
+        for (i32 c = 0; c < 8; c++) q[c] = _mm512_i32gather_ps(rows, transforms + 8 * i + c, 4);
+        apply_avx512(q, in, out, i);
+    }
+    apply_range_scalar(transforms, in, out, i, count);
+}
+
+LT_TARGET_AVX512 lt_internal void
+skin_kernel_avx512(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences,
+                   const SkinVertices &in, const SkinVertices &out, usize count)
+{
+    usize i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 q[8];
+        blend_avx512(palette, joints + i * influences, weights + i * influences, influences, q);
+        apply_avx512(q, in, out, i);
+    }
+    skin_range_scalar(palette, joints, weights, influences, in, out, i, count);
+}
+
+#if LT_GCC && !LT_CLANG
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+struct SkinKernel
+{
+    CpuIsa isa;
+    void (*blend)(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences, f32 *out, usize count);
+    void (*apply)(const f32 *transforms, const SkinVertices &in, const SkinVertices &out, usize count);
+    void (*skin)(const f32 *palette, const u16 *joints, const f32 *weights, u32 influences,
+                 const SkinVertices &in, const SkinVertices &out, usize count);
+};
+
+lt_global_variable const SkinKernel g_skin_kernels[] = {
+    {CpuIsa_Scalar, blend_kernel_scalar, apply_kernel_scalar, skin_kernel_scalar},
+#if defined(__SSE2__)
+    {CpuIsa_SSE2,   blend_kernel_sse2,   apply_kernel_sse2,   skin_kernel_sse2},
+#endif
+#if LT_CPU_HAS_AVX2
+    {CpuIsa_AVX2,   blend_kernel_avx2,   apply_kernel_avx2,   skin_kernel_avx2},
+#endif
+#if LT_CPU_HAS_AVX512
+    {CpuIsa_AVX512, blend_kernel_avx512, apply_kernel_avx512, skin_kernel_avx512},
+#endif
+};
+lt_global_variable CpuDispatchCache g_skin_dispatch;
+
+const char *
+lt::skin_kernel_name()
+{
+    return cpu_isa_name(cpu_select(g_skin_kernels, &g_skin_dispatch)->isa);
+}
+
+void
+lt::skin_blend(const DualQuatf *palette, const u16 *joints, const f32 *weights, u32 influences,
+               DualQuatf *out, usize count)
+{
+    LT_Assert(influences > 0);
+    cpu_select(g_skin_kernels, &g_skin_dispatch)->blend((const f32*)palette, joints, weights, influences, (f32*)out, count);
+}
+
+void
+lt::skin_apply(const DualQuatf *transforms, const SkinVertices &in, const SkinVertices &out, usize count)
+{
+    cpu_select(g_skin_kernels, &g_skin_dispatch)->apply((const f32*)transforms, in, out, count);
+}
+
+void
+lt::skin_vertices(const DualQuatf *palette, const u16 *joints, const f32 *weights, u32 influences,
+                  const SkinVertices &in, const SkinVertices &out, usize count)
+{
+    LT_Assert(influences > 0);
+    cpu_select(g_skin_kernels, &g_skin_dispatch)->skin((const f32*)palette, joints, weights, influences, in, out, count);
+}
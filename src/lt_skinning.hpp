@@ -0,0 +1,51 @@
+#ifndef LT_SKINNING_HPP
+#define LT_SKINNING_HPP
+
+#include "lt_core.hpp"
+#include "lt_math.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Skinning
+//
+// Dual quaternion linear blending (Kavan et al.): every vertex adds up the dual quaternions of
+// its joints scaled by its weights, normalizes the sum and applies it as a rigid transform. A
+// joint is 8 floats instead of the 12 of an affine matrix, a blend is 8 multiply-adds per
+// influence instead of 12, and blended rotations keep the volume that matrix blending loses
+// around twisting joints. Joints cannot scale, skin_palette drops the scale of the matrices.
+//
+// Vertices have `influences` joints each, stored one vertex after the other in `joints` and
+// `weights`. The weights of a vertex should add up to 1 and must not all be 0. Every joint is
+// sign aligned with the first one of the vertex, so the blend takes the short way around.
+//
+// Vertex data is structure of arrays, the normals are optional and `out` can be `in`. The
+// kernels do 4, 8 or 16 vertices at a time (SSE2, AVX2 with FMA, AVX-512), picked from the
+// CpuIsa, and can differ in the last bit between tiers because of the FMA.
+//
+
+struct SkinVertices
+{
+    f32 *x, *y, *z;
+    f32 *nx, *ny, *nz;   // Null without normals.
+};
+
+namespace lt
+{
+
+// Rigid part of every joint matrix (usually world * inverse bind), see lt::decompose.
+void skin_palette(const Mat4f *joint_matrices, DualQuatf *palette, usize count);
+
+// Blended and normalized transform of every vertex.
+void skin_blend(const DualQuatf *palette, const u16 *joints, const f32 *weights, u32 influences,
+                DualQuatf *out, usize count);
+// Transforms vertex i by transforms[i].
+void skin_apply(const DualQuatf *transforms, const SkinVertices &in, const SkinVertices &out, usize count);
+// skin_blend and skin_apply in one pass, without storing the blended transforms.
+void skin_vertices(const DualQuatf *palette, const u16 *joints, const f32 *weights, u32 influences,
+                   const SkinVertices &in, const SkinVertices &out, usize count);
+
+const char *skin_kernel_name();
+
+}
+
+#endif // LT_SKINNING_HPP
@@ -0,0 +1,338 @@
+#include "lt_snapshot.hpp"
+#include "lt_hash.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+#if LT_PLATFORM_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define LT_SNAPSHOT_MAGIC        0x50534E53u   // "SNSP" in a little endian file.
+#define LT_SNAPSHOT_FOOTER_MAGIC 0x444E4553u   // "SEND"
+
+struct SnapshotHeader
+{
+    u32 magic;
+    u16 version;
+    u8  little_endian;
+    u8  reserved0;
+    u32 alignment;
+    u32 reserved[13];
+};
+
+struct SnapshotFooter
+{
+    u64 table_offset;
+    u64 file_size;
+    u32 num_sections;
+    u32 table_crc;
+    u32 magic;
+    u32 footer_crc;   // Of the bytes before it.
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header layout");
+static_assert(sizeof(SnapshotFooter) == 32, "snapshot footer layout");
+static_assert(sizeof(SnapshotSection) == 72, "snapshot section layout");
+
+lt_global_variable const u32 g_type_sizes[SnapshotType_Count] = {
+    1,
+    sizeof(u32),
+    sizeof(i32),
+    sizeof(u64),
+    sizeof(i64),
+    sizeof(f32),
+    sizeof(f64),
+    sizeof(Vec2f),
+    sizeof(Vec3f),
+    sizeof(Vec4f),
+    sizeof(Quatf),
+    sizeof(Mat3f),
+    sizeof(Mat4f),
+};
+
+lt_global_variable const u8 g_zeros[LT_SNAPSHOT_ALIGNMENT] = {};
+
+u32
+lt::snapshot_type_size(SnapshotType type)
+{
+    return (type >= 0 && type < SnapshotType_Count) ? g_type_sizes[type] : 0;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Writer
+//
+
+lt_internal bool
+writer_fail(SnapshotWriter *writer, SnapshotError error)
+{
+    if (writer->error == SnapshotError_None) writer->error = error;
+    return false;
+}
+
+// Writes the padding up to `alignment` and the data in one call.
+lt_internal bool
+put(SnapshotWriter *writer, u64 alignment, const void *data, usize size)
+{
+    const usize pad = (usize)((alignment - writer->offset % alignment) % alignment);
+    const WriteBlock blocks[2] = {{g_zeros, pad}, {data, size}};
+    if (!ltfs::writer_write_blocks(&writer->file, blocks, 2)) return writer_fail(writer, SnapshotError_Write);
+    writer->offset += pad + size;
+    return true;
+}
+
+bool
+lt::snapshot_begin(SnapshotWriter *writer, const std::string &path)
+{
+    writer->sections.clear();
+    writer->offset = 0;
+    writer->in_section = false;
+    writer->error = SnapshotError_None;
+
+    FileWriteOptions options;
+    options.atomic = true;
+    options.background_flush = true;
+    if (!ltfs::writer_open(&writer->file, path, options))
+    {
+        ltfs::writer_destroy(&writer->file);
+        return writer_fail(writer, SnapshotError_Open);
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LT_SNAPSHOT_MAGIC;
+    header.version = LT_SNAPSHOT_VERSION;
+    header.little_endian = is_little_endian();
+    header.alignment = LT_SNAPSHOT_ALIGNMENT;
+    return put(writer, 1, &header, sizeof(header));
+}
+
+bool
+lt::snapshot_section_begin(SnapshotWriter *writer, const char *name, SnapshotType type)
+{
+    if (writer->error != SnapshotError_None) return false;
+    LT_Assert(!writer->in_section);
+    LT_Assert(type >= 0 && type < SnapshotType_Count);
+
+    const usize len = strlen(name);
+    if (len >= LT_SNAPSHOT_NAME_SIZE) return writer_fail(writer, SnapshotError_Name);
+
+    // Padding now, so an empty section still starts aligned.
+    if (!put(writer, LT_SNAPSHOT_ALIGNMENT, nullptr, 0)) return false;
+
+    SnapshotSection section;
+    memset(&section, 0, sizeof(section));
+    memcpy(section.name, name, len);
+    section.type = type;
+    section.element_size = g_type_sizes[type];
+    section.offset = writer->offset;
+    writer->sections.push_back(section);
+    writer->in_section = true;
+    return true;
+}
+
+bool
+lt::snapshot_section_append(SnapshotWriter *writer, const void *data, u64 count)
+{
+    if (writer->error != SnapshotError_None) return false;
+    LT_Assert(writer->in_section);
+
+    SnapshotSection *section = &writer->sections.back();
+    const usize size = (usize)(count * section->element_size);
+    section->crc = crc32c(data, size, section->crc);
+    section->count += count;
+    section->size += size;
+    return put(writer, 1, data, size);
+}
+
+bool
+lt::snapshot_section_end(SnapshotWriter *writer)
+{
+    if (writer->error != SnapshotError_None) return false;
+    LT_Assert(writer->in_section);
+    writer->in_section = false;
+    return true;
+}
+
+bool
+lt::snapshot_write(SnapshotWriter *writer, const char *name, SnapshotType type, const void *data, u64 count)
+{
+    return snapshot_section_begin(writer, name, type) &&
+           snapshot_section_append(writer, data, count) &&
+           snapshot_section_end(writer);
+}
+
+// Section table and footer, after the last section.
+lt_internal bool
+write_table(SnapshotWriter *writer)
+{
+    const usize table_size = writer->sections.size() * sizeof(SnapshotSection);
+    if (!put(writer, alignof(SnapshotSection), writer->sections.data(), table_size)) return false;
+
+    SnapshotFooter footer;
+    memset(&footer, 0, sizeof(footer));
+    footer.table_offset = writer->offset - table_size;
+    footer.file_size = writer->offset + sizeof(footer);
+    footer.num_sections = (u32)writer->sections.size();
+    footer.table_crc = lt::crc32c(writer->sections.data(), table_size);
+    footer.magic = LT_SNAPSHOT_FOOTER_MAGIC;
+    footer.footer_crc = lt::crc32c(&footer, offsetof(SnapshotFooter, footer_crc));
+    return put(writer, 1, &footer, sizeof(footer));
+}
+
+bool
+lt::snapshot_end(SnapshotWriter *writer)
+{
+    if (writer->in_section) snapshot_section_end(writer);
+    if (writer->error != SnapshotError_None || !write_table(writer))
+    {
+        snapshot_abort(writer);
+        return false;
+    }
+
+    const bool closed = ltfs::writer_close(&writer->file);
+    ltfs::writer_destroy(&writer->file);
+    return closed || writer_fail(writer, SnapshotError_Write);
+}
+
+void
+lt::snapshot_abort(SnapshotWriter *writer)
+{
+    ltfs::writer_destroy(&writer->file);
+    writer->in_section = false;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Reader
+//
+
+lt_internal bool
+reader_fail(SnapshotReader *reader, SnapshotError error)
+{
+    lt::snapshot_close(reader);
+    reader->error = error;
+    return false;
+}
+
+// Header, footer and table, without reading the sections.
+lt_internal bool
+validate(SnapshotReader *reader)
+{
+    if (reader->size < sizeof(SnapshotHeader) + sizeof(SnapshotFooter)) return reader_fail(reader, SnapshotError_Format);
+
+    SnapshotHeader header;
+    memcpy(&header, reader->data, sizeof(header));
+    if (header.magic == __builtin_bswap32(LT_SNAPSHOT_MAGIC)) return reader_fail(reader, SnapshotError_Endianness);
+    if (header.magic != LT_SNAPSHOT_MAGIC) return reader_fail(reader, SnapshotError_Format);
+    if (header.little_endian != (u8)lt::is_little_endian()) return reader_fail(reader, SnapshotError_Endianness);
+    if (header.version != LT_SNAPSHOT_VERSION) return reader_fail(reader, SnapshotError_Version);
+
+    SnapshotFooter footer;
+    memcpy(&footer, reader->data + reader->size - sizeof(footer), sizeof(footer));
+    if (footer.magic != LT_SNAPSHOT_FOOTER_MAGIC || footer.file_size != reader->size)
+        return reader_fail(reader, SnapshotError_Format);
+    if (footer.footer_crc != lt::crc32c(&footer, offsetof(SnapshotFooter, footer_crc)))
+        return reader_fail(reader, SnapshotError_Checksum);
+
+    const u64 table_size = (u64)footer.num_sections * sizeof(SnapshotSection);
+    const u64 table_end = reader->size - sizeof(footer);
+    if (footer.table_offset % alignof(SnapshotSection) != 0 || footer.table_offset > table_end ||
+        table_end - footer.table_offset != table_size)
+        return reader_fail(reader, SnapshotError_Format);
+
+    const SnapshotSection *sections = (const SnapshotSection*)(reader->data + footer.table_offset);
+    if (footer.table_crc != lt::crc32c(sections, (usize)table_size)) return reader_fail(reader, SnapshotError_Checksum);
+
+    for (u32 i = 0; i < footer.num_sections; i++)
+    {
+        const SnapshotSection *s = &sections[i];
+        const bool valid = s->type < SnapshotType_Count &&
+                           s->element_size > 0 &&
+                           s->name[LT_SNAPSHOT_NAME_SIZE - 1] == 0 &&
+                           s->offset % LT_SNAPSHOT_ALIGNMENT == 0 &&
+                           s->offset <= footer.table_offset &&
+                           s->size <= footer.table_offset - s->offset &&
+                           s->count == s->size / s->element_size &&
+                           s->size % s->element_size == 0;
+        if (!valid) return reader_fail(reader, SnapshotError_Format);
+    }
+
+    reader->sections = sections;
+    reader->num_sections = footer.num_sections;
+    return true;
+}
+
+bool
+lt::snapshot_open(SnapshotReader *reader, const char *path, bool verify)
+{
+    *reader = SnapshotReader();
+
+#if LT_PLATFORM_UNIX
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return reader_fail(reader, SnapshotError_Open);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return reader_fail(reader, SnapshotError_Open);
+    }
+    if (st.st_size <= 0)
+    {
+        close(fd);
+        return reader_fail(reader, (st.st_size == 0) ? SnapshotError_Format : SnapshotError_Open);
+    }
+
+    // Everything is read when verifying, so the mapping is populated up front with large reads
+    // instead of one page fault at a time.
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (verify) flags |= MAP_POPULATE;
+#endif
+    void *data = mmap(NULL, (usize)st.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return reader_fail(reader, SnapshotError_Open);
+    if (!verify) madvise(data, (usize)st.st_size, MADV_WILLNEED);
+
+    reader->data = (const u8*)data;
+    reader->size = (u64)st.st_size;
+#else
+#error "Currently only implemented on UNIX systems."
+#endif
+
+    if (!validate(reader)) return false;
+    return !verify || snapshot_verify(reader);
+}
+
+void
+lt::snapshot_close(SnapshotReader *reader)
+{
+#if LT_PLATFORM_UNIX
+    if (reader->data) munmap((void*)reader->data, (usize)reader->size);
+#endif
+    *reader = SnapshotReader();
+}
+
+bool
+lt::snapshot_verify(SnapshotReader *reader)
+{
+    for (u32 i = 0; i < reader->num_sections; i++)
+    {
+        const SnapshotSection *s = &reader->sections[i];
+        if (crc32c(reader->data + s->offset, (usize)s->size) != s->crc) return reader_fail(reader, SnapshotError_Checksum);
+    }
+    return true;
+}
+
+const SnapshotSection *
+lt::snapshot_find(const SnapshotReader *reader, const char *name)
+{
+    for (u32 i = 0; i < reader->num_sections; i++)
+        if (strncmp(reader->sections[i].name, name, LT_SNAPSHOT_NAME_SIZE) == 0) return &reader->sections[i];
+    return nullptr;
+}
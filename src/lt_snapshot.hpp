@@ -0,0 +1,157 @@
+#ifndef LT_SNAPSHOT_HPP
+#define LT_SNAPSHOT_HPP
+
+#include <string>
+#include <vector>
+
+#include "lt_core.hpp"
+#include "lt_fs.hpp"
+#include "lt_math.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Snapshots
+//
+// Binary checkpoint files made of named arrays (sections) that are loaded without parsing or
+// copying: the reader maps the file and hands out pointers into the mapping.
+//
+//   header     64 bytes: magic, version, byte order of the writer
+//   sections   raw arrays, each starting on a LT_SNAPSHOT_ALIGNMENT boundary
+//   table      one SnapshotSection per section
+//   footer     32 bytes: where the table is and its checksum
+//
+// Every section has a CRC32C of its bytes, computed while it is written, and the reader
+// checks them on open unless told not to. Data is stored in the byte order of the writer, a
+// file from a machine of the other order is refused rather than converted.
+//
+// The writer streams through FileWriter (atomic replace, background flush), a section can be
+// written in one call or appended to piece by piece.
+//
+
+#define LT_SNAPSHOT_VERSION   1
+#define LT_SNAPSHOT_ALIGNMENT 64
+#define LT_SNAPSHOT_NAME_SIZE 32   // Terminating zero included.
+
+enum SnapshotError
+{
+    SnapshotError_None,
+
+    SnapshotError_Open,
+    SnapshotError_Write,
+    SnapshotError_Format,      // Not a snapshot, truncated or inconsistent.
+    SnapshotError_Version,
+    SnapshotError_Endianness,
+    SnapshotError_Checksum,
+    SnapshotError_Name,        // Too long for LT_SNAPSHOT_NAME_SIZE.
+
+    SnapshotError_Count,
+};
+
+enum SnapshotType
+{
+    SnapshotType_Bytes,
+    SnapshotType_U32,
+    SnapshotType_I32,
+    SnapshotType_U64,
+    SnapshotType_I64,
+    SnapshotType_F32,
+    SnapshotType_F64,
+    SnapshotType_Vec2f,
+    SnapshotType_Vec3f,
+    SnapshotType_Vec4f,
+    SnapshotType_Quatf,
+    SnapshotType_Mat3f,
+    SnapshotType_Mat4f,
+
+    SnapshotType_Count,
+};
+
+template<typename T> struct SnapshotTypeOf;
+template<> struct SnapshotTypeOf<u8>    { static constexpr SnapshotType value = SnapshotType_Bytes; };
+template<> struct SnapshotTypeOf<u32>   { static constexpr SnapshotType value = SnapshotType_U32; };
+template<> struct SnapshotTypeOf<i32>   { static constexpr SnapshotType value = SnapshotType_I32; };
+template<> struct SnapshotTypeOf<u64>   { static constexpr SnapshotType value = SnapshotType_U64; };
+template<> struct SnapshotTypeOf<i64>   { static constexpr SnapshotType value = SnapshotType_I64; };
+template<> struct SnapshotTypeOf<f32>   { static constexpr SnapshotType value = SnapshotType_F32; };
+template<> struct SnapshotTypeOf<f64>   { static constexpr SnapshotType value = SnapshotType_F64; };
+template<> struct SnapshotTypeOf<Vec2f> { static constexpr SnapshotType value = SnapshotType_Vec2f; };
+template<> struct SnapshotTypeOf<Vec3f> { static constexpr SnapshotType value = SnapshotType_Vec3f; };
+template<> struct SnapshotTypeOf<Vec4f> { static constexpr SnapshotType value = SnapshotType_Vec4f; };
+template<> struct SnapshotTypeOf<Quatf> { static constexpr SnapshotType value = SnapshotType_Quatf; };
+template<> struct SnapshotTypeOf<Mat3f> { static constexpr SnapshotType value = SnapshotType_Mat3f; };
+template<> struct SnapshotTypeOf<Mat4f> { static constexpr SnapshotType value = SnapshotType_Mat4f; };
+
+// Entry of the section table, as stored in the file.
+struct SnapshotSection
+{
+    char name[LT_SNAPSHOT_NAME_SIZE];
+    u32  type;           // SnapshotType
+    u32  element_size;   // sizeof of the element type when written, checked on access.
+    u64  offset;         // From the start of the file.
+    u64  count;
+    u64  size;           // count * element_size
+    u32  crc;            // CRC32C of the section bytes.
+    u32  reserved;
+};
+
+struct SnapshotWriter
+{
+    FileWriter                   file;
+    std::vector<SnapshotSection> sections;
+    u64                          offset = 0;   // Bytes written so far.
+    bool                         in_section = false;
+    SnapshotError                error = SnapshotError_None;
+};
+
+struct SnapshotReader
+{
+    const u8              *data = nullptr;
+    u64                    size = 0;
+    const SnapshotSection *sections = nullptr;
+    u32                    num_sections = 0;
+    SnapshotError          error = SnapshotError_None;
+};
+
+namespace lt
+{
+
+// All the writer functions return false once an error happened, `writer->error` tells which.
+// The target is only replaced by a successful snapshot_end. Finish every snapshot_begin with
+// snapshot_end or snapshot_abort, also after errors: both free the write buffers.
+bool snapshot_begin(SnapshotWriter *writer, const std::string &path);
+bool snapshot_write(SnapshotWriter *writer, const char *name, SnapshotType type, const void *data, u64 count);
+bool snapshot_section_begin(SnapshotWriter *writer, const char *name, SnapshotType type);
+bool snapshot_section_append(SnapshotWriter *writer, const void *data, u64 count);
+bool snapshot_section_end(SnapshotWriter *writer);
+bool snapshot_end(SnapshotWriter *writer);
+void snapshot_abort(SnapshotWriter *writer);
+
+template<typename T> inline bool
+snapshot_write(SnapshotWriter *writer, const char *name, const T *data, u64 count)
+{
+    return snapshot_write(writer, name, SnapshotTypeOf<T>::value, data, count);
+}
+
+// Maps the file and validates its structure, and the section checksums with `verify`.
+bool snapshot_open(SnapshotReader *reader, const char *path, bool verify = true);
+void snapshot_close(SnapshotReader *reader);
+bool snapshot_verify(SnapshotReader *reader);
+
+const SnapshotSection *snapshot_find(const SnapshotReader *reader, const char *name);
+
+// Pointer into the mapping, valid until snapshot_close. Null when the section is missing or
+// was written with another type or element size.
+template<typename T> inline const T *
+snapshot_get(const SnapshotReader *reader, const char *name, u64 *count)
+{
+    const SnapshotSection *s = snapshot_find(reader, name);
+    if (!s || s->type != SnapshotTypeOf<T>::value || s->element_size != sizeof(T)) return nullptr;
+    *count = s->count;
+    return (const T*)(reader->data + s->offset);
+}
+
+u32 snapshot_type_size(SnapshotType type);
+
+}
+
+#endif // LT_SNAPSHOT_HPP
@@ -0,0 +1,416 @@
+#include "lt_sort.hpp"
+#include "lt_cpu.hpp"
+#include "lt_parallel.hpp"
+#include "lt_perf.hpp"
+
+#define SORT_BUCKETS          (1 << LT_SORT_RADIX_BITS)
+#define SORT_SMALL            64       // Insertion sort below this many keys.
+#define SORT_PARALLEL_MIN     65536    // Keys per thread.
+#define SORT_ALIGNMENT        64
+
+/////////////////////////////////////////////////////////
+//
+// Radix sort
+//
+
+lt_internal inline usize
+align_up(usize size)
+{
+    return (size + SORT_ALIGNMENT - 1) & ~(usize)(SORT_ALIGNMENT - 1);
+}
+
+usize
+lt::radix_sort_scratch_size(usize count, usize key_size, bool with_values)
+{
+    return align_up(count * key_size) + (with_values ? align_up(count * sizeof(u32)) : 0);
+}
+
+lt_internal inline usize
+sort_parts(usize count)
+{
+    usize parts = count / SORT_PARALLEL_MIN;
+    if (parts > lt::worker_count()) parts = lt::worker_count();
+    return (parts > 0) ? parts : 1;
+}
+
+// Runs fn(part) for every part, one per thread.
+template<typename F> lt_internal void
+for_each_part(usize num_parts, const F &fn)
+{
+    lt::parallel_for(num_parts, 1, [&](usize first, usize last) {
+        for (usize p = first; p < last; p++) fn(p);
+    });
+}
+
+template<typename K> lt_internal void
+insertion_sort(K *keys, u32 *values, usize count)
+{
+    for (usize i = 1; i < count; i++)
+    {
+        const K key = keys[i];
+        const u32 value = values ? values[i] : 0;
+        usize j = i;
+        for (; j > 0 && keys[j - 1] > key; j--)
+        {
+            keys[j] = keys[j - 1];
+            if (values) values[j] = values[j - 1];
+        }
+        keys[j] = key;
+        if (values) values[j] = value;
+    }
+}
+
+template<typename K> lt_internal inline u32
+digit(K key, u32 d)
+{
+    return (u32)(key >> (d * LT_SORT_RADIX_BITS)) & (SORT_BUCKETS - 1);
+}
+
+// Counts of every digit of keys [begin, end), histogram[d][bucket].
+template<typename K> lt_internal void
+count_digits(const K *keys, usize begin, usize end, u32 (*histogram)[SORT_BUCKETS])
+{
+    memset(histogram, 0, sizeof(u32) * SORT_BUCKETS * sizeof(K));
+    for (usize i = begin; i < end; i++)
+    {
+        const K key = keys[i];
+        for (u32 d = 0; d < sizeof(K); d++) histogram[d][digit(key, d)]++;
+    }
+}
+
+template<typename K> lt_internal void
+count_digit(const K *keys, usize begin, usize end, u32 d, u32 *histogram)
+{
+    memset(histogram, 0, sizeof(u32) * SORT_BUCKETS);
+    for (usize i = begin; i < end; i++) histogram[digit(keys[i], d)]++;
+}
+
+// Moves keys [begin, end) of `src` to their bucket, `offsets` holds the next position of
+// every bucket in `dst` for this part.
+template<typename K> lt_internal void
+scatter(const K *src, const u32 *src_values, K *dst, u32 *dst_values, usize begin, usize end, u32 d,
+        u32 *offsets)
+{
+    if (src_values)
+    {
+        for (usize i = begin; i < end; i++)
+        {
+            const K key = src[i];
+            const u32 slot = offsets[digit(key, d)]++;
+            dst[slot] = key;
+            dst_values[slot] = src_values[i];
+        }
+    }
+    else
+    {
+        for (usize i = begin; i < end; i++)
+        {
+            const K key = src[i];
+            dst[offsets[digit(key, d)]++] = key;
+        }
+    }
+}
+
+template<typename K> lt_internal bool
+radix_sort_keys(K *keys, u32 *values, usize count, void *scratch)
+{
+    LT_Assert(count <= 0xffffffffull);
+    if (count < SORT_SMALL)
+    {
+        insertion_sort(keys, values, count);
+        return true;
+    }
+
+    constexpr u32 num_digits = sizeof(K);
+    typedef u32 Histogram[num_digits][SORT_BUCKETS];
+
+    const usize num_parts = sort_parts(count);
+    auto part_begin = [&](usize p) { return count * p / num_parts; };
+
+    void *owned_scratch = nullptr;
+    if (!scratch)
+    {
+        owned_scratch = LT_AlignedAlloc(SORT_ALIGNMENT, lt::radix_sort_scratch_size(count, sizeof(K), values != nullptr),
+                                        MemoryTag_General);
+        if (!owned_scratch) return false;
+        scratch = owned_scratch;
+    }
+
+    // A single part keeps its counts on the stack.
+    Histogram local_histogram;
+    Histogram *histograms = &local_histogram;
+    u32 (*offsets)[SORT_BUCKETS] = nullptr;
+    u32 local_offsets[SORT_BUCKETS];
+    if (num_parts > 1)
+    {
+        histograms = (Histogram*)LT_Malloc(sizeof(Histogram) * num_parts, MemoryTag_General);
+        offsets = (u32(*)[SORT_BUCKETS])LT_Malloc(sizeof(u32) * SORT_BUCKETS * num_parts, MemoryTag_General);
+        if (!histograms || !offsets)
+        {
+            if (histograms) LT_Free(histograms);
+            if (offsets) LT_Free(offsets);
+            if (owned_scratch) LT_Free(owned_scratch);
+            return false;
+        }
+    }
+    else
+    {
+        offsets = &local_offsets;
+    }
+
+    for_each_part(num_parts, [&](usize p) {
+        count_digits(keys, part_begin(p), part_begin(p + 1), histograms[p]);
+    });
+
+    K *src = keys, *dst = (K*)scratch;
+    u32 *src_values = values;
+    u32 *dst_values = values ? (u32*)((u8*)scratch + align_up(count * sizeof(K))) : nullptr;
+    u32 passes = 0;
+
+    for (u32 d = 0; d < num_digits; d++)
+    {
+        // Every key has the same digit: the pass would not move anything.
+        bool trivial = false;
+        for (u32 b = 0; b < SORT_BUCKETS && !trivial; b++)
+        {
+            usize total = 0;
+            for (usize p = 0; p < num_parts; p++) total += histograms[p][d][b];
+            trivial = (total == count);
+        }
+        if (trivial) continue;
+
+        // The first counts are of the input order, later passes count their parts again.
+        if (passes > 0 && num_parts > 1)
+        {
+            for_each_part(num_parts, [&](usize p) {
+                count_digit(src, part_begin(p), part_begin(p + 1), d, histograms[p][d]);
+            });
+        }
+
+        u32 offset = 0;
+        for (u32 b = 0; b < SORT_BUCKETS; b++)
+        {
+            for (usize p = 0; p < num_parts; p++)
+            {
+                offsets[p][b] = offset;
+                offset += histograms[p][d][b];
+            }
+        }
+
+        for_each_part(num_parts, [&](usize p) {
+            scatter(src, src_values, dst, dst_values, part_begin(p), part_begin(p + 1), d, offsets[p]);
+        });
+
+        K *t = src; src = dst; dst = t;
+        u32 *tv = src_values; src_values = dst_values; dst_values = tv;
+        passes++;
+    }
+
+    if (src != keys)
+    {
+        for_each_part(num_parts, [&](usize p) {
+            const usize begin = part_begin(p), n = part_begin(p + 1) - begin;
+            memcpy(keys + begin, src + begin, n * sizeof(K));
+            if (values) memcpy(values + begin, src_values + begin, n * sizeof(u32));
+        });
+    }
+
+    if (num_parts > 1)
+    {
+        LT_Free(histograms);
+        LT_Free(offsets);
+    }
+    if (owned_scratch) LT_Free(owned_scratch);
+    return true;
+}
+
+bool
+lt::radix_sort(u32 *keys, u32 *values, usize count, void *scratch)
+{
+    LT_PERF_SCOPE("radix_sort_u32", count);
+    return radix_sort_keys(keys, values, count, scratch);
+}
+
+bool
+lt::radix_sort(u64 *keys, u32 *values, usize count, void *scratch)
+{
+    LT_PERF_SCOPE("radix_sort_u64", count);
+    return radix_sort_keys(keys, values, count, scratch);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Keys
+//
+
+void
+lt::depth_keys(const Vec3f *positions, usize count, Vec3f forward, bool back_to_front, u32 *keys)
+{
+    const u32 flip = back_to_front ? 0xffffffffu : 0;
+    parallel_for(count, SORT_PARALLEL_MIN, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) keys[i] = f32_sort_key(lt::dot(positions[i], forward)) ^ flip;
+    });
+}
+
+// Position relative to the box, scaled to [0, max_coord] per axis. NaN goes to 0.
+struct MortonQuantizer
+{
+    Vec3f origin;
+    Vec3f scale;
+    f32   max_coord;
+};
+
+lt_internal MortonQuantizer
+morton_quantizer(const AABB &bounds, u32 bits)
+{
+    MortonQuantizer q;
+    q.origin = bounds.min;
+    q.max_coord = (f32)((1u << bits) - 1);
+    const Vec3f extent = bounds.max - bounds.min;
+    q.scale.x = (extent.x > 0) ? q.max_coord / extent.x : 0;
+    q.scale.y = (extent.y > 0) ? q.max_coord / extent.y : 0;
+    q.scale.z = (extent.z > 0) ? q.max_coord / extent.z : 0;
+    return q;
+}
+
+lt_internal inline u32
+quantize(f32 x, f32 origin, f32 scale, f32 max_coord)
+{
+    f32 t = (x - origin) * scale;
+    t = (t > 0) ? t : 0;
+    t = (t < max_coord) ? t : max_coord;
+    return (u32)t;
+}
+
+lt_internal void
+morton32_scalar(const Vec3f *positions, usize begin, usize end, const MortonQuantizer &q, u32 *keys)
+{
+    for (usize i = begin; i < end; i++)
+    {
+        const Vec3f p = positions[i];
+        keys[i] = lt::morton_spread3_32(quantize(p.x, q.origin.x, q.scale.x, q.max_coord)) |
+            (lt::morton_spread3_32(quantize(p.y, q.origin.y, q.scale.y, q.max_coord)) << 1) |
+            (lt::morton_spread3_32(quantize(p.z, q.origin.z, q.scale.z, q.max_coord)) << 2);
+    }
+}
+
+lt_internal void
+morton64_scalar(const Vec3f *positions, usize begin, usize end, const MortonQuantizer &q, u64 *keys)
+{
+    for (usize i = begin; i < end; i++)
+    {
+        const Vec3f p = positions[i];
+        keys[i] = lt::morton_spread3_64(quantize(p.x, q.origin.x, q.scale.x, q.max_coord)) |
+            (lt::morton_spread3_64(quantize(p.y, q.origin.y, q.scale.y, q.max_coord)) << 1) |
+            (lt::morton_spread3_64(quantize(p.z, q.origin.z, q.scale.z, q.max_coord)) << 2);
+    }
+}
+
+// BMI2 comes with the AVX2 tier. pdep is one instruction on Intel since Haswell and on AMD
+// since Zen 3 (microcoded and slower than the magic numbers on Zen 1 and 2).
+#if LT_CPU_HAS_AVX2
+LT_TARGET_AVX2 lt_internal void
+morton32_bmi2(const Vec3f *positions, usize begin, usize end, const MortonQuantizer &q, u32 *keys)
+{
+    for (usize i = begin; i < end; i++)
+    {
+        const Vec3f p = positions[i];
+        keys[i] = _pdep_u32(quantize(p.x, q.origin.x, q.scale.x, q.max_coord), 0x09249249u) |
+            _pdep_u32(quantize(p.y, q.origin.y, q.scale.y, q.max_coord), 0x12492492u) |
+            _pdep_u32(quantize(p.z, q.origin.z, q.scale.z, q.max_coord), 0x24924924u);
+    }
+}
+
+LT_TARGET_AVX2 lt_internal void
+morton64_bmi2(const Vec3f *positions, usize begin, usize end, const MortonQuantizer &q, u64 *keys)
+{
+    for (usize i = begin; i < end; i++)
+    {
+        const Vec3f p = positions[i];
+        keys[i] = _pdep_u64(quantize(p.x, q.origin.x, q.scale.x, q.max_coord), 0x1249249249249249ull) |
+            _pdep_u64(quantize(p.y, q.origin.y, q.scale.y, q.max_coord), 0x2492492492492492ull) |
+            _pdep_u64(quantize(p.z, q.origin.z, q.scale.z, q.max_coord), 0x4924924924924924ull);
+    }
+}
+#endif
+
+struct MortonKernel
+{
+    CpuIsa isa;
+    void (*keys32)(const Vec3f *positions, usize begin, usize end, const MortonQuantizer &q, u32 *keys);
+    void (*keys64)(const Vec3f *positions, usize begin, usize end, const MortonQuantizer &q, u64 *keys);
+};
+
+lt_global_variable const MortonKernel g_morton_kernels[] = {
+    {CpuIsa_Scalar, morton32_scalar, morton64_scalar},
+#if LT_CPU_HAS_AVX2
+    {CpuIsa_AVX2,   morton32_bmi2,   morton64_bmi2},
+#endif
+};
+lt_global_variable CpuDispatchCache g_morton_dispatch;
+
+const char *
+lt::morton_kernel_name()
+{
+    return cpu_isa_name(cpu_select(g_morton_kernels, &g_morton_dispatch)->isa);
+}
+
+void
+lt::morton_keys(const Vec3f *positions, usize count, const AABB &bounds, u32 *keys)
+{
+    const MortonKernel *kernel = cpu_select(g_morton_kernels, &g_morton_dispatch);
+    const MortonQuantizer q = morton_quantizer(bounds, 10);
+    parallel_for(count, SORT_PARALLEL_MIN, [&](usize begin, usize end) {
+        kernel->keys32(positions, begin, end, q, keys);
+    });
+}
+
+void
+lt::morton_keys(const Vec3f *positions, usize count, const AABB &bounds, u64 *keys)
+{
+    const MortonKernel *kernel = cpu_select(g_morton_kernels, &g_morton_dispatch);
+    const MortonQuantizer q = morton_quantizer(bounds, 21);
+    parallel_for(count, SORT_PARALLEL_MIN, [&](usize begin, usize end) {
+        kernel->keys64(positions, begin, end, q, keys);
+    });
+}
+
+/////////////////////////////////////////////////////////
+//
+// Sorting items
+//
+
+// Keys, then the radix sort scratch, in one allocation. make_keys(keys) writes the keys.
+template<typename F> lt_internal bool
+sort_indices(usize count, u32 *indices, const F &make_keys)
+{
+    const usize keys_size = align_up(count * sizeof(u32));
+    u8 *memory = (u8*)LT_AlignedAlloc(SORT_ALIGNMENT, keys_size + lt::radix_sort_scratch_size(count, sizeof(u32), true),
+                                      MemoryTag_General);
+    if (!memory) return false;
+
+    u32 *keys = (u32*)memory;
+    make_keys(keys);
+    lt::parallel_for(count, SORT_PARALLEL_MIN, [&](usize begin, usize end) {
+        for (usize i = begin; i < end; i++) indices[i] = (u32)i;
+    });
+    const bool sorted = lt::radix_sort(keys, indices, count, memory + keys_size);
+    LT_Free(memory);
+    return sorted;
+}
+
+bool
+lt::sort_by_depth(const Vec3f *positions, usize count, Vec3f forward, bool back_to_front, u32 *indices)
+{
+    return sort_indices(count, indices, [&](u32 *keys) {
+        depth_keys(positions, count, forward, back_to_front, keys);
+    });
+}
+
+bool
+lt::sort_by_morton(const Vec3f *positions, usize count, const AABB &bounds, u32 *indices)
+{
+    return sort_indices(count, indices, [&](u32 *keys) {
+        morton_keys(positions, count, bounds, keys);
+    });
+}
@@ -0,0 +1,134 @@
+#ifndef LT_SORT_HPP
+#define LT_SORT_HPP
+
+#include <cstring>
+#include "lt_core.hpp"
+#include "lt_math.hpp"
+#include "lt_geometry.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Radix sort
+//
+// Least significant digit radix sort of u32 and u64 keys, optionally carrying a u32 value
+// (usually the index of the item) along with every key. 8 bits per pass. The sort is
+// ascending and stable.
+//
+// One read of the keys builds the histograms of every digit. A digit that has the same value
+// in all keys is then skipped without touching the data, so 30-bit Morton codes take 4 passes
+// and not 8. Large inputs are cut into one part per thread. Every part counts its digits, a
+// prefix sum over (bucket, part) gives each part its own output positions, and the parts
+// scatter in parallel. The result does not depend on the number of threads.
+//
+// Keys come from the helpers below:
+//
+//   - f32_sort_key maps floats to u32 keys with the same order (negative values first,
+//     -0 before +0). depth_keys uses it on lt::dot(position, forward), which has the order of
+//     the view depth (the dot with the eye position is the same for every item).
+//   - morton3_32 and morton3_64 interleave 10 and 21 bits of three coordinates. They use BMI2
+//     pdep when the compiler targets it. morton_keys quantizes positions inside a box, and
+//     picks its pdep kernel at run time from the CpuIsa.
+//
+
+#define LT_SORT_RADIX_BITS 8
+
+namespace lt
+{
+
+// Size in bytes of the `scratch` buffer that the radix sorts need for `count` keys.
+usize radix_sort_scratch_size(usize count, usize key_size, bool with_values);
+
+// `values` can be null. `scratch` can be null, the sort then allocates it (and returns false
+// if that fails). Otherwise it must hold radix_sort_scratch_size bytes, aligned to 64 bytes.
+// Counts must fit in a u32.
+bool radix_sort(u32 *keys, u32 *values, usize count, void *scratch = nullptr);
+bool radix_sort(u64 *keys, u32 *values, usize count, void *scratch = nullptr);
+
+inline u32
+f32_sort_key(f32 x)
+{
+    u32 bits;
+    memcpy(&bits, &x, sizeof(bits));
+    // Negative values have every bit flipped (so larger magnitudes come first), positive
+    // values only the sign bit.
+    const u32 mask = (u32)((i32)bits >> 31) | 0x80000000u;
+    return bits ^ mask;
+}
+
+inline f32
+f32_from_sort_key(u32 key)
+{
+    const u32 mask = (key & 0x80000000u) ? 0x80000000u : 0xffffffffu;
+    const u32 bits = key ^ mask;
+    f32 x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+// Spaces the low 10 (21) bits of v two zeros apart, bit i goes to bit 3i.
+inline u32
+morton_spread3_32(u32 v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ffu;
+    v = (v | (v << 8))  & 0x0300f00fu;
+    v = (v | (v << 4))  & 0x030c30c3u;
+    v = (v | (v << 2))  & 0x09249249u;
+    return v;
+}
+
+inline u64
+morton_spread3_64(u64 v)
+{
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x001f00000000ffffull;
+    v = (v | (v << 16)) & 0x001f0000ff0000ffull;
+    v = (v | (v << 8))  & 0x100f00f00f00f00full;
+    v = (v | (v << 4))  & 0x10c30c30c30c30c3ull;
+    v = (v | (v << 2))  & 0x1249249249249249ull;
+    return v;
+}
+
+// Interleaves the low 10 bits of x, y and z: bit i of x goes to bit 3i, of y to 3i + 1, of z
+// to 3i + 2.
+inline u32
+morton3_32(u32 x, u32 y, u32 z)
+{
+#if defined(__BMI2__)
+    return _pdep_u32(x, 0x09249249u) | _pdep_u32(y, 0x12492492u) | _pdep_u32(z, 0x24924924u);
+#else
+    return morton_spread3_32(x) | (morton_spread3_32(y) << 1) | (morton_spread3_32(z) << 2);
+#endif
+}
+
+// Same with the low 21 bits.
+inline u64
+morton3_64(u32 x, u32 y, u32 z)
+{
+#if defined(__BMI2__)
+    return _pdep_u64(x, 0x1249249249249249ull) | _pdep_u64(y, 0x2492492492492492ull) |
+        _pdep_u64(z, 0x4924924924924924ull);
+#else
+    return morton_spread3_64(x) | (morton_spread3_64(y) << 1) | (morton_spread3_64(z) << 2);
+#endif
+}
+
+// Nearest first, or farthest first with `back_to_front` (transparent surfaces). `forward` does
+// not need to be normalized.
+void depth_keys(const Vec3f *positions, usize count, Vec3f forward, bool back_to_front, u32 *keys);
+
+// Positions are quantized to 10 or 21 bits per axis inside `bounds`. Positions outside are
+// clamped to it.
+void morton_keys(const Vec3f *positions, usize count, const AABB &bounds, u32 *keys);
+void morton_keys(const Vec3f *positions, usize count, const AABB &bounds, u64 *keys);
+
+// Write the order of the items to `indices`: indices[0] is the first item. Return false on
+// allocation failure. sort_by_morton sorts 30-bit codes (1024 cells per axis).
+bool sort_by_depth(const Vec3f *positions, usize count, Vec3f forward, bool back_to_front, u32 *indices);
+bool sort_by_morton(const Vec3f *positions, usize count, const AABB &bounds, u32 *indices);
+
+const char *morton_kernel_name();
+
+}
+
+#endif // LT_SORT_HPP
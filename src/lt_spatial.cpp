@@ -0,0 +1,314 @@
+#include "lt_spatial.hpp"
+#include "lt_parallel.hpp"
+#include <vector>
+
+#define SPATIAL_PARALLEL_MIN_POINTS 65536
+#define SPATIAL_STACK_BUCKETS       256
+
+lt_internal inline u32
+point_bucket(const SpatialHash &grid, Vec3f p)
+{
+    return lt::spatial_hash_bucket(grid, lt::spatial_hash_cell_coord(grid, p.x),
+                                   lt::spatial_hash_cell_coord(grid, p.y),
+                                   lt::spatial_hash_cell_coord(grid, p.z));
+}
+
+template<typename T> lt_internal bool
+grow_array(T **array, usize count)
+{
+    T *p = (T*)LT_Realloc(*array, sizeof(T) * (count > 0 ? count : 1), MemoryTag_Spatial);
+    if (!p) return false;
+    *array = p;
+    return true;
+}
+
+void
+lt::spatial_hash_init(SpatialHash *grid, f32 cell_size, u32 num_buckets)
+{
+    LT_Assert(cell_size > 0);
+    *grid = SpatialHash{};
+    grid->cell_size = cell_size;
+    grid->inv_cell_size = 1.0f / cell_size;
+    grid->requested_buckets = (num_buckets > 0) ? (u32)lt::next_power_of_two(num_buckets) : 0;
+}
+
+void
+lt::spatial_hash_destroy(SpatialHash *grid)
+{
+    LT_Free(grid->bucket_start);
+    LT_Free(grid->indices);
+    LT_Free(grid->positions);
+    LT_Free(grid->point_bucket);
+    LT_Free(grid->point_slot);
+    LT_Free(grid->overflow_bucket);
+    LT_Free(grid->overflow_index);
+    LT_Free(grid->overflow_position);
+    *grid = SpatialHash{};
+}
+
+bool
+lt::spatial_hash_build(SpatialHash *grid, const Vec3f *positions, u32 count)
+{
+    u32 num_buckets = grid->requested_buckets;
+    if (num_buckets == 0)
+        num_buckets = (u32)lt::next_power_of_two((count > 8) ? (usize)count * 2 : 16);
+
+    if (num_buckets != grid->num_buckets || grid->bucket_start == NULL)
+    {
+        if (!grow_array(&grid->bucket_start, (usize)num_buckets + 1)) return false;
+        grid->num_buckets = num_buckets;
+    }
+    if (count > grid->capacity)
+    {
+        if (!grow_array(&grid->indices, count) || !grow_array(&grid->positions, count) ||
+            !grow_array(&grid->point_bucket, count) || !grow_array(&grid->point_slot, count))
+            return false;
+        grid->capacity = count;
+    }
+
+    grid->num_points = count;
+    grid->num_overflow = 0;
+
+    u32 *start = grid->bucket_start;
+    memset(start, 0, sizeof(u32) * ((usize)num_buckets + 1));
+
+    const bool parallel = count >= SPATIAL_PARALLEL_MIN_POINTS && lt::worker_count() > 1;
+    if (!parallel)
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            const u32 b = point_bucket(*grid, positions[i]);
+            grid->point_bucket[i] = b;
+            start[b + 1]++;
+        }
+        for (u32 b = 0; b < num_buckets; b++) start[b + 1] += start[b];
+
+        u32 *cursor = (u32*)LT_Malloc(sizeof(u32) * num_buckets, MemoryTag_Spatial);
+        if (!cursor) return false;
+        memcpy(cursor, start, sizeof(u32) * num_buckets);
+        for (u32 i = 0; i < count; i++)
+        {
+            const u32 slot = cursor[grid->point_bucket[i]]++;
+            grid->indices[slot] = i;
+            grid->positions[slot] = positions[i];
+            grid->point_slot[i] = slot;
+        }
+        LT_Free(cursor);
+        return true;
+    }
+
+    // Counting sort with one histogram per part, like the radix sort: the offsets are laid out
+    // by (bucket, part), so every part scatters its points in index order into its own range
+    // of each bucket and the result is the same as the serial one.
+    usize num_parts = count / (SPATIAL_PARALLEL_MIN_POINTS / 4);
+    if (num_parts > lt::worker_count()) num_parts = lt::worker_count();
+    auto part_begin = [&](usize p) { return (usize)count * p / num_parts; };
+    auto for_each_part = [&](const auto &fn) {
+        lt::parallel_for(num_parts, 1, [&](usize first, usize last) {
+            for (usize p = first; p < last; p++) fn(p);
+        });
+    };
+
+    u32 *histograms = (u32*)LT_Malloc(sizeof(u32) * num_parts * num_buckets, MemoryTag_Spatial);
+    if (!histograms) return false;
+
+    for_each_part([&](usize p) {
+        u32 *histogram = histograms + p * num_buckets;
+        memset(histogram, 0, sizeof(u32) * num_buckets);
+        for (usize i = part_begin(p); i < part_begin(p + 1); i++)
+        {
+            const u32 b = point_bucket(*grid, positions[i]);
+            grid->point_bucket[i] = b;
+            histogram[b]++;
+        }
+    });
+
+    lt::parallel_for(num_buckets, SPATIAL_PARALLEL_MIN_POINTS, [&](usize begin, usize end) {
+        for (usize b = begin; b < end; b++)
+        {
+            u32 total = 0;
+            for (usize p = 0; p < num_parts; p++) total += histograms[p * num_buckets + b];
+            start[b + 1] = total;
+        }
+    });
+    for (u32 b = 0; b < num_buckets; b++) start[b + 1] += start[b];
+
+    lt::parallel_for(num_buckets, SPATIAL_PARALLEL_MIN_POINTS, [&](usize begin, usize end) {
+        for (usize b = begin; b < end; b++)
+        {
+            u32 offset = start[b];
+            for (usize p = 0; p < num_parts; p++)
+            {
+                const u32 n = histograms[p * num_buckets + b];
+                histograms[p * num_buckets + b] = offset;
+                offset += n;
+            }
+        }
+    });
+
+    for_each_part([&](usize p) {
+        u32 *cursor = histograms + p * num_buckets;
+        for (usize i = part_begin(p); i < part_begin(p + 1); i++)
+        {
+            const u32 slot = cursor[grid->point_bucket[i]]++;
+            grid->indices[slot] = (u32)i;
+            grid->positions[slot] = positions[i];
+            grid->point_slot[i] = slot;
+        }
+    });
+    LT_Free(histograms);
+    return true;
+}
+
+// Overflow entries are kept sorted by (bucket, index).
+lt_internal void
+sort_overflow(SpatialHash *grid)
+{
+    const u32 n = grid->num_overflow;
+    std::vector<u64> keys(n);
+    std::vector<Vec3f> pos(grid->overflow_position, grid->overflow_position + n);
+    for (u32 i = 0; i < n; i++) keys[i] = ((u64)grid->overflow_bucket[i] << 32) | i;
+    std::sort(keys.begin(), keys.end(), [&](u64 a, u64 b) {
+        const u32 ba = (u32)(a >> 32), bb = (u32)(b >> 32);
+        if (ba != bb) return ba < bb;
+        return grid->overflow_index[(u32)a] < grid->overflow_index[(u32)b];
+    });
+
+    std::vector<u32> index(grid->overflow_index, grid->overflow_index + n);
+    for (u32 i = 0; i < n; i++)
+    {
+        const u32 from = (u32)keys[i];
+        grid->overflow_bucket[i] = (u32)(keys[i] >> 32);
+        grid->overflow_index[i] = index[from];
+        grid->overflow_position[i] = pos[from];
+    }
+}
+
+bool
+lt::spatial_hash_update(SpatialHash *grid, const Vec3f *positions, const u32 *moved, u32 num_moved)
+{
+    const u32 overflow_limit = 1024 + grid->num_points / 32;
+
+    // Points already in the overflow are refreshed from `positions` as a whole, it is small.
+    for (u32 i = 0; i < grid->num_overflow; i++)
+    {
+        const u32 index = grid->overflow_index[i];
+        const u32 b = point_bucket(*grid, positions[index]);
+        grid->overflow_bucket[i] = b;
+        grid->overflow_position[i] = positions[index];
+        grid->point_bucket[index] = b;
+    }
+
+    for (u32 m = 0; m < num_moved; m++)
+    {
+        const u32 index = moved[m];
+        LT_Assert(index < grid->num_points);
+        const u32 slot = grid->point_slot[index];
+        if (slot == LT_SPATIAL_INVALID) continue;
+
+        const Vec3f p = positions[index];
+        const u32 b = point_bucket(*grid, p);
+        if (b == grid->point_bucket[index])
+        {
+            grid->positions[slot] = p;
+            continue;
+        }
+
+        if (grid->num_overflow >= overflow_limit)
+            return lt::spatial_hash_build(grid, positions, grid->num_points);
+
+        if (grid->num_overflow == grid->overflow_capacity)
+        {
+            const u32 cap = (grid->overflow_capacity > 0) ? grid->overflow_capacity * 2 : 64;
+            if (!grow_array(&grid->overflow_bucket, cap) || !grow_array(&grid->overflow_index, cap) ||
+                !grow_array(&grid->overflow_position, cap))
+                return false;
+            grid->overflow_capacity = cap;
+        }
+
+        grid->indices[slot] = LT_SPATIAL_INVALID;
+        grid->point_slot[index] = LT_SPATIAL_INVALID;
+        grid->point_bucket[index] = b;
+        grid->overflow_bucket[grid->num_overflow] = b;
+        grid->overflow_index[grid->num_overflow] = index;
+        grid->overflow_position[grid->num_overflow] = p;
+        grid->num_overflow++;
+    }
+
+    sort_overflow(grid);
+    return true;
+}
+
+u32
+lt::spatial_hash_query_aabb(const SpatialHash &grid, const AABB &box, SpatialSpan *spans, u32 max_spans)
+{
+    if (grid.num_points == 0) return 0;
+
+    const i32 x0 = spatial_hash_cell_coord(grid, box.min.x), x1 = spatial_hash_cell_coord(grid, box.max.x);
+    const i32 y0 = spatial_hash_cell_coord(grid, box.min.y), y1 = spatial_hash_cell_coord(grid, box.max.y);
+    const i32 z0 = spatial_hash_cell_coord(grid, box.min.z), z1 = spatial_hash_cell_coord(grid, box.max.z);
+    if (x1 < x0 || y1 < y0 || z1 < z0) return 0;
+
+    // Collect the distinct buckets first, several cells can hash to the same one.
+    const i64 num_cells = (i64)(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+    const bool all_buckets = num_cells >= (i64)grid.num_buckets;
+
+    u32 stack_buckets[SPATIAL_STACK_BUCKETS];
+    std::vector<u32> heap_buckets;
+    u32 *buckets = stack_buckets;
+    u32 num_buckets = 0;
+    if (all_buckets)
+    {
+        heap_buckets.resize(grid.num_buckets);
+        buckets = heap_buckets.data();
+        for (u32 b = 0; b < grid.num_buckets; b++) buckets[num_buckets++] = b;
+    }
+    else
+    {
+        if (num_cells > SPATIAL_STACK_BUCKETS)
+        {
+            heap_buckets.resize((usize)num_cells);
+            buckets = heap_buckets.data();
+        }
+        for (i32 z = z0; z <= z1; z++)
+        for (i32 y = y0; y <= y1; y++)
+        for (i32 x = x0; x <= x1; x++)
+            buckets[num_buckets++] = spatial_hash_bucket(grid, x, y, z);
+        std::sort(buckets, buckets + num_buckets);
+        num_buckets = (u32)(std::unique(buckets, buckets + num_buckets) - buckets);
+    }
+
+    u32 total = 0;
+    auto emit = [&](const u32 *indices, const Vec3f *positions, u32 count, u32 bucket) {
+        if (count == 0) return;
+        if (total < max_spans) spans[total] = SpatialSpan{indices, positions, count, bucket};
+        total++;
+    };
+
+    const u32 *ob = grid.overflow_bucket;
+    u32 o = 0;
+    for (u32 i = 0; i < num_buckets; i++)
+    {
+        const u32 b = buckets[i];
+        const u32 begin = grid.bucket_start[b];
+        emit(grid.indices + begin, grid.positions + begin, grid.bucket_start[b + 1] - begin, b);
+
+        // Both lists are sorted, so the overflow is merged in a single pass.
+        while (o < grid.num_overflow && ob[o] < b) o++;
+        const u32 first = o;
+        while (o < grid.num_overflow && ob[o] == b) o++;
+        emit(grid.overflow_index + first, grid.overflow_position + first, o - first, b);
+    }
+    return total;
+}
+
+u32
+lt::spatial_hash_query_radius(const SpatialHash &grid, Vec3f center, f32 radius, u32 *out, u32 max_out)
+{
+    u32 total = 0;
+    lt::spatial_hash_visit_radius(grid, center, radius, [&](u32 index, Vec3f) {
+        if (total < max_out) out[total] = index;
+        total++;
+    });
+    return total;
+}
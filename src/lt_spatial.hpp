@@ -0,0 +1,156 @@
+#ifndef LT_SPATIAL_HPP
+#define LT_SPATIAL_HPP
+
+#include <algorithm>
+#include "lt_core.hpp"
+#include "lt_math.hpp"
+#include "lt_geometry.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Spatial hash
+//
+// Broadphase over points. Space is cut into cubic cells of `cell_size`, and every cell is
+// hashed into one of `num_buckets` buckets. A build counting-sorts the points by bucket, so
+// each bucket is a contiguous run of point indices (with a copy of their positions next to
+// them). Queries visit the buckets of the cells they overlap, hash collisions mean a bucket can
+// hold points from unrelated cells, so the exact queries also test the distance.
+//
+// spatial_hash_update handles a few moving points without a rebuild: points that stay in
+// their cell only get their position refreshed, points that change cell are tombstoned in
+// their old bucket (LT_SPATIAL_INVALID) and kept in a small sorted overflow list. Once the
+// overflow gets large, the next update does a full rebuild.
+//
+// Pick a cell size close to the query radius, that keeps radius queries at 27 cells.
+//
+
+#define LT_SPATIAL_INVALID 0xffffffffu
+
+struct SpatialHash
+{
+    f32    cell_size;
+    f32    inv_cell_size;
+    u32    num_buckets;       // Power of two.
+    u32    requested_buckets; // 0 sizes the table from the point count.
+    u32    num_points;
+    u32    capacity;
+
+    u32   *bucket_start;      // num_buckets + 1 offsets into `indices`.
+    u32   *indices;           // Point indices sorted by bucket, LT_SPATIAL_INVALID when moved away.
+    Vec3f *positions;         // Positions in the same order as `indices`.
+    u32   *point_bucket;      // Bucket of every point.
+    u32   *point_slot;        // Slot of every point in `indices`, or LT_SPATIAL_INVALID if in overflow.
+
+    u32    num_overflow;
+    u32    overflow_capacity;
+    u32   *overflow_bucket;   // Sorted.
+    u32   *overflow_index;
+    Vec3f *overflow_position;
+};
+
+// A contiguous run of point indices from one bucket. It can contain LT_SPATIAL_INVALID.
+struct SpatialSpan
+{
+    const u32   *indices;
+    const Vec3f *positions;
+    u32          count;
+    u32          bucket;
+};
+
+namespace lt
+{
+
+// `num_buckets` is rounded up to a power of two, 0 picks twice the point count on every build.
+void spatial_hash_init(SpatialHash *grid, f32 cell_size, u32 num_buckets = 0);
+void spatial_hash_destroy(SpatialHash *grid);
+
+// Returns false on allocation failure. Large inputs are hashed and scattered in parallel, the
+// result does not depend on the number of threads.
+bool spatial_hash_build(SpatialHash *grid, const Vec3f *positions, u32 count);
+
+// `moved` lists the points whose position changed, `positions` is the full array.
+bool spatial_hash_update(SpatialHash *grid, const Vec3f *positions, const u32 *moved, u32 num_moved);
+
+// Writes up to `max_spans` spans for the buckets overlapping `box` (main table and overflow)
+// and returns how many there are in total.
+u32 spatial_hash_query_aabb(const SpatialHash &grid, const AABB &box, SpatialSpan *spans, u32 max_spans);
+
+// Writes up to `max_out` indices of points within `radius` of `center` and returns how many
+// there are in total.
+u32 spatial_hash_query_radius(const SpatialHash &grid, Vec3f center, f32 radius, u32 *out, u32 max_out);
+
+inline i32
+spatial_hash_cell_coord(const SpatialHash &grid, f32 x)
+{
+    return (i32)std::floor(x * grid.inv_cell_size);
+}
+
+inline u32
+spatial_hash_bucket(const SpatialHash &grid, i32 cx, i32 cy, i32 cz)
+{
+    const u32 h = ((u32)cx * 73856093u) ^ ((u32)cy * 19349663u) ^ ((u32)cz * 83492791u);
+    return h & (grid.num_buckets - 1);
+}
+
+// Calls fn(index, position) for every point within `radius` of `center`, without allocating.
+template<typename F> void
+spatial_hash_visit_radius(const SpatialHash &grid, Vec3f center, f32 radius, const F &fn)
+{
+    if (grid.num_points == 0) return;
+
+    const f32 r2 = radius * radius;
+    const i32 x0 = spatial_hash_cell_coord(grid, center.x - radius), x1 = spatial_hash_cell_coord(grid, center.x + radius);
+    const i32 y0 = spatial_hash_cell_coord(grid, center.y - radius), y1 = spatial_hash_cell_coord(grid, center.y + radius);
+    const i32 z0 = spatial_hash_cell_coord(grid, center.z - radius), z1 = spatial_hash_cell_coord(grid, center.z + radius);
+
+    auto in_sphere = [&](Vec3f p) {
+        const Vec3f d = p - center;
+        return d.x*d.x + d.y*d.y + d.z*d.z <= r2;
+    };
+
+    // Radius larger than the table: walk every bucket once.
+    const i64 num_cells = (i64)(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+    if (num_cells >= (i64)grid.num_buckets)
+    {
+        for (u32 s = 0; s < grid.bucket_start[grid.num_buckets]; s++)
+            if (grid.indices[s] != LT_SPATIAL_INVALID && in_sphere(grid.positions[s])) fn(grid.indices[s], grid.positions[s]);
+        for (u32 i = 0; i < grid.num_overflow; i++)
+            if (in_sphere(grid.overflow_position[i])) fn(grid.overflow_index[i], grid.overflow_position[i]);
+        return;
+    }
+
+    // Distinct cells can share a bucket, so a bucket only reports the points that belong to the
+    // cell it is visited for. That way every point is reported once.
+    auto in_cell = [&](Vec3f p, i32 x, i32 y, i32 z) {
+        return spatial_hash_cell_coord(grid, p.x) == x && spatial_hash_cell_coord(grid, p.y) == y &&
+            spatial_hash_cell_coord(grid, p.z) == z;
+    };
+
+    for (i32 z = z0; z <= z1; z++)
+    for (i32 y = y0; y <= y1; y++)
+    for (i32 x = x0; x <= x1; x++)
+    {
+        const u32 bucket = spatial_hash_bucket(grid, x, y, z);
+        for (u32 s = grid.bucket_start[bucket]; s < grid.bucket_start[bucket + 1]; s++)
+        {
+            const Vec3f p = grid.positions[s];
+            if (grid.indices[s] != LT_SPATIAL_INVALID && in_sphere(p) && in_cell(p, x, y, z))
+                fn(grid.indices[s], p);
+        }
+
+        if (grid.num_overflow > 0)
+        {
+            const u32 *ob = grid.overflow_bucket;
+            u32 i = (u32)(std::lower_bound(ob, ob + grid.num_overflow, bucket) - ob);
+            for (; i < grid.num_overflow && ob[i] == bucket; i++)
+            {
+                const Vec3f p = grid.overflow_position[i];
+                if (in_sphere(p) && in_cell(p, x, y, z)) fn(grid.overflow_index[i], p);
+            }
+        }
+    }
+}
+
+}
+
+#endif // LT_SPATIAL_HPP
@@ -0,0 +1,313 @@
+#include "lt_task.hpp"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <cstdlib>
+#include <new>
+#include "lt_parallel.hpp"
+
+#if LT_PLATFORM_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#define LT_TASK_FRAME_GRANULARITY 64
+#define LT_TASK_FRAME_CLASSES     16   // Frames up to 1 KB are pooled.
+#define LT_TASK_FRAME_CACHE       256  // Blocks kept per class and thread.
+#define LT_TASK_QUEUE_CAPACITY    4096
+
+/////////////////////////////////////////////////////////
+//
+// Frame pool
+//
+// Frames often finish on another thread than the one that created them, so a block goes back
+// to the free list of the thread that frees it. Every list is capped and the surplus goes back
+// to the heap.
+//
+
+struct FrameBlock
+{
+    FrameBlock *next;
+};
+
+struct FrameCache
+{
+    FrameBlock *heads[LT_TASK_FRAME_CLASSES] = {};
+    u32         counts[LT_TASK_FRAME_CLASSES] = {};
+
+    ~FrameCache()
+    {
+        for (FrameBlock *&head : heads)
+        {
+            while (head)
+            {
+                void *p = head;
+                head = head->next;
+                LT_Free(p);
+            }
+        }
+    }
+};
+
+lt_internal thread_local FrameCache t_frame_cache;
+
+lt_internal inline usize
+frame_class(usize size)
+{
+    return (size + LT_TASK_FRAME_GRANULARITY - 1) / LT_TASK_FRAME_GRANULARITY - 1;
+}
+
+void *
+lt::task_frame_alloc(usize size)
+{
+    const usize c = frame_class(size);
+    if (c >= LT_TASK_FRAME_CLASSES)
+    {
+        void *p = LT_Malloc(size, MemoryTag_General);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+
+    FrameCache *cache = &t_frame_cache;
+    if (FrameBlock *block = cache->heads[c])
+    {
+        cache->heads[c] = block->next;
+        cache->counts[c]--;
+        return block;
+    }
+
+    void *p = LT_Malloc((c + 1) * LT_TASK_FRAME_GRANULARITY, MemoryTag_General);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void
+lt::task_frame_free(void *p, usize size)
+{
+    const usize c = frame_class(size);
+    FrameCache *cache = &t_frame_cache;
+    if (c >= LT_TASK_FRAME_CLASSES || cache->counts[c] >= LT_TASK_FRAME_CACHE)
+    {
+        LT_Free(p);
+        return;
+    }
+
+    FrameBlock *block = (FrameBlock*)p;
+    block->next = cache->heads[c];
+    cache->heads[c] = block;
+    cache->counts[c]++;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Task pool
+//
+// Workers and I/O threads block on their queues and exit when they pop a job without a
+// function. Timers are kept in a heap by a dedicated thread that posts the expired ones to
+// the workers.
+//
+// The pool's own threads never block on a post: when a queue is full their jobs go to its
+// overflow list, which the consumers move back into the queue before each pop. A job only
+// overflows when the queue is full after the list was marked, so some consumer still has a
+// pop ahead of it that sees the mark.
+//
+
+lt_internal thread_local const lt::TaskPool *t_pool = nullptr;   // Pool of the calling thread.
+
+void
+lt::TaskPool::push_job(JobQueue *queue, TaskJob job)
+{
+    if (queue->jobs.try_push(job)) return;
+    if (t_pool != this)
+    {
+        queue->jobs.push(job);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue->overflow_mutex);
+        queue->overflow.push_back(job);
+        queue->has_overflow.store(true);
+    }
+    // The consumers may have emptied the queue before the mark.
+    drain_overflow(queue);
+}
+
+void
+lt::TaskPool::drain_overflow(JobQueue *queue)
+{
+    std::lock_guard<std::mutex> lock(queue->overflow_mutex);
+    while (!queue->overflow.empty() && queue->jobs.try_push(queue->overflow.front())) queue->overflow.pop_front();
+    queue->has_overflow.store(!queue->overflow.empty());
+}
+
+void
+lt::TaskPool::run_jobs(JobQueue *queue)
+{
+    t_pool = this;
+    for (;;)
+    {
+        if (queue->has_overflow.load()) drain_overflow(queue);
+        TaskJob job;
+        queue->jobs.pop(&job);
+        if (!job.run) break;
+        job.run(job.arg);
+    }
+}
+
+lt::TaskPool::TaskPool(u32 num_workers, u32 num_io_threads)
+    : m_jobs(LT_TASK_QUEUE_CAPACITY)
+    , m_io_jobs(LT_TASK_QUEUE_CAPACITY)
+{
+    if (num_workers == 0) num_workers = worker_count();
+
+    m_workers.reserve(num_workers);
+    for (u32 i = 0; i < num_workers; i++) m_workers.emplace_back([this] { run_jobs(&m_jobs); });
+
+    m_io_threads.reserve(num_io_threads);
+    for (u32 i = 0; i < num_io_threads; i++) m_io_threads.emplace_back([this] { run_jobs(&m_io_jobs); });
+
+    m_timer_thread = std::thread([this] { timer_loop(); });
+}
+
+lt::TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_timer_mutex);
+        m_stopping = true;
+    }
+    m_timer_cv.notify_all();
+    m_timer_thread.join();
+
+    // I/O jobs post to the workers, so the I/O threads stop first.
+    for (usize i = 0; i < m_io_threads.size(); i++) m_io_jobs.jobs.push(TaskJob{nullptr, nullptr});
+    for (std::thread &t : m_io_threads) t.join();
+
+    for (usize i = 0; i < m_workers.size(); i++) m_jobs.jobs.push(TaskJob{nullptr, nullptr});
+    for (std::thread &t : m_workers) t.join();
+}
+
+void
+lt::TaskPool::post(TaskJob job)
+{
+    LT_Assert(job.run);
+    push_job(&m_jobs, job);
+}
+
+void
+lt::TaskPool::post_io(TaskJob job)
+{
+    LT_Assert(job.run);
+    push_job(&m_io_jobs, job);
+}
+
+void
+lt::TaskPool::post_at(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> h)
+{
+    bool earliest;
+    {
+        std::lock_guard<std::mutex> lock(m_timer_mutex);
+        earliest = m_timers.empty() || deadline < m_timers.top().deadline;
+        m_timers.push(Timer{deadline, h});
+    }
+    if (earliest) m_timer_cv.notify_one();
+}
+
+void
+lt::TaskPool::timer_loop()
+{
+    t_pool = this;
+    std::unique_lock<std::mutex> lock(m_timer_mutex);
+    while (!m_stopping)
+    {
+        if (m_timers.empty())
+        {
+            m_timer_cv.wait(lock);
+            continue;
+        }
+
+        const auto deadline = m_timers.top().deadline;
+        if (std::chrono::steady_clock::now() < deadline)
+        {
+            m_timer_cv.wait_until(lock, deadline);
+            continue;
+        }
+
+        const std::coroutine_handle<> h = m_timers.top().handle;
+        m_timers.pop();
+        lock.unlock();
+        post(resume_job(h));
+        lock.lock();
+    }
+}
+
+/////////////////////////////////////////////////////////
+//
+// File awaitables
+//
+
+lt_internal void
+read_file_job(void *arg)
+{
+    lt::ReadFileAwaiter *a = (lt::ReadFileAwaiter*)arg;
+    a->result = file_read_contents(a->path.c_str(), a->insert_final_zero);
+    a->pool->post(lt::resume_job(a->handle));
+}
+
+lt_internal void
+read_range_job(void *arg)
+{
+    lt::ReadRangeAwaiter *a = (lt::ReadRangeAwaiter*)arg;
+    a->result = -1;
+
+#if LT_PLATFORM_UNIX
+    const int fd = open(a->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        usize done = 0;
+        while (done < a->size)
+        {
+            const ssize_t n = pread(fd, (char*)a->dst + done, a->size - done, (off_t)(a->offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0)
+            {
+                if (n < 0) done = (usize)-1;
+                break;
+            }
+            done += (usize)n;
+        }
+        close(fd);
+        a->result = (done == (usize)-1) ? -1 : (isize)done;
+    }
+#else
+    FILE *fp = fopen(a->path.c_str(), "rb");
+    if (fp)
+    {
+        if (fseek(fp, (long)a->offset, SEEK_SET) == 0)
+        {
+            const usize n = fread(a->dst, 1, a->size, fp);
+            a->result = ferror(fp) ? -1 : (isize)n;
+        }
+        fclose(fp);
+    }
+#endif
+
+    a->pool->post(lt::resume_job(a->handle));
+}
+
+void
+lt::ReadFileAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    handle = h;
+    pool->post_io(TaskJob{read_file_job, this});
+}
+
+void
+lt::ReadRangeAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    handle = h;
+    pool->post_io(TaskJob{read_range_job, this});
+}
+
+#endif // __cpp_impl_coroutine
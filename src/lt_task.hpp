@@ -0,0 +1,548 @@
+#ifndef LT_TASK_HPP
+#define LT_TASK_HPP
+
+#include "lt_core.hpp"
+
+// Coroutines need C++20, the rest of lt builds as C++17 and sees an empty header.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "lt_fs.hpp"
+#include "lt_queue.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Tasks
+//
+// Task<T> is a lazily started coroutine: it runs when awaited, and when it finishes it
+// resumes its awaiter through symmetric transfer, so long chains of tasks completing
+// synchronously do not grow the stack. Coroutine frames come from per-thread free lists of
+// size classes instead of the heap.
+//
+// A TaskPool runs coroutines on worker threads. I/O awaitables (read_file_async,
+// read_range_async) do their blocking reads on separate I/O threads and resume the awaiting
+// coroutine on a worker, so hundreds of reads can be in flight without holding up the
+// workers. when_all starts a list of tasks together and resumes the caller when the last one
+// finishes.
+//
+//     Task<FileContents*> load(TaskPool &pool, const char *path)
+//     {
+//         FileContents *fc = co_await lt::read_file_async(pool, path);
+//         co_await pool.schedule();   // Continue on a worker.
+//         ...
+//         co_return fc;
+//     }
+//
+
+namespace lt
+{
+
+void *task_frame_alloc(usize size);
+void  task_frame_free(void *p, usize size);
+
+struct TaskJob
+{
+    void (*run)(void *arg);
+    void  *arg;
+};
+
+inline TaskJob
+resume_job(std::coroutine_handle<> h)
+{
+    return TaskJob{[](void *address) { std::coroutine_handle<>::from_address(address).resume(); }, h.address()};
+}
+
+struct TaskPool
+{
+    // 0 workers means worker_count().
+    explicit TaskPool(u32 num_workers = 0, u32 num_io_threads = 8);
+    // Every task must be finished: queued jobs still run, pending timers are dropped.
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool &operator=(const TaskPool&) = delete;
+
+    // Block while the queue is full, except on the pool's own threads, which never block.
+    void post(TaskJob job);
+    void post_io(TaskJob job);
+    void post_at(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> h);
+
+    struct ScheduleAwaiter
+    {
+        TaskPool *pool;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { pool->post(resume_job(h)); }
+        void await_resume() const noexcept {}
+    };
+
+    struct TimerAwaiter
+    {
+        TaskPool                             *pool;
+        std::chrono::steady_clock::time_point deadline;
+
+        bool await_ready() const noexcept { return deadline <= std::chrono::steady_clock::now(); }
+        void await_suspend(std::coroutine_handle<> h) { pool->post_at(deadline, h); }
+        void await_resume() const noexcept {}
+    };
+
+    // Moves the awaiting coroutine to a worker thread.
+    ScheduleAwaiter schedule() { return ScheduleAwaiter{this}; }
+    // Resumes the awaiting coroutine on a worker after `delay`.
+    TimerAwaiter    sleep_for(std::chrono::nanoseconds delay)
+    {
+        return TimerAwaiter{this, std::chrono::steady_clock::now() + delay};
+    }
+
+    u32 num_workers() const { return (u32)m_workers.size(); }
+
+private:
+    struct Timer
+    {
+        std::chrono::steady_clock::time_point deadline;
+        std::coroutine_handle<>               handle;
+
+        bool operator>(const Timer &other) const { return deadline > other.deadline; }
+    };
+
+    // A bounded queue, and the jobs its consumers posted while it was full. A thread waiting
+    // for room in the queue it consumes would deadlock.
+    struct JobQueue
+    {
+        explicit JobQueue(usize capacity) : jobs(capacity) {}
+
+        MpmcQueue<TaskJob>  jobs;
+        std::mutex          overflow_mutex;
+        std::deque<TaskJob> overflow;
+        std::atomic<bool>   has_overflow{false};
+    };
+
+    void push_job(JobQueue *queue, TaskJob job);
+    void drain_overflow(JobQueue *queue);
+    void run_jobs(JobQueue *queue);
+    void timer_loop();
+
+    JobQueue                 m_jobs;
+    JobQueue                 m_io_jobs;
+    std::vector<std::thread> m_workers;
+    std::vector<std::thread> m_io_threads;
+
+    std::thread              m_timer_thread;
+    std::mutex               m_timer_mutex;
+    std::condition_variable  m_timer_cv;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> m_timers;
+    bool                     m_stopping = false;
+};
+
+template<typename T> struct Task;
+
+namespace task_detail
+{
+
+struct FramePool
+{
+    static void *operator new(usize size) { return task_frame_alloc(size); }
+    static void  operator delete(void *p, usize size) { task_frame_free(p, size); }
+};
+
+struct PromiseBase : FramePool
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr      exception;
+
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+
+        template<typename P> std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            std::coroutine_handle<> next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter        final_suspend() const noexcept { return {}; }
+    void                unhandled_exception() { exception = std::current_exception(); }
+};
+
+template<typename T>
+struct Promise : PromiseBase
+{
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+
+    template<typename U> void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+
+    T
+    result()
+    {
+        if (exception) std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+
+template<>
+struct Promise<void> : PromiseBase
+{
+    Task<void> get_return_object();
+
+    void return_void() const noexcept {}
+
+    void
+    result()
+    {
+        if (exception) std::rethrow_exception(exception);
+    }
+};
+
+}
+
+template<typename T>
+struct [[nodiscard]] Task
+{
+    using promise_type = task_detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(Handle h) : m_handle(h) {}
+    Task(Task &&other) noexcept : m_handle(other.m_handle) { other.m_handle = nullptr; }
+
+    Task &
+    operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_handle) m_handle.destroy();
+            m_handle = other.m_handle;
+            other.m_handle = nullptr;
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (m_handle) m_handle.destroy();
+    }
+
+    struct Awaiter
+    {
+        Handle handle;
+
+        bool await_ready() const noexcept { return !handle || handle.done(); }
+
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+
+        T await_resume() { return handle.promise().result(); }
+    };
+
+    Awaiter operator co_await() const noexcept { return Awaiter{m_handle}; }
+
+    bool done() const { return !m_handle || m_handle.done(); }
+
+private:
+    Handle m_handle = nullptr;
+};
+
+template<typename T> inline Task<T>
+task_detail::Promise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void>
+task_detail::Promise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+/////////////////////////////////////////////////////////
+//
+// sync_wait and when_all
+//
+
+namespace task_detail
+{
+
+struct Latch
+{
+    std::atomic<usize>      count;
+    std::coroutine_handle<> waiter;
+};
+
+// Frame owned by whoever started it; when it finishes it transfers to `latch->waiter` if it
+// was the last one.
+struct LatchedTask
+{
+    struct promise_type : FramePool
+    {
+        Latch *latch = nullptr;
+
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+
+            std::coroutine_handle<>
+            await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                Latch *latch = h.promise().latch;
+                if (latch->count.fetch_sub(1, std::memory_order_acq_rel) == 1) return latch->waiter;
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        LatchedTask get_return_object()
+        {
+            return LatchedTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter        final_suspend() const noexcept { return {}; }
+        void                return_void() const noexcept {}
+        void                unhandled_exception() const noexcept { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+    explicit LatchedTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+    LatchedTask(LatchedTask &&other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    LatchedTask(const LatchedTask&) = delete;
+
+    ~LatchedTask()
+    {
+        if (handle) handle.destroy();
+    }
+
+    void
+    start(Latch *latch)
+    {
+        handle.promise().latch = latch;
+        handle.resume();
+    }
+};
+
+template<typename T>
+struct Slot
+{
+    std::optional<T>   value;
+    std::exception_ptr exception;
+};
+
+template<>
+struct Slot<void>
+{
+    std::exception_ptr exception;
+};
+
+template<typename T> LatchedTask
+run_into(const Task<T> &task, Slot<T> *slot)
+{
+    try
+    {
+        if constexpr (std::is_void_v<T>) co_await task;
+        else slot->value.emplace(co_await task);
+    }
+    catch (...)
+    {
+        slot->exception = std::current_exception();
+    }
+}
+
+// Starts every latched task and suspends until the last one finishes. Does not suspend when
+// they all finished synchronously.
+struct LatchAwaiter
+{
+    std::vector<LatchedTask> *tasks;
+    Latch                     latch;
+
+    bool await_ready() const noexcept { return tasks->empty(); }
+
+    bool
+    await_suspend(std::coroutine_handle<> h)
+    {
+        latch.waiter = h;
+        latch.count.store(tasks->size() + 1, std::memory_order_relaxed);
+        for (LatchedTask &t : *tasks) t.start(&latch);
+        return latch.count.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    void await_resume() const noexcept {}
+};
+
+// Detached driver for sync_wait, signals the blocked thread when done.
+struct SyncEvent
+{
+    std::mutex              mutex;
+    std::condition_variable cv;
+    bool                    done = false;
+
+    void
+    set()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cv.notify_all();
+    }
+
+    void
+    wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return done; });
+    }
+};
+
+struct DetachedTask
+{
+    struct promise_type : FramePool
+    {
+        DetachedTask        get_return_object() const noexcept { return {}; }
+        std::suspend_never  initial_suspend() const noexcept { return {}; }
+        std::suspend_never  final_suspend() const noexcept { return {}; }
+        void                return_void() const noexcept {}
+        void                unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+template<typename T> DetachedTask
+sync_driver(const Task<T> &task, Slot<T> *slot, SyncEvent *event)
+{
+    try
+    {
+        if constexpr (std::is_void_v<T>) co_await task;
+        else slot->value.emplace(co_await task);
+    }
+    catch (...)
+    {
+        slot->exception = std::current_exception();
+    }
+    event->set();
+}
+
+}
+
+// Runs `task` and blocks the calling thread until it finishes. Must not be called from a
+// pool worker the task depends on.
+template<typename T> T
+sync_wait(Task<T> task)
+{
+    task_detail::Slot<T> slot;
+    task_detail::SyncEvent event;
+    task_detail::sync_driver(task, &slot, &event);
+    event.wait();
+
+    if (slot.exception) std::rethrow_exception(slot.exception);
+    if constexpr (!std::is_void_v<T>) return std::move(*slot.value);
+}
+
+// Runs all the tasks concurrently and returns their results in order. The first exception,
+// in task order, is rethrown after all of them finished.
+template<typename T> Task<std::vector<T>>
+when_all(std::vector<Task<T>> tasks)
+{
+    std::vector<task_detail::Slot<T>> slots(tasks.size());
+    std::vector<task_detail::LatchedTask> latched;
+    latched.reserve(tasks.size());
+    for (usize i = 0; i < tasks.size(); i++) latched.push_back(task_detail::run_into(tasks[i], &slots[i]));
+
+    co_await task_detail::LatchAwaiter{&latched, {}};
+
+    std::vector<T> results;
+    results.reserve(slots.size());
+    for (auto &slot : slots)
+    {
+        if (slot.exception) std::rethrow_exception(slot.exception);
+        results.push_back(std::move(*slot.value));
+    }
+    co_return results;
+}
+
+inline Task<void>
+when_all(std::vector<Task<void>> tasks)
+{
+    std::vector<task_detail::Slot<void>> slots(tasks.size());
+    std::vector<task_detail::LatchedTask> latched;
+    latched.reserve(tasks.size());
+    for (usize i = 0; i < tasks.size(); i++) latched.push_back(task_detail::run_into(tasks[i], &slots[i]));
+
+    co_await task_detail::LatchAwaiter{&latched, {}};
+
+    for (auto &slot : slots)
+        if (slot.exception) std::rethrow_exception(slot.exception);
+}
+
+/////////////////////////////////////////////////////////
+//
+// File awaitables
+//
+
+struct ReadFileAwaiter
+{
+    TaskPool               *pool;
+    std::string             path;
+    bool                    insert_final_zero;
+    FileContents           *result = nullptr;
+    std::coroutine_handle<> handle;
+
+    bool          await_ready() const noexcept { return false; }
+    void          await_suspend(std::coroutine_handle<> h);
+    FileContents *await_resume() const noexcept { return result; }
+};
+
+struct ReadRangeAwaiter
+{
+    TaskPool               *pool;
+    std::string             path;
+    u64                     offset;
+    void                   *dst;
+    usize                   size;
+    isize                   result = -1;
+    std::coroutine_handle<> handle;
+
+    bool  await_ready() const noexcept { return false; }
+    void  await_suspend(std::coroutine_handle<> h);
+    isize await_resume() const noexcept { return result; }
+};
+
+// Same result as file_read_contents, free it with file_free_contents.
+inline ReadFileAwaiter
+read_file_async(TaskPool &pool, std::string path, bool insert_final_zero = false)
+{
+    return ReadFileAwaiter{&pool, std::move(path), insert_final_zero, nullptr, {}};
+}
+
+// Reads up to `size` bytes at `offset` into `dst`. Returns the number of bytes read (short at
+// the end of the file) or -1 on errors.
+inline ReadRangeAwaiter
+read_range_async(TaskPool &pool, std::string path, u64 offset, void *dst, usize size)
+{
+    return ReadRangeAwaiter{&pool, std::move(path), offset, dst, size, -1, {}};
+}
+
+}
+
+#endif // __cpp_impl_coroutine
+
+#endif // LT_TASK_HPP
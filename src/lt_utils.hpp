@@ -1,57 +1,88 @@
 #ifndef LT_UTILS_HPP
 #define LT_UTILS_HPP
 
+#include <stdio.h>
 #include <sstream>
-#include <iostream>
+#include <type_traits>
+
+#include "lt_format.hpp"
+#if LT_FLIGHT_RECORDER
+#include "lt_flight.hpp"
+#endif
+
+// Lines longer than this are written in several pieces.
+#define LT_LOGGER_LINE_SIZE 1024
 
 namespace lt
 {
 
+template<typename T, typename = void>
+struct HasFormatAppend : std::false_type {};
+
+template<typename T>
+struct HasFormatAppend<T, std::void_t<decltype(format_append((FormatBuffer*)nullptr, std::declval<const T&>()))>>
+    : std::true_type {};
+
+// Types without a format_append overload are still printed, through their operator<<.
+template<typename T> inline void
+format_value(FormatBuffer *buf, const T &value)
+{
+    if constexpr (HasFormatAppend<T>::value)
+    {
+        format_append(buf, value);
+    }
+    else
+    {
+        std::ostringstream os;
+        os << value;
+        format_append(buf, os.str());
+    }
+}
+
 struct Logger
 {
     template<typename... Args> void
     log(const Args&... args)
     {
-        std::ostringstream msg;
-        msg << "[" << m_name << "] ";
-        log_recursive(msg, args...);
+        write_line("", args...);
     }
 
     template<typename... Args> void
     warn(const Args&... args)
     {
-        std::ostringstream msg;
-        msg << "[" << m_name << "] Warning: ";
-        log_recursive(msg, args...);
+        write_line("Warning: ", args...);
     }
 
     template<typename... Args> void
     error(const Args&... args)
     {
-        std::ostringstream msg;
-        msg << "[" << m_name << "] Error: ";
-        log_recursive(msg, args...);
+        write_line("Error: ", args...);
     }
 
     explicit Logger(const char *name) : m_name(name) {}
 private:
     const char *m_name;
 
-    // Terminator
-    void log_recursive(std::ostringstream& msg)
-    {
-        std::cout << msg.str() << std::endl;
-    }
-
-    // "Recursive" variadic function
-    template<typename T, typename... Args>
-    void log_recursive(std::ostringstream& msg,
-                       T value, const Args&... args)
+    // The line is built on the stack and written to stdout with one call, flushed like
+    // std::endl did. With LT_FLIGHT_RECORDER it is recorded as well.
+    template<typename... Args> void
+    write_line(const char *level, const Args&... args)
     {
-        msg << value;
-        log_recursive(msg, args...);
+        char storage[LT_LOGGER_LINE_SIZE];
+        FormatBuffer buf(storage, sizeof(storage), stdout);
+        format_append(&buf, '[');
+        format_append(&buf, m_name);
+        format_append(&buf, "] ");
+        format_append(&buf, level);
+        (format_value(&buf, args), ...);
+#if LT_FLIGHT_RECORDER
+        // The end of the line when a long one was already partly written.
+        flight_text(FlightEvent_Log, m_name, buf.data, buf.size);
+#endif
+        format_append(&buf, '\n');
+        format_flush(&buf);
+        fflush(stdout);
     }
-
 };
 
 }
@@ -0,0 +1,45 @@
+#ifndef LT_TEST_HPP
+#define LT_TEST_HPP
+
+#include <cstdio>
+#include "lt_core.hpp"
+
+/////////////////////////////////////////////////////////
+//
+// Test helpers
+//
+// Every test is a plain executable. LT_Check reports the failed condition and keeps going,
+// main returns lt_test_result() so that ctest sees the failure.
+//
+
+lt_global_variable i32 g_test_failures = 0;
+
+#define LT_Check(cond) \
+    do { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_test_failures++; \
+        } \
+    } while (0)
+
+// Same, and returns from the calling function.
+#define LT_Require(cond) \
+    do { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: requirement failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_test_failures++; \
+            return; \
+        } \
+    } while (0)
+
+inline int
+lt_test_result(const char *name)
+{
+    if (g_test_failures) fprintf(stderr, "%s: %d failures\n", name, g_test_failures);
+    else printf("%s: ok\n", name);
+    return g_test_failures ? 1 : 0;
+}
+
+#endif // LT_TEST_HPP
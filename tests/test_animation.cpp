@@ -0,0 +1,149 @@
+#include <cmath>
+#include <vector>
+#include "lt_animation.hpp"
+#include "lt_cpu.hpp"
+#include "lt_test.hpp"
+
+// Key reduction stays within the tolerance of the original curves and stays fast on long
+// linear curves, and the sampling kernels of every CpuIsa tier agree.
+
+lt_internal Quatf
+axis_angle(f32 angle)
+{
+    const f32 s = std::sin(angle * 0.5f), c = std::cos(angle * 0.5f);
+    const f32 n = 1.0f / std::sqrt(3.0f);
+    return Quatf(c, s * n, s * n, s * n);
+}
+
+struct TestTrack
+{
+    std::vector<f32>   times;
+    std::vector<Vec3f> translations;
+    std::vector<Quatf> rotations;
+};
+
+lt_internal AnimTrackKeys
+track_keys(const TestTrack &t)
+{
+    AnimTrackKeys keys = {};
+    keys.translation_times = t.times.data();
+    keys.translations = t.translations.data();
+    keys.num_translations = (u32)t.times.size();
+    keys.rotation_times = t.times.data();
+    keys.rotations = t.rotations.data();
+    keys.num_rotations = (u32)t.times.size();
+    return keys;
+}
+
+lt_internal void
+test_reduction()
+{
+    // One long linear track, and a few curved ones.
+    const u32 num_keys = 100000;
+    std::vector<TestTrack> tracks(5);
+    for (u32 t = 0; t < tracks.size(); t++)
+        for (u32 k = 0; k < num_keys; k++)
+        {
+            const f32 time = (f32)k / 30.0f;
+            tracks[t].times.push_back(time);
+            if (t == 0)
+            {
+                tracks[t].translations.push_back(Vec3f(time, 2.0f * time, -time));
+                tracks[t].rotations.push_back(Quatf(1, 0, 0, 0));
+            }
+            else
+            {
+                tracks[t].translations.push_back(Vec3f(std::sin(time * t), std::cos(time), 0.5f * t));
+                tracks[t].rotations.push_back(axis_angle(std::sin(time * 0.7f * t) * 2.0f));
+            }
+        }
+    std::vector<AnimTrackKeys> keys;
+    for (const TestTrack &t : tracks) keys.push_back(track_keys(t));
+
+    const AnimCompression compression = {1e-3f, 1e-3f, 1e-3f};
+    AnimClip clip;
+    LT_Require(lt::anim_clip_build(&clip, keys.data(), (u32)keys.size(), &compression));
+    const AnimCurves &translation = clip.channels[AnimChannel_Translation];
+    // The linear track only keeps the segment ends forced by the window.
+    LT_Check(translation.first[1] - translation.first[0] <= num_keys / 256 + 2);
+    LT_Check(translation.num_keys < num_keys * 5);
+
+    // Sampled between the original keys, against the original curves.
+    AnimCursor cursor;
+    LT_Require(lt::anim_cursor_init(&cursor, clip));
+    std::vector<AnimTransform> out(tracks.size());
+    u32 bad = 0;
+    for (u32 k = 0; k + 1 < num_keys; k += 7)
+    {
+        lt::anim_sample(clip, &cursor, ((f32)k + 0.5f) / 30.0f, out.data());
+        for (u32 t = 0; t < tracks.size(); t++)
+        {
+            const Vec3f a = tracks[t].translations[k], b = tracks[t].translations[k + 1];
+            const Vec3f d = out[t].translation - (a + (b - a) * 0.5f);
+            if (std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z) > 2e-3f) bad++;
+        }
+    }
+    LT_Check(bad == 0);
+    lt::anim_cursor_destroy(&cursor);
+    lt::anim_clip_destroy(&clip);
+}
+
+lt_internal void
+test_kernel_parity()
+{
+    // 13 tracks, so the last lane group is partial.
+    const u32 num_tracks = 13, num_keys = 50;
+    std::vector<TestTrack> tracks(num_tracks);
+    for (u32 t = 0; t < num_tracks; t++)
+        for (u32 k = 0; k < num_keys; k++)
+        {
+            const f32 time = (f32)k * 0.1f;
+            tracks[t].times.push_back(time);
+            tracks[t].translations.push_back(Vec3f(std::sin(time + t), time * t, 1.0f));
+            tracks[t].rotations.push_back(axis_angle(time * (1.0f + t)));
+        }
+    std::vector<AnimTrackKeys> keys;
+    for (const TestTrack &t : tracks) keys.push_back(track_keys(t));
+    AnimClip clip;
+    LT_Require(lt::anim_clip_build(&clip, keys.data(), num_tracks, nullptr));
+
+    // Every tier against the scalar kernel, each with its own cursor. cpu_set_isa clamps to the
+    // detected tier, so the last ones may repeat.
+    const CpuIsa saved = lt::cpu_isa();
+    const CpuIsa isas[] = {CpuIsa_SSE2, CpuIsa_AVX2};
+    std::vector<AnimTransform> ref(num_tracks), out(num_tracks);
+    u32 bad = 0;
+    for (CpuIsa isa : isas)
+    {
+        AnimCursor ref_cursor, cursor;
+        LT_Require(lt::anim_cursor_init(&ref_cursor, clip));
+        LT_Require(lt::anim_cursor_init(&cursor, clip));
+        for (f32 time = 0.0f; time < 5.0f; time += 0.037f)
+        {
+            lt::cpu_set_isa(CpuIsa_Scalar);
+            lt::anim_sample(clip, &ref_cursor, time, ref.data());
+            lt::cpu_set_isa(isa);
+            lt::anim_sample(clip, &cursor, time, out.data());
+            for (u32 t = 0; t < num_tracks; t++)
+            {
+                const Vec3f d = out[t].translation - ref[t].translation;
+                f32 rotation_error = 0.0f;
+                for (i32 i = 0; i < 4; i++) rotation_error += std::fabs(out[t].rotation.val[i] - ref[t].rotation.val[i]);
+                if (std::fabs(d.x) + std::fabs(d.y) + std::fabs(d.z) > 1e-5f || rotation_error > 1e-5f) bad++;
+            }
+        }
+        lt::anim_cursor_destroy(&ref_cursor);
+        lt::anim_cursor_destroy(&cursor);
+    }
+    lt::cpu_set_isa(saved);
+    LT_Check(bad == 0);
+    lt::anim_clip_destroy(&clip);
+}
+
+int
+main()
+{
+    test_reduction();
+    test_kernel_parity();
+    return lt_test_result("test_animation");
+}
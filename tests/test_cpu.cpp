@@ -0,0 +1,108 @@
+#include <cstdlib>
+#include <cstring>
+#include "lt_animation.hpp"
+#include "lt_cpu.hpp"
+#include "lt_hash.hpp"
+#include "lt_math.hpp"
+#include "lt_sort.hpp"
+#include "lt_test.hpp"
+
+// Tier names, LT_CPU_ISA, the clamping of cpu_set_isa, and the dispatch caches: a lower tier
+// must reach every cached site, the kernel names of the modules included.
+
+struct TestKernel
+{
+    CpuIsa isa;
+};
+
+lt_global_variable const TestKernel g_test_kernels[] = {
+    {CpuIsa_Scalar}, {CpuIsa_SSE2}, {CpuIsa_SSE42}, {CpuIsa_AVX2}, {CpuIsa_AVX512},
+};
+lt_global_variable CpuDispatchCache g_test_dispatch;
+
+// Must run before anything reads the active tier.
+lt_internal void
+test_environment()
+{
+    setenv("LT_CPU_ISA", "SCALAR", 1);
+    LT_Check(lt::cpu_isa() == CpuIsa_Scalar);
+    LT_Check(lt::cpu_set_isa(CpuIsa_Count) == lt::cpu_detected_isa());
+}
+
+lt_internal void
+test_parse()
+{
+    for (i32 i = 0; i < CpuIsa_Count; i++)
+    {
+        CpuIsa isa = CpuIsa_Count;
+        LT_Check(lt::cpu_parse_isa(lt::cpu_isa_name((CpuIsa)i), &isa) && isa == (CpuIsa)i);
+    }
+    CpuIsa isa = CpuIsa_Count;
+    LT_Check(lt::cpu_parse_isa("AVX2", &isa) && isa == CpuIsa_AVX2);
+    LT_Check(lt::cpu_parse_isa("Sse4.2", &isa) && isa == CpuIsa_SSE42);
+
+    isa = CpuIsa_Count;
+    LT_Check(!lt::cpu_parse_isa("", &isa));
+    LT_Check(!lt::cpu_parse_isa("avx", &isa));
+    LT_Check(!lt::cpu_parse_isa("sse2 ", &isa));
+    LT_Check(isa == CpuIsa_Count);
+    LT_Check(strcmp(lt::cpu_isa_name(CpuIsa_Count), "unknown") == 0);
+    LT_Check(strcmp(lt::cpu_isa_name((CpuIsa)-1), "unknown") == 0);
+}
+
+lt_internal void
+test_set_isa()
+{
+    const CpuIsa detected = lt::cpu_detected_isa();
+    LT_Check(lt::cpu_set_isa((CpuIsa)(CpuIsa_Count + 3)) == detected);
+    LT_Check(lt::cpu_isa() == detected);
+    LT_Check(lt::cpu_set_isa((CpuIsa)-2) == CpuIsa_Scalar);
+    LT_Check(lt::cpu_isa() == CpuIsa_Scalar);
+    for (i32 i = 0; i < CpuIsa_Count; i++)
+    {
+        const CpuIsa expected = ((CpuIsa)i < detected) ? (CpuIsa)i : detected;
+        LT_Check(lt::cpu_set_isa((CpuIsa)i) == expected);
+        LT_Check(lt::cpu_isa() == expected);
+    }
+    lt::cpu_set_isa(detected);
+}
+
+lt_internal void
+test_caches()
+{
+    const CpuIsa detected = lt::cpu_detected_isa();
+    lt::cpu_set_isa(detected);
+    LT_Check(lt::cpu_select(g_test_kernels, &g_test_dispatch)->isa == detected);
+    LT_Check(g_test_dispatch.kernel.load() == &g_test_kernels[detected]);
+    // The library's own sites, so that the lower tier below has to reach them too.
+    LT_Check(strcmp(lt::mat4_kernel_name(), lt::cpu_isa_name(detected >= CpuIsa_AVX2 ? CpuIsa_AVX2 : CpuIsa_Scalar)) == 0);
+    LT_Check(strcmp(lt::hash_kernel_name(), "scalar") != 0 || detected < CpuIsa_SSE2);
+
+    // Going down one tier at a time, every cached site follows.
+    for (i32 i = detected; i >= CpuIsa_Scalar; i--)
+    {
+        lt::cpu_set_isa((CpuIsa)i);
+        LT_Check(g_test_dispatch.kernel.load() == nullptr);
+        LT_Check(lt::cpu_select(g_test_kernels, &g_test_dispatch)->isa == (CpuIsa)i);
+        LT_Check(lt::cpu_select(g_test_kernels, &g_test_dispatch) == &g_test_kernels[i]);
+    }
+    LT_Check(strcmp(lt::mat4_kernel_name(), "scalar") == 0);
+    LT_Check(strcmp(lt::hash_kernel_name(), "scalar") == 0);
+    LT_Check(strcmp(lt::anim_kernel_name(), "scalar") == 0);
+    LT_Check(strcmp(lt::morton_kernel_name(), "scalar") == 0);
+
+    // And back up.
+    lt::cpu_set_isa(detected);
+    LT_Check(lt::cpu_select(g_test_kernels, &g_test_dispatch)->isa == detected);
+    LT_Check(strcmp(lt::mat4_kernel_name(), "scalar") != 0 || detected < CpuIsa_AVX2);
+}
+
+int
+main()
+{
+    test_environment();
+    test_parse();
+    test_set_isa();
+    test_caches();
+    return lt_test_result("test_cpu");
+}
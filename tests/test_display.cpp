@@ -0,0 +1,226 @@
+#define LT_DISPLAY_IMPL
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "lt_display.hpp"
+#include "lt_test.hpp"
+
+// Output discovery and the RandR notifications against a private Xvfb server: a mode change
+// refreshes the cache, a CRTC that only moved is patched in place and a new screen size comes
+// in through RRScreenChangeNotify. Without Xvfb in PATH the test reports a skip to ctest.
+
+#define TEST_SKIPPED 77
+
+lt_global_variable i32 g_x_errors = 0;
+
+lt_internal int
+count_x_error(Display *, XErrorEvent *)
+{
+    g_x_errors++;
+    return 0;
+}
+
+lt_internal bool
+find_in_path(const char *program)
+{
+    const char *path = getenv("PATH");
+    if (!path) return false;
+    const std::string dirs = path;
+    usize start = 0;
+    while (start <= dirs.size())
+    {
+        usize end = dirs.find(':', start);
+        if (end == std::string::npos) end = dirs.size();
+        const std::string file = dirs.substr(start, end - start) + "/" + program;
+        if (access(file.c_str(), X_OK) == 0) return true;
+        start = end + 1;
+    }
+    return false;
+}
+
+// Xvfb picks a free display itself, -displayfd writes its number once it accepts connections.
+lt_internal pid_t
+start_xvfb(char *display, usize size)
+{
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        char fd[16];
+        snprintf(fd, sizeof(fd), "%d", fds[1]);
+        execlp("Xvfb", "Xvfb", "-displayfd", fd, "-screen", "0", "1280x1024x24", "-nolisten", "tcp", (char *)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+    if (pid < 0)
+    {
+        close(fds[0]);
+        return -1;
+    }
+
+    char number[16] = {};
+    usize len = 0;
+    pollfd p = {fds[0], POLLIN, 0};
+    while (len < sizeof(number) - 1 && poll(&p, 1, 10000) > 0)
+    {
+        const ssize_t n = read(fds[0], number + len, sizeof(number) - 1 - len);
+        if (n <= 0) break;
+        len += (usize)n;
+        if (number[len - 1] == '\n') break;
+    }
+    close(fds[0]);
+
+    if (len == 0 || number[len - 1] != '\n')
+    {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    snprintf(display, size, ":%d", atoi(number));
+    return pid;
+}
+
+// The notifications can trail the request, poll the connection for up to a second.
+lt_internal bool
+wait_for_update(lt::DisplayContext *ctx)
+{
+    for (i32 i = 0; i < 100; i++)
+    {
+        if (lt::display_context_update(ctx)) return true;
+        pollfd p = {lt::display_context_fd(ctx), POLLIN, 0};
+        poll(&p, 1, 10);
+    }
+    return false;
+}
+
+lt_internal void
+test_discovery(const char *display)
+{
+    lt::DisplayContext ctx;
+    LT_Require(lt::display_context_open(&ctx, display));
+    LT_Check(ctx.has_randr);
+    LT_Check(ctx.num_outputs >= 1);
+    LT_Check(lt::display_context_fd(&ctx) >= 0);
+
+    const lt::DisplayOutput *primary = lt::display_primary_output(&ctx);
+    LT_Check(primary != NULL);
+    if (primary)
+    {
+        LT_Check(primary->primary);
+        LT_Check(primary->x == 0 && primary->y == 0);
+        LT_Check(primary->width == 1280 && primary->height == 1024);
+        LT_Check(primary->rotation == RR_Rotate_0);
+        LT_Check(primary->width_mm > 0 && primary->height_mm > 0);
+        LT_Check(primary->dpi_x > 0 && primary->dpi_y > 0);
+        LT_Check(lt::display_output_at(&ctx, 0, 0) == primary);
+        LT_Check(lt::display_output_at(&ctx, 1279, 1023) == primary);
+        LT_Check(lt::display_output_at(&ctx, 1280, 0) == NULL);
+    }
+
+    // Nothing changed since the open.
+    LT_Check(!lt::display_context_update(&ctx));
+
+    i32 dpi_x = 0, dpi_y = 0;
+    lt::lt_get_display_dpi(&dpi_x, &dpi_y);     // DISPLAY is set to the Xvfb server in main.
+    if (primary) LT_Check(dpi_x == primary->dpi_x && dpi_y == primary->dpi_y);
+
+    lt::display_context_close(&ctx);
+    LT_Check(ctx.dpy == NULL && ctx.num_outputs == 0);
+}
+
+lt_internal void
+test_changes(const char *display)
+{
+    lt::DisplayContext ctx;
+    LT_Require(lt::display_context_open(&ctx, display));
+    const lt::DisplayOutput *primary = lt::display_primary_output(&ctx);
+    if (!ctx.has_randr || !primary || primary->crtc_id == None)
+    {
+        printf("test_display: the server has no RandR CRTC, changes not tested\n");
+        lt::display_context_close(&ctx);
+        return;
+    }
+    RROutput output = primary->output_id;
+    const RRCrtc crtc = primary->crtc_id;
+
+    // A 1024x768 mode at 60 Hz.
+    char name[] = "lt_test_1024x768";
+    XRRModeInfo *info = XRRAllocModeInfo(name, (int)sizeof(name) - 1);
+    info->width = 1024;
+    info->height = 768;
+    info->hTotal = 1344;
+    info->vTotal = 806;
+    info->dotClock = 1344 * 806 * 60;
+    const RRMode mode = XRRCreateMode(ctx.dpy, ctx.root, info);
+    XRRFreeModeInfo(info);
+    XRRAddOutputMode(ctx.dpy, output, mode);
+
+    // A new mode refreshes the whole cache.
+    XRRScreenResources *res = XRRGetScreenResourcesCurrent(ctx.dpy, ctx.root);
+    LT_Require(res);
+    LT_Check(XRRSetCrtcConfig(ctx.dpy, res, crtc, CurrentTime, 0, 0, mode, RR_Rotate_0, &output, 1) == RRSetConfigSuccess);
+    LT_Check(wait_for_update(&ctx));
+    primary = lt::display_primary_output(&ctx);
+    LT_Check(primary && primary->mode_id == mode && primary->width == 1024 && primary->height == 768);
+    if (primary) LT_Check(primary->refresh_rate > 59.9 && primary->refresh_rate < 60.1);
+
+    // The same mode somewhere else only moves the output.
+    LT_Check(XRRSetCrtcConfig(ctx.dpy, res, crtc, CurrentTime, 100, 50, mode, RR_Rotate_0, &output, 1) == RRSetConfigSuccess);
+    LT_Check(wait_for_update(&ctx));
+    primary = lt::display_primary_output(&ctx);
+    LT_Check(primary && primary->x == 100 && primary->y == 50 && primary->width == 1024);
+    LT_Check(lt::display_output_at(&ctx, 100, 50) == primary);
+    LT_Check(lt::display_output_at(&ctx, 99, 50) == NULL);
+
+    // The screen shrinks to the output, which arrives as RRScreenChangeNotify.
+    LT_Check(XRRSetCrtcConfig(ctx.dpy, res, crtc, CurrentTime, 0, 0, mode, RR_Rotate_0, &output, 1) == RRSetConfigSuccess);
+    LT_Check(wait_for_update(&ctx));
+    const i32 scr = DefaultScreen(ctx.dpy);
+    const i32 width_mm = DisplayWidthMM(ctx.dpy, scr) * 1024 / 1280;
+    const i32 height_mm = DisplayHeightMM(ctx.dpy, scr) * 768 / 1024;
+    XRRSetScreenSize(ctx.dpy, ctx.root, 1024, 768, width_mm, height_mm);
+    XSync(ctx.dpy, False);
+    LT_Check(wait_for_update(&ctx));
+    LT_Check(DisplayWidth(ctx.dpy, scr) == 1024 && DisplayHeight(ctx.dpy, scr) == 768);
+    primary = lt::display_primary_output(&ctx);
+    LT_Check(primary && primary->x == 0 && primary->y == 0 && primary->width == 1024 && primary->height == 768);
+    LT_Check(primary && primary->dpi_x > 0 && primary->dpi_y > 0);
+
+    XRRFreeScreenResources(res);
+    lt::display_context_close(&ctx);
+}
+
+int
+main()
+{
+    if (!find_in_path("Xvfb"))
+    {
+        printf("test_display: skipped, no Xvfb in PATH\n");
+        return TEST_SKIPPED;
+    }
+
+    char display[32];
+    const pid_t server = start_xvfb(display, sizeof(display));
+    if (server < 0)
+    {
+        fprintf(stderr, "test_display: Xvfb did not start\n");
+        return 1;
+    }
+    setenv("DISPLAY", display, 1);
+    XSetErrorHandler(count_x_error);
+
+    test_discovery(display);
+    test_changes(display);
+    LT_Check(g_x_errors == 0);
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    return lt_test_result("test_display");
+}
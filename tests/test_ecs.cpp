@@ -0,0 +1,215 @@
+#include <map>
+#include <utility>
+#include <vector>
+#include "lt_ecs.hpp"
+#include "lt_math.hpp"
+#include "lt_random.hpp"
+#include "lt_test.hpp"
+
+// Randomized model test: 300K structural changes checked against a std::map of the expected
+// component masks and values.
+
+struct ModelEntity
+{
+    EcsMask mask;
+    f32     values[4];     // First float of the 4 data components.
+};
+
+typedef std::map<std::pair<u32, u32>, ModelEntity> Model;
+
+lt_global_variable EcsComponent g_components[5];
+lt_global_variable const u32    NUM_DATA_COMPONENTS = 4;   // The 5th one is an empty tag.
+
+lt_internal std::pair<u32, u32>
+key(EcsEntity e)
+{
+    return std::make_pair(e.index, e.generation);
+}
+
+// Sets the first float of the new, zeroed, component to a random value.
+lt_internal void
+fill_component(EcsWorld *world, Rng *rng, EcsEntity e, u32 c, ModelEntity *m)
+{
+    if (c >= NUM_DATA_COMPONENTS) return;
+    f32 *p = (f32*)lt::ecs_get(world, e, g_components[c]);
+    LT_Require(p);
+    LT_Check(p[0] == 0.0f);
+    m->values[c] = (f32)lt::rng_below(rng, 1000) + 1.0f;
+    p[0] = m->values[c];
+}
+
+lt_internal void
+check_world(EcsWorld *world, const Model &model, const std::vector<EcsEntity> &dead)
+{
+    for (const auto &kv : model)
+    {
+        const EcsEntity e = {kv.first.first, kv.first.second};
+        LT_Check(lt::ecs_entity_alive(world, e));
+        LT_Check(lt::ecs_entity_mask(world, e) == kv.second.mask);
+        for (u32 c = 0; c < NUM_DATA_COMPONENTS; c++)
+        {
+            const f32 *p = (const f32*)lt::ecs_get(world, e, g_components[c]);
+            const bool has = (kv.second.mask >> c) & 1;
+            LT_Check((p != nullptr) == has);
+            if (p && has) LT_Check(p[0] == kv.second.values[c]);
+        }
+    }
+    for (EcsEntity e : dead)
+    {
+        LT_Check(!lt::ecs_entity_alive(world, e));
+        LT_Check(!lt::ecs_get(world, e, g_components[0]));
+    }
+    LT_Check(world->num_entities == model.size());
+    LT_Check(lt::ecs_count(world, {0, 0}) == model.size());
+
+    // Entities with component 0 and without the tag, through the chunks.
+    const EcsQuery query = {(EcsMask)1 << g_components[0], (EcsMask)1 << g_components[4]};
+    u32 expected = 0;
+    for (const auto &kv : model)
+        if ((kv.second.mask & query.all) && !(kv.second.mask & query.none)) expected++;
+    u32 seen = 0;
+    lt::ecs_each_chunk(world, query, [&](EcsChunk *chunk) {
+        const EcsEntity *entities = lt::ecs_entities(chunk);
+        const Vec3f *column = lt::ecs_column<Vec3f>(chunk, g_components[0]);
+        for (u32 i = 0; i < chunk->count; i++)
+        {
+            auto it = model.find(key(entities[i]));
+            if (it == model.end())
+            {
+                LT_Check(!"entity in a chunk but not in the model");
+                continue;
+            }
+            LT_Check(column[i].x == it->second.values[0]);
+            seen++;
+        }
+    });
+    LT_Check(seen == expected);
+    LT_Check(lt::ecs_count(world, query) == expected);
+}
+
+lt_internal void
+test_model()
+{
+    EcsWorld world;
+    LT_Require(lt::ecs_world_init(&world));
+    g_components[0] = lt::ecs_component_register<Vec3f>(&world, "position");
+    g_components[1] = lt::ecs_component_register<Vec3f>(&world, "velocity");
+    g_components[2] = lt::ecs_component_register<Quatf>(&world, "rotation");
+    g_components[3] = lt::ecs_component_register<Mat4f>(&world, "world");
+    g_components[4] = lt::ecs_component_register(&world, "tag", 0, 1);
+
+    Rng rng;
+    lt::rng_seed(&rng, 7);
+    Model model;
+    std::vector<EcsEntity> dead;
+    std::vector<EcsEntity> created;
+
+    for (u32 step = 0; step < 300000; step++)
+    {
+        const u32 op = lt::rng_below(&rng, 10);
+        if (op < 4 || model.empty())
+        {
+            const EcsMask mask = lt::rng_below(&rng, 32);
+            const u32 count = lt::rng_below(&rng, 8) == 0 ? lt::rng_below(&rng, 600) + 1 : 1;
+            created.resize(count);
+            if (!lt::ecs_entity_create_many(&world, mask, count, created.data()))
+            {
+                LT_Check(!"ecs_entity_create_many failed");
+                continue;
+            }
+            for (EcsEntity e : created)
+            {
+                ModelEntity m = {mask, {}};
+                for (u32 c = 0; c < NUM_DATA_COMPONENTS; c++)
+                    if ((mask >> c) & 1) fill_component(&world, &rng, e, c, &m);
+                LT_Check(!model.count(key(e)));
+                model[key(e)] = m;
+            }
+            continue;
+        }
+
+        // Mostly old entities, sometimes the newest one.
+        auto it = model.begin();
+        std::advance(it, lt::rng_below(&rng, (u32)(model.size() < 64 ? model.size() : 64)));
+        if (lt::rng_below(&rng, 2)) it = std::prev(model.end());
+        const EcsEntity e = {it->first.first, it->first.second};
+        const u32 c = lt::rng_below(&rng, 5);
+
+        if (op < 6)
+        {
+            LT_Check(lt::ecs_entity_destroy(&world, e));
+            model.erase(it);
+            dead.push_back(e);
+        }
+        else if (op < 8)
+        {
+            LT_Check(lt::ecs_add_component(&world, e, g_components[c]));
+            if (!((it->second.mask >> c) & 1))
+            {
+                it->second.mask |= (EcsMask)1 << c;
+                fill_component(&world, &rng, e, c, &it->second);
+            }
+        }
+        else
+        {
+            LT_Check(lt::ecs_remove_component(&world, e, g_components[c]));
+            it->second.mask &= ~((EcsMask)1 << c);
+        }
+
+        if (step % 5000 == 0)
+        {
+            check_world(&world, model, dead);
+            // Keep the model small, and exercise mass destruction.
+            while (model.size() > 20000)
+            {
+                const EcsEntity old = {model.begin()->first.first, model.begin()->first.second};
+                LT_Check(lt::ecs_entity_destroy(&world, old));
+                model.erase(model.begin());
+            }
+        }
+    }
+    check_world(&world, model, dead);
+    lt::ecs_world_destroy(&world);
+}
+
+lt_internal void
+test_invalid()
+{
+    EcsWorld world;
+    LT_Require(lt::ecs_world_init(&world));
+    const EcsComponent position = lt::ecs_component_register<Vec3f>(&world, "position");
+    const EcsEntity e = lt::ecs_entity_create(&world, (EcsMask)1 << position);
+
+    LT_Check(lt::ecs_entity_alive(&world, e));
+    LT_Check(!lt::ecs_entity_alive(&world, EcsEntity{}));
+    LT_Check(lt::ecs_get(&world, e, position));
+    LT_Check(!lt::ecs_get(&world, e, LT_ECS_INVALID));
+    LT_Check(!lt::ecs_get(&world, e, position + 1));
+    LT_Check(!lt::ecs_add_component(&world, e, LT_ECS_INVALID));
+    LT_Check(!lt::ecs_remove_component(&world, e, LT_ECS_INVALID));
+    LT_Check(lt::ecs_entity_mask(&world, e) == (EcsMask)1 << position);
+
+    // Queries with an id that has no mask bit visit nothing.
+    const EcsComponent invalid[2] = {position, LT_ECS_INVALID};
+    LT_Check(lt::ecs_mask(invalid, 2) == (EcsMask)1 << position);
+    u32 visited = 0;
+    lt::ecs_each<Vec3f, Vec3f>(&world, invalid, [&](const EcsEntity*, u32, Vec3f*, Vec3f*) { visited++; });
+    lt::ecs_each_parallel<Vec3f, Vec3f>(&world, invalid, [&](const EcsEntity*, u32, Vec3f*, Vec3f*) { visited++; });
+    const EcsComponent valid[1] = {position};
+    lt::ecs_each<Vec3f>(&world, valid, [&](const EcsEntity*, u32 count, Vec3f *p) { visited += 10 * count * (p != nullptr); });
+    LT_Check(visited == 10);
+
+    // A freed slot keeps its bumped generation: a forged handle must not be alive.
+    LT_Check(lt::ecs_entity_destroy(&world, e));
+    LT_Check(!lt::ecs_entity_destroy(&world, e));
+    LT_Check(!lt::ecs_entity_alive(&world, EcsEntity{e.index, e.generation + 1}));
+    lt::ecs_world_destroy(&world);
+}
+
+int
+main()
+{
+    test_invalid();
+    test_model();
+    return lt_test_result("test_ecs");
+}
@@ -0,0 +1,137 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "lt_flight.hpp"
+#include "lt_test.hpp"
+
+// The dump text of a pipe, with the markers, notes and thread name of the calling thread. In
+// child processes, since only the first crash of a process dumps: the crash record written by
+// flight_crash, and a dump that faults itself, which must end the process instead of waiting
+// for its own dump to finish.
+
+#define TEST_FLIGHT_PATH "test_flight_crash.txt"
+
+lt_internal std::string
+read_all(int fd)
+{
+    std::string text;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) text.append(buf, (usize)n);
+    return text;
+}
+
+lt_internal std::string
+read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return std::string();
+    std::string text;
+    char buf[4096];
+    usize n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+    fclose(f);
+    return text;
+}
+
+lt_internal bool
+contains(const std::string &text, const char *what)
+{
+    return text.find(what) != std::string::npos;
+}
+
+// Waits up to 10 seconds for the child, a child that is still running then is killed.
+lt_internal bool
+wait_child(pid_t pid, int *status)
+{
+    for (i32 i = 0; i < 1000; i++)
+    {
+        if (waitpid(pid, status, WNOHANG) == pid) return true;
+        poll(nullptr, 0, 10);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, status, 0);
+    return false;
+}
+
+lt_internal void
+test_dump_fd()
+{
+    int fds[2];
+    LT_Require(pipe(fds) == 0);
+    lt::flight_set_thread_name("test main");
+    lt::flight_mark("test_marker", 42);
+    lt::flight_note("test_note", "hello\nworld");
+    // The whole dump fits the pipe buffer.
+    lt::flight_dump_fd(fds[1], "test");
+    close(fds[1]);
+    const std::string text = read_all(fds[0]);
+    close(fds[0]);
+
+    LT_Check(text.compare(0, strlen("lt flight recorder\n"), "lt flight recorder\n") == 0);
+    LT_Check(contains(text, "reason: test\n"));
+    LT_Check(contains(text, "\"test main\""));
+    LT_Check(contains(text, "marker  test_marker 42\n"));
+    // Control characters turn into spaces.
+    LT_Check(contains(text, "note    test_note: hello world\n"));
+    LT_Check(text.find("test_marker") < text.find("test_note"));
+}
+
+lt_internal void
+test_crash_record()
+{
+    remove(TEST_FLIGHT_PATH);
+    const pid_t pid = fork();
+    LT_Require(pid >= 0);
+    if (pid == 0)
+    {
+        lt::flight_init(TEST_FLIGHT_PATH, false);
+        lt::flight_mark("before_crash", 7);
+        lt::flight_crash("LT_Assert", "x > 0", "file.cpp", 12);
+        _exit(0);
+    }
+    int status = 0;
+    LT_Check(wait_child(pid, &status));
+    LT_Check(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    const std::string text = read_file(TEST_FLIGHT_PATH);
+    LT_Check(contains(text, "reason: LT_Assert\n"));
+    LT_Check(contains(text, "times: relative to the dump, in ns\n"));
+    LT_Check(contains(text, "marker  before_crash 7\n"));
+    LT_Check(contains(text, "crash   LT_Assert: x > 0 at file.cpp:12\n"));
+    remove(TEST_FLIGHT_PATH);
+}
+
+lt_internal void
+test_crash_in_dump()
+{
+    const pid_t pid = fork();
+    LT_Require(pid >= 0);
+    if (pid == 0)
+    {
+        // Names must be static strings, a bad pointer faults in the dump and the handler
+        // runs on the thread that holds the dump.
+        lt::flight_init(TEST_FLIGHT_PATH, true);
+        lt::flight_mark((const char*)8, 0);
+        lt::flight_crash("LT_Assert", "x > 0", "file.cpp", 12);
+        _exit(0);
+    }
+    int status = 0;
+    LT_Check(wait_child(pid, &status));
+    LT_Check(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+    remove(TEST_FLIGHT_PATH);
+}
+
+int
+main()
+{
+    // Before anything in this process crashes, the children inherit the dump state.
+    test_crash_record();
+    test_crash_in_dump();
+    test_dump_fd();
+    return lt_test_result("test_flight");
+}
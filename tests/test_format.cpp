@@ -0,0 +1,105 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "lt_format.hpp"
+#include "lt_random.hpp"
+#include "lt_test.hpp"
+
+// format_f64/f32_digits must give the text of printf "%.*g" for every digit count, also when
+// that needs more digits than the shortest representation holds. The shortest text parses
+// back to the same value, and so do numbers too long for the stack buffer of the slow parse.
+
+lt_internal u32
+check_digits(f64 value, bool as_f32)
+{
+    u32 bad = 0;
+    for (i32 digits = 1; digits <= 17; digits++)
+    {
+        char expected[64], buf[64];
+        snprintf(expected, sizeof(expected), "%.*g", digits, value);
+        char *end = as_f32 ? lt::format_f32_digits(buf, (f32)value, digits) : lt::format_f64_digits(buf, value, digits);
+        *end = 0;
+        if (strcmp(buf, expected) != 0)
+        {
+            if (bad++ < 10) fprintf(stderr, "%.17g at %d digits: %s, printf %s\n", value, digits, buf, expected);
+        }
+    }
+    return bad;
+}
+
+lt_internal void
+test_digits()
+{
+    const f64 cases[] = {
+        0.1, 0.2, 0.3, 1.0 / 3.0, 2.0 / 3.0, 0.5, 1.0, 100.0, 123456789.0, 1e22, 1e23, 5e-324,
+        2.2250738585072014e-308, 1.7976931348623157e308, 9007199254740993.0, 0.125, 1.5, 2.5,
+        0.00015, 0.000123, 1e-5, 1e16, 1e17, 12345678901234567890.0, 3.0e-5, 0.45, 8.5, 9.5,
+        -0.1, -2.5, 1024.0, 0.0009765625, 4503599627370496.5, 1152921504606846976.0,
+    };
+    u32 bad = 0;
+    for (f64 value : cases)
+    {
+        bad += check_digits(value, false);
+        bad += check_digits((f32)value, true);
+    }
+
+    // 0.1 needs digits past its shortest text at 17 digits.
+    char buf[64];
+    *lt::format_f64_digits(buf, 0.1, 17) = 0;
+    LT_Check(strcmp(buf, "0.10000000000000001") == 0);
+
+    Rng rng;
+    lt::rng_seed(&rng, 5);
+    for (u32 i = 0; i < 20000; i++)
+    {
+        // Random bit patterns cover every exponent, powers of two and small integers the rest.
+        u64 bits = lt::rng_next(&rng);
+        f64 value;
+        memcpy(&value, &bits, sizeof(value));
+        if (std::isfinite(value)) bad += check_digits(value, false);
+        bad += check_digits(std::ldexp(1.0, (i32)(bits % 2000) - 1000), false);
+        bad += check_digits((f64)(bits >> 40), false);
+
+        u32 bits32 = (u32)bits;
+        f32 value32;
+        memcpy(&value32, &bits32, sizeof(value32));
+        if (std::isfinite(value32)) bad += check_digits(value32, true);
+    }
+    LT_Check(bad == 0);
+}
+
+lt_internal void
+test_round_trip()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 6);
+    u32 bad = 0;
+    for (u32 i = 0; i < 100000; i++)
+    {
+        u64 bits = lt::rng_next(&rng);
+        f64 value;
+        memcpy(&value, &bits, sizeof(value));
+        if (!std::isfinite(value)) continue;
+        char buf[64];
+        const char *end = lt::format_f64(buf, value);
+        f64 parsed;
+        if (lt::parse_f64(buf, end, &parsed) != end || parsed != value) bad++;
+    }
+    LT_Check(bad == 0);
+
+    // More than 512 characters, just above the tie between two doubles, so that only the
+    // last digit decides the rounding.
+    const std::string text = "9007199254740993." + std::string(600, '0') + "1";
+    f64 value = 0.0;
+    LT_Check(lt::parse_f64(text.data(), text.data() + text.size(), &value) == text.data() + text.size());
+    LT_Check(value == 9007199254740994.0);
+}
+
+int
+main()
+{
+    test_digits();
+    test_round_trip();
+    return lt_test_result("test_format");
+}
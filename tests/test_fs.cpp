@@ -0,0 +1,194 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "lt_fs.hpp"
+#include "lt_random.hpp"
+#include "lt_test.hpp"
+
+// The buffered writer against the bytes it was given, for every mix of small, block list and
+// larger than buffer writes, and the atomic replace keeping the target's permissions. The
+// sequential reader (O_DIRECT when the file system allows it, buffered otherwise) and its
+// unaligned range reads against the file contents.
+
+#define TEST_FS_PATH "test_fs.bin"
+
+lt_internal std::string
+random_bytes(Rng *rng, usize size)
+{
+    std::string bytes(size, 0);
+    for (char &c : bytes) c = (char)lt::rng_next(rng);
+    return bytes;
+}
+
+lt_internal std::string
+read_back(const char *path)
+{
+    FileContents *fc = file_read_contents(path);
+    std::string bytes;
+    if (fc->error == FileError_None) bytes.assign((const char*)fc->data, (usize)fc->size);
+    file_free_contents(fc);
+    return bytes;
+}
+
+lt_internal bool
+has_temp_files()
+{
+    DIR *dir = opendir(".");
+    if (!dir) return false;
+    bool found = false;
+    while (struct dirent *entry = readdir(dir))
+        found |= strncmp(entry->d_name, TEST_FS_PATH ".tmp.", strlen(TEST_FS_PATH ".tmp.")) == 0;
+    closedir(dir);
+    return found;
+}
+
+lt_internal void
+test_writer()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 51);
+    FileWriter writer;
+    u32 bad = 0;
+    for (usize buffer_size : {4096, 65536})
+        for (bool background : {false, true})
+            for (bool atomic : {false, true})
+            {
+                FileWriteOptions options;
+                options.buffer_size = buffer_size;
+                options.background_flush = background;
+                options.atomic = atomic;
+                options.preallocate = atomic ? Megabytes(1) : 0;
+                LT_Require(ltfs::writer_open(&writer, TEST_FS_PATH, options));
+
+                std::string expected;
+                for (u32 i = 0; i < 200; i++)
+                {
+                    const usize size = lt::rng_below(&rng, (u32)(3 * buffer_size));
+                    if (i % 3 == 0)
+                    {
+                        // A list of small blocks, the last one may not fit the buffer.
+                        std::vector<std::string> parts;
+                        std::vector<WriteBlock> blocks;
+                        for (u32 k = 0; k < 5; k++) parts.push_back(random_bytes(&rng, size / 5 + k));
+                        for (const std::string &part : parts)
+                        {
+                            blocks.push_back({part.data(), part.size()});
+                            expected += part;
+                        }
+                        if (!ltfs::writer_write_blocks(&writer, blocks.data(), blocks.size())) bad++;
+                    }
+                    else
+                    {
+                        const std::string part = random_bytes(&rng, size);
+                        expected += part;
+                        if (!ltfs::writer_write(&writer, part.data(), part.size())) bad++;
+                    }
+                    if (i == 100 && !ltfs::writer_flush(&writer)) bad++;
+                }
+                if (!ltfs::writer_close(&writer) || writer.written != expected.size()) bad++;
+                if (read_back(TEST_FS_PATH) != expected) bad++;
+            }
+    ltfs::writer_destroy(&writer);
+    LT_Check(bad == 0);
+    LT_Check(!has_temp_files());
+    remove(TEST_FS_PATH);
+}
+
+lt_internal void
+test_atomic_replace()
+{
+    LT_Require(ltfs::write_file(TEST_FS_PATH, "old", 3, false));
+    LT_Require(chmod(TEST_FS_PATH, 0640) == 0);
+
+    LT_Check(ltfs::write_file(TEST_FS_PATH, "new", 3, true));
+    LT_Check(read_back(TEST_FS_PATH) == "new");
+    struct stat st;
+    LT_Check(stat(TEST_FS_PATH, &st) == 0 && (st.st_mode & 07777) == 0640);
+
+    // An aborted write leaves the target alone.
+    FileWriter writer;
+    FileWriteOptions options;
+    options.atomic = true;
+    LT_Require(ltfs::writer_open(&writer, TEST_FS_PATH, options));
+    LT_Check(ltfs::writer_write(&writer, "aborted", 7));
+    ltfs::writer_abort(&writer);
+    LT_Check(read_back(TEST_FS_PATH) == "new");
+    LT_Check(!has_temp_files());
+
+    LT_Check(!ltfs::writer_open(&writer, "missing_directory/test.bin", options));
+    LT_Check(writer.error == FileError_Create);
+    ltfs::writer_destroy(&writer);
+    remove(TEST_FS_PATH);
+}
+
+lt_internal void
+test_reader()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 52);
+    u32 bad = 0;
+    for (usize size : {0, 1, 4096, 3 * 8192, 5 * 8192 + 1234})
+    {
+        const std::string bytes = random_bytes(&rng, size);
+        LT_Require(ltfs::write_file(TEST_FS_PATH, bytes.data(), bytes.size(), false));
+
+        bool used_direct = false;
+        FileContents *fc = file_read_contents_direct(TEST_FS_PATH, true, &used_direct);
+        if (fc->error != FileError_None || fc->size != (isize)size || memcmp(fc->data, bytes.data(), size) != 0 ||
+            ((const char*)fc->data)[size] != 0)
+            bad++;
+        file_free_contents(fc);
+
+        for (bool direct : {false, true})
+            for (bool prefetch : {false, true})
+            {
+                FileReadOptions options;
+                options.chunk_size = 8192;
+                options.direct = direct;
+                options.prefetch = prefetch;
+                FileReader reader;
+                LT_Require(ltfs::reader_open(&reader, TEST_FS_PATH, options));
+                if (!direct && reader.direct) bad++;
+                if (reader.size != size) bad++;
+
+                std::string read;
+                const char *data;
+                isize n;
+                while ((n = ltfs::reader_next(&reader, &data)) > 0) read.append(data, (usize)n);
+                if (n < 0 || read != bytes) bad++;
+
+                // Unaligned offsets and sizes, a range across chunks and one past the end.
+                for (u32 i = 0; i < 20 && size > 0; i++)
+                {
+                    const u64 offset = lt::rng_below(&rng, (u32)size);
+                    const usize length = lt::rng_below(&rng, (u32)(size - offset)) + 1;
+                    std::string range(length, 0);
+                    if (!ltfs::reader_read_range(&reader, offset, range.data(), length) ||
+                        range != bytes.substr((usize)offset, length))
+                        bad++;
+                }
+                char byte;
+                if (ltfs::reader_read_range(&reader, size, &byte, 1)) bad++;
+                ltfs::reader_close(&reader);
+            }
+        if (size == 4096) printf("test_fs: O_DIRECT %s\n", used_direct ? "used" : "not supported, buffered reads");
+    }
+    LT_Check(bad == 0);
+
+    FileReader reader;
+    LT_Check(!ltfs::reader_open(&reader, "missing_directory/test.bin"));
+    LT_Check(reader.error == FileError_NotExists);
+    remove(TEST_FS_PATH);
+}
+
+int
+main()
+{
+    test_writer();
+    test_atomic_replace();
+    test_reader();
+    return lt_test_result("test_fs");
+}
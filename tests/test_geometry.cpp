@@ -0,0 +1,297 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "lt_cpu.hpp"
+#include "lt_geometry.hpp"
+#include "lt_random.hpp"
+#include "lt_test.hpp"
+
+// bvh_intersect and bvh_occluded against a brute force loop over ray_triangle, on random
+// triangle soups, on degenerate input that would make an SAH only tree too deep for the
+// traversal stack, and with axis parallel rays that start on box planes (0 * inf in the slab
+// tests). The 8-wide packet kernels of every CpuIsa tier match the scalar ones.
+
+struct TestMesh
+{
+    std::vector<Vec3f> positions;
+    std::vector<u32>   indices;
+
+    void
+    add(Vec3f v0, Vec3f v1, Vec3f v2)
+    {
+        const u32 base = (u32)positions.size();
+        positions.push_back(v0);
+        positions.push_back(v1);
+        positions.push_back(v2);
+        indices.push_back(base);
+        indices.push_back(base + 1);
+        indices.push_back(base + 2);
+    }
+
+    usize num_triangles() const { return indices.size() / 3; }
+};
+
+lt_internal bool
+brute_intersect(const TestMesh &mesh, const Ray &ray, RayHit *hit)
+{
+    bool found = false;
+    f32 closest = ray.t_max;
+    for (usize i = 0; i < mesh.num_triangles(); i++)
+    {
+        f32 t, u, v;
+        const Vec3f v0 = mesh.positions[mesh.indices[3*i]];
+        const Vec3f v1 = mesh.positions[mesh.indices[3*i + 1]];
+        const Vec3f v2 = mesh.positions[mesh.indices[3*i + 2]];
+        if (lt::ray_triangle(ray, v0, v1, v2, &t, &u, &v) && t <= closest)
+        {
+            closest = t;
+            hit->t = t;
+            hit->prim = (u32)i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+lt_internal Vec3f
+random_point(Rng *rng, f32 scale)
+{
+    return Vec3f((lt::rng_f32(rng) * 2.0f - 1.0f) * scale, (lt::rng_f32(rng) * 2.0f - 1.0f) * scale,
+                 (lt::rng_f32(rng) * 2.0f - 1.0f) * scale);
+}
+
+// Compares the tree with the brute force loop on `rays`. The closest hit may be a different
+// triangle when two share the hit distance, so only the distance has to match.
+lt_internal void
+check_rays(const TestMesh &mesh, const std::vector<Ray> &rays)
+{
+    Bvh4 bvh;
+    LT_Require(lt::bvh_build(&bvh, mesh.positions.data(), mesh.indices.data(), mesh.num_triangles()));
+    u32 hits = 0, mismatches = 0;
+    for (const Ray &ray : rays)
+    {
+        RayHit expected = {}, hit = {};
+        const bool brute = brute_intersect(mesh, ray, &expected);
+        const bool found = lt::bvh_intersect(bvh, ray, &hit);
+        if (brute != found || lt::bvh_occluded(bvh, ray) != brute || (brute && hit.t != expected.t)) mismatches++;
+        hits += brute;
+    }
+    LT_Check(mismatches == 0);
+    LT_Check(hits > 0);
+    lt::bvh_destroy(&bvh);
+}
+
+lt_internal void
+test_random_soup()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 31);
+    TestMesh mesh;
+    for (u32 i = 0; i < 5000; i++)
+    {
+        const Vec3f c = random_point(&rng, 10.0f);
+        mesh.add(c + random_point(&rng, 0.5f), c + random_point(&rng, 0.5f), c + random_point(&rng, 0.5f));
+    }
+    std::vector<Ray> rays;
+    for (u32 i = 0; i < 2000; i++)
+    {
+        const Vec3f origin = random_point(&rng, 12.0f);
+        const Vec3f target = random_point(&rng, 8.0f);
+        rays.push_back(Ray(origin, target - origin));
+    }
+    // Axis parallel rays, with zero direction components.
+    for (u32 i = 0; i < 300; i++)
+    {
+        const Vec3f origin = random_point(&rng, 10.0f);
+        const f32 sign = (i & 1) ? 1.0f : -1.0f;
+        rays.push_back(Ray(origin, Vec3f(sign, 0.0f, 0.0f)));
+        rays.push_back(Ray(origin, Vec3f(0.0f, sign, 0.0f)));
+        rays.push_back(Ray(origin, Vec3f(0.0f, 0.0f, -sign)));
+    }
+    check_rays(mesh, rays);
+}
+
+// Triangles facing +x at x = 2^k for k in [-100, 100], many per plane. The binned SAH splits
+// off one plane per level, which without the median fallback builds a tree a few hundred
+// levels deep. The rays run along x, so they test the tree at every depth.
+lt_internal void
+test_degenerate()
+{
+    TestMesh mesh;
+    for (i32 k = -100; k <= 100; k++)
+        for (i32 copy = 0; copy < 20; copy++)
+        {
+            const f32 x = std::ldexp(1.0f, k);
+            const f32 y = (f32)copy;
+            mesh.add(Vec3f(x, y - 1.0f, -1.0f), Vec3f(x, y + 1.0f, -1.0f), Vec3f(x, y, 1.0f));
+        }
+    // All triangles in one spot.
+    TestMesh same;
+    for (u32 i = 0; i < 20000; i++) same.add(Vec3f(0, -1, -1), Vec3f(0, 1, -1), Vec3f(0, 0, 1));
+
+    std::vector<Ray> rays;
+    for (i32 copy = 0; copy < 20; copy++)
+    {
+        rays.push_back(Ray(Vec3f(-1.0f, (f32)copy + 0.25f, 0.0f), Vec3f(1.0f, 0.0f, 0.0f)));
+        rays.push_back(Ray(Vec3f(1e31f, (f32)copy - 0.25f, 0.0f), Vec3f(-1.0f, 0.0f, 0.0f)));
+        rays.push_back(Ray(Vec3f(0.75f, (f32)copy, -0.5f), Vec3f(1.0f, 0.0f, 0.0f)));
+    }
+    check_rays(mesh, rays);
+    check_rays(same, rays);
+}
+
+// Rays running inside a face plane of the box, where the slab gives 0 * inf.
+lt_internal void
+test_slab_planes()
+{
+    const AABB box = {Vec3f(0, 0, 0), Vec3f(1, 1, 1)};
+    AABB4 box4;
+    AABB8 box8;
+    for (i32 i = 0; i < 8; i++)
+    {
+        if (i < 4)
+        {
+            box4.min_x[i] = box4.min_y[i] = box4.min_z[i] = 0.0f;
+            box4.max_x[i] = box4.max_y[i] = box4.max_z[i] = 1.0f;
+        }
+        box8.min_x[i] = box8.min_y[i] = box8.min_z[i] = 0.0f;
+        box8.max_x[i] = box8.max_y[i] = box8.max_z[i] = 1.0f;
+    }
+
+    struct Case { Vec3f origin; Vec3f direction; bool hit; };
+    const Case cases[] = {
+        {Vec3f(-1.0f, 1.0f, 0.5f), Vec3f(1, 0, 0), true},     // On the max y plane.
+        {Vec3f(-1.0f, 0.0f, 0.5f), Vec3f(1, 0, 0), true},     // On the min y plane.
+        {Vec3f(2.0f, 0.0f, 1.0f), Vec3f(-1, 0, 0), true},     // On an edge.
+        {Vec3f(0.0f, 0.5f, 2.0f), Vec3f(0, 0, -1), true},
+        {Vec3f(1.0f, 1.0f, -3.0f), Vec3f(0, 0, 1), true},
+        {Vec3f(0.5f, 1.0f, 0.5f), Vec3f(0, -0.0f, 1), true},   // -0 direction, inside.
+        {Vec3f(-1.0f, 1.5f, 0.5f), Vec3f(1, 0, 0), false},
+        {Vec3f(-1.0f, 1.0f, 0.5f), Vec3f(-1, 0, 0), false},   // On the plane, going away.
+        {Vec3f(1.0f, 1.0f, 2.0f), Vec3f(0, 1, 0), false},
+    };
+    for (const Case &c : cases)
+    {
+        const Ray ray(c.origin, c.direction);
+        const Vec3f inv_dir = lt::ray_inverse_direction(ray);
+        alignas(32) f32 t_near[8];
+        LT_Check(lt::ray_aabb(ray, inv_dir, box, t_near) == c.hit);
+        LT_Check(lt::ray_aabb4(ray, inv_dir, box4, t_near) == (c.hit ? 0xfu : 0u));
+        LT_Check(lt::ray_aabb8(ray, inv_dir, box8, t_near) == (c.hit ? 0xffu : 0u));
+    }
+
+    // A ray along the edge of a quad, inside the min x plane of its box. The tree must agree
+    // with ray_triangle on the edge.
+    TestMesh quad;
+    quad.add(Vec3f(0, 0, 0), Vec3f(1, 0, 0), Vec3f(1, 1, 0));
+    quad.add(Vec3f(0, 0, 0), Vec3f(1, 1, 0), Vec3f(0, 1, 0));
+    std::vector<Ray> rays;
+    for (f32 x : {0.0f, 0.5f, 1.0f})
+        for (f32 y : {0.0f, 0.25f, 1.0f}) rays.push_back(Ray(Vec3f(x, y, 1.0f), Vec3f(0, 0, -1)));
+    check_rays(quad, rays);
+}
+
+lt_internal void
+test_refit()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 32);
+    TestMesh mesh;
+    for (u32 i = 0; i < 2000; i++)
+    {
+        const Vec3f c = random_point(&rng, 10.0f);
+        mesh.add(c + random_point(&rng, 0.5f), c + random_point(&rng, 0.5f), c + random_point(&rng, 0.5f));
+    }
+    Bvh4 bvh;
+    LT_Require(lt::bvh_build(&bvh, mesh.positions.data(), mesh.indices.data(), mesh.num_triangles()));
+    for (Vec3f &p : mesh.positions) p = p + random_point(&rng, 1.0f);
+    lt::bvh_refit(&bvh, mesh.positions.data(), mesh.indices.data());
+
+    u32 mismatches = 0;
+    for (u32 i = 0; i < 1000; i++)
+    {
+        const Vec3f origin = random_point(&rng, 12.0f);
+        const Ray ray(origin, random_point(&rng, 8.0f) - origin);
+        RayHit expected = {}, hit = {};
+        const bool brute = brute_intersect(mesh, ray, &expected);
+        if (lt::bvh_intersect(bvh, ray, &hit) != brute || (brute && hit.t != expected.t)) mismatches++;
+    }
+    LT_Check(mismatches == 0);
+    lt::bvh_destroy(&bvh);
+}
+
+// Values of the AVX2 tier can be a few ulps off.
+lt_internal bool
+nearly_equal(f32 a, f32 b)
+{
+    return std::fabs(a - b) <= 1e-5f * std::fmax(1.0f, std::fabs(b));
+}
+
+// A packet hits the lanes the scalar kernel hits, with about the same values.
+lt_internal void
+test_packet_kernels()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 33);
+    const CpuIsa saved = lt::cpu_isa();
+    const CpuIsa isas[] = {CpuIsa_Scalar, CpuIsa_SSE2, CpuIsa_AVX2, CpuIsa_AVX512};
+    u32 bad = 0, hits = 0;
+    for (u32 i = 0; i < 2000; i++)
+    {
+        AABB8 boxes;
+        Triangle8 tris;
+        for (i32 lane = 0; lane < 8; lane++)
+        {
+            const Vec3f c = random_point(&rng, 4.0f);
+            const Vec3f e = Vec3f(lt::rng_f32(&rng), lt::rng_f32(&rng), lt::rng_f32(&rng));
+            boxes.min_x[lane] = c.x - e.x; boxes.min_y[lane] = c.y - e.y; boxes.min_z[lane] = c.z - e.z;
+            boxes.max_x[lane] = c.x + e.x; boxes.max_y[lane] = c.y + e.y; boxes.max_z[lane] = c.z + e.z;
+            lt::triangle8_set(&tris, lane, c + random_point(&rng, 1.0f), c + random_point(&rng, 1.0f),
+                              c + random_point(&rng, 1.0f), (u32)lane);
+        }
+        const Vec3f origin = random_point(&rng, 6.0f);
+        Vec3f direction = random_point(&rng, 4.0f) - origin;
+        if (i % 4 == 0) direction.y = 0.0f;     // Zero direction components take the fix up path.
+        const Ray ray(origin, direction);
+        const Vec3f inv_dir = lt::ray_inverse_direction(ray);
+
+        alignas(32) f32 expected_near[8], expected_t[8], expected_u[8], expected_v[8];
+        lt::cpu_set_isa(CpuIsa_Scalar);
+        const u32 expected_box = lt::ray_aabb8(ray, inv_dir, boxes, expected_near);
+        const u32 expected_tri = lt::ray_triangle8(ray, tris, expected_t, expected_u, expected_v);
+        hits += expected_box != 0;
+        for (CpuIsa isa : isas)
+        {
+            // cpu_set_isa clamps to the detected tier, so the last ones may repeat.
+            lt::cpu_set_isa(isa);
+            alignas(32) f32 t_near[8], t[8], u[8], v[8];
+            const u32 box_mask = lt::ray_aabb8(ray, inv_dir, boxes, t_near);
+            const u32 tri_mask = lt::ray_triangle8(ray, tris, t, u, v);
+            if (box_mask != expected_box || tri_mask != expected_tri) bad++;
+            for (i32 lane = 0; lane < 8; lane++)
+            {
+                if ((box_mask >> lane & 1) && !nearly_equal(t_near[lane], expected_near[lane])) bad++;
+                if ((tri_mask >> lane & 1) &&
+                    (!nearly_equal(t[lane], expected_t[lane]) || !nearly_equal(u[lane], expected_u[lane]) ||
+                     !nearly_equal(v[lane], expected_v[lane])))
+                    bad++;
+            }
+        }
+    }
+    lt::cpu_set_isa(CpuIsa_Scalar);
+    LT_Check(strcmp(lt::geometry_kernel_name(), "scalar") == 0);
+    lt::cpu_set_isa(saved);
+    LT_Check(bad == 0);
+    LT_Check(hits > 0);
+}
+
+int
+main()
+{
+    test_random_soup();
+    test_degenerate();
+    test_slab_planes();
+    test_refit();
+    test_packet_kernels();
+    return lt_test_result("test_geometry");
+}
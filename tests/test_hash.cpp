@@ -0,0 +1,140 @@
+#include <cstdio>
+#include <vector>
+#include "lt_cpu.hpp"
+#include "lt_hash.hpp"
+#include "lt_random.hpp"
+#include "lt_test.hpp"
+
+// Known answers: CRC32C from RFC 3720, and for hash64/hash128, whose output is not the one of
+// the reference XXH3, the digests this implementation is committed to keep. Every CpuIsa tier
+// must give them, the streaming interface must agree with the one-shot functions, and the
+// hardware CRC32C with the table one.
+
+struct HashAnswer
+{
+    usize len;
+    u64   seed;
+    u64   hash64;      // Also the low half of hash128.
+    u64   hash128_high;
+};
+
+// Input byte i is (u8)(i * 31 + 7).
+lt_global_variable const HashAnswer g_hash_answers[] = {
+    {0, 0x0000000000000000ull, 0x3cdb1509ff974f7eull, 0x59b72d44ef524a23ull},
+    {0, 0x9e3779b97f4a7c15ull, 0xc3189ddfd585cb05ull, 0x295568025123f2feull},
+    {1, 0x0000000000000000ull, 0x6d287cbd3d164bb8ull, 0xa9b0d64462d9a895ull},
+    {1, 0x9e3779b97f4a7c15ull, 0xb370f2a177078251ull, 0xd113b91d3a063147ull},
+    {3, 0x0000000000000000ull, 0x6e911fe4bc983967ull, 0xda36cf558862d986ull},
+    {3, 0x9e3779b97f4a7c15ull, 0xc6230324bda45c21ull, 0x981035d861a77ee0ull},
+    {8, 0x0000000000000000ull, 0x2a5a87e88a9a2868ull, 0x007d0283548196a7ull},
+    {8, 0x9e3779b97f4a7c15ull, 0x4fd49f8f46218b3cull, 0x072b20cbfe2e40b5ull},
+    {16, 0x0000000000000000ull, 0x5d4a7e799fd1c47full, 0xfd131241032b138full},
+    {16, 0x9e3779b97f4a7c15ull, 0x5a75c75e4397629eull, 0x7b496a5d5fa2a5c0ull},
+    {17, 0x0000000000000000ull, 0x6415582812048933ull, 0xf180de731d9b5a63ull},
+    {17, 0x9e3779b97f4a7c15ull, 0x535cf68669ef0d2bull, 0xa1c21c0af2be9400ull},
+    {128, 0x0000000000000000ull, 0x8a88c64b98b71405ull, 0xc21e50402578142cull},
+    {128, 0x9e3779b97f4a7c15ull, 0xe81a7bd02780d1e1ull, 0xd23a4c849846b7a1ull},
+    {129, 0x0000000000000000ull, 0x933017a1f7635586ull, 0xa1b3fb7e06c58d2eull},
+    {129, 0x9e3779b97f4a7c15ull, 0xb011dc68bd997a5aull, 0xa7c844ecba0e9e0dull},
+    {240, 0x0000000000000000ull, 0xf4e736dbd0c15285ull, 0x44f621931996acb1ull},
+    {240, 0x9e3779b97f4a7c15ull, 0x3256d335516b1fa1ull, 0x1b56e5293cb64fbcull},
+    {241, 0x0000000000000000ull, 0x3aec150d2c1e0492ull, 0x6f13f446bd81a8a0ull},
+    {241, 0x9e3779b97f4a7c15ull, 0x8180b64fda1a5eeaull, 0xd496a4d31a6745b8ull},
+    {1000, 0x0000000000000000ull, 0x9a26ab0258384cd8ull, 0xfe72cefa1c58e9b5ull},
+    {1000, 0x9e3779b97f4a7c15ull, 0x4b951f420dbc6504ull, 0x3c249c86c9cbdcbfull},
+    {100000, 0x0000000000000000ull, 0x5212143e061b0c57ull, 0xce50630ca265da85ull},
+    {100000, 0x9e3779b97f4a7c15ull, 0x465ab5cb3b662770ull, 0x06227efc066189fcull},
+};
+
+lt_internal std::vector<u8>
+answer_input()
+{
+    std::vector<u8> data(100000);
+    for (usize i = 0; i < data.size(); i++) data[i] = (u8)(i * 31 + 7);
+    return data;
+}
+
+lt_internal void
+test_hash_answers()
+{
+    const std::vector<u8> data = answer_input();
+    const CpuIsa saved = lt::cpu_isa();
+    const CpuIsa isas[] = {CpuIsa_Scalar, CpuIsa_SSE2, CpuIsa_AVX2, CpuIsa_AVX512};
+    for (CpuIsa isa : isas)
+    {
+        // cpu_set_isa clamps to the detected tier, so the last ones may repeat.
+        lt::cpu_set_isa(isa);
+        u32 bad = 0;
+        for (const HashAnswer &a : g_hash_answers)
+        {
+            const lt::Hash128 h = lt::hash128(data.data(), a.len, a.seed);
+            if (lt::hash64(data.data(), a.len, a.seed) != a.hash64 || h.low != a.hash64 || h.high != a.hash128_high)
+                bad++;
+
+            // Streaming, in uneven pieces.
+            lt::HashState state;
+            lt::hash_init(&state, a.seed);
+            for (usize offset = 0, piece = 1; offset < a.len; offset += piece, piece = piece * 3 + 1)
+                lt::hash_update(&state, data.data() + offset, (piece < a.len - offset) ? piece : a.len - offset);
+            if (lt::hash_digest64(&state) != a.hash64 || lt::hash_digest128(&state) != h) bad++;
+        }
+        if (bad) fprintf(stderr, "hash kernel %s: %u wrong answers\n", lt::hash_kernel_name(), bad);
+        LT_Check(bad == 0);
+    }
+    lt::cpu_set_isa(saved);
+}
+
+lt_internal void
+test_crc32c()
+{
+    u8 zeros[32], ones[32], ascending[32], descending[32];
+    for (u32 i = 0; i < 32; i++)
+    {
+        zeros[i] = 0;
+        ones[i] = 0xff;
+        ascending[i] = (u8)i;
+        descending[i] = (u8)(31 - i);
+    }
+
+    const CpuIsa saved = lt::cpu_isa();
+    for (CpuIsa isa : {CpuIsa_Scalar, CpuIsa_SSE42})
+    {
+        lt::cpu_set_isa(isa);
+        LT_Check(lt::crc32c("123456789", 9) == 0xe3069283u);
+        LT_Check(lt::crc32c(zeros, 32) == 0x8a9136aau);
+        LT_Check(lt::crc32c(ones, 32) == 0x62a8ab43u);
+        LT_Check(lt::crc32c(ascending, 32) == 0x46dd794eu);
+        LT_Check(lt::crc32c(descending, 32) == 0x113fdb5cu);
+        LT_Check(lt::crc32c(nullptr, 0) == 0);
+    }
+
+    // Table and instruction agree on every length and alignment, and pieces chain.
+    Rng rng;
+    lt::rng_seed(&rng, 26);
+    std::vector<u8> data(5000);
+    for (u8 &b : data) b = (u8)lt::rng_next(&rng);
+    u32 bad = 0;
+    for (usize offset = 0; offset < 8; offset++)
+        for (usize len = 0; len + offset <= data.size(); len += 1 + len / 4)
+        {
+            lt::cpu_set_isa(CpuIsa_Scalar);
+            const u32 table = lt::crc32c(data.data() + offset, len);
+            lt::cpu_set_isa(saved);
+            const u32 fast = lt::crc32c(data.data() + offset, len);
+            const usize half = len / 3;
+            const u32 chained = lt::crc32c(data.data() + offset + half, len - half, lt::crc32c(data.data() + offset, half));
+            const u32 combined = lt::crc32c_combine(lt::crc32c(data.data() + offset, half),
+                                                    lt::crc32c(data.data() + offset + half, len - half), len - half);
+            if (table != fast || chained != fast || combined != fast) bad++;
+        }
+    lt::cpu_set_isa(saved);
+    LT_Check(bad == 0);
+}
+
+int
+main()
+{
+    test_hash_answers();
+    test_crc32c();
+    return lt_test_result("test_hash");
+}
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "lt_cpu.hpp"
+#include "lt_math.hpp"
+#include "lt_random.hpp"
+#include "lt_test.hpp"
+
+// The Mat4 product against a plain triple loop, and the batch kernels of the detected CpuIsa
+// tier against the scalar ones: bit for bit for the conversions, within a few ULP for the
+// model view (FMA).
+
+template<typename T> lt_internal Mat4<T>
+random_mat4(Rng *rng, f64 scale)
+{
+    Mat4<T> m;
+    for (i32 i = 0; i < 16; i++) m.data()[i] = (T)((lt::rng_f64(rng) * 2.0 - 1.0) * scale);
+    return m;
+}
+
+template<typename T> lt_internal void
+check_product(Rng *rng)
+{
+    for (u32 n = 0; n < 1000; n++)
+    {
+        const Mat4<T> a = random_mat4<T>(rng, 10.0), b = random_mat4<T>(rng, 10.0);
+        const Mat4<T> r = a * b;
+        bool same = true;
+        for (i32 row = 0; row < 4; row++)
+            for (i32 col = 0; col < 4; col++)
+            {
+                const T expected = a(row,0)*b(0,col) + a(row,1)*b(1,col) + a(row,2)*b(2,col) + a(row,3)*b(3,col);
+                same &= r(row, col) == expected;
+            }
+        LT_Check(same);
+    }
+}
+
+lt_internal void
+test_batch_kernels()
+{
+    const usize N = 1001;
+    Rng rng;
+    lt::rng_seed(&rng, 5);
+    std::vector<Mat4d> world(N);
+    std::vector<Mat4f> single(N);
+    for (usize i = 0; i < N; i++)
+    {
+        world[i] = random_mat4<f64>(&rng, 1e6);
+        single[i] = random_mat4<f32>(&rng, 1e3);
+    }
+    const Vec3<f64> camera(123456.789, -98765.4321, 5555.5);
+    const Mat4f view = random_mat4<f32>(&rng, 1.0);
+
+    std::vector<Mat4f> f_ref(N), f_out(N), mv_ref(N), mv_out(N);
+    std::vector<Mat4d> d_ref(N), d_out(N);
+    const CpuIsa saved = lt::cpu_isa();
+    lt::cpu_set_isa(CpuIsa_Scalar);
+    lt::to_mat4f(world.data(), f_ref.data(), N);
+    lt::to_mat4d(single.data(), d_ref.data(), N);
+    lt::camera_relative_model_view(world.data(), N, camera, view, mv_ref.data());
+
+    lt::cpu_set_isa(lt::cpu_detected_isa());
+    lt::to_mat4f(world.data(), f_out.data(), N);
+    lt::to_mat4d(single.data(), d_out.data(), N);
+    lt::camera_relative_model_view(world.data(), N, camera, view, mv_out.data());
+    lt::cpu_set_isa(saved);
+
+    LT_Check(memcmp(f_ref.data(), f_out.data(), N * sizeof(Mat4f)) == 0);
+    LT_Check(memcmp(d_ref.data(), d_out.data(), N * sizeof(Mat4d)) == 0);
+    // Error against the size of the terms, the sums cancel.
+    usize bad = 0;
+    for (usize i = 0; i < N; i++)
+    {
+        Mat4d relative = world[i];
+        relative(0,3) -= camera.x;
+        relative(1,3) -= camera.y;
+        relative(2,3) -= camera.z;
+        const Mat4f b = lt::to_mat4f(relative);
+        for (i32 row = 0; row < 4; row++)
+            for (i32 col = 0; col < 4; col++)
+            {
+                f32 magnitude = 0.0f;
+                for (i32 k = 0; k < 4; k++) magnitude += std::abs(view(row, k) * b(k, col));
+                if (std::abs(mv_out[i](row, col) - mv_ref[i](row, col)) > magnitude * 1e-6f) bad++;
+            }
+    }
+    LT_Check(bad == 0);
+}
+
+int
+main()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 4);
+    check_product<f32>(&rng);
+    check_product<f64>(&rng);
+    test_batch_kernels();
+    return lt_test_result("test_math");
+}
@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+#include "lt_mesh.hpp"
+#include "lt_test.hpp"
+
+// Loads the fixtures of tests/data, and binary PLY versions of quads.ply built in memory, and
+// compares every triangle corner with the expected one. Truncated PLY records and indices that
+// are not integers in range fail. The vertex cache option applies to every loader.
+
+typedef std::array<f32, 8> Corner;   // x y z nx ny nz u v
+
+// Corners of the triangles of quads.obj in file order, the quads split as fans.
+lt_global_variable const Corner g_obj_corners[] = {
+    {0, 0, 0,  0, 0, 1,  0, 0}, {1, 0, 0,  0, 0, 1,  0.5f, 0}, {1, 1, 0,  0, 0, 1,  0.5f, 1},
+    {0, 0, 0,  0, 0, 1,  0, 0}, {1, 1, 0,  0, 0, 1,  0.5f, 1}, {0, 1, 0,  0, 0, 1,  0, 1},
+    {1, 0, 0,  0, 0, 1,  0.5f, 0}, {2, 0, 0,  0, 0, 1,  1, 0}, {2, 1, 0,  0, 0, 1,  1, 1},
+    {1, 0, 0,  0, 0, 1,  0.5f, 0}, {2, 1, 0,  0, 0, 1,  1, 1}, {1, 1, 0,  0, 0, 1,  0.5f, 1},
+    {2, 0, 0,  0, 0, 1,  0.5f, 1}, {0, 1, 0,  0, 0, 1,  1, 1}, {0.5f, 2, 0.25f,  0, 0, 1,  0.25f, 1.5f},
+};
+
+lt_internal Corner
+mesh_corner(const Mesh &mesh, u32 i)
+{
+    const u32 v = mesh.indices[i];
+    Corner c = {mesh.x[v], mesh.y[v], mesh.z[v], 0, 0, 0, 0, 0};
+    if (mesh.nx)
+    {
+        c[3] = mesh.nx[v];
+        c[4] = mesh.ny[v];
+        c[5] = mesh.nz[v];
+    }
+    if (mesh.u)
+    {
+        c[6] = mesh.u[v];
+        c[7] = mesh.v[v];
+    }
+    return c;
+}
+
+lt_internal bool
+streams_aligned(const Mesh &mesh)
+{
+    const uintptr_t bits = (uintptr_t)mesh.x | (uintptr_t)mesh.y | (uintptr_t)mesh.z |
+        (uintptr_t)mesh.nx | (uintptr_t)mesh.u | (uintptr_t)mesh.indices;
+    return (bits & (LT_MESH_ALIGNMENT - 1)) == 0;
+}
+
+// The triangles as sets of corners: every triangle rotated to start at its smallest corner,
+// then sorted. Two meshes with the same triangles in another order (or with another vertex
+// numbering) give the same list.
+lt_internal std::vector<std::array<Corner, 3>>
+triangle_set(const Mesh &mesh)
+{
+    std::vector<std::array<Corner, 3>> triangles;
+    for (u32 i = 0; i + 2 < mesh.num_indices; i += 3)
+    {
+        std::array<Corner, 3> t = {mesh_corner(mesh, i), mesh_corner(mesh, i + 1), mesh_corner(mesh, i + 2)};
+        while (t[0] > t[1] || t[0] > t[2]) std::rotate(t.begin(), t.begin() + 1, t.end());
+        triangles.push_back(t);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+lt_internal void
+test_obj()
+{
+    Mesh mesh;
+    LT_Require(lt::mesh_load(&mesh, LT_TEST_DATA_DIR "/quads.obj"));
+    LT_Check(mesh.error == MeshError_None);
+    LT_Check(streams_aligned(mesh));
+    LT_Require(mesh.num_indices == LT_Count(g_obj_corners));
+    LT_Check(mesh.num_vertices == 9);   // 6 quad corners and the 3 of the triangle.
+    for (u32 i = 0; i < mesh.num_indices; i++) LT_Check(mesh_corner(mesh, i) == g_obj_corners[i]);
+
+    // The vertex cache order keeps the same triangles.
+    Mesh optimized;
+    MeshLoadOptions options;
+    options.optimize_vertex_cache = true;
+    LT_Require(lt::mesh_load(&optimized, LT_TEST_DATA_DIR "/quads.obj", options));
+    LT_Check(triangle_set(optimized) == triangle_set(mesh));
+    lt::mesh_destroy(&optimized);
+
+    // Skipped streams are null.
+    Mesh positions;
+    options = MeshLoadOptions();
+    options.normals = false;
+    options.uvs = false;
+    const char text[] = "v 0 0 0\nv 1 0 0\nv .5 1. 0\nvn 0 0 1\nf -3//1 -2//1 -1//1";
+    LT_Require(lt::mesh_load_obj(&positions, text, sizeof(text) - 1, options));
+    LT_Check(!positions.nx && !positions.u);
+    LT_Check(positions.num_vertices == 3 && positions.num_indices == 3 && positions.x[2] == 0.5f);
+    lt::mesh_destroy(&positions);
+    lt::mesh_destroy(&mesh);
+}
+
+lt_internal void
+test_obj_errors()
+{
+    Mesh mesh;
+    const char out_of_range[] = "v 0 0 0\nv 1 0 0\nf 1 2 3\n";
+    LT_Check(!lt::mesh_load_obj(&mesh, out_of_range, sizeof(out_of_range) - 1));
+    LT_Check(mesh.error == MeshError_Index);
+    const char bad_float[] = "v 0 0 x\n";
+    LT_Check(!lt::mesh_load_obj(&mesh, bad_float, sizeof(bad_float) - 1));
+    LT_Check(mesh.error == MeshError_Format);
+    LT_Check(!lt::mesh_load(&mesh, LT_TEST_DATA_DIR "/missing.obj"));
+    LT_Check(mesh.error == MeshError_Open);
+}
+
+lt_internal void
+put_f32(std::string *out, f32 x, bool big_endian)
+{
+    u8 bytes[4];
+    memcpy(bytes, &x, 4);
+    if (big_endian) std::reverse(bytes, bytes + 4);
+    out->append((const char*)bytes, 4);
+}
+
+lt_internal void
+put_i32(std::string *out, i32 x, bool big_endian)
+{
+    u8 bytes[4];
+    memcpy(bytes, &x, 4);
+    if (big_endian) std::reverse(bytes, bytes + 4);
+    out->append((const char*)bytes, 4);
+}
+
+// quads.ply in binary, with an extra property between the vertex attributes.
+lt_internal std::string
+binary_ply(bool big_endian)
+{
+    const f32 vertices[6][8] = {
+        {0, 0, 0, 0, 0, 1, 0, 0}, {1, 0, 0, 0, 0, 1, 0.5f, 0}, {2, 0, 0, 0, 0, 1, 1, 0},
+        {0, 1, 0, 0, 0, 1, 0, 1}, {1, 1, 0, 0, 0, 1, 0.5f, 1}, {2, 1, 0, 0, 0, 1, 1, 1},
+    };
+    const i32 faces[2][4] = {{0, 1, 4, 3}, {1, 2, 5, 4}};
+
+    std::string ply = "ply\nformat ";
+    ply += big_endian ? "binary_big_endian" : "binary_little_endian";
+    ply += " 1.0\nelement vertex 6\nproperty float x\nproperty float y\nproperty float z\n"
+        "property uchar quality\nproperty float nx\nproperty float ny\nproperty float nz\n"
+        "property float u\nproperty float v\nelement face 2\nproperty list uchar int vertex_indices\n"
+        "end_header\n";
+    for (const auto &v : vertices)
+    {
+        for (u32 i = 0; i < 3; i++) put_f32(&ply, v[i], big_endian);
+        ply += (char)7;
+        for (u32 i = 3; i < 8; i++) put_f32(&ply, v[i], big_endian);
+    }
+    for (const auto &f : faces)
+    {
+        ply += (char)4;
+        for (i32 index : f) put_i32(&ply, index, big_endian);
+    }
+    return ply;
+}
+
+lt_internal void
+test_ply()
+{
+    Mesh ascii;
+    LT_Require(lt::mesh_load(&ascii, LT_TEST_DATA_DIR "/quads.ply"));
+    LT_Check(streams_aligned(ascii));
+    LT_Check(ascii.num_vertices == 6);
+    LT_Require(ascii.num_indices == 12);
+    // PLY is not welded and keeps the file's vertex order, the fans give the OBJ quads.
+    for (u32 i = 0; i < 12; i++) LT_Check(mesh_corner(ascii, i) == g_obj_corners[i]);
+
+    for (bool big_endian : {false, true})
+    {
+        const std::string data = binary_ply(big_endian);
+        Mesh binary;
+        LT_Require(lt::mesh_load_ply(&binary, data.data(), data.size()));
+        LT_Check(binary.num_vertices == 6 && binary.num_indices == 12);
+        LT_Check(streams_aligned(binary));
+        LT_Check(triangle_set(binary) == triangle_set(ascii));
+        LT_Check(memcmp(binary.indices, ascii.indices, 12 * sizeof(u32)) == 0);
+        lt::mesh_destroy(&binary);
+    }
+
+    // Truncated data.
+    const std::string data = binary_ply(false);
+    Mesh truncated;
+    LT_Check(!lt::mesh_load_ply(&truncated, data.data(), data.size() - 3));
+    LT_Check(truncated.error == MeshError_Format);
+    lt::mesh_destroy(&ascii);
+}
+
+lt_internal std::string
+ply_vertices(const char *format, const char *face_properties)
+{
+    std::string ply = "ply\nformat ";
+    ply += format;
+    ply += " 1.0\nelement vertex 3\nproperty float x\nproperty float y\nproperty float z\nelement face 2\n";
+    ply += face_properties;
+    ply += "end_header\n";
+    return ply;
+}
+
+// Records that end inside the data, counts and indices that are not integers in range.
+lt_internal void
+test_ply_errors()
+{
+    // The face records have a fixed part before the list, the second face is missing.
+    std::string ply = ply_vertices("binary_little_endian", "property uchar flags\nproperty list uchar int vertex_indices\n");
+    for (u32 i = 0; i < 9; i++) put_f32(&ply, (f32)(i % 2), false);
+    ply += (char)1;
+    ply += (char)3;
+    for (i32 index : {0, 1, 2}) put_i32(&ply, index, false);
+    Mesh mesh;
+    for (usize cut : {0, 1, 2, 5})
+    {
+        // A copy of the exact size, so that reads past the end touch another allocation.
+        const std::vector<char> data(ply.begin(), ply.end() - cut);
+        LT_Check(!lt::mesh_load_ply(&mesh, data.data(), data.size()));
+        LT_Check(mesh.error == MeshError_Format);
+    }
+    ply += (char)1;
+    LT_Check(!lt::mesh_load_ply(&mesh, ply.data(), ply.size()));
+    LT_Check(mesh.error == MeshError_Format);
+    ply += (char)3;
+    for (i32 index : {2, 1, 0}) put_i32(&ply, index, false);
+    LT_Check(lt::mesh_load_ply(&mesh, ply.data(), ply.size()));
+    LT_Check(mesh.num_vertices == 3 && mesh.num_indices == 6);
+    lt::mesh_destroy(&mesh);
+
+    // Float indices, on the triangle fast path and on the fan path.
+    const f32 nan = std::numeric_limits<f32>::quiet_NaN();
+    for (bool quads : {false, true})
+        for (f32 bad : {nan, 1.5f, -0.5f, 3.0f})
+        {
+            ply = ply_vertices("binary_little_endian", "property list uchar float vertex_indices\n");
+            for (u32 i = 0; i < 9; i++) put_f32(&ply, (f32)(i % 2), false);
+            for (u32 f = 0; f < 2; f++)
+            {
+                ply += (char)(quads ? 4 : 3);
+                for (f32 index : {0.0f, 1.0f, 2.0f}) put_f32(&ply, index, false);
+                if (quads) put_f32(&ply, (f == 1) ? bad : 2.0f, false);
+                else if (f == 1) ply.replace(ply.size() - 4, 4, std::string((const char*)&bad, 4));
+            }
+            LT_Check(!lt::mesh_load_ply(&mesh, ply.data(), ply.size()));
+            LT_Check(mesh.error == MeshError_Index);
+        }
+
+    // ASCII list counts and indices.
+    const char *faces[][2] = {
+        {"3 0 1 2\n", "3 0 1 nan\n"}, {"3 0 1 2\n", "3 0 1 1.5\n"}, {"3 0 1 2\n", "3 0 1 -1\n"},
+        {"nan 0 1 2\n", "3 0 1 2\n"}, {"2.5 0 1 2\n", "3 0 1 2\n"}, {"1e300 0 1 2\n", "3 0 1 2\n"},
+    };
+    for (usize i = 0; i < LT_Count(faces); i++)
+    {
+        ply = ply_vertices("ascii", "property list uchar int vertex_indices\n");
+        ply += "0 0 0\n1 0 0\n0 1 0\n";
+        ply += faces[i][0];
+        ply += faces[i][1];
+        LT_Check(!lt::mesh_load_ply(&mesh, ply.data(), ply.size()));
+        LT_Check(mesh.error == ((i < 3) ? MeshError_Index : MeshError_Format));
+    }
+}
+
+// A grid of quads wider than the vertex cache, in row order, as OBJ and ASCII PLY text.
+lt_internal void
+grid_text(u32 side, std::string *obj, std::string *ply)
+{
+    const u32 num_vertices = (side + 1) * (side + 1);
+    char line[64];
+    snprintf(line, sizeof(line), "element vertex %u\n", num_vertices);
+    *ply = "ply\nformat ascii 1.0\n";
+    *ply += line;
+    *ply += "property float x\nproperty float y\nproperty float z\n";
+    snprintf(line, sizeof(line), "element face %u\n", side * side);
+    *ply += line;
+    *ply += "property list uchar int vertex_indices\nend_header\n";
+    obj->clear();
+    for (u32 y = 0; y <= side; y++)
+        for (u32 x = 0; x <= side; x++)
+        {
+            snprintf(line, sizeof(line), "%u %u 0\n", x, y);
+            *obj += "v ";
+            *obj += line;
+            *ply += line;
+        }
+    for (u32 y = 0; y < side; y++)
+        for (u32 x = 0; x < side; x++)
+        {
+            const u32 i = y * (side + 1) + x;
+            const u32 quad[4] = {i, i + 1, i + side + 2, i + side + 1};
+            snprintf(line, sizeof(line), "f %u %u %u %u\n", quad[0] + 1, quad[1] + 1, quad[2] + 1, quad[3] + 1);
+            *obj += line;
+            snprintf(line, sizeof(line), "4 %u %u %u %u\n", quad[0], quad[1], quad[2], quad[3]);
+            *ply += line;
+        }
+}
+
+lt_internal void
+test_optimize_option()
+{
+    std::string obj, ply;
+    grid_text(64, &obj, &ply);
+    MeshLoadOptions options;
+    for (bool is_ply : {false, true})
+    {
+        Mesh plain, optimized;
+        options.optimize_vertex_cache = false;
+        LT_Require(is_ply ? lt::mesh_load_ply(&plain, ply.data(), ply.size(), options)
+                          : lt::mesh_load_obj(&plain, obj.data(), obj.size(), options));
+        options.optimize_vertex_cache = true;
+        LT_Require(is_ply ? lt::mesh_load_ply(&optimized, ply.data(), ply.size(), options)
+                          : lt::mesh_load_obj(&optimized, obj.data(), obj.size(), options));
+
+        LT_Check(triangle_set(optimized) == triangle_set(plain));
+        const f32 before = lt::vertex_cache_acmr(plain.indices, plain.num_indices, plain.num_vertices);
+        const f32 after = lt::vertex_cache_acmr(optimized.indices, optimized.num_indices, optimized.num_vertices);
+        LT_Check(after < before * 0.9f);
+        lt::mesh_destroy(&plain);
+        lt::mesh_destroy(&optimized);
+    }
+}
+
+int
+main()
+{
+    test_obj();
+    test_obj_errors();
+    test_ply();
+    test_ply_errors();
+    test_optimize_option();
+    return lt_test_result("test_mesh");
+}
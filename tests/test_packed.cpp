@@ -0,0 +1,247 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "lt_cpu.hpp"
+#include "lt_packed.hpp"
+#include "lt_random.hpp"
+#include "lt_test.hpp"
+
+// The precision documented in lt_packed.hpp, measured over random inputs. The batch versions
+// give the bits of the single value ones, and the half kernels of every tier agree.
+
+#define TEST_SAMPLES 200000
+
+lt_internal f64
+random_signed(Rng *rng)
+{
+    return lt::rng_f64(rng) * 2.0 - 1.0;
+}
+
+lt_internal Vec3f
+random_unit_vec3(Rng *rng)
+{
+    for (;;)
+    {
+        const f64 x = random_signed(rng), y = random_signed(rng), z = random_signed(rng);
+        const f64 len = std::sqrt(x*x + y*y + z*z);
+        if (len > 0.1 && len <= 1.0) return Vec3f((f32)(x / len), (f32)(y / len), (f32)(z / len));
+    }
+}
+
+lt_internal Quatf
+random_unit_quat(Rng *rng)
+{
+    for (;;)
+    {
+        const f64 w = random_signed(rng), x = random_signed(rng), y = random_signed(rng), z = random_signed(rng);
+        const f64 len = std::sqrt(w*w + x*x + y*y + z*z);
+        if (len > 0.1 && len <= 1.0) return Quatf((f32)(w / len), (f32)(x / len), (f32)(y / len), (f32)(z / len));
+    }
+}
+
+lt_internal bool
+same_bits(f32 a, f32 b)
+{
+    return memcmp(&a, &b, sizeof(f32)) == 0;
+}
+
+// Angle between two vectors, 2 atan2(|a - b|, |a + b|) once normalized, which unlike acos of
+// the dot product stays accurate for tiny angles.
+template<usize N> lt_internal f64
+angle_degrees(const f32 *a, const f32 *b)
+{
+    f64 len_a = 0.0, len_b = 0.0;
+    for (usize i = 0; i < N; i++)
+    {
+        len_a += (f64)a[i] * a[i];
+        len_b += (f64)b[i] * b[i];
+    }
+    len_a = std::sqrt(len_a);
+    len_b = std::sqrt(len_b);
+    f64 diff = 0.0, sum = 0.0;
+    for (usize i = 0; i < N; i++)
+    {
+        const f64 x = a[i] / len_a, y = b[i] / len_b;
+        diff += (x - y) * (x - y);
+        sum += (x + y) * (x + y);
+    }
+    return 2.0 * std::atan2(std::sqrt(diff), std::sqrt(sum)) * (180.0 / LT_PI);
+}
+
+// Largest component and angular error of `packed` over random unit quaternions, and whether
+// the batch versions agree bit for bit with the single value ones.
+template<typename P> lt_internal void
+check_quat(P (*pack)(const Quatf &), Quatf (*unpack)(P), void (*pack_batch)(const Quatf *, P *, usize),
+           void (*unpack_batch)(const P *, Quatf *, usize), f64 max_component, f64 max_degrees)
+{
+    Rng rng;
+    lt::rng_seed(&rng, 41);
+    std::vector<Quatf> in(TEST_SAMPLES), out(TEST_SAMPLES);
+    std::vector<P> packed(TEST_SAMPLES);
+    for (Quatf &q : in) q = random_unit_quat(&rng);
+    pack_batch(in.data(), packed.data(), in.size());
+    unpack_batch(packed.data(), out.data(), in.size());
+
+    f64 component = 0.0, degrees = 0.0;
+    u32 mismatches = 0;
+    for (usize i = 0; i < in.size(); i++)
+    {
+        const P single = pack(in[i]);
+        const Quatf q = unpack(single);
+        if (memcmp(&single, &packed[i], sizeof(P)) != 0 || memcmp(&q, &out[i], sizeof(Quatf)) != 0) mismatches++;
+
+        // q and -q are the same rotation.
+        f64 dot = 0.0;
+        for (i32 j = 0; j < 4; j++) dot += (f64)in[i].val[j] * q.val[j];
+        const f32 sign = (dot < 0) ? -1.0f : 1.0f;
+        const Quatf same(sign * q.val[0], sign * q.val[1], sign * q.val[2], sign * q.val[3]);
+        for (i32 j = 0; j < 4; j++) component = std::fmax(component, std::fabs((f64)same.val[j] - in[i].val[j]));
+        // The rotation angle is twice the angle between the quaternions.
+        degrees = std::fmax(degrees, 2.0 * angle_degrees<4>(same.val, in[i].val));
+    }
+    printf("component error %.3g, angular error %.3g degrees\n", component, degrees);
+    LT_Check(mismatches == 0);
+    LT_Check(component <= max_component);
+    LT_Check(degrees <= max_degrees);
+}
+
+lt_internal void
+test_quat()
+{
+    check_quat<Quat32>(lt::pack_quat32, lt::unpack_quat32, lt::pack_quat32, lt::unpack_quat32, 2.1e-3, 0.28);
+    check_quat<Quat48>(lt::pack_quat48, lt::unpack_quat48, lt::pack_quat48, lt::unpack_quat48, 6.5e-5, 0.0086);
+}
+
+lt_internal void
+test_snorm16()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 42);
+    std::vector<Vec3f> in(TEST_SAMPLES), out(TEST_SAMPLES);
+    std::vector<Snorm16x3> packed(TEST_SAMPLES);
+    for (Vec3f &v : in) v = Vec3f((f32)random_signed(&rng), (f32)random_signed(&rng), (f32)random_signed(&rng));
+    in[0] = Vec3f(-1.0f, 1.0f, 0.0f);
+    in[1] = Vec3f(-2.0f, 3.0f, -0.0f);
+    lt::pack_snorm16(in.data(), packed.data(), in.size());
+    lt::unpack_snorm16(packed.data(), out.data(), in.size());
+
+    f64 error = 0.0;
+    u32 mismatches = 0;
+    for (usize i = 0; i < in.size(); i++)
+    {
+        const Snorm16x3 single = lt::pack_snorm16(in[i]);
+        const Vec3f v = lt::unpack_snorm16(single);
+        if (memcmp(&single, &packed[i], sizeof(single)) != 0 || memcmp(&v, &out[i], sizeof(v)) != 0) mismatches++;
+        if (i < 2) continue;
+        for (i32 j = 0; j < 3; j++) error = std::fmax(error, std::fabs((f64)v.val[j] - in[i].val[j]));
+    }
+    printf("snorm16 error %.4g\n", error);
+    LT_Check(mismatches == 0);
+    LT_Check(error <= 1.54e-5);
+    LT_Check(out[0].x == -1.0f && out[0].y == 1.0f && out[0].z == 0.0f);
+    LT_Check(out[1].x == -1.0f && out[1].y == 1.0f);
+
+    // NaN packs to 0 in both versions, also inside a full SIMD block.
+    const f32 nan = std::numeric_limits<f32>::quiet_NaN();
+    Vec3f nans[4];
+    for (Vec3f &v : nans) v = Vec3f(nan, 0.5f, -nan);
+    Snorm16x3 nan_packed[4];
+    lt::pack_snorm16(nans, nan_packed, 4);
+    const Snorm16x3 nan_single = lt::pack_snorm16(nans[0]);
+    LT_Check(nan_single.x == 0 && nan_single.z == 0);
+    for (const Snorm16x3 &q : nan_packed) LT_Check(q.x == 0 && q.y == nan_single.y && q.z == 0);
+}
+
+lt_internal void
+test_octahedral()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 43);
+    std::vector<Vec3f> in(TEST_SAMPLES), out(TEST_SAMPLES);
+    std::vector<Octahedral32> packed(TEST_SAMPLES);
+    for (Vec3f &v : in) v = random_unit_vec3(&rng);
+    lt::pack_octahedral(in.data(), packed.data(), in.size());
+    lt::unpack_octahedral(packed.data(), out.data(), in.size());
+
+    f64 degrees = 0.0;
+    u32 mismatches = 0;
+    for (usize i = 0; i < in.size(); i++)
+    {
+        const Octahedral32 single = lt::pack_octahedral(in[i]);
+        const Vec3f v = lt::unpack_octahedral(single);
+        if (memcmp(&single, &packed[i], sizeof(single)) != 0 || memcmp(&v, &out[i], sizeof(v)) != 0) mismatches++;
+        degrees = std::fmax(degrees, angle_degrees<3>(v.val, in[i].val));
+    }
+    printf("octahedral error %.3g degrees\n", degrees);
+    LT_Check(mismatches == 0);
+    LT_Check(degrees <= 0.004);
+}
+
+lt_internal void
+test_half()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 44);
+    std::vector<f32> in(TEST_SAMPLES);
+    for (usize i = 0; i < in.size(); i++)
+    {
+        // Random bit patterns cover NaN, inf and the subnormals, the rest the normal range.
+        u32 bits = (u32)lt::rng_next(&rng);
+        if (i % 2) bits = (bits & 0x80000000u) | (((bits >> 23) % 30 + 113) << 23) | (bits & 0x7fffffu);
+        memcpy(&in[i], &bits, sizeof(bits));
+    }
+
+    const CpuIsa saved = lt::cpu_isa();
+    const CpuIsa isas[] = {CpuIsa_Scalar, CpuIsa_SSE2, CpuIsa_AVX2, CpuIsa_AVX512};
+    std::vector<u16> expected(in.size()), halves(in.size());
+    std::vector<f32> expected_back(65536), back(65536);
+    std::vector<u16> all(65536);
+    for (u32 h = 0; h < 65536; h++) all[h] = (u16)h;
+    lt::cpu_set_isa(CpuIsa_Scalar);
+    LT_Check(strcmp(lt::half_kernel_name(), "scalar") == 0);
+    lt::f32_to_f16(in.data(), expected.data(), in.size());
+    lt::f16_to_f32(all.data(), expected_back.data(), all.size());
+
+    u32 bad = 0;
+    for (CpuIsa isa : isas)
+    {
+        // cpu_set_isa clamps to the detected tier, so the last ones may repeat.
+        lt::cpu_set_isa(isa);
+        lt::f32_to_f16(in.data(), halves.data(), in.size());
+        lt::f16_to_f32(all.data(), back.data(), all.size());
+        if (halves != expected || memcmp(back.data(), expected_back.data(), back.size() * sizeof(f32)) != 0) bad++;
+        for (usize i = 0; i < 1000; i++)
+            if (lt::f32_to_f16(in[i]) != expected[i] || !same_bits(lt::f16_to_f32(all[i * 65]), expected_back[i * 65])) bad++;
+        if (bad) fprintf(stderr, "half kernel %s differs from the scalar one\n", lt::half_kernel_name());
+    }
+    lt::cpu_set_isa(saved);
+    LT_Check(bad == 0);
+
+    // Every half comes back to itself, NaN aside.
+    u32 round_trip = 0;
+    for (u32 h = 0; h < 65536; h++)
+        if ((h & 0x7c00) != 0x7c00 || (h & 0x3ff) == 0) round_trip += lt::f32_to_f16(expected_back[h]) != h;
+    LT_Check(round_trip == 0);
+
+    f64 relative = 0.0, absolute = 0.0;
+    for (usize i = 0; i < in.size(); i++)
+    {
+        const f64 x = in[i], y = lt::f16_to_f32(expected[i]);
+        if (std::fabs(x) > 65504.0 || x != x) continue;
+        if (std::fabs(x) >= 0x1.0p-14) relative = std::fmax(relative, std::fabs(y - x) / std::fabs(x));
+        else absolute = std::fmax(absolute, std::fabs(y - x));
+    }
+    printf("half relative error %.3g, absolute error below 2^-14 %.3g\n", relative, absolute);
+    LT_Check(relative <= 0x1.0p-11);
+    LT_Check(absolute <= 0x1.0p-25);
+}
+
+int
+main()
+{
+    test_quat();
+    test_snorm16();
+    test_octahedral();
+    test_half();
+    return lt_test_result("test_packed");
+}
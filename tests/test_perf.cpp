@@ -0,0 +1,85 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lt_perf.hpp"
+#include "lt_test.hpp"
+
+// Scopes from several threads end up in the region totals once, whether the threads exited
+// (merged into the region) or still run (summed by perf_report). Counters are often not
+// permitted in test environments, the checks hold either way.
+
+lt_global_variable PerfRegion g_region("test_perf_region");
+
+lt_internal std::string
+report()
+{
+    char *buffer = nullptr;
+    size_t size = 0;
+    FILE *out = open_memstream(&buffer, &size);
+    lt::perf_report(out);
+    fclose(out);
+    std::string text(buffer, size);
+    free(buffer);
+    return text;
+}
+
+lt_internal void
+test_totals()
+{
+    const u32 num_threads = 4, scopes = 10000;
+    std::vector<std::thread> threads;
+    for (u32 t = 0; t < num_threads; t++)
+        threads.emplace_back([]() {
+            for (u32 i = 0; i < scopes; i++) lt::PerfScope scope(&g_region, 3);
+        });
+    for (std::thread &t : threads) t.join();
+
+    // The exited threads are in the shared totals.
+    const u64 calls = g_region.totals.calls.load();
+    LT_Check(calls == (u64)num_threads * scopes);
+    LT_Check(g_region.totals.elements.load() == 3 * calls);
+    if (lt::perf_available())
+    {
+        // Every scope either counted or failed.
+        LT_Check(g_region.totals.counted_elements.load() + 3 * g_region.totals.failed.load() == 3 * calls);
+    }
+
+    // The main thread's scopes are only in its own totals until perf_report sums them.
+    for (u32 i = 0; i < 100; i++) lt::PerfScope scope(&g_region, 3);
+    LT_Check(g_region.totals.calls.load() == calls);
+    const std::string text = report();
+    const size_t line = text.find("test_perf_region");
+    LT_Require(line != std::string::npos);
+    LT_Check(text.find(" 40100 ", line) != std::string::npos);
+
+    lt::perf_reset();
+    LT_Check(g_region.totals.calls.load() == 0);
+    LT_Check(report().find("test_perf_region") == std::string::npos);
+}
+
+lt_internal void
+test_read()
+{
+    PerfSample a, b;
+    const bool read = lt::perf_read(&a);
+    LT_Check(read == (lt::perf_available() != 0));
+    volatile u64 sink = 0;
+    for (u32 i = 0; i < 100000; i++) sink = sink + i;
+    if (lt::perf_read(&b))
+    {
+        LT_Check(b.ticks >= a.ticks);
+        for (i32 c = 0; c < PerfCounter_Count; c++)
+            if (a.valid & b.valid & (1u << c)) LT_Check(b.values[c] >= a.values[c]);
+    }
+}
+
+int
+main()
+{
+    test_totals();
+    test_read();
+    return lt_test_result("test_perf");
+}
@@ -0,0 +1,63 @@
+#include <thread>
+#include <vector>
+#include "lt_queue.hpp"
+#include "lt_test.hpp"
+
+// Blocking push and pop through tiny queues, so that both sides sleep all the time. A lost
+// wake up hangs the test (ctest times it out), a lost or duplicated item breaks the sums.
+
+template<typename Q> lt_internal void
+check_queue(Q *queue, u32 producers, u32 consumers, u64 count)
+{
+    std::vector<std::thread> threads;
+    std::vector<u64> sums(consumers, 0), counts(consumers, 0);
+    for (u32 c = 0; c < consumers; c++)
+        threads.emplace_back([=, &sums, &counts]() {
+            u64 item;
+            for (;;)
+            {
+                queue->pop(&item);
+                if (!item) break;
+                sums[c] += item;
+                counts[c]++;
+            }
+        });
+    std::vector<std::thread> pushers;
+    for (u32 p = 0; p < producers; p++)
+        pushers.emplace_back([=]() {
+            for (u64 i = p + 1; i <= count; i += producers) queue->push(i);
+        });
+    for (std::thread &t : pushers) t.join();
+    for (u32 c = 0; c < consumers; c++) queue->push((u64)0);
+    for (std::thread &t : threads) t.join();
+
+    u64 sum = 0, n = 0;
+    for (u32 c = 0; c < consumers; c++)
+    {
+        sum += sums[c];
+        n += counts[c];
+    }
+    LT_Check(n == count);
+    LT_Check(sum == count * (count + 1) / 2);
+}
+
+int
+main()
+{
+    const u64 count = 200000;
+    {
+        lt::SpscQueue<u64> queue(2);
+        check_queue(&queue, 1, 1, count);
+    }
+    {
+        lt::MpmcQueue<u64> queue(2);
+        check_queue(&queue, 1, 1, count);
+        check_queue(&queue, 4, 4, count);
+        check_queue(&queue, 1, 4, count);
+    }
+    {
+        lt::MpscQueue<u64> queue;
+        check_queue(&queue, 4, 1, count);
+    }
+    return lt_test_result("test_queue");
+}
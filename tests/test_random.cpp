@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "lt_cpu.hpp"
+#include "lt_random.hpp"
+#include "lt_test.hpp"
+
+// The batch fills must give the same numbers on every CpuIsa tier the machine supports, and
+// lane i of a batch is the scalar generator after i jumps. The cached kernel follows
+// cpu_set_isa.
+
+lt_internal void
+test_isa_parity()
+{
+    const usize N = 100003;
+    std::vector<u64> ref_u64(N), out_u64(N);
+    std::vector<f32> ref_f32(N), out_f32(N);
+    const CpuIsa saved = lt::cpu_isa();
+    const char *saved_kernel = lt::rng_kernel_name();
+    const CpuIsa isas[] = {CpuIsa_Scalar, CpuIsa_SSE2, CpuIsa_AVX2, CpuIsa_AVX512};
+    for (usize t = 0; t < LT_Count(isas); t++)
+    {
+        // cpu_set_isa clamps to the detected tier, so the last ones may repeat.
+        lt::cpu_set_isa(isas[t]);
+        RngBatch batch;
+        lt::rng_batch_seed(&batch, 99, 3);
+        lt::rng_fill_u64(&batch, out_u64.data(), N);
+        lt::rng_fill_f32(&batch, out_f32.data(), N, -2.0f, 5.0f);
+        lt::rng_fill_f32(&batch, out_f32.data() + 100, 500);
+        if (t == 0)
+        {
+            LT_Check(strcmp(lt::rng_kernel_name(), "scalar") == 0);
+            ref_u64 = out_u64;
+            ref_f32 = out_f32;
+            continue;
+        }
+        if (out_u64 != ref_u64 || memcmp(out_f32.data(), ref_f32.data(), N * sizeof(f32)) != 0)
+            fprintf(stderr, "rng kernel %s differs from the scalar one\n", lt::rng_kernel_name());
+        LT_Check(out_u64 == ref_u64);
+        LT_Check(memcmp(out_f32.data(), ref_f32.data(), N * sizeof(f32)) == 0);
+    }
+    lt::cpu_set_isa(saved);
+    LT_Check(strcmp(lt::rng_kernel_name(), saved_kernel) == 0);
+}
+
+lt_internal void
+test_lanes()
+{
+    RngBatch batch;
+    lt::rng_batch_seed(&batch, 7);
+    std::vector<u64> out(100 * LT_RNG_LANES);
+    lt::rng_fill_u64(&batch, out.data(), out.size());
+    for (u32 lane = 0; lane < LT_RNG_LANES; lane++)
+    {
+        Rng rng;
+        lt::rng_seed(&rng, 7);
+        for (u32 j = 0; j < lane; j++) lt::rng_jump(&rng);
+        bool same = true;
+        for (u32 i = 0; i < 100; i++) same &= out[i * LT_RNG_LANES + lane] == lt::rng_next(&rng);
+        LT_Check(same);
+    }
+}
+
+lt_internal void
+test_samplers()
+{
+    RngBatch batch;
+    lt::rng_batch_seed(&batch, 1);
+    const usize N = 100000;
+    std::vector<f32> x(N), y(N), z(N), w(N);
+
+    lt::sample_unit_sphere(&batch, x.data(), y.data(), z.data(), N);
+    f64 max_error = 0.0;
+    for (usize i = 0; i < N; i++)
+        max_error = std::max(max_error, std::abs(std::sqrt((f64)x[i] * x[i] + (f64)y[i] * y[i] + (f64)z[i] * z[i]) - 1.0));
+    LT_Check(max_error < 1e-5);
+
+    const Vec3f normal(0.0f, 0.6f, 0.8f);
+    lt::sample_hemisphere(&batch, normal, x.data(), y.data(), z.data(), N);
+    f32 min_dot = 1.0f;
+    for (usize i = 0; i < N; i++) min_dot = std::min(min_dot, x[i] * normal.x + y[i] * normal.y + z[i] * normal.z);
+    LT_Check(min_dot >= -1e-6f);
+
+    lt::sample_quat(&batch, w.data(), x.data(), y.data(), z.data(), N);
+    max_error = 0.0;
+    for (usize i = 0; i < N; i++)
+        max_error = std::max(max_error, std::abs(std::sqrt((f64)w[i] * w[i] + (f64)x[i] * x[i] + (f64)y[i] * y[i] +
+                                                        (f64)z[i] * z[i]) - 1.0));
+    LT_Check(max_error < 1e-5);
+}
+
+int
+main()
+{
+    test_isa_parity();
+    test_lanes();
+    test_samplers();
+    return lt_test_result("test_random");
+}
@@ -0,0 +1,150 @@
+#include <string>
+#include <vector>
+#include "lt_cpu.hpp"
+#include "lt_random.hpp"
+#include "lt_scan.hpp"
+#include "lt_test.hpp"
+
+// The mask kernels of every CpuIsa tier against a loop over the bytes, and CSV splitting with
+// quoted newlines: the chunks of scan_split start on record boundaries outside quotes, so
+// scanning them one by one gives the records of a scan of the whole text.
+
+lt_internal std::string
+random_csv(Rng *rng, usize size)
+{
+    const char alphabet[] = "abc,,\n\"\"\r 01";
+    std::string text;
+    for (usize i = 0; i < size; i++) text += alphabet[lt::rng_next(rng) % (sizeof(alphabet) - 1)];
+    return text;
+}
+
+// Records by a byte loop, quotes toggling the newlines off.
+lt_internal std::vector<std::string>
+reference_records(const std::string &text, bool quotes)
+{
+    std::vector<std::string> records;
+    usize start = 0;
+    bool inside = false;
+    for (usize i = 0; i < text.size(); i++)
+    {
+        if (quotes && text[i] == '"') inside = !inside;
+        if (text[i] == '\n' && !inside)
+        {
+            usize len = i - start;
+            if (len > 0 && text[i - 1] == '\r') len--;
+            records.push_back(text.substr(start, len));
+            start = i + 1;
+        }
+    }
+    if (start < text.size())
+    {
+        usize len = text.size() - start;
+        if (text.back() == '\r') len--;
+        records.push_back(text.substr(start, len));
+    }
+    return records;
+}
+
+lt_internal std::vector<std::string>
+scan_all(const char *data, usize size, const ScanOptions &options)
+{
+    std::vector<std::string> records;
+    lt::scan_records(data, size, options, [&](const char *record, usize len) { records.emplace_back(record, len); });
+    return records;
+}
+
+lt_internal void
+test_kernels()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 21);
+    const CpuIsa saved = lt::cpu_isa();
+    const CpuIsa isas[] = {CpuIsa_Scalar, CpuIsa_SSE2, CpuIsa_AVX2, CpuIsa_AVX512};
+    u32 bad = 0;
+    for (usize size : {0, 1, 63, 64, 65, 200, 4095, 64 * LT_SCAN_WINDOW_BLOCKS + 17})
+    {
+        const std::string text = random_csv(&rng, size);
+        for (CpuIsa isa : isas)
+        {
+            // cpu_set_isa clamps to the detected tier, so the last ones may repeat.
+            lt::cpu_set_isa(isa);
+            ScanMasks masks[LT_SCAN_WINDOW_BLOCKS];
+            const usize blocks = lt::scan_masks_window(text.data(), text.size(), ';', masks);
+            for (usize i = 0; i < size && i < 64 * LT_SCAN_WINDOW_BLOCKS; i++)
+            {
+                const ScanMasks &m = masks[i / 64];
+                const u64 bit = (u64)1 << (i % 64);
+                if (((m.newline & bit) != 0) != (text[i] == '\n')) bad++;
+                if (((m.delimiter & bit) != 0) != (text[i] == ';')) bad++;
+                if (((m.quote & bit) != 0) != (text[i] == '"')) bad++;
+            }
+            if (size % 64 && size < 64 * LT_SCAN_WINDOW_BLOCKS && masks[blocks - 1].newline >> (size % 64)) bad++;
+
+            usize count = 0;
+            for (char c : text) count += c == ',';
+            if (lt::scan_count(text.data(), text.size(), ',') != count) bad++;
+            const char *end = text.data() + text.size();
+            const usize first = text.find('\r');
+            const char *found = lt::scan_find(text.data(), end, '\r');
+            if (found != (first == std::string::npos ? end : text.data() + first)) bad++;
+        }
+    }
+    lt::cpu_set_isa(saved);
+    LT_Check(bad == 0);
+}
+
+lt_internal void
+test_records_and_split()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 22);
+    u32 bad = 0;
+    for (usize size : {1, 100, 5000, 100000})
+    {
+        const std::string text = random_csv(&rng, size);
+        for (bool quotes : {false, true})
+        {
+            ScanOptions options;
+            options.quotes = quotes;
+            const std::vector<std::string> expected = reference_records(text, quotes);
+            if (scan_all(text.data(), text.size(), options) != expected) bad++;
+
+            for (usize max_chunks : {1, 2, 7, 64})
+            {
+                std::vector<TextChunk> chunks(max_chunks);
+                const usize n = lt::scan_split(text.data(), text.size(), options, chunks.data(), max_chunks);
+                if (n == 0 || n > max_chunks || chunks[0].begin != text.data() || chunks[n - 1].end != text.data() + text.size())
+                {
+                    bad++;
+                    continue;
+                }
+                std::vector<std::string> records;
+                for (usize i = 0; i < n; i++)
+                {
+                    if (i > 0 && chunks[i].begin != chunks[i - 1].end) bad++;
+                    const std::vector<std::string> part = scan_all(chunks[i].begin, (usize)(chunks[i].end - chunks[i].begin), options);
+                    records.insert(records.end(), part.begin(), part.end());
+                }
+                if (records != expected) bad++;
+            }
+        }
+    }
+    LT_Check(bad == 0);
+
+    // A quoted newline right at a nominal boundary.
+    const std::string csv = "a,\"x\ny\"\nb,c\n";
+    ScanOptions options;
+    options.quotes = true;
+    TextChunk chunks[4];
+    const usize n = lt::scan_split(csv.data(), csv.size(), options, chunks, 4);
+    LT_Require(n >= 1);
+    LT_Check(chunks[0].end == csv.data() + 8);
+}
+
+int
+main()
+{
+    test_kernels();
+    test_records_and_split();
+    return lt_test_result("test_scan");
+}
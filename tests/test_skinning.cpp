@@ -0,0 +1,273 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "lt_cpu.hpp"
+#include "lt_random.hpp"
+#include "lt_skinning.hpp"
+#include "lt_test.hpp"
+
+// lt::decompose against the translation, rotation and scale a matrix was built from, and its
+// documented degenerate cases. Skinning against a blend done in double precision on every
+// CpuIsa tier, with and without normals, in place and in the fused and two pass versions.
+
+#define TEST_VERTICES 10007   // Not a multiple of any kernel width.
+#define TEST_JOINTS   64
+#define TEST_INFLUENCES 4
+
+lt_internal f32
+random_signed(Rng *rng)
+{
+    return (f32)(lt::rng_f64(rng) * 2.0 - 1.0);
+}
+
+lt_internal Quatf
+random_unit_quat(Rng *rng)
+{
+    for (;;)
+    {
+        const f64 w = random_signed(rng), x = random_signed(rng), y = random_signed(rng), z = random_signed(rng);
+        const f64 len = std::sqrt(w*w + x*x + y*y + z*z);
+        if (len > 0.1 && len <= 1.0) return Quatf((f32)(w / len), (f32)(x / len), (f32)(y / len), (f32)(z / len));
+    }
+}
+
+// Largest component difference, q and -q being the same rotation.
+lt_internal f64
+quat_error(const Quatf &a, const Quatf &b)
+{
+    f64 dot = 0.0;
+    for (i32 j = 0; j < 4; j++) dot += (f64)a.val[j] * b.val[j];
+    const f64 sign = (dot < 0) ? -1.0 : 1.0;
+    f64 error = 0.0;
+    for (i32 j = 0; j < 4; j++) error = std::fmax(error, std::fabs(sign * a.val[j] - b.val[j]));
+    return error;
+}
+
+lt_internal void
+test_decompose()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 46);
+    const usize N = 100000;
+    std::vector<Mat4f> matrices(N);
+    std::vector<Vec3f> translations(N), scales(N), out_translations(N), out_scales(N);
+    std::vector<Quatf> rotations(N), out_rotations(N);
+    for (usize i = 0; i < N; i++)
+    {
+        translations[i] = Vec3f(10 * random_signed(&rng), 10 * random_signed(&rng), 10 * random_signed(&rng));
+        rotations[i] = random_unit_quat(&rng);
+        // Scales from 0.1 to 10, the z one mirrored now and then.
+        for (i32 j = 0; j < 3; j++) scales[i].val[j] = (f32)std::pow(10.0, random_signed(&rng));
+        if (i % 5 == 0) scales[i].z = -scales[i].z;
+        matrices[i] = lt::trs_matrix(translations[i], rotations[i], scales[i]);
+    }
+    lt::decompose(matrices.data(), out_translations.data(), out_rotations.data(), out_scales.data(), N);
+
+    f64 rotation = 0.0, scale = 0.0;
+    u32 mismatches = 0;
+    for (usize i = 0; i < N; i++)
+    {
+        Vec3f t, s;
+        Quatf r;
+        lt::decompose(matrices[i], &t, &r, &s);
+        if (memcmp(&t, &out_translations[i], sizeof(t)) != 0 || memcmp(&r, &out_rotations[i], sizeof(r)) != 0 ||
+            memcmp(&s, &out_scales[i], sizeof(s)) != 0)
+            mismatches++;
+        if (!(t == translations[i])) mismatches++;
+        rotation = std::fmax(rotation, quat_error(r, rotations[i]));
+        for (i32 j = 0; j < 3; j++) scale = std::fmax(scale, std::fabs((f64)s.val[j] / scales[i].val[j] - 1.0));
+    }
+    printf("decompose rotation error %.3g, relative scale error %.3g\n", rotation, scale);
+    LT_Check(mismatches == 0);
+    LT_Check(rotation <= 2.3e-6);
+    LT_Check(scale <= 2.3e-6);
+
+    // A zero column gets a zero scale and an axis completed from the other ones.
+    Vec3f t, s;
+    Quatf r;
+    lt::decompose(lt::trs_matrix(Vec3f(1, 2, 3), rotations[0], Vec3f(2, 0, 3)), &t, &r, &s);
+    LT_Check(quat_error(r, rotations[0]) <= 2.3e-6);
+    LT_Check(std::fabs(s.x - 2) <= 1e-5f && s.y == 0 && std::fabs(s.z - 3) <= 1e-5f);
+
+    // The zero matrix gives the identity rotation.
+    lt::decompose(Mat4f(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0), &t, &r, &s);
+    LT_Check(r == Quatf::identity());
+    LT_Check(s.x == 0 && s.y == 0 && s.z == 0);
+
+    // Shear is dropped, the rotation comes from the x column and the x, y plane.
+    lt::decompose(Mat4f(1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1), &t, &r, &s);
+    LT_Check(quat_error(r, Quatf::identity()) <= 1e-7);
+    LT_Check(s.x == 1 && s.y == 1 && s.z == 1);
+}
+
+struct SkinMesh
+{
+    std::vector<DualQuatf> palette;
+    std::vector<u16> joints;
+    std::vector<f32> weights;
+    std::vector<f32> x, y, z, nx, ny, nz;
+};
+
+lt_internal void
+make_mesh(SkinMesh *mesh)
+{
+    Rng rng;
+    lt::rng_seed(&rng, 47);
+    std::vector<Mat4f> matrices(TEST_JOINTS);
+    for (Mat4f &m : matrices)
+    {
+        // The scale is dropped by skin_palette.
+        const Vec3f scale((f32)(1 + lt::rng_f64(&rng)), 1, 1);
+        m = lt::trs_matrix(Vec3f(random_signed(&rng), random_signed(&rng), random_signed(&rng)),
+                           random_unit_quat(&rng), scale);
+    }
+    mesh->palette.resize(TEST_JOINTS);
+    lt::skin_palette(matrices.data(), mesh->palette.data(), TEST_JOINTS);
+
+    mesh->joints.resize(TEST_VERTICES * TEST_INFLUENCES);
+    mesh->weights.resize(TEST_VERTICES * TEST_INFLUENCES);
+    for (usize i = 0; i < TEST_VERTICES; i++)
+    {
+        f32 sum = 0;
+        for (u32 k = 0; k < TEST_INFLUENCES; k++)
+        {
+            mesh->joints[i * TEST_INFLUENCES + k] = (u16)lt::rng_below(&rng, TEST_JOINTS);
+            const f32 w = (k == 0 || i % 3 != 0) ? (f32)lt::rng_f64(&rng) + 0.01f : 0.0f;
+            mesh->weights[i * TEST_INFLUENCES + k] = w;
+            sum += w;
+        }
+        for (u32 k = 0; k < TEST_INFLUENCES; k++) mesh->weights[i * TEST_INFLUENCES + k] /= sum;
+    }
+
+    for (std::vector<f32> *v : {&mesh->x, &mesh->y, &mesh->z, &mesh->nx, &mesh->ny, &mesh->nz})
+    {
+        v->resize(TEST_VERTICES);
+        for (f32 &c : *v) c = random_signed(&rng);
+    }
+}
+
+lt_internal DualQuatd
+to_f64(const DualQuatf &dq)
+{
+    return DualQuatd(Quatd(dq.real.val[0], dq.real.val[1], dq.real.val[2], dq.real.val[3]),
+                     Quatd(dq.dual.val[0], dq.dual.val[1], dq.dual.val[2], dq.dual.val[3]));
+}
+
+// The blend of vertex i in double precision, joints sign aligned with the first one.
+lt_internal DualQuatd
+reference_blend(const SkinMesh &mesh, usize i)
+{
+    const u16 *joints = &mesh.joints[i * TEST_INFLUENCES];
+    const f32 *weights = &mesh.weights[i * TEST_INFLUENCES];
+    const DualQuatd first = to_f64(mesh.palette[joints[0]]);
+    DualQuatd sum(Quatd(0, 0, 0, 0), Quatd(0, 0, 0, 0));
+    for (u32 k = 0; k < TEST_INFLUENCES; k++)
+    {
+        const DualQuatd p = to_f64(mesh.palette[joints[k]]);
+        f64 dot = 0.0;
+        for (i32 j = 0; j < 4; j++) dot += p.real.val[j] * first.real.val[j];
+        const f64 w = (dot < 0) ? -(f64)weights[k] : (f64)weights[k];
+        sum.real = sum.real + p.real * w;
+        sum.dual = sum.dual + p.dual * w;
+    }
+    return lt::normalize(sum);
+}
+
+lt_internal f64
+vec_error(const Vec3d &expected, f32 x, f32 y, f32 z)
+{
+    return std::fmax(std::fabs(expected.x - x), std::fmax(std::fabs(expected.y - y), std::fabs(expected.z - z)));
+}
+
+// Largest error of the skinned positions and normals, absolute since the vertices are in the unit
+// cube and the joints move them by less than 2.
+lt_internal f64
+skin_error(const SkinMesh &mesh, const std::vector<DualQuatd> &blends, const SkinVertices &out, bool normals)
+{
+    f64 error = 0.0;
+    for (usize i = 0; i < TEST_VERTICES; i++)
+    {
+        const Vec3d p = lt::transform_point(blends[i], Vec3d(mesh.x[i], mesh.y[i], mesh.z[i]));
+        error = std::fmax(error, vec_error(p, out.x[i], out.y[i], out.z[i]));
+        if (!normals) continue;
+        const Vec3d n = lt::transform_direction(blends[i], Vec3d(mesh.nx[i], mesh.ny[i], mesh.nz[i]));
+        error = std::fmax(error, vec_error(n, out.nx[i], out.ny[i], out.nz[i]));
+    }
+    return error;
+}
+
+lt_internal void
+test_skinning()
+{
+    SkinMesh mesh;
+    make_mesh(&mesh);
+    std::vector<DualQuatd> blends(TEST_VERTICES);
+    for (usize i = 0; i < TEST_VERTICES; i++) blends[i] = reference_blend(mesh, i);
+
+    std::vector<f32> x(TEST_VERTICES), y(TEST_VERTICES), z(TEST_VERTICES);
+    std::vector<f32> nx(TEST_VERTICES), ny(TEST_VERTICES), nz(TEST_VERTICES);
+    std::vector<DualQuatf> transforms(TEST_VERTICES);
+    const SkinVertices in = {mesh.x.data(), mesh.y.data(), mesh.z.data(), mesh.nx.data(), mesh.ny.data(), mesh.nz.data()};
+    const SkinVertices out = {x.data(), y.data(), z.data(), nx.data(), ny.data(), nz.data()};
+    const SkinVertices in_positions = {mesh.x.data(), mesh.y.data(), mesh.z.data(), nullptr, nullptr, nullptr};
+    const SkinVertices out_positions = {x.data(), y.data(), z.data(), nullptr, nullptr, nullptr};
+
+    const CpuIsa saved = lt::cpu_isa();
+    const CpuIsa isas[] = {CpuIsa_Scalar, CpuIsa_SSE2, CpuIsa_AVX2, CpuIsa_AVX512};
+    lt::cpu_set_isa(CpuIsa_Scalar);
+    LT_Check(strcmp(lt::skin_kernel_name(), "scalar") == 0);
+    for (CpuIsa isa : isas)
+    {
+        // cpu_set_isa clamps to the detected tier, so the last ones may repeat.
+        lt::cpu_set_isa(isa);
+        const char *name = lt::skin_kernel_name();
+
+        f64 blend = 0.0;
+        lt::skin_blend(mesh.palette.data(), mesh.joints.data(), mesh.weights.data(), TEST_INFLUENCES,
+                       transforms.data(), TEST_VERTICES);
+        for (usize i = 0; i < TEST_VERTICES; i++)
+        {
+            const DualQuatd q = to_f64(transforms[i]);
+            for (i32 j = 0; j < 4; j++)
+            {
+                blend = std::fmax(blend, std::fabs(q.real.val[j] - blends[i].real.val[j]));
+                blend = std::fmax(blend, std::fabs(q.dual.val[j] - blends[i].dual.val[j]));
+            }
+        }
+
+        lt::skin_vertices(mesh.palette.data(), mesh.joints.data(), mesh.weights.data(), TEST_INFLUENCES, in, out,
+                          TEST_VERTICES);
+        const f64 fused = skin_error(mesh, blends, out, true);
+
+        lt::skin_apply(transforms.data(), in, out, TEST_VERTICES);
+        const f64 two_pass = skin_error(mesh, blends, out, true);
+
+        lt::skin_vertices(mesh.palette.data(), mesh.joints.data(), mesh.weights.data(), TEST_INFLUENCES,
+                          in_positions, out_positions, TEST_VERTICES);
+        const f64 positions = skin_error(mesh, blends, out_positions, false);
+
+        // In place.
+        SkinMesh copy = mesh;
+        const SkinVertices inout = {copy.x.data(), copy.y.data(), copy.z.data(), copy.nx.data(), copy.ny.data(), copy.nz.data()};
+        lt::skin_vertices(mesh.palette.data(), mesh.joints.data(), mesh.weights.data(), TEST_INFLUENCES, inout, inout,
+                          TEST_VERTICES);
+        const f64 in_place = skin_error(mesh, blends, inout, true);
+
+        printf("skinning %s: blend error %.3g, vertex error %.3g fused, %.3g two pass, %.3g positions only, %.3g in place\n",
+               name, blend, fused, two_pass, positions, in_place);
+        LT_Check(blend <= 1.2e-6);
+        LT_Check(fused <= 1.2e-6);
+        LT_Check(two_pass <= 1.2e-6);
+        LT_Check(positions <= 1.2e-6);
+        LT_Check(in_place <= 1.2e-6);
+    }
+    lt::cpu_set_isa(saved);
+}
+
+int
+main()
+{
+    test_decompose();
+    test_skinning();
+    return lt_test_result("test_skinning");
+}
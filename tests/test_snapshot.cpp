@@ -0,0 +1,90 @@
+#include <cstdio>
+#include <vector>
+#include "lt_snapshot.hpp"
+#include "lt_test.hpp"
+
+// A snapshot reads back with its sections, and the writer frees its buffers on every way out:
+// snapshot_end, snapshot_abort, a failed open and an error before snapshot_end.
+
+#define TEST_SNAPSHOT_PATH "test_snapshot.bin"
+
+lt_internal bool
+buffers_freed(const SnapshotWriter &writer)
+{
+    return !writer.file.buffers[0] && !writer.file.buffers[1] && writer.file.fd < 0;
+}
+
+lt_internal void
+test_round_trip()
+{
+    std::vector<u32> numbers(100000);
+    for (u32 i = 0; i < numbers.size(); i++) numbers[i] = i * 7;
+    const Vec3f points[3] = {Vec3f(1, 2, 3), Vec3f(4, 5, 6), Vec3f(7, 8, 9)};
+
+    SnapshotWriter writer;
+    LT_Require(lt::snapshot_begin(&writer, TEST_SNAPSHOT_PATH));
+    LT_Check(lt::snapshot_write(&writer, "numbers", numbers.data(), numbers.size()));
+    LT_Check(lt::snapshot_write(&writer, "points", points, 3));
+    LT_Check(lt::snapshot_end(&writer));
+    LT_Check(buffers_freed(writer));
+
+    SnapshotReader reader;
+    LT_Require(lt::snapshot_open(&reader, TEST_SNAPSHOT_PATH));
+    u64 count = 0;
+    const u32 *read_numbers = lt::snapshot_get<u32>(&reader, "numbers", &count);
+    LT_Check(read_numbers && count == numbers.size());
+    if (read_numbers) LT_Check(std::vector<u32>(read_numbers, read_numbers + count) == numbers);
+    const Vec3f *read_points = lt::snapshot_get<Vec3f>(&reader, "points", &count);
+    LT_Check(read_points && count == 3 && read_points[2] == points[2]);
+    lt::snapshot_close(&reader);
+
+    // The same writer again, for a snapshot that is given up.
+    LT_Require(lt::snapshot_begin(&writer, TEST_SNAPSHOT_PATH));
+    LT_Check(lt::snapshot_write(&writer, "numbers", numbers.data(), 10));
+    lt::snapshot_abort(&writer);
+    LT_Check(buffers_freed(writer));
+    LT_Require(lt::snapshot_open(&reader, TEST_SNAPSHOT_PATH));
+    LT_Check(lt::snapshot_get<u32>(&reader, "numbers", &count) && count == numbers.size());
+    lt::snapshot_close(&reader);
+    remove(TEST_SNAPSHOT_PATH);
+}
+
+lt_internal void
+test_errors()
+{
+    SnapshotWriter writer;
+    LT_Check(!lt::snapshot_begin(&writer, "missing_directory/test.bin"));
+    LT_Check(writer.error == SnapshotError_Open);
+    LT_Check(buffers_freed(writer));
+    LT_Check(!lt::snapshot_end(&writer));
+
+    // A name that does not fit fails the snapshot, snapshot_end gives up the file.
+    const u32 value = 1;
+    LT_Require(lt::snapshot_begin(&writer, TEST_SNAPSHOT_PATH));
+    LT_Check(!lt::snapshot_write(&writer, "a_section_name_longer_than_the_limit", &value, 1));
+    LT_Check(writer.error == SnapshotError_Name);
+    LT_Check(!lt::snapshot_end(&writer));
+    LT_Check(buffers_freed(writer));
+    FILE *f = fopen(TEST_SNAPSHOT_PATH, "rb");
+    LT_Check(!f);
+    if (f) fclose(f);
+
+    // A missing file fails the open, an empty one is not a snapshot.
+    SnapshotReader reader;
+    LT_Check(!lt::snapshot_open(&reader, TEST_SNAPSHOT_PATH));
+    LT_Check(reader.error == SnapshotError_Open);
+    f = fopen(TEST_SNAPSHOT_PATH, "wb");
+    LT_Require(f);
+    fclose(f);
+    LT_Check(!lt::snapshot_open(&reader, TEST_SNAPSHOT_PATH));
+    LT_Check(reader.error == SnapshotError_Format);
+    remove(TEST_SNAPSHOT_PATH);
+}
+
+int
+main()
+{
+    test_round_trip();
+    test_errors();
+    return lt_test_result("test_snapshot");
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include "lt_cpu.hpp"
+#include "lt_random.hpp"
+#include "lt_sort.hpp"
+#include "lt_test.hpp"
+
+// Radix sorts against std::stable_sort, on sizes around the parallel threshold and on keys
+// with few significant bits (skipped passes).
+
+template<typename K> lt_internal void
+check_radix_sort(Rng *rng, usize count, u32 bits, bool with_values)
+{
+    std::vector<K> keys(count);
+    std::vector<u32> values(count);
+    std::vector<std::pair<K, u32>> expected(count);
+    for (usize i = 0; i < count; i++)
+    {
+        K key = (K)lt::rng_next(rng);
+        if (bits < sizeof(K) * 8) key &= ((K)1 << bits) - 1;
+        keys[i] = key;
+        values[i] = (u32)i;
+        expected[i] = std::make_pair(key, (u32)i);
+    }
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const std::pair<K, u32> &a, const std::pair<K, u32> &b) { return a.first < b.first; });
+
+    LT_Require(lt::radix_sort(keys.data(), with_values ? values.data() : nullptr, count));
+    usize mismatches = 0;
+    for (usize i = 0; i < count; i++)
+    {
+        if (keys[i] != expected[i].first) mismatches++;
+        else if (with_values && values[i] != expected[i].second) mismatches++;
+    }
+    if (mismatches)
+        fprintf(stderr, "radix_sort u%d count %zu bits %u values %d: %zu mismatches\n",
+                (int)sizeof(K) * 8, count, bits, (int)with_values, mismatches);
+    LT_Check(mismatches == 0);
+}
+
+lt_internal void
+test_radix_sort()
+{
+    Rng rng;
+    lt::rng_seed(&rng, 1);
+    const usize counts[] = {0, 1, 5, 63, 64, 65, 1000, 65535, 65536, 200000, 1000003};
+    const u32 bits[] = {3, 8, 12, 30, 32, 63, 64};
+    for (usize count : counts)
+        for (u32 b : bits)
+            for (bool with_values : {false, true})
+            {
+                if (b <= 32) check_radix_sort<u32>(&rng, count, b, with_values);
+                check_radix_sort<u64>(&rng, count, b, with_values);
+            }
+}
+
+lt_internal void
+test_keys()
+{
+    const f32 ordered[] = {-INFINITY, -1e30f, -2.0f, -1.0f, -0.0f, 0.0f, 1e-40f, 1.0f, 3.0f, INFINITY};
+    for (usize i = 0; i < LT_Count(ordered); i++)
+    {
+        if (i > 0) LT_Check(lt::f32_sort_key(ordered[i - 1]) < lt::f32_sort_key(ordered[i]));
+        const f32 back = lt::f32_from_sort_key(lt::f32_sort_key(ordered[i]));
+        LT_Check(back == ordered[i] && std::signbit(back) == std::signbit(ordered[i]));
+    }
+
+    Rng rng;
+    lt::rng_seed(&rng, 2);
+    for (u32 i = 0; i < 10000; i++)
+    {
+        const u32 x = (u32)lt::rng_next(&rng), y = (u32)lt::rng_next(&rng), z = (u32)lt::rng_next(&rng);
+        u64 expected = 0;
+        for (u32 b = 0; b < 21; b++)
+            expected |= ((u64)((x >> b) & 1) << (3 * b)) | ((u64)((y >> b) & 1) << (3 * b + 1)) |
+                ((u64)((z >> b) & 1) << (3 * b + 2));
+        LT_Check(lt::morton3_64(x, y, z) == expected);
+        LT_Check(lt::morton3_32(x, y, z) == (u32)(expected & 0x3fffffff));
+    }
+}
+
+lt_internal void
+test_morton_kernels()
+{
+    const usize N = 100003;
+    std::vector<Vec3f> positions(N);
+    Rng rng;
+    lt::rng_seed(&rng, 3);
+    for (Vec3f &p : positions)
+        p = Vec3f(lt::rng_f32(&rng) * 200.0f - 100.0f, lt::rng_f32(&rng) * 200.0f - 100.0f,
+                  lt::rng_f32(&rng) * 200.0f - 100.0f);
+    positions[3] = Vec3f(NAN, 1e9f, -1e9f);
+    const AABB bounds = {Vec3f(-100.0f, -100.0f, -100.0f), Vec3f(100.0f, 100.0f, 100.0f)};
+
+    std::vector<u32> keys32[2] = {std::vector<u32>(N), std::vector<u32>(N)};
+    std::vector<u64> keys64[2] = {std::vector<u64>(N), std::vector<u64>(N)};
+    const CpuIsa isas[2] = {CpuIsa_Scalar, lt::cpu_detected_isa()};
+    const CpuIsa saved = lt::cpu_isa();
+    for (u32 i = 0; i < 2; i++)
+    {
+        lt::cpu_set_isa(isas[i]);
+        lt::morton_keys(positions.data(), N, bounds, keys32[i].data());
+        lt::morton_keys(positions.data(), N, bounds, keys64[i].data());
+    }
+    lt::cpu_set_isa(saved);
+    LT_Check(keys32[0] == keys32[1]);
+    LT_Check(keys64[0] == keys64[1]);
+
+    // Back to front: the depth along `forward` never increases.
+    const Vec3f forward(0.3f, -0.5f, 0.8f);
+    std::vector<u32> order(N);
+    LT_Require(lt::sort_by_depth(positions.data(), N, forward, true, order.data()));
+    usize bad = 0;
+    for (usize i = 1; i < N; i++)
+    {
+        if (order[i] == 3 || order[i - 1] == 3) continue;
+        if (lt::dot(positions[order[i - 1]], forward) < lt::dot(positions[order[i]], forward)) bad++;
+    }
+    LT_Check(bad == 0);
+}
+
+int
+main()
+{
+    test_radix_sort();
+    test_keys();
+    test_morton_kernels();
+    return lt_test_result("test_sort");
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <vector>
+#include "lt_random.hpp"
+#include "lt_spatial.hpp"
+#include "lt_test.hpp"
+
+// A build large enough for the parallel path (on machines with more than one thread) must
+// give the layout of the serial counting sort: buckets in order, each one holding its point
+// indices in increasing order. Radius queries are compared with a brute force loop, before
+// and after an update that moves some points to other cells.
+
+lt_internal void
+check_layout(const SpatialHash &grid, const Vec3f *positions)
+{
+    u32 bad = 0;
+    for (u32 b = 0; b < grid.num_buckets; b++)
+    {
+        const u32 begin = grid.bucket_start[b], end = grid.bucket_start[b + 1];
+        if (end < begin) bad++;
+        for (u32 s = begin; s < end; s++)
+        {
+            const u32 index = grid.indices[s];
+            if (s > begin && grid.indices[s - 1] >= index) bad++;
+            if (grid.point_bucket[index] != b || grid.point_slot[index] != s) bad++;
+            if (grid.positions[s] != positions[index]) bad++;
+        }
+    }
+    LT_Check(bad == 0);
+    LT_Check(grid.bucket_start[grid.num_buckets] == grid.num_points);
+}
+
+lt_internal void
+check_queries(const SpatialHash &grid, const std::vector<Vec3f> &positions, Rng *rng)
+{
+    u32 bad = 0;
+    std::vector<u32> found, expected;
+    for (u32 q = 0; q < 200; q++)
+    {
+        const Vec3f center(lt::rng_f32(rng) * 100.0f, lt::rng_f32(rng) * 100.0f, lt::rng_f32(rng) * 10.0f);
+        const f32 radius = 0.5f + lt::rng_f32(rng) * 2.0f;
+        found.clear();
+        expected.clear();
+        lt::spatial_hash_visit_radius(grid, center, radius, [&](u32 index, Vec3f) { found.push_back(index); });
+        for (u32 i = 0; i < (u32)positions.size(); i++)
+        {
+            const Vec3f d = positions[i] - center;
+            if (d.x*d.x + d.y*d.y + d.z*d.z <= radius * radius) expected.push_back(i);
+        }
+        std::sort(found.begin(), found.end());
+        if (found != expected) bad++;
+    }
+    LT_Check(bad == 0);
+}
+
+lt_internal void
+test_build_and_update()
+{
+    const u32 count = 300000;
+    Rng rng;
+    lt::rng_seed(&rng, 11);
+    std::vector<Vec3f> positions(count);
+    for (Vec3f &p : positions)
+        p = Vec3f(lt::rng_f32(&rng) * 100.0f, lt::rng_f32(&rng) * 100.0f, lt::rng_f32(&rng) * 10.0f);
+
+    // Default table size, and a small table where every bucket holds hundreds of points.
+    for (u32 num_buckets : {0u, 1024u})
+    {
+        SpatialHash grid;
+        lt::spatial_hash_init(&grid, 1.0f, num_buckets);
+        LT_Require(lt::spatial_hash_build(&grid, positions.data(), count));
+        check_layout(grid, positions.data());
+        check_queries(grid, positions, &rng);
+
+        std::vector<u32> moved;
+        for (u32 i = 0; i < count; i += 997)
+        {
+            positions[i].x = 100.0f - positions[i].x;
+            moved.push_back(i);
+        }
+        LT_Require(lt::spatial_hash_update(&grid, positions.data(), moved.data(), (u32)moved.size()));
+        check_queries(grid, positions, &rng);
+
+        LT_Require(lt::spatial_hash_build(&grid, positions.data(), count));
+        check_layout(grid, positions.data());
+        lt::spatial_hash_destroy(&grid);
+    }
+}
+
+int
+main()
+{
+    test_build_and_update();
+    return lt_test_result("test_spatial");
+}
@@ -0,0 +1,57 @@
+#include <atomic>
+#include <vector>
+#include "lt_task.hpp"
+#include "lt_test.hpp"
+
+// Posts from the pool's own threads must not block on a full queue: a single worker that
+// schedules more leaves than the queue holds would wait for itself. Posts from other threads
+// still wait for room.
+
+lt_internal lt::Task<void>
+leaf(lt::TaskPool *pool, std::atomic<u32> *done)
+{
+    co_await pool->schedule();
+    done->fetch_add(1);
+}
+
+lt_internal lt::Task<void>
+fan_out(lt::TaskPool *pool, std::atomic<u32> *done, u32 count)
+{
+    // when_all starts every leaf on the calling thread, here the worker.
+    co_await pool->schedule();
+    std::vector<lt::Task<void>> leaves;
+    leaves.reserve(count);
+    for (u32 i = 0; i < count; i++) leaves.push_back(leaf(pool, done));
+    co_await lt::when_all(std::move(leaves));
+}
+
+lt_internal void
+test_worker_fan_out()
+{
+    lt::TaskPool pool(1, 1);
+    for (u32 count : {5000u, 20000u})
+    {
+        std::atomic<u32> done{0};
+        lt::sync_wait(fan_out(&pool, &done, count));
+        LT_Check(done.load() == count);
+    }
+}
+
+lt_internal void
+test_external_fan_out()
+{
+    lt::TaskPool pool(1, 1);
+    std::atomic<u32> done{0};
+    std::vector<lt::Task<void>> leaves;
+    for (u32 i = 0; i < 10000; i++) leaves.push_back(leaf(&pool, &done));
+    lt::sync_wait(lt::when_all(std::move(leaves)));
+    LT_Check(done.load() == 10000);
+}
+
+int
+main()
+{
+    test_worker_fan_out();
+    test_external_fan_out();
+    return lt_test_result("test_task");
+}